@@ -0,0 +1,217 @@
+/* Bounded head+tail capture
+ * Collector output streams through a fixed head buffer and a ring buffer for the tail,
+ * so a multi-gigabyte log costs no more memory than the section budget and the newest
+ * lines (usually the interesting ones) are never the ones cut off.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "capture.h"
+
+#define CAPTURE_READ_CHUNK 65536
+
+void capture_init(Capture *c, size_t budget) {
+    memset(c, 0, sizeof(*c));
+    size_t usable = budget > CAPTURE_MARKER_MAX * 4 ? budget - CAPTURE_MARKER_MAX : budget;
+    c->head_cap = usable / 4;
+    c->tail_cap = usable - c->head_cap;
+}
+
+static uint64_t count_newlines(const char *p, size_t n) {
+    uint64_t lines = 0;
+    const char *end = p + n;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        lines++;
+        p++;
+    }
+    return lines;
+}
+
+// Count and forget the n oldest bytes of the ring
+static void drop_oldest(Capture *c, size_t n) {
+    size_t start = (c->tail_pos + c->tail_cap - c->tail_len) % c->tail_cap;
+    size_t first = c->tail_cap - start < n ? c->tail_cap - start : n;
+    c->skipped_lines += count_newlines(c->tail + start, first);
+    c->skipped_lines += count_newlines(c->tail, n - first);
+    c->skipped_bytes += n;
+    c->tail_len -= n;
+}
+
+int capture_write(Capture *c, const char *data, size_t n) {
+    c->total_bytes += n;
+
+    if (c->head_len < c->head_cap) {
+        size_t k = c->head_cap - c->head_len < n ? c->head_cap - c->head_len : n;
+        if (c->head_len + k > c->head_alloc) {
+            size_t alloc = c->head_alloc ? c->head_alloc * 2 : 4096;
+            while (alloc < c->head_len + k) alloc *= 2;
+            if (alloc > c->head_cap) alloc = c->head_cap;
+            char *p = realloc(c->head, alloc);
+            if (!p) return -1;
+            c->head = p;
+            c->head_alloc = alloc;
+        }
+        memcpy(c->head + c->head_len, data, k);
+        c->head_len += k;
+        data += k;
+        n -= k;
+    }
+    if (n == 0) return 0;
+    if (c->tail_cap == 0) {
+        c->skipped_lines += count_newlines(data, n);
+        c->skipped_bytes += n;
+        return 0;
+    }
+    if (!c->tail) {
+        c->tail = malloc(c->tail_cap);
+        if (!c->tail) return -1;
+    }
+
+    if (n >= c->tail_cap) {
+        // The whole ring and the start of data fall out
+        drop_oldest(c, c->tail_len);
+        size_t lost = n - c->tail_cap;
+        c->skipped_lines += count_newlines(data, lost);
+        c->skipped_bytes += lost;
+        memcpy(c->tail, data + lost, c->tail_cap);
+        c->tail_pos = 0;
+        c->tail_len = c->tail_cap;
+        return 0;
+    }
+    if (c->tail_len + n > c->tail_cap) drop_oldest(c, c->tail_len + n - c->tail_cap);
+    size_t first = c->tail_cap - c->tail_pos < n ? c->tail_cap - c->tail_pos : n;
+    memcpy(c->tail + c->tail_pos, data, first);
+    memcpy(c->tail, data + first, n - first);
+    c->tail_pos = (c->tail_pos + n) % c->tail_cap;
+    c->tail_len += n;
+    return 0;
+}
+
+int capture_fill(Capture *c, int fd) {
+    char chunk[CAPTURE_READ_CHUNK];
+    ssize_t r = read(fd, chunk, sizeof(chunk));
+    if (r < 0) return (errno == EINTR || errno == EAGAIN) ? 1 : -1;
+    if (r == 0) return 0;
+    return capture_write(c, chunk, (size_t)r) == 0 ? 1 : -1;
+}
+
+// The "... [N bytes, M lines skipped] ..." line, on a line of its own
+static size_t format_marker(char marker[CAPTURE_MARKER_MAX], int after_partial_line, uint64_t bytes, uint64_t lines) {
+    int mlen = snprintf(marker, CAPTURE_MARKER_MAX, "%s... [%llu bytes, %llu lines skipped] ...\n",
+                        after_partial_line ? "\n" : "", (unsigned long long)bytes, (unsigned long long)lines);
+    if (mlen < 0) return 0;
+    return (size_t)mlen >= CAPTURE_MARKER_MAX ? CAPTURE_MARKER_MAX - 1 : (size_t)mlen;
+}
+
+char* capture_finish(Capture *c, size_t *out_len) {
+    size_t head_len = c->head_len;
+    size_t tail_start = (c->tail_pos + c->tail_cap - c->tail_len) % (c->tail_cap ? c->tail_cap : 1);
+    size_t tail_len = c->tail_len;
+
+    if (c->skipped_bytes > 0) {
+        // Cut at line boundaries: the head ends after its last newline and the tail
+        // starts after its first one; the partial lines count as skipped.
+        const char *nl = head_len ? memrchr(c->head, '\n', head_len) : NULL;
+        if (nl) {
+            size_t keep = (size_t)(nl - c->head) + 1;
+            c->skipped_bytes += head_len - keep;
+            head_len = keep;
+        }
+        for (size_t i = 0; i < tail_len; ++i) {
+            if (c->tail[(tail_start + i) % c->tail_cap] == '\n') {
+                c->skipped_bytes += i + 1;
+                c->skipped_lines++;
+                tail_start = (tail_start + i + 1) % c->tail_cap;
+                tail_len -= i + 1;
+                break;
+            }
+        }
+    }
+
+    char marker[CAPTURE_MARKER_MAX];
+    int mlen = 0;
+    if (c->skipped_bytes > 0) {
+        mlen = (int)format_marker(marker, head_len && c->head[head_len - 1] != '\n', c->skipped_bytes, c->skipped_lines);
+    }
+
+    char *out = malloc(head_len + (size_t)mlen + tail_len + 1);
+    if (out) {
+        size_t p = 0;
+        if (head_len) memcpy(out, c->head, head_len);
+        p += head_len;
+        memcpy(out + p, marker, (size_t)mlen);
+        p += (size_t)mlen;
+        if (tail_len) {
+            size_t first = c->tail_cap - tail_start < tail_len ? c->tail_cap - tail_start : tail_len;
+            memcpy(out + p, c->tail + tail_start, first);
+            memcpy(out + p + first, c->tail, tail_len - first);
+            p += tail_len;
+        }
+        out[p] = '\0';
+        if (out_len) *out_len = p;
+    }
+    capture_free(c);
+    return out;
+}
+
+void capture_free(Capture *c) {
+    free(c->head);
+    free(c->tail);
+    c->head = c->tail = NULL;
+    c->head_len = c->head_alloc = c->tail_len = c->tail_pos = 0;
+}
+
+void capture_cut(const char *data, size_t len, size_t budget, CaptureCut *cut) {
+    // Same split as streaming data through capture_write() in one piece
+    Capture c;
+    capture_init(&c, budget);
+    memset(cut, 0, sizeof(*cut));
+    cut->head_len = len < c.head_cap ? len : c.head_cap;
+    size_t rest = len - cut->head_len;
+    cut->tail_len = rest < c.tail_cap ? rest : c.tail_cap;
+    cut->tail_off = len - cut->tail_len;
+    uint64_t skipped_bytes = rest - cut->tail_len;
+    if (skipped_bytes == 0) {
+        cut->head_len = len;
+        cut->tail_off = len;
+        cut->tail_len = 0;
+        return;
+    }
+    uint64_t skipped_lines = count_newlines(data + cut->head_len, skipped_bytes);
+
+    // Line boundaries, as in capture_finish()
+    const char *nl = cut->head_len ? memrchr(data, '\n', cut->head_len) : NULL;
+    if (nl) {
+        size_t keep = (size_t)(nl - data) + 1;
+        skipped_bytes += cut->head_len - keep;
+        cut->head_len = keep;
+    }
+    nl = cut->tail_len ? memchr(data + cut->tail_off, '\n', cut->tail_len) : NULL;
+    if (nl) {
+        size_t drop = (size_t)(nl - (data + cut->tail_off)) + 1;
+        skipped_bytes += drop;
+        skipped_lines++;
+        cut->tail_off += drop;
+        cut->tail_len -= drop;
+    }
+    cut->marker_len = format_marker(cut->marker, cut->head_len && data[cut->head_len - 1] != '\n',
+                                    skipped_bytes, skipped_lines);
+}
+
+char* capture_bounded_copy(const char *data, size_t len, size_t budget, size_t *out_len) {
+    CaptureCut cut;
+    capture_cut(data, len, budget, &cut);
+    size_t n = cut.head_len + cut.marker_len + cut.tail_len;
+    char *out = malloc(n + 1);
+    if (!out) return NULL;
+    memcpy(out, data, cut.head_len);
+    memcpy(out + cut.head_len, cut.marker, cut.marker_len);
+    memcpy(out + cut.head_len + cut.marker_len, data + cut.tail_off, cut.tail_len);
+    out[n] = '\0';
+    if (out_len) *out_len = n;
+    return out;
+}
@@ -0,0 +1,62 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Default budget for one report section: what append_section keeps, and what every
+// collector is allowed to hold in memory while its output streams in.
+#define CAPTURE_DEFAULT_BUDGET (200 * 1024)
+// Room kept free in the budget for the skip marker
+#define CAPTURE_MARKER_MAX 96
+
+// Bounded output capture: the first quarter of the budget keeps the head of the stream,
+// the rest is a ring buffer holding the newest bytes. Whatever falls out of the ring in
+// between is counted, not stored, so memory stays at the budget whatever the input size.
+typedef struct {
+    char *head;
+    size_t head_len;
+    size_t head_alloc;
+    size_t head_cap;         // head budget
+    char *tail;              // ring buffer, allocated once the head is full
+    size_t tail_cap;
+    size_t tail_pos;         // next write position in the ring
+    size_t tail_len;         // valid bytes in the ring
+    uint64_t total_bytes;    // everything written
+    uint64_t skipped_bytes;  // dropped between head and tail
+    uint64_t skipped_lines;  // newlines among the dropped bytes
+} Capture;
+
+void capture_init(Capture *c, size_t budget);
+
+// Append n bytes. Returns 0, or -1 if memory for the head/ring could not be allocated.
+int capture_write(Capture *c, const char *data, size_t n);
+
+// Read one chunk from fd into the capture.
+// Returns 1 if data was read (or the read should be retried), 0 on EOF, -1 on error.
+int capture_fill(Capture *c, int fd);
+
+// Assemble head, a "... [N bytes, M lines skipped] ..." marker when something was
+// dropped, and tail into one NUL-terminated string no larger than the budget. The cut
+// is moved to line boundaries. Frees the capture's buffers; the counters stay valid.
+// Caller frees the result (NULL only when out of memory).
+char* capture_finish(Capture *c, size_t *out_len);
+
+void capture_free(Capture *c);
+
+// Where a string already in memory is cut to fit budget, without copying it: the first
+// head_len bytes, the marker, then tail_len bytes from tail_off. marker_len is 0 (and the
+// whole string is the head) when it fits.
+typedef struct {
+    size_t head_len;
+    size_t tail_off, tail_len;
+    char marker[CAPTURE_MARKER_MAX];
+    size_t marker_len;
+} CaptureCut;
+
+void capture_cut(const char *data, size_t len, size_t budget, CaptureCut *cut);
+
+// Head+tail cut of a string that is already in memory (e.g. a native collector's output).
+char* capture_bounded_copy(const char *data, size_t len, size_t budget, size_t *out_len);
+
+#endif // CAPTURE_H
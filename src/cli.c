@@ -0,0 +1,819 @@
+/* Headless command line mode
+ * Gathers the same report as the GUI, classifies and fingerprints it, writes it as text
+ * or JSON and optionally files it through the blocking API calls. Nothing in here
+ * refers to the GUI module, so GTK is never loaded. In watch mode the same report runs
+ * on a worker thread whenever the watcher triggers. Every report is also kept in the local
+ * history, which --history, --recurring and --show query without collecting anything.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <signal.h>
+#include <jansson.h>
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <systemd/sd-id128.h>
+#include "cli.h"
+#include "crash_reporter.h"
+#include "severity.h"
+#include "fingerprint.h"
+#include "spool.h"
+#include "history.h"
+#include "watch.h"
+#include "config.h"
+
+typedef struct {
+    int headless;
+    int json;
+    int file_issue;
+    int use_ai;
+    int escalate;
+    int watch;
+    int watch_tuned;         // a watch option was given
+    WatchOptions watch_opts;
+    const char *output;      // NULL or "-" for stdout
+    int history;             // --history, --recurring or --show
+    int history_filtered;    // a history filter was given
+    unsigned long long show_id;
+    HistoryQuery query;
+    char boot_id[SD_ID128_STRING_MAX];
+    char fingerprint[FINGERPRINT_ID_SIZE];
+} CliOptions;
+
+enum { HISTORY_LIST = 1, HISTORY_RECURRING, HISTORY_SHOW };
+
+static const struct option long_options[] = {
+    {"headless", no_argument, NULL, 'H'},
+    {"format", required_argument, NULL, 'f'},
+    {"output", required_argument, NULL, 'o'},
+    {"file-issue", no_argument, NULL, 'i'},
+    {"no-ai", no_argument, NULL, 'n'},
+    {"escalate", no_argument, NULL, 'e'},
+    {"watch", no_argument, NULL, 'w'},
+    {"threshold", required_argument, NULL, 't'},
+    {"window", required_argument, NULL, 'W'},
+    {"cooldown", required_argument, NULL, 'c'},
+    {"history", no_argument, NULL, 'Y'},
+    {"recurring", no_argument, NULL, 'R'},
+    {"show", required_argument, NULL, 'S'},
+    {"since", required_argument, NULL, 's'},
+    {"until", required_argument, NULL, 'u'},
+    {"host", required_argument, NULL, 'N'},
+    {"boot", required_argument, NULL, 'b'},
+    {"fingerprint", required_argument, NULL, 'F'},
+    {"help", no_argument, NULL, 'h'},
+    {"version", no_argument, NULL, 'V'},
+    {NULL, 0, NULL, 0},
+};
+
+typedef struct {
+    const char *action;      // "created", "commented", "queued", "failed", or NULL when not filed
+    char *url;
+} FileResult;
+
+static void usage(FILE *f, const char *prog) {
+    fprintf(f,
+        "Usage: %s [--headless] [options]\n"
+        "Without options the graphical reporter starts.\n"
+        "\n"
+        "  --headless          collect and print the report without a window\n"
+        "  --format=text|json  report format (default text)\n"
+        "  -o, --output=FILE   write the report to FILE instead of stdout\n"
+        "  --file-issue        file the report on GitHub when it has errors (a known crash\n"
+        "                      gets a comment on its issue; offline, it is queued)\n"
+        "  --no-ai             file without the Gemini summary\n"
+        "  --escalate          allow polkit prompts for privileged logs (off when headless)\n"
+        "  --watch             keep running and report whenever new errors show up in the\n"
+        "                      journal, the kernel log or /var/log (one report per trigger;\n"
+        "                      JSON reports are written one per line)\n"
+        "  --threshold=N       watch: error lines needed within the window (default %d;\n"
+        "                      a critical line is always enough)\n"
+        "  --window=SEC        watch: window for the threshold (default %d)\n"
+        "  --cooldown=SEC      watch: quiet time after a report (default %d)\n"
+        "  --history           list the reports kept in the local history, oldest first\n"
+        "  --recurring         list the problems (fingerprints) found in more than one report\n"
+        "  --show=ID           print a report from the history\n"
+        "  --since=TIME        history: reports from TIME on (YYYY-MM-DD[ HH:MM[:SS]], @EPOCH,\n"
+        "                      or an age such as 90m, 12h or 7d)\n"
+        "  --until=TIME        history: reports before TIME\n"
+        "  --host=NAME         history: reports from this host\n"
+        "  --boot=ID|current   history: reports from this boot\n"
+        "  --fingerprint=ID    history: reports with this fingerprint\n"
+        "  -h, --help          show this help\n"
+        "  --version           show the version\n"
+        "\n"
+        "The report options imply --headless. API keys come from the saved key file or from\n"
+        "CRASH_REPORTER_GITHUB_TOKEN and CRASH_REPORTER_GEMINI_KEY. Every report is kept,\n"
+        "compressed, in $XDG_STATE_HOME/crash-reporter/history for %d days or up to %d MB.\n"
+        "\n"
+        "Exit status: 0 nothing worth filing, 1 errors found (and filed when asked),\n"
+        "2 usage error, 3 collection failed, 4 filing failed, 5 queued for sending later.\n"
+        "--watch runs until interrupted and then exits with 0. The history queries exit with\n"
+        "0, or 3 when the history cannot be read.\n",
+        prog, WATCH_THRESHOLD, WATCH_WINDOW_SEC, WATCH_COOLDOWN_SEC, HISTORY_MAX_AGE_DAYS,
+        HISTORY_MAX_BYTES / (1024 * 1024));
+}
+
+// Whether argv asks for a command line mode at all; otherwise it belongs to GTK
+static int wants_cli(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        if (strcmp(a, "-h") == 0 || strcmp(a, "-o") == 0) return 1;
+        if (strncmp(a, "--", 2) != 0) continue;
+        size_t n = strcspn(a + 2, "=");
+        for (const struct option *o = long_options; o->name; ++o) {
+            if (strlen(o->name) == n && strncmp(a + 2, o->name, n) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+static json_t* severity_counts_json(const size_t counts[SEVERITY_LEVELS]) {
+    json_t *obj = json_object();
+    for (int s = SEVERITY_WARNING; s < SEVERITY_LEVELS; ++s) {
+        json_object_set_new(obj, severity_name((Severity)s), json_integer((json_int_t)counts[s]));
+    }
+    return obj;
+}
+
+static void add_section_json(json_t *sections, const char *title, size_t title_len, const char *body,
+                             size_t body_len, const SeverityReport *sev) {
+    while (body_len > 0 && body[body_len - 1] == '\n') body_len--;
+    json_t *sec = json_object();
+    json_object_set_new(sec, "title", json_stringn(title, title_len));
+    json_object_set_new(sec, "text", json_stringn(body, body_len));
+    for (size_t k = 0; k < sev->nsections; ++k) {
+        if (strlen(sev->sections[k].title) == title_len && memcmp(sev->sections[k].title, title, title_len) == 0) {
+            json_object_set_new(sec, "counts", severity_counts_json(sev->sections[k].counts));
+            break;
+        }
+    }
+    json_array_append_new(sections, sec);
+}
+
+// The report's "== title ==" sections as an array of {title, text, counts}. The report
+// knows where its sections are; only their bodies are searched, for sections a collector
+// made of its own (one per crash).
+static json_t* sections_json(const Report *report, const char *text, const SeverityReport *sev) {
+    json_t *sections = json_array();
+    for (size_t i = 0; i < report_nsections(report); ++i) {
+        const ReportSection *sec = report_section(report, i);
+        const char *title = sec->title, *body = text + sec->body_offset;
+        size_t title_len = strlen(title);
+        const char *p = body, *end = body + sec->body_len;
+        while (p < end) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+            if (n >= 6 && memcmp(p, "== ", 3) == 0 && memcmp(p + n - 3, " ==", 3) == 0) {
+                add_section_json(sections, title, title_len, body, (size_t)(p - body), sev);
+                title = p + 3;
+                title_len = n - 6;
+                body = nl ? nl + 1 : end;
+            }
+            p = nl ? nl + 1 : end;
+        }
+        add_section_json(sections, title, title_len, body, (size_t)(end - body), sev);
+    }
+    return sections;
+}
+
+static int write_json(FILE *out, const SystemInfo *info, const Report *report, const char *report_text, const SeverityReport *sev,
+                      int worth, const Fingerprint *fp, const FileResult *filed, const WatchTrigger *trigger,
+                      size_t flags) {
+    json_t *root = json_object();
+    json_object_set_new(root, "version", json_integer(1));
+    json_object_set_new(root, "generated", json_integer((json_int_t)time(NULL)));
+    json_t *system = json_object();
+    json_object_set_new(system, "hostname", json_string(info->hostname ? info->hostname : ""));
+    json_object_set_new(system, "kernel", json_string(info->kernel ? info->kernel : ""));
+    json_object_set_new(system, "os_release", json_string(info->os_release ? info->os_release : ""));
+    json_object_set_new(system, "uptime", json_string(info->uptime ? info->uptime : ""));
+    json_object_set_new(root, "system", system);
+    json_object_set_new(root, "severity", severity_counts_json(sev->counts));
+    json_object_set_new(root, "worth_filing", worth ? json_true() : json_false());
+    if (trigger) {
+        json_t *t = json_object();
+        json_object_set_new(t, "source", json_string(trigger->source));
+        json_object_set_new(t, "line", json_string(trigger->line));
+        json_object_set_new(t, "severity", json_string(severity_name(trigger->severity)));
+        json_object_set_new(t, "lines", json_integer((json_int_t)trigger->lines));
+        json_object_set_new(root, "trigger", t);
+    }
+    if (fp->id[0]) {
+        json_t *f = json_object();
+        json_object_set_new(f, "id", json_string(fp->id));
+        json_object_set_new(f, "summary", json_string(fp->summary));
+        json_object_set_new(root, "fingerprint", f);
+    }
+    if (filed->action) {
+        json_t *issue = json_object();
+        json_object_set_new(issue, "action", json_string(filed->action));
+        if (filed->url) json_object_set_new(issue, "url", json_string(filed->url));
+        json_object_set_new(root, "issue", issue);
+    }
+    json_object_set_new(root, "spool_depth", json_integer((json_int_t)spool_depth()));
+    json_object_set_new(root, "sections", sections_json(report, report_text, sev));
+    char *text = json_dumps(root, flags);
+    json_decref(root);
+    if (!text) return -1;
+    int rc = fputs(text, out) < 0 || fputc('\n', out) == EOF ? -1 : 0;
+    free(text);
+    return rc;
+}
+
+static int write_text(FILE *out, const Report *report, const SeverityReport *sev, int worth, const Fingerprint *fp,
+                      const FileResult *filed, const WatchTrigger *trigger) {
+    report_write(report, out);
+    fprintf(out, "\n== Summary ==\n%zu critical, %zu errors, %zu warnings; %s\n", sev->counts[SEVERITY_CRITICAL],
+            sev->counts[SEVERITY_ERROR], sev->counts[SEVERITY_WARNING], worth ? "worth filing" : "nothing to file");
+    if (trigger) fprintf(out, "Triggered by: %s: %s\n", trigger->source, trigger->line);
+    if (fp->id[0]) fprintf(out, "Fingerprint: %s\n", fp->id);
+    if (filed->action) fprintf(out, "Issue: %s%s%s\n", filed->action, filed->url ? " " : "", filed->url ? filed->url : "");
+    size_t depth = spool_depth();
+    if (depth > 0) fprintf(out, "Queued reports: %zu\n", depth);
+    return ferror(out) ? -1 : 0;
+}
+
+// Queue what could not be sent; the outcome is "queued" or "failed"
+static const char* queue_report(const SpoolReport *q) {
+    return spool_store(q) == 0 ? "queued" : "failed";
+}
+
+// Same order as the GUI: a crash already filed (local index, then GitHub search) gets a
+// comment; anything else a new issue with the AI summary. Transient failures are spooled.
+static FileResult file_report(const SystemInfo *info, Report *report, const Fingerprint *fp, int use_ai) {
+    FileResult res = {"failed", NULL};
+    const char *fp_id = fp->id[0] && fp->components > 0 ? fp->id : NULL;
+    char *known = NULL;
+    if (fp_id) {
+        known = fingerprint_index_lookup(fp_id, NULL);
+        if (!known) known = github_find_issue(fp_id);
+    }
+
+    if (known) {
+        char *comment = build_repeat_comment(info, fp);
+        char *comment_url = comment ? github_comment_issue(known, comment) : NULL;
+        if (comment_url) {
+            fingerprint_index_record(fp_id, known);
+            res.action = "commented";
+            res.url = known;
+            known = NULL;
+        } else if (comment && api_last_error() == API_ERROR_NETWORK) {
+            SpoolReport q = {NULL, NULL, known, comment, fp_id};
+            res.action = queue_report(&q);
+        }
+        free(comment_url);
+        free(comment);
+        free(known);
+        return res;
+    }
+
+    char *ai = use_ai ? generate_ai_message(report_text(report, NULL)) : strdup("(No AI summary was requested.)");
+    char *title = build_issue_title(info);
+    Report *body = NULL;
+    if (ai && title) {
+        body = build_issue_body(report, ai, fp); // takes ai
+    } else {
+        free(ai);
+    }
+    if (!body) {
+        free(title);
+        return res;
+    }
+    char *url = create_github_issue(title, body);
+    if (url) {
+        if (fp_id) fingerprint_index_record(fp_id, url);
+        res.action = "created";
+        res.url = url;
+    } else if (api_last_error() == API_ERROR_NETWORK) {
+        char *comment = fp_id ? build_repeat_comment(info, fp) : NULL;
+        char *text = report_flatten(body, NULL);
+        SpoolReport q = {title, text, NULL, comment, fp_id};
+        res.action = text ? queue_report(&q) : "failed";
+        free(text);
+        free(comment);
+    }
+    free(title);
+    report_free(body);
+    return res;
+}
+
+static void apply_env_keys(void) {
+    const char *gh = getenv("CRASH_REPORTER_GITHUB_TOKEN");
+    const char *gm = getenv("CRASH_REPORTER_GEMINI_KEY");
+    if (gh && gh[0]) set_runtime_github_token(gh);
+    if (gm && gm[0]) set_runtime_gemini_api_key(gm);
+}
+
+// The report owns stdout; everything the collectors and API calls print goes to stderr
+static FILE* open_output(const CliOptions *opts) {
+    FILE *out;
+    if (!opts->output || strcmp(opts->output, "-") == 0) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        out = fd >= 0 ? fdopen(fd, "w") : NULL;
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        // A watcher adds one report per trigger
+        out = fopen(opts->output, opts->watch ? "a" : "w");
+    }
+    if (!out) fprintf(stderr, "Cannot write the report to %s\n", opts->output ? opts->output : "stdout");
+    return out;
+}
+
+// Collect, classify, optionally file, and write one report. Keys must already be loaded.
+static int report_once(const CliOptions *opts, FILE *out, const WatchTrigger *trigger) {
+    SystemInfo info = {0};
+    info.hostname = get_hostname();
+    info.kernel = get_kernel_version();
+    info.os_release = get_os_release();
+    info.uptime = get_uptime();
+
+    int rc;
+    Report *report = gather_report(&info, NULL, NULL, NULL);
+    size_t len = 0;
+    const char *text = report ? report_text(report, &len) : NULL;
+    SeverityReport sev;
+    if (!text || severity_scan(text, len, &sev) != 0) {
+        fprintf(stderr, "Failed to gather system errors\n");
+        report_free(report);
+        free_system_info(&info);
+        return CLI_EXIT_COLLECT_FAILED;
+    }
+    int worth = severity_worth_filing(&sev);
+    Fingerprint fp = {0};
+    if (worth) fingerprint_report(text, len, &fp);
+    // Kept whether or not it gets filed, to look back at later
+    history_add(info.hostname, text, len, &sev, &fp);
+
+    FileResult filed = {NULL, NULL};
+    if (worth && opts->file_issue) filed = file_report(&info, report, &fp, opts->use_ai);
+
+    // Watch mode writes JSON Lines so a consumer can split the stream
+    size_t flags = opts->watch ? JSON_COMPACT : JSON_INDENT(2);
+    int werr = opts->json ? write_json(out, &info, report, text, &sev, worth, &fp, &filed, trigger, flags)
+                          : write_text(out, report, &sev, worth, &fp, &filed, trigger);
+    if (fflush(out) != 0) werr = -1;
+    if (werr != 0) fprintf(stderr, "Writing the report failed\n");
+
+    if (!worth) rc = CLI_EXIT_CLEAN;
+    else if (!filed.action || strcmp(filed.action, "created") == 0 || strcmp(filed.action, "commented") == 0) rc = CLI_EXIT_ERRORS;
+    else if (strcmp(filed.action, "queued") == 0) rc = CLI_EXIT_QUEUED;
+    else rc = CLI_EXIT_FILE_FAILED;
+    if (werr != 0 && rc == CLI_EXIT_CLEAN) rc = CLI_EXIT_USAGE;
+
+    free(filed.url);
+    fingerprint_free(&fp);
+    severity_report_free(&sev);
+    report_free(report);
+    free_system_info(&info);
+    return rc;
+}
+
+static int run_headless(const CliOptions *opts) {
+    FILE *out = open_output(opts);
+    if (!out) return CLI_EXIT_USAGE;
+    set_privilege_escalation(opts->escalate);
+    if (opts->file_issue) {
+        load_runtime_keys();
+        apply_env_keys();
+    }
+    int rc = report_once(opts, out, NULL);
+    if (fclose(out) != 0 && rc == CLI_EXIT_CLEAN) rc = CLI_EXIT_USAGE;
+    return rc;
+}
+
+/* ---- Watch mode ---- */
+
+typedef struct {
+    const CliOptions *opts;
+    FILE *out;
+    GMainLoop *loop;
+    SpoolDrainer *drainer;
+    int busy;                // a report is being collected or filed
+    int quitting;            // quit once it is done
+    WatchTrigger trigger;    // what the report in progress is about
+} WatchState;
+
+static void watch_report_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    (void)cancellable;
+    WatchState *ws = task_data;
+    int rc = report_once(ws->opts, ws->out, &ws->trigger);
+    g_task_return_boolean(task, rc == CLI_EXIT_QUEUED);
+}
+
+static void watch_report_done(GObject *source, GAsyncResult *res, gpointer user_data) {
+    (void)source;
+    WatchState *ws = user_data;
+    gboolean queued = g_task_propagate_boolean(G_TASK(res), NULL);
+    ws->busy = 0;
+    if (queued) spool_drainer_kick(ws->drainer);
+    if (ws->quitting) g_main_loop_quit(ws->loop);
+}
+
+static void on_watch_trigger(const WatchTrigger *trigger, void *user) {
+    WatchState *ws = user;
+    if (ws->busy || ws->quitting) {
+        fprintf(stderr, "Still reporting the previous problem; not collecting again\n");
+        return;
+    }
+    ws->busy = 1;
+    ws->trigger = *trigger;
+    fprintf(stderr, "Collecting a report (%zu matching lines, up to %s)\n", trigger->lines,
+            severity_name(trigger->severity));
+    GTask *task = g_task_new(NULL, NULL, watch_report_done, ws);
+    g_task_set_task_data(task, ws, NULL);
+    g_task_run_in_thread(task, watch_report_thread);
+    g_object_unref(task);
+}
+
+static gboolean on_watch_signal(gpointer data) {
+    WatchState *ws = data;
+    if (ws->busy && !ws->quitting) {
+        // Let the report in progress finish so nothing is half written or half filed
+        fprintf(stderr, "Finishing the report in progress before exiting\n");
+        ws->quitting = 1;
+    } else {
+        g_main_loop_quit(ws->loop);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static int run_watch(const CliOptions *opts) {
+    FILE *out = open_output(opts);
+    if (!out) return CLI_EXIT_USAGE;
+    set_privilege_escalation(opts->escalate);
+    if (opts->file_issue) {
+        load_runtime_keys();
+        apply_env_keys();
+    }
+
+    WatchState ws = {0};
+    ws.opts = opts;
+    ws.out = out;
+    ws.loop = g_main_loop_new(NULL, FALSE);
+    Watcher *w = watcher_start(&opts->watch_opts, on_watch_trigger, &ws);
+    if (!w) {
+        fprintf(stderr, "None of the logs can be watched from this process\n");
+        g_main_loop_unref(ws.loop);
+        fclose(out);
+        return CLI_EXIT_COLLECT_FAILED;
+    }
+    // Reports queued while offline (by this or an earlier run) go out when GitHub is back
+    if (opts->file_issue) ws.drainer = spool_drainer_start(NULL, NULL);
+    guint sigint = g_unix_signal_add(SIGINT, on_watch_signal, &ws);
+    guint sigterm = g_unix_signal_add(SIGTERM, on_watch_signal, &ws);
+    fprintf(stderr, "Watching for errors: %u lines within %u seconds, then quiet for %u seconds\n",
+            opts->watch_opts.threshold, opts->watch_opts.window_sec, opts->watch_opts.cooldown_sec);
+
+    g_main_loop_run(ws.loop);
+
+    g_source_remove(sigint);
+    g_source_remove(sigterm);
+    spool_drainer_stop(ws.drainer);
+    watcher_stop(w);
+    g_main_loop_unref(ws.loop);
+    fclose(out);
+    return CLI_EXIT_CLEAN;
+}
+
+/* ---- History ---- */
+
+static void format_time(int64_t t, char *out, size_t size) {
+    time_t tt = (time_t)t;
+    struct tm tm;
+    if (!localtime_r(&tt, &tm) || strftime(out, size, "%Y-%m-%d %H:%M:%S", &tm) == 0) snprintf(out, size, "@%lld", (long long)t);
+}
+
+static json_t* entry_json(const HistoryEntry *e) {
+    json_t *obj = json_object();
+    json_object_set_new(obj, "id", json_integer((json_int_t)e->id));
+    json_object_set_new(obj, "time", json_integer((json_int_t)e->time));
+    json_object_set_new(obj, "hostname", json_string(e->hostname));
+    json_object_set_new(obj, "boot_id", json_string(e->boot_id));
+    if (e->fingerprint[0]) json_object_set_new(obj, "fingerprint", json_string(e->fingerprint));
+    json_object_set_new(obj, "severity", severity_counts_json(e->counts));
+    json_object_set_new(obj, "length", json_integer((json_int_t)e->length));
+    json_object_set_new(obj, "stored", json_integer((json_int_t)e->stored));
+    return obj;
+}
+
+static int write_history_json(FILE *out, const char *key, json_t *items) {
+    json_t *root = json_object();
+    json_object_set_new(root, "version", json_integer(1));
+    json_object_set_new(root, key, items);
+    char *text = json_dumps(root, JSON_INDENT(2));
+    json_decref(root);
+    if (!text) return -1;
+    int rc = fputs(text, out) < 0 || fputc('\n', out) == EOF ? -1 : 0;
+    free(text);
+    return rc;
+}
+
+static int list_history(FILE *out, const CliOptions *opts) {
+    HistoryEntry *entries;
+    size_t n;
+    if (history_find(&opts->query, &entries, &n) != 0) return CLI_EXIT_COLLECT_FAILED;
+    if (opts->json) {
+        json_t *items = json_array();
+        for (size_t i = 0; i < n; ++i) json_array_append_new(items, entry_json(&entries[i]));
+        write_history_json(out, "reports", items);
+    } else if (n == 0) {
+        fprintf(stderr, "No reports in the history match\n");
+    } else {
+        fprintf(out, "%-8s %-19s  %-20s %-8s %5s %5s %5s  %s\n", "ID", "TIME", "HOST", "BOOT", "CRIT", "ERR", "WARN",
+                "FINGERPRINT");
+        for (size_t i = 0; i < n; ++i) {
+            const HistoryEntry *e = &entries[i];
+            char when[64];
+            format_time(e->time, when, sizeof(when));
+            fprintf(out, "%-8llu %-19s  %-20s %.8s %5zu %5zu %5zu  %s\n", (unsigned long long)e->id, when, e->hostname,
+                    e->boot_id, e->counts[SEVERITY_CRITICAL], e->counts[SEVERITY_ERROR], e->counts[SEVERITY_WARNING],
+                    e->fingerprint[0] ? e->fingerprint : "-");
+        }
+    }
+    free(entries);
+    return CLI_EXIT_CLEAN;
+}
+
+// With the issue each one was filed as, when the fingerprint index knows it
+static int list_recurring(FILE *out, const CliOptions *opts) {
+    HistoryProblem *problems;
+    size_t n;
+    if (history_recurring(&opts->query, 2, &problems, &n) != 0) return CLI_EXIT_COLLECT_FAILED;
+    json_t *items = opts->json ? json_array() : NULL;
+    if (!opts->json && n == 0) fprintf(stderr, "No problem in the history was found more than once\n");
+    if (!opts->json && n > 0) {
+        fprintf(out, "%5s %5s %5s  %-19s  %-19s  %-8s %s\n", "COUNT", "BOOTS", "HOSTS", "FIRST SEEN", "LAST SEEN",
+                "LAST ID", "FINGERPRINT");
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const HistoryProblem *p = &problems[i];
+        char *url = fingerprint_index_lookup(p->fingerprint, NULL);
+        if (items) {
+            json_t *obj = json_object();
+            json_object_set_new(obj, "fingerprint", json_string(p->fingerprint));
+            json_object_set_new(obj, "occurrences", json_integer((json_int_t)p->occurrences));
+            json_object_set_new(obj, "boots", json_integer((json_int_t)p->boots));
+            json_object_set_new(obj, "hosts", json_integer((json_int_t)p->hosts));
+            json_object_set_new(obj, "first_seen", json_integer((json_int_t)p->first_seen));
+            json_object_set_new(obj, "last_seen", json_integer((json_int_t)p->last_seen));
+            json_object_set_new(obj, "last_id", json_integer((json_int_t)p->last_id));
+            if (url) json_object_set_new(obj, "issue_url", json_string(url));
+            json_array_append_new(items, obj);
+        } else {
+            char first[64], last[64];
+            format_time(p->first_seen, first, sizeof(first));
+            format_time(p->last_seen, last, sizeof(last));
+            fprintf(out, "%5zu %5zu %5zu  %-19s  %-19s  %-8llu %s\n", p->occurrences, p->boots, p->hosts, first, last,
+                    (unsigned long long)p->last_id, p->fingerprint);
+            if (url) fprintf(out, "%*sfiled as %s\n", 6, "", url);
+        }
+        free(url);
+    }
+    if (items) write_history_json(out, "problems", items);
+    free(problems);
+    return CLI_EXIT_CLEAN;
+}
+
+static int show_history(FILE *out, const CliOptions *opts) {
+    HistoryEntry e;
+    size_t len;
+    char *text = history_read(opts->show_id, &len, &e);
+    if (!text) {
+        fprintf(stderr, "Report %llu is not in the history\n", opts->show_id);
+        return CLI_EXIT_COLLECT_FAILED;
+    }
+    if (opts->json) {
+        json_t *obj = entry_json(&e);
+        json_object_set_new(obj, "text", json_stringn(text, len));
+        char *dump = json_dumps(obj, JSON_INDENT(2));
+        json_decref(obj);
+        if (dump) {
+            fputs(dump, out);
+            fputc('\n', out);
+        }
+        free(dump);
+    } else {
+        fwrite(text, 1, len, out);
+    }
+    free(text);
+    return CLI_EXIT_CLEAN;
+}
+
+static int run_history(const CliOptions *opts) {
+    FILE *out = open_output(opts);
+    if (!out) return CLI_EXIT_USAGE;
+    int rc = opts->history == HISTORY_SHOW ? show_history(out, opts)
+           : opts->history == HISTORY_RECURRING ? list_recurring(out, opts)
+           : list_history(out, opts);
+    if ((fflush(out) != 0 || ferror(out)) && rc == CLI_EXIT_CLEAN) {
+        fprintf(stderr, "Writing the history failed\n");
+        rc = CLI_EXIT_USAGE;
+    }
+    fclose(out);
+    return rc;
+}
+
+// Local time as YYYY-MM-DD[ HH:MM[:SS]] (or with a T), @EPOCH, or an age: N followed by
+// s, m, h, d or w
+static int parse_time(const char *arg, const char *name, int64_t *out) {
+    char *end;
+    errno = 0;
+    if (arg[0] == '@') {
+        long long v = strtoll(arg + 1, &end, 10);
+        if (errno == 0 && end != arg + 1 && !*end && v > 0) {
+            *out = v;
+            return 0;
+        }
+    } else if (arg[0] >= '0' && arg[0] <= '9') {
+        unsigned long long v = strtoull(arg, &end, 10);
+        static const struct { char suffix; long long seconds; } units[] = {
+            {'s', 1}, {'m', 60}, {'h', 3600}, {'d', 86400}, {'w', 7 * 86400},
+        };
+        for (size_t i = 0; errno == 0 && end[0] && !end[1] && i < sizeof(units) / sizeof(units[0]); ++i) {
+            if (end[0] == units[i].suffix && v <= 100ULL * 365 * 86400 / (unsigned long long)units[i].seconds) {
+                *out = (int64_t)time(NULL) - (int64_t)v * units[i].seconds;
+                return 0;
+            }
+        }
+        static const char *const formats[] = {"%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M",
+                                              "%Y-%m-%dT%H:%M", "%Y-%m-%d"};
+        for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+            const char *rest = strptime(arg, formats[i], &tm);
+            if (rest && !*rest) {
+                tm.tm_isdst = -1;
+                time_t t = mktime(&tm);
+                if (t != (time_t)-1) {
+                    *out = (int64_t)t;
+                    return 0;
+                }
+            }
+        }
+    }
+    fprintf(stderr, "Invalid time '%s' for --%s\n", arg, name);
+    return -1;
+}
+
+// 32 hex digits, case folded, into out
+static int parse_hex_id(const char *arg, char out[33]) {
+    if (strlen(arg) != 32 || strspn(arg, "0123456789abcdefABCDEF") != 32) return -1;
+    for (int i = 0; i < 32; ++i) out[i] = (char)(arg[i] >= 'A' && arg[i] <= 'F' ? arg[i] - 'A' + 'a' : arg[i]);
+    out[32] = '\0';
+    return 0;
+}
+
+static int set_history_mode(CliOptions *opts, int mode) {
+    if (opts->history && opts->history != mode) {
+        fprintf(stderr, "Use only one of --history, --recurring and --show\n");
+        return -1;
+    }
+    opts->history = mode;
+    return 0;
+}
+
+static int parse_count(const char *arg, const char *name, unsigned min, unsigned *out) {
+    char *end;
+    errno = 0;
+    unsigned long v = strtoul(arg, &end, 10);
+    if (errno != 0 || end == arg || *end || arg[0] == '-' || v < min || v > 86400 * 7) {
+        fprintf(stderr, "Invalid value '%s' for --%s\n", arg, name);
+        return -1;
+    }
+    *out = (unsigned)v;
+    return 0;
+}
+
+int cli_main(int argc, char *argv[]) {
+    if (!wants_cli(argc, argv)) return -1;
+
+    CliOptions opts = {0};
+    opts.use_ai = 1;
+    opts.watch_opts.threshold = WATCH_THRESHOLD;
+    opts.watch_opts.window_sec = WATCH_WINDOW_SEC;
+    opts.watch_opts.cooldown_sec = WATCH_COOLDOWN_SEC;
+    int c;
+    opterr = 0;
+    while ((c = getopt_long(argc, argv, "ho:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'H': opts.headless = 1; break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) opts.json = 1;
+                else if (strcmp(optarg, "text") != 0) {
+                    fprintf(stderr, "Unknown format '%s' (use text or json)\n", optarg);
+                    return CLI_EXIT_USAGE;
+                }
+                opts.headless = 1;
+                break;
+            case 'o': opts.output = optarg; opts.headless = 1; break;
+            case 'i': opts.file_issue = 1; opts.headless = 1; break;
+            case 'n': opts.use_ai = 0; opts.headless = 1; break;
+            case 'e': opts.escalate = 1; break;
+            case 'w': opts.watch = 1; opts.headless = 1; break;
+            case 't':
+                opts.watch_tuned = 1;
+                if (parse_count(optarg, "threshold", 1, &opts.watch_opts.threshold) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'W':
+                opts.watch_tuned = 1;
+                if (parse_count(optarg, "window", 1, &opts.watch_opts.window_sec) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'c':
+                opts.watch_tuned = 1;
+                if (parse_count(optarg, "cooldown", 0, &opts.watch_opts.cooldown_sec) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'Y':
+                if (set_history_mode(&opts, HISTORY_LIST) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'R':
+                if (set_history_mode(&opts, HISTORY_RECURRING) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'S': {
+                char *end;
+                errno = 0;
+                opts.show_id = strtoull(optarg, &end, 10);
+                if (errno != 0 || end == optarg || *end || optarg[0] == '-' || opts.show_id == 0) {
+                    fprintf(stderr, "Invalid report ID '%s'\n", optarg);
+                    return CLI_EXIT_USAGE;
+                }
+                if (set_history_mode(&opts, HISTORY_SHOW) != 0) return CLI_EXIT_USAGE;
+                break;
+            }
+            case 's':
+                opts.history_filtered = 1;
+                if (parse_time(optarg, "since", &opts.query.since) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'u':
+                opts.history_filtered = 1;
+                if (parse_time(optarg, "until", &opts.query.until) != 0) return CLI_EXIT_USAGE;
+                break;
+            case 'N':
+                opts.history_filtered = 1;
+                opts.query.hostname = optarg;
+                break;
+            case 'b':
+                opts.history_filtered = 1;
+                if (strcmp(optarg, "current") == 0) {
+                    sd_id128_t boot;
+                    if (sd_id128_get_boot(&boot) != 0) {
+                        fprintf(stderr, "The current boot ID is not available\n");
+                        return CLI_EXIT_USAGE;
+                    }
+                    sd_id128_to_string(boot, opts.boot_id);
+                } else if (parse_hex_id(optarg, opts.boot_id) != 0) {
+                    fprintf(stderr, "Invalid boot ID '%s' (32 hex digits, or current)\n", optarg);
+                    return CLI_EXIT_USAGE;
+                }
+                opts.query.boot_id = opts.boot_id;
+                break;
+            case 'F': {
+                size_t pl = strlen(FINGERPRINT_PREFIX);
+                if (strncmp(optarg, FINGERPRINT_PREFIX, pl) != 0 || parse_hex_id(optarg + pl, opts.fingerprint + pl) != 0) {
+                    fprintf(stderr, "Invalid fingerprint '%s'\n", optarg);
+                    return CLI_EXIT_USAGE;
+                }
+                memcpy(opts.fingerprint, FINGERPRINT_PREFIX, pl);
+                opts.query.fingerprint = opts.fingerprint;
+                opts.history_filtered = 1;
+                break;
+            }
+            case 'h': usage(stdout, argv[0]); return CLI_EXIT_CLEAN;
+            case 'V': printf("crash_reporter %s\n", CRASH_REPORTER_VERSION); return CLI_EXIT_CLEAN;
+            default:
+                fprintf(stderr, "Unknown option '%s'\n", argv[optind - 1]);
+                usage(stderr, argv[0]);
+                return CLI_EXIT_USAGE;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "Unexpected argument '%s'\n", argv[optind]);
+        return CLI_EXIT_USAGE;
+    }
+    if (opts.watch_tuned && !opts.watch) {
+        fprintf(stderr, "--threshold, --window and --cooldown only apply to --watch\n");
+        return CLI_EXIT_USAGE;
+    }
+    if (opts.history_filtered && opts.history != HISTORY_LIST && opts.history != HISTORY_RECURRING) {
+        fprintf(stderr, "--since, --until, --host, --boot and --fingerprint only apply to --history and --recurring\n");
+        return CLI_EXIT_USAGE;
+    }
+    if (opts.history) {
+        if (opts.watch || opts.file_issue) {
+            fprintf(stderr, "The history queries cannot be combined with --watch or --file-issue\n");
+            return CLI_EXIT_USAGE;
+        }
+        return run_history(&opts);
+    }
+    // --escalate alone still means the GUI
+    if (!opts.headless) return -1;
+    return opts.watch ? run_watch(&opts) : run_headless(&opts);
+}
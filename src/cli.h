@@ -0,0 +1,22 @@
+#ifndef CLI_H
+#define CLI_H
+
+// Command line modes. With --headless (or any of the report options) the collectors run
+// without a window and without loading GTK at all; the report goes to stdout or a file
+// as plain text or JSON, and can be filed without any dialog. Status messages go to
+// stderr so the report can be piped.
+
+// Exit codes, stable for scripts and fleet tooling
+typedef enum {
+    CLI_EXIT_CLEAN = 0,          // nothing worth filing was found
+    CLI_EXIT_ERRORS = 1,         // errors were found (and filed, when asked to)
+    CLI_EXIT_USAGE = 2,          // bad arguments, unwritable output, or no GUI available
+    CLI_EXIT_COLLECT_FAILED = 3, // the report could not be gathered
+    CLI_EXIT_FILE_FAILED = 4,    // filing was asked for and failed
+    CLI_EXIT_QUEUED = 5,         // GitHub was unreachable; the report waits in the spool
+} CliExit;
+
+// Handle the command line. Returns an exit code, or -1 when the GUI should start instead.
+int cli_main(int argc, char *argv[]);
+
+#endif // CLI_H
@@ -0,0 +1,382 @@
+/* Parallel collection engine
+ * Command collectors run as child processes whose stdout pipes are read together
+ * with poll(); native collectors run on their own threads, which wake the poll loop
+ * through a pipe when they are done. Total time is close to the slowest single
+ * collector, each result is reported as soon as it is done, and a cancelled run
+ * returns without waiting for any collector still busy.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "collector.h"
+#include "subprocess.h"
+#include "capture.h"
+#include "dedup.h"
+#include "crash_reporter.h"
+#include "helper.h"
+
+typedef struct {
+    pid_t pid;
+    int fds[2];        // stdout / stderr read ends, -1 once drained
+    Capture out;       // head and tail of stdout, bounded by CAPTURE_DEFAULT_BUDGET
+    Dedup *dedup;      // instead of out for dedup specs; grouped lines are cut afterwards
+    SpawnBuffer err;   // drained so the child never blocks; not part of the report
+} RunningCollector;
+
+// A native collector's thread and what it hands back. When the run is cancelled while
+// the collector is busy, the run stops waiting and the thread frees the job itself.
+typedef struct {
+    CollectorSpec spec;  // copied: the caller's array may be gone before the thread is
+    size_t index;
+    int cancel;          // what the collector polls; set when the run is cancelled (atomic)
+    int want_token;
+    char *token;
+    char *result;
+    size_t len;
+    int wake_fd;         // the run's wake-up pipe, written once the job is done
+    pthread_mutex_t lock;
+    int done;            // under lock
+    int abandoned;       // under lock
+    pthread_t thread;
+} NativeCollector;
+
+int collector_cancel_requested(const int *cancel) {
+    return cancel && __atomic_load_n(cancel, __ATOMIC_ACQUIRE);
+}
+
+int collector_cancelled(const CollectorProgress *progress) {
+    return progress && collector_cancel_requested(progress->cancel);
+}
+
+// Taken in the collector's own job, so sources are not visited one after another first
+static void take_token(const CollectorSpec *spec, size_t index, const CollectorProgress *progress) {
+    if (progress && progress->tokens && spec->token && !progress->tokens[index]) progress->tokens[index] = spec->token();
+}
+
+static void report_done(const CollectorProgress *progress, size_t index, const char *output, size_t len) {
+    if (progress && progress->on_done) progress->on_done(index, output, len, progress->user);
+}
+
+// Keep a finished output within the section budget. Takes ownership of output.
+static char* bound_output(char *output, size_t *len) {
+    if (output && *len > CAPTURE_DEFAULT_BUDGET) {
+        // Same head+tail cut as streamed output, so the snapshot holds at most the budget
+        size_t cut_len = 0;
+        char *cut = capture_bounded_copy(output, *len, CAPTURE_DEFAULT_BUDGET, &cut_len);
+        if (cut) {
+            free(output);
+            output = cut;
+            *len = cut_len;
+        }
+    }
+    return output;
+}
+
+// Group repeated lines of a finished output, then bound it. Takes ownership of output.
+static char* finish_output(const CollectorSpec *spec, char *output, size_t *len) {
+    if (output && spec->dedup) {
+        size_t dlen = 0;
+        char *grouped = dedup_text(output, *len, &dlen, NULL);
+        if (grouped) {
+            free(output);
+            output = grouped;
+            *len = dlen;
+        }
+    }
+    return bound_output(output, len);
+}
+
+// Read one chunk of a dedup collector's stdout. Same return values as capture_fill().
+static int dedup_fill(Dedup *d, int fd) {
+    char chunk[65536];
+    ssize_t r = read(fd, chunk, sizeof(chunk));
+    if (r < 0) return (errno == EINTR || errno == EAGAIN) ? 1 : -1;
+    if (r == 0) return 0;
+    return dedup_write(d, chunk, (size_t)r) == 0 ? 1 : -1;
+}
+
+static void native_free(NativeCollector *nc) {
+    free(nc->token);
+    free(nc->result);
+    pthread_mutex_destroy(&nc->lock);
+    free(nc);
+}
+
+// Thread body for native collectors; falls back to the privileged helper when the
+// native reader cannot serve the request. The spec's command, the last fallback, is
+// started by the run so that cancelling can kill it.
+static void* native_collector_main(void *arg) {
+    NativeCollector *nc = (NativeCollector*)arg;
+    if (nc->want_token) nc->token = nc->spec.token();
+    nc->result = nc->spec.fn(&nc->cancel, &nc->len);
+    if (!nc->result && nc->spec.privileged && helper_available() && !collector_cancel_requested(&nc->cancel)) {
+        nc->result = helper_collect(nc->spec.name, &nc->len);
+    }
+    nc->result = finish_output(&nc->spec, nc->result, &nc->len);
+
+    pthread_mutex_lock(&nc->lock);
+    nc->done = 1;
+    int abandoned = nc->abandoned;
+    // Nonblocking: a full pipe wakes the run all the same
+    if (!abandoned) write(nc->wake_fd, "", 1);
+    pthread_mutex_unlock(&nc->lock);
+    if (abandoned) native_free(nc);
+    return NULL;
+}
+
+static NativeCollector* native_start(const CollectorSpec *spec, size_t index, const CollectorProgress *progress,
+                                     int wake_fd) {
+    NativeCollector *nc = calloc(1, sizeof(NativeCollector));
+    if (!nc) return NULL;
+    nc->spec = *spec;
+    nc->index = index;
+    nc->want_token = progress && progress->tokens && spec->token && !progress->tokens[index];
+    nc->wake_fd = wake_fd;
+    pthread_mutex_init(&nc->lock, NULL);
+    if (pthread_create(&nc->thread, NULL, native_collector_main, nc) != 0) {
+        native_free(nc);
+        return NULL;
+    }
+    return nc;
+}
+
+static int native_done(NativeCollector *nc) {
+    pthread_mutex_lock(&nc->lock);
+    int done = nc->done;
+    pthread_mutex_unlock(&nc->lock);
+    return done;
+}
+
+// Stop waiting for a collector that is still busy; its thread frees it when it is done.
+// Returns 0 when it had finished after all and is still ours to reap.
+static int native_abandon(NativeCollector *nc) {
+    __atomic_store_n(&nc->cancel, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&nc->lock);
+    int busy = !nc->done;
+    if (busy) nc->abandoned = 1;
+    pthread_mutex_unlock(&nc->lock);
+    if (busy) pthread_detach(nc->thread);
+    return busy;
+}
+
+// Join a finished native collector and take over its token and output. Returns 1 when
+// the output is missing and the spec's command should be tried instead.
+static int native_finish(NativeCollector *nc, char **results, size_t *out_lens, const CollectorProgress *progress) {
+    pthread_join(nc->thread, NULL);
+    size_t i = nc->index;
+    if (nc->token && progress && progress->tokens && !progress->tokens[i]) {
+        progress->tokens[i] = nc->token;
+        nc->token = NULL;
+    }
+    results[i] = nc->result;
+    nc->result = NULL;
+    if (out_lens) out_lens[i] = results[i] ? nc->len : 0;
+    int fallback = !results[i] && nc->spec.argv && !collector_cancelled(progress);
+    if (!fallback) report_done(progress, i, results[i], results[i] ? nc->len : 0);
+    native_free(nc);
+    return fallback;
+}
+
+// Reap a command collector whose pipes are both closed and hand its output over
+static void finish_command(RunningCollector *rc, size_t index, char **results, size_t *out_lens,
+                           const CollectorProgress *progress) {
+    spawn_wait(rc->pid);
+    rc->pid = 0;
+    size_t len = 0;
+    if (collector_cancelled(progress)) {
+        results[index] = NULL;
+    } else if (rc->dedup) {
+        results[index] = dedup_finish(rc->dedup, &len, NULL);
+        rc->dedup = NULL;
+        results[index] = bound_output(results[index], &len);
+    } else {
+        results[index] = capture_finish(&rc->out, &len);
+    }
+    if (out_lens) out_lens[index] = results[index] ? len : 0;
+    report_done(progress, index, results[index], out_lens ? out_lens[index] : len);
+}
+
+// Start a spec's command, either as the collector itself or as a native collector's
+// fallback. Returns the number of pipes added to the poll set.
+static size_t start_command(const CollectorSpec *spec, RunningCollector *rc) {
+    const char **wrapped = spec->privileged ? wrap_privileged_argv(spec->argv) : NULL;
+    const char *const *argv = wrapped ? wrapped : spec->argv;
+    size_t added = 0;
+    if (spawn_start(argv, &rc->pid, &rc->fds[0], &rc->fds[1]) == 0) {
+        added = 2;
+        // Without a table the output is kept head+tail as it streams
+        if (spec->dedup) rc->dedup = dedup_new(DEDUP_DEFAULT_MEMORY);
+    } else {
+        rc->pid = 0;
+    }
+    free(wrapped);
+    return added;
+}
+
+char** run_collectors_parallel(const CollectorSpec *specs, size_t n, size_t *out_lens,
+                               const CollectorProgress *progress) {
+    char **results = calloc(n, sizeof(char*));
+    RunningCollector *rcs = calloc(n, sizeof(RunningCollector));
+    struct pollfd *pfds = calloc(n * 2 + 1, sizeof(struct pollfd));
+    size_t *pidx = calloc(n * 2 + 1, sizeof(size_t));
+    NativeCollector **ncs = calloc(n, sizeof(NativeCollector*));
+    int wake[2] = { -1, -1 };
+    if (!results || !rcs || !pfds || !pidx || !ncs || pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        free(results);
+        free(rcs);
+        free(pfds);
+        free(pidx);
+        free(ncs);
+        return NULL;
+    }
+
+    // Authenticate once up front so parallel pkexec children do not each prompt.
+    for (size_t i = 0; i < n; ++i) {
+        if (specs[i].privileged) {
+            preauthenticate_polkit();
+            break;
+        }
+    }
+
+    size_t active = 0, natives = 0;
+    for (size_t i = 0; i < n; ++i) {
+        rcs[i].fds[0] = rcs[i].fds[1] = -1;
+        capture_init(&rcs[i].out, CAPTURE_DEFAULT_BUDGET);
+        rcs[i].dedup = NULL;
+        if (specs[i].fn) {
+            ncs[i] = native_start(&specs[i], i, progress, wake[1]);
+            if (ncs[i]) natives++;
+            else report_done(progress, i, NULL, 0);
+            continue;
+        }
+        take_token(&specs[i], i, progress);
+        size_t added = start_command(&specs[i], &rcs[i]);
+        if (added == 0) report_done(progress, i, NULL, 0);
+        active += added;
+    }
+
+    while (active > 0 || natives > 0) {
+        nfds_t np = 0;
+        if (natives > 0) {
+            pfds[np].fd = wake[0];
+            pfds[np].events = POLLIN;
+            pfds[np++].revents = 0;
+        }
+        size_t first_pipe = np;
+        for (size_t i = 0; i < n; ++i) {
+            for (int s = 0; s < 2; ++s) {
+                if (rcs[i].fds[s] < 0) continue;
+                pfds[np].fd = rcs[i].fds[s];
+                pfds[np].events = POLLIN;
+                pfds[np].revents = 0;
+                pidx[np++] = i * 2 + s;
+            }
+        }
+        if (collector_cancelled(progress)) {
+            // Closing the pipes also stops children we may not signal (pkexec'd ones) the
+            // next time they write. Those run as root and may take a while yet, so they
+            // are left to the main loop to reap instead of being waited for here.
+            for (size_t i = 0; i < n; ++i) {
+                for (int s = 0; s < 2; ++s) {
+                    if (rcs[i].fds[s] >= 0) {
+                        close(rcs[i].fds[s]);
+                        rcs[i].fds[s] = -1;
+                    }
+                }
+                if (rcs[i].pid <= 0) continue;
+                if (kill(rcs[i].pid, SIGTERM) != 0 || specs[i].privileged) {
+                    spawn_abandon(rcs[i].pid);
+                    rcs[i].pid = 0;
+                    report_done(progress, i, NULL, 0);
+                }
+            }
+            // Collectors still reading are told to stop, but not waited for: a /var/log
+            // sweep or an unwind may take a while to notice, and a helper call not at all.
+            // Their sections are reported as cancelled now.
+            for (size_t i = 0; i < n; ++i) {
+                if (!ncs[i]) continue;
+                if (native_abandon(ncs[i])) report_done(progress, i, NULL, 0);
+                else native_finish(ncs[i], results, out_lens, progress);
+                ncs[i] = NULL;
+            }
+            natives = 0;
+            break;
+        }
+        int pr = poll(pfds, np, progress && progress->cancel ? COLLECTOR_CANCEL_POLL_MS : -1);
+        if (pr < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (first_pipe > 0 && (pfds[0].revents & POLLIN)) {
+            char drain[64];
+            while (read(wake[0], drain, sizeof(drain)) > 0) {}
+            for (size_t i = 0; i < n; ++i) {
+                if (!ncs[i] || !native_done(ncs[i])) continue;
+                natives--;
+                int fallback = native_finish(ncs[i], results, out_lens, progress);
+                ncs[i] = NULL;
+                if (!fallback) continue;
+                size_t added = start_command(&specs[i], &rcs[i]);
+                if (added == 0) report_done(progress, i, NULL, 0);
+                active += added;
+            }
+        }
+        for (nfds_t k = first_pipe; k < np; ++k) {
+            if (!(pfds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            size_t slot = pidx[k];
+            RunningCollector *rc = &rcs[slot / 2];
+            int s = (int)(slot % 2);
+            int r = s == 1 ? spawn_buffer_fill(&rc->err, rc->fds[s])
+                  : rc->dedup ? dedup_fill(rc->dedup, rc->fds[s])
+                  : capture_fill(&rc->out, rc->fds[s]);
+            if (r <= 0) {
+                close(rc->fds[s]);
+                rc->fds[s] = -1;
+                active--;
+            }
+            // stderr is not reported; keep the buffer from growing
+            if (s == 1) rc->err.len = 0;
+            if (rc->fds[0] < 0 && rc->fds[1] < 0 && rc->pid > 0) {
+                finish_command(rc, slot / 2, results, out_lens, progress);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        for (int s = 0; s < 2; ++s) {
+            if (rcs[i].fds[s] >= 0) close(rcs[i].fds[s]);
+        }
+        free(rcs[i].err.data);
+        if (ncs[i]) {
+            // Only left when poll() failed; too late for a fallback command
+            if (native_abandon(ncs[i]) || native_finish(ncs[i], results, out_lens, progress)) {
+                report_done(progress, i, NULL, 0);
+            }
+        } else if (rcs[i].pid > 0) {
+            finish_command(&rcs[i], i, results, out_lens, progress);
+        } else if (out_lens && !results[i]) {
+            out_lens[i] = 0;
+        }
+        capture_free(&rcs[i].out);
+        if (rcs[i].dedup) free(dedup_finish(rcs[i].dedup, NULL, NULL)); // cancelled or never reaped
+    }
+
+    // Abandoned collectors never write to the pipe again
+    close(wake[0]);
+    close(wake[1]);
+    free(rcs);
+    free(pfds);
+    free(pidx);
+    free(ncs);
+    return results;
+}
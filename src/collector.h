@@ -0,0 +1,56 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <stddef.h>
+
+// How often a blocked collection run looks at the cancel flag
+#define COLLECTOR_CANCEL_POLL_MS 100
+
+// One independent data source for the error report. A collector is either an
+// in-process function (run on its own thread) or an argv array executed directly
+// (no shell, NULL-terminated). When the function returns NULL, e.g. because it lacks
+// the privileges to read its source, a privileged collector is asked of the privileged
+// helper by name, and argv through pkexec is the last fallback. The function is passed
+// the run's cancel flag (NULL outside a run) and returns NULL soon after it is set,
+// rather than a partial output that could pass for the whole source.
+typedef struct {
+    const char *name;           // stable id, also the collector name served by the privileged helper
+    const char *title;          // section title used in the assembled report
+    const char *const *argv;    // command producing the section body
+    int privileged;             // needs root: use the helper / pkexec when not root
+    char* (*fn)(const int *cancel, size_t *out_len); // native collector, may be NULL
+    char* (*token)(void);       // cheap validity token of the source (see snapshot.h), may be NULL
+    int dedup;                  // group repeated log lines (see dedup.h) before the budget cut
+} CollectorSpec;
+
+// Optional progress reporting and cancellation for a collection run.
+typedef struct {
+    // Called once per collector as soon as its output is complete (output may be NULL).
+    // Runs on the thread that called run_collectors_parallel(), and must not keep output
+    // beyond the call.
+    void (*on_done)(size_t index, const char *output, size_t len, void *user);
+    void *user;
+    // When it becomes nonzero (read atomically), the run returns within
+    // COLLECTOR_CANCEL_POLL_MS: running commands are killed, native collectors are told
+    // to stop and left to finish on their own, and every unfinished entry is NULL.
+    const int *cancel;
+    // When not NULL, each collector's job first takes its spec's validity token into
+    // tokens[index] (unless one is there already), before it reads its source
+    char **tokens;
+} CollectorProgress;
+
+// Start every collector at once: commands are multiplexed with poll(), native
+// collectors run on worker threads.
+// Returns an array of n allocated strings in the same order as specs; an entry is
+// NULL if that collector could not be started. If out_lens is non-NULL it receives
+// the byte length of each output. progress may be NULL. Caller frees each entry and the array.
+char** run_collectors_parallel(const CollectorSpec *specs, size_t n, size_t *out_lens,
+                               const CollectorProgress *progress);
+
+// Nonzero once progress->cancel has been set
+int collector_cancelled(const CollectorProgress *progress);
+
+// Nonzero once *cancel has been set; for the loops of native collectors (cancel may be NULL)
+int collector_cancel_requested(const int *cancel);
+
+#endif // COLLECTOR_H
@@ -1,13 +1,105 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#define CRASH_REPORTER_VERSION "0.1.0"
+
+// Installed location of the GUI module; one next to the executable is tried first, and
+// CRASH_REPORTER_GUI_MODULE overrides both
+#define CRASH_REPORTER_GUI_MODULE_PATH "/usr/lib/crash-reporter/crash-reporter-gui.so"
+
 #define GITHUB_TOKEN "your_github_token_here"
 #define GEMINI_API_KEY "your_gemini_api_key_here"
 
 #define GITHUB_REPO_OWNER "acreetionos-linux"
 #define GITHUB_REPO_NAME "acreetionos"
 
+// GitHub REST API root; the CRASH_REPORTER_GITHUB_API environment variable overrides it
+// (a local mock server, GitHub Enterprise)
+#define GITHUB_API_BASE "https://api.github.com"
+
 // Comma-separated usernames to ping, e.g., "cobra3282000,spivajohnathan64"
 #define GITHUB_PING_USERS "cobra3282000,spivajohnathan64"
 
+// Maximum number of log files the /var/log scanner reads at the same time
+#define LOGSCAN_IO_CONCURRENCY 4
+
+// Approximate token budget for the report sent to Gemini; the most severe and most
+// recent lines of each section are kept when the report is larger
+#define GEMINI_PROMPT_TOKEN_BUDGET 16000
+
+// Severity keywords, matched case-insensitively anywhere in a line (see severity.h)
+#define SEVERITY_KEYWORDS \
+    { "panic", SEVERITY_CRITICAL }, { "fatal", SEVERITY_CRITICAL }, { "critical", SEVERITY_CRITICAL }, \
+    { "emerg", SEVERITY_CRITICAL }, { "segfault", SEVERITY_CRITICAL }, { "oops", SEVERITY_CRITICAL }, \
+    { "call trace", SEVERITY_CRITICAL }, { "core dumped", SEVERITY_CRITICAL }, { "kernel bug", SEVERITY_CRITICAL }, \
+    { "dumped core", SEVERITY_CRITICAL }, \
+    { "error", SEVERITY_ERROR }, { "fail", SEVERITY_ERROR }, { "denied", SEVERITY_ERROR }, \
+    { "timed out", SEVERITY_ERROR }, { "unable to", SEVERITY_ERROR }, { "traceback", SEVERITY_ERROR }, \
+    { "warn", SEVERITY_WARNING }
+
+// A report is filed when at least this many lines match at this severity or above
+#define SEVERITY_FILE_MIN_LEVEL SEVERITY_ERROR
+#define SEVERITY_FILE_MIN_HITS 1
+
+// Crash fingerprints (see fingerprint.h): how many of the most severe log line templates
+// and kernel call trace frames go into one
+#define FINGERPRINT_MAX_LINES 8
+#define FINGERPRINT_MAX_FRAMES 8
+
+// Offline spool (see spool.h): reports sent at the same time, and the retry delay, which
+// doubles after every failed attempt up to the maximum
+#define SPOOL_MAX_UPLOADS 2
+#define SPOOL_RETRY_BASE_SEC 30
+#define SPOOL_RETRY_MAX_SEC 3600
+
+// Process crashes (see coredump.h): how many of the newest crashes are reported and how
+// far back, and how many decompressed bytes of their dumps may be read, per dump and in
+// total, to get at the notes
+#define COREDUMP_MAX_ENTRIES 10
+#define COREDUMP_MAX_AGE_DAYS 14
+#define COREDUMP_READ_BUDGET (8 * 1024 * 1024)
+#define COREDUMP_TOTAL_READ_BUDGET (32 * 1024 * 1024)
+// Frames of systemd-coredump's stack trace kept per crash
+#define COREDUMP_MAX_TRACE_LINES 40
+
+// Failed units (see units.h): how long a D-Bus call to systemd may take, and how many
+// recent journal lines are shown per unit
+#define UNITS_DBUS_TIMEOUT_MS 5000
+#define UNITS_JOURNAL_LINES 10
+
+// Symbolization (see symbolize.h): debug files are looked up by build-id under
+// SYMBOLIZE_DEBUG_DIR. With SYMBOLIZE_DEBUGINFOD set to 1, libdw also asks the servers in
+// DEBUGINFOD_URLS, which can mean downloading hundreds of megabytes during a report.
+#define SYMBOLIZE_DEBUG_DIR "/usr/lib/debug"
+#define SYMBOLIZE_DEBUGINFOD 0
+// Distinct binaries resolved per backtrace
+#define SYMBOLIZE_MAX_MODULES 64
+// When systemd-coredump left no stack trace, the newest SYMBOLIZE_MAX_UNWINDS stored
+// dumps are unwound here instead, decompressed into memory within what is left of
+// COREDUMP_TOTAL_READ_BUDGET after the notes were read
+#define SYMBOLIZE_MAX_UNWINDS 2
+// Binaries kept in the symbol cache; the least recently used go first
+#define SYMCACHE_MAX_ENTRIES 256
+
+// Watch mode (see watch.h): a report is collected once WATCH_THRESHOLD new lines at or
+// above WATCH_MIN_LEVEL arrive within WATCH_WINDOW_SEC (a critical line is enough on its
+// own), then not again for WATCH_COOLDOWN_SEC. The command line can override all three.
+#define WATCH_MIN_LEVEL SEVERITY_ERROR
+#define WATCH_THRESHOLD 3
+#define WATCH_WINDOW_SEC 60
+#define WATCH_COOLDOWN_SEC 900
+// Time given to a burst (an oops and its call trace) to finish before collecting
+#define WATCH_SETTLE_MS 500
+// Log files directly in this directory are followed; at most this much new data is
+// matched per file and wakeup
+#define WATCH_LOG_DIR "/var/log"
+#define WATCH_READ_MAX (256 * 1024)
+
+// Report history (see history.h): the store is kept below HISTORY_MAX_BYTES and reports
+// older than HISTORY_MAX_AGE_DAYS are dropped. Space is freed a segment at a time.
+#define HISTORY_MAX_BYTES (64 * 1024 * 1024)
+#define HISTORY_MAX_AGE_DAYS 180
+#define HISTORY_SEGMENT_BYTES (2 * 1024 * 1024)
+#define HISTORY_COMPRESSION_LEVEL 6
+
 #endif // CONFIG_H
@@ -0,0 +1,619 @@
+/* systemd-coredump reader
+ * Crashes are listed from the journal by MESSAGE_ID. For each one the stored dump (or,
+ * with Storage=journal, the COREDUMP field) is decompressed only as far as the ELF
+ * header, the program headers and the PT_NOTE segments, which the kernel writes before
+ * any memory contents, and within a byte budget.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <elf.h>
+#include <sys/procfs.h>
+#include <systemd/sd-journal.h>
+#if defined(__x86_64__)
+#include <sys/reg.h>
+#endif
+#include "coredump.h"
+#include "decompress.h"
+#include "symbolize.h"
+#include "journal.h"
+#include "helper.h"
+#include "collector.h"
+#include "strbuf.h"
+#include "config.h"
+
+#define COREDUMP_READ_CHUNK 65536
+// sd-journal's default field size limit, restored after fetching the head of a COREDUMP field
+#define COREDUMP_FIELD_THRESHOLD 65536
+
+#define NOTE_ALIGN(n) (((uint64_t)(n) + 3) & ~(uint64_t)3)
+
+/* ---- ELF core notes ---- */
+
+// Bytes of the core that hold the ELF header, the program headers and every PT_NOTE
+// segment, as far as the first len bytes tell; 0 when this is not a 64-bit ELF core
+static size_t bytes_needed(const unsigned char *core, size_t len) {
+    Elf64_Ehdr eh;
+    if (len < sizeof(eh)) return sizeof(eh);
+    memcpy(&eh, core, sizeof(eh));
+    if (memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 || eh.e_ident[EI_CLASS] != ELFCLASS64 || eh.e_type != ET_CORE ||
+        eh.e_phentsize != sizeof(Elf64_Phdr) || eh.e_phnum == 0 || eh.e_phnum == PN_XNUM) {
+        return 0;
+    }
+    uint64_t need = eh.e_phoff + (uint64_t)eh.e_phnum * sizeof(Elf64_Phdr);
+    if (eh.e_phoff > SIZE_MAX / 2 || need > SIZE_MAX / 2) return 0;
+    if (len < need) return (size_t)need;
+    for (size_t i = 0; i < eh.e_phnum; ++i) {
+        Elf64_Phdr ph;
+        memcpy(&ph, core + eh.e_phoff + i * sizeof(ph), sizeof(ph));
+        if (ph.p_type != PT_NOTE) continue;
+        if (ph.p_offset > SIZE_MAX / 2 || ph.p_filesz > SIZE_MAX / 2) return 0;
+        if (ph.p_offset + ph.p_filesz > need) need = ph.p_offset + ph.p_filesz;
+    }
+    return (size_t)need;
+}
+
+// NT_FILE: count, page size, count (start, end, page offset) triples, then count file names
+static void parse_file_note(CoreNotes *out, const unsigned char *desc, size_t size) {
+    uint64_t count, page;
+    if (size < 16 || out->maps) return;
+    memcpy(&count, desc, 8);
+    memcpy(&page, desc + 8, 8);
+    if (count == 0 || count > (size - 16) / 24) return;
+    out->maps = calloc((size_t)count, sizeof(CoreMapping));
+    if (!out->maps) return;
+    const unsigned char *name = desc + 16 + count * 24, *end = desc + size;
+    for (uint64_t i = 0; i < count && name < end; ++i) {
+        uint64_t range[3];
+        memcpy(range, desc + 16 + i * 24, sizeof(range));
+        const unsigned char *nul = memchr(name, '\0', (size_t)(end - name));
+        if (!nul) break;
+        CoreMapping *m = &out->maps[out->nmaps];
+        m->start = range[0];
+        m->end = range[1];
+        m->offset = range[2] * page;
+        m->path = strndup((const char *)name, (size_t)(nul - name));
+        if (!m->path) break;
+        out->nmaps++;
+        name = nul + 1;
+    }
+}
+
+static void parse_core_note(CoreNotes *out, uint32_t type, const unsigned char *desc, size_t size) {
+    switch (type) {
+    case NT_PRSTATUS: {
+        // The kernel writes the thread that took the signal first
+        struct elf_prstatus pr;
+        if (out->have_regs || size < sizeof(pr)) return;
+        memcpy(&pr, desc, sizeof(pr));
+        if (!out->have_siginfo) out->signo = pr.pr_cursig;
+#if defined(__x86_64__)
+        out->pc = (uint64_t)pr.pr_reg[RIP];
+        out->sp = (uint64_t)pr.pr_reg[RSP];
+        out->have_regs = 1;
+#elif defined(__aarch64__)
+        out->pc = (uint64_t)pr.pr_reg[32];
+        out->sp = (uint64_t)pr.pr_reg[31];
+        out->have_regs = 1;
+#endif
+        break;
+    }
+    case NT_SIGINFO: {
+        siginfo_t si;
+        if (out->have_siginfo || size < sizeof(si)) return;
+        memcpy(&si, desc, sizeof(si));
+        out->have_siginfo = 1;
+        out->signo = si.si_signo;
+        out->code = si.si_code;
+        out->fault_addr = (uint64_t)(uintptr_t)si.si_addr;
+        break;
+    }
+    case NT_FILE:
+        parse_file_note(out, desc, size);
+        break;
+    default:
+        break;
+    }
+}
+
+int coredump_parse_notes(const unsigned char *core, size_t len, CoreNotes *out) {
+    memset(out, 0, sizeof(*out));
+    size_t need = bytes_needed(core, len);
+    if (need == 0 || len < sizeof(Elf64_Ehdr)) {
+        errno = ENOEXEC;
+        return -1;
+    }
+    out->bytes_read = len;
+    out->truncated = need > len;
+
+    Elf64_Ehdr eh;
+    memcpy(&eh, core, sizeof(eh));
+    if (eh.e_phoff + (uint64_t)eh.e_phnum * sizeof(Elf64_Phdr) > len) return 0;
+    for (size_t i = 0; i < eh.e_phnum; ++i) {
+        Elf64_Phdr ph;
+        memcpy(&ph, core + eh.e_phoff + i * sizeof(ph), sizeof(ph));
+        if (ph.p_type != PT_NOTE || ph.p_offset >= len) continue;
+        uint64_t off = ph.p_offset;
+        uint64_t end = ph.p_offset + ph.p_filesz < len ? ph.p_offset + ph.p_filesz : len;
+        while (off + sizeof(Elf64_Nhdr) <= end) {
+            Elf64_Nhdr nh;
+            memcpy(&nh, core + off, sizeof(nh));
+            uint64_t name_off = off + sizeof(nh);
+            uint64_t desc_off = name_off + NOTE_ALIGN(nh.n_namesz);
+            if (desc_off + nh.n_descsz > end) break; // cut off by the budget
+            if (nh.n_namesz == 5 && memcmp(core + name_off, "CORE", 5) == 0) {
+                parse_core_note(out, nh.n_type, core + desc_off, nh.n_descsz);
+            }
+            off = desc_off + NOTE_ALIGN(nh.n_descsz);
+        }
+    }
+    return 0;
+}
+
+int coredump_read_notes(const char *path, size_t budget, CoreNotes *out) {
+    memset(out, 0, sizeof(*out));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    Compression kind = compression_for_path(path);
+    Decoder *d = NULL;
+    if (kind != COMPRESSION_NONE && !(d = decoder_new(kind))) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    unsigned char *core = NULL;
+    size_t len = 0, cap = 0;
+    unsigned char in[COREDUMP_READ_CHUNK];
+    const unsigned char *inp = in;
+    size_t in_len = 0;
+    int in_eof = 0, done = 0, failed = 0;
+    // Grows as the headers reveal where the notes end
+    size_t need = sizeof(Elf64_Ehdr);
+    while (len < need && len < budget && !done) {
+        size_t want = need < budget ? need : budget;
+        if (cap < want) {
+            unsigned char *n = realloc(core, want);
+            if (!n) {
+                failed = 1;
+                break;
+            }
+            core = n;
+            cap = want;
+        }
+        if (!d) {
+            ssize_t r = pread(fd, core + len, want - len, (off_t)len);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) break;
+            len += (size_t)r;
+        } else {
+            if (in_len == 0 && !in_eof) {
+                ssize_t r = read(fd, in, sizeof(in));
+                if (r < 0 && errno == EINTR) continue;
+                if (r <= 0) in_eof = 1;
+                else {
+                    inp = in;
+                    in_len = (size_t)r;
+                }
+            }
+            ssize_t produced = decoder_step(d, &inp, &in_len, in_eof, core + len, want - len, &done);
+            if (produced < 0) {
+                failed = 1;
+                break;
+            }
+            if (produced == 0 && in_eof && in_len == 0) break; // truncated stream
+            len += (size_t)produced;
+        }
+        if (len >= need && (need = bytes_needed(core, len)) == 0) failed = 1;
+    }
+    decoder_free(d);
+    close(fd);
+
+    int rc = -1;
+    if (!failed && coredump_parse_notes(core, len, out) == 0) {
+        rc = 0;
+    } else {
+        errno = ENOEXEC;
+    }
+    free(core);
+    return rc;
+}
+
+void core_notes_free(CoreNotes *notes) {
+    for (size_t i = 0; i < notes->nmaps; ++i) free(notes->maps[i].path);
+    free(notes->maps);
+    memset(notes, 0, sizeof(*notes));
+}
+
+const CoreMapping* core_notes_find_mapping(const CoreNotes *notes, uint64_t addr) {
+    for (size_t i = 0; i < notes->nmaps; ++i) {
+        if (addr >= notes->maps[i].start && addr < notes->maps[i].end) return &notes->maps[i];
+    }
+    return NULL;
+}
+
+/* ---- Journal ---- */
+
+static long get_long_field(sd_journal *j, const char *field, long fallback) {
+    char *v = journal_get_field(j, field);
+    long n = v ? strtol(v, NULL, 10) : fallback;
+    free(v);
+    return n;
+}
+
+static void free_entry(CoredumpEntry *e) {
+    free(e->signal_name);
+    free(e->exe);
+    free(e->comm);
+    free(e->cmdline);
+    free(e->unit);
+    free(e->package);
+    free(e->filename);
+    free(e->message);
+    core_notes_free(&e->notes);
+}
+
+// Read the notes of the current entry's dump within *budget, which is reduced by what it took
+static void read_entry_dump(sd_journal *j, CoredumpEntry *e, size_t *budget) {
+    size_t limit = *budget < COREDUMP_READ_BUDGET ? *budget : COREDUMP_READ_BUDGET;
+    if (e->filename) {
+        if (limit == 0) {
+            e->dump = COREDUMP_DUMP_SKIPPED;
+        } else if (coredump_read_notes(e->filename, limit, &e->notes) == 0) {
+            e->dump = COREDUMP_DUMP_READ;
+            *budget -= e->notes.bytes_read;
+        } else {
+            e->dump = errno == ENOENT ? COREDUMP_DUMP_MISSING
+                    : errno == EACCES || errno == EPERM ? COREDUMP_DUMP_UNREADABLE : COREDUMP_DUMP_INVALID;
+        }
+        return;
+    }
+    // Storage=journal keeps the dump in the entry; sd-journal decompresses only its head
+    const void *data;
+    size_t len;
+    const size_t prefix = strlen("COREDUMP=");
+    sd_journal_set_data_threshold(j, limit + prefix);
+    int have = limit > 0 && sd_journal_get_data(j, "COREDUMP", &data, &len) >= 0 && len > prefix;
+    if (have) {
+        if (coredump_parse_notes((const unsigned char *)data + prefix, len - prefix, &e->notes) == 0) {
+            e->dump = COREDUMP_DUMP_READ;
+            *budget -= e->notes.bytes_read;
+        } else {
+            e->dump = COREDUMP_DUMP_INVALID;
+        }
+    } else {
+        e->dump = limit == 0 ? COREDUMP_DUMP_SKIPPED : COREDUMP_DUMP_NONE;
+    }
+    sd_journal_set_data_threshold(j, COREDUMP_FIELD_THRESHOLD);
+}
+
+int coredump_list(size_t max_entries, uint64_t since_usec, size_t read_budget, const int *cancel, CoredumpList *out) {
+    memset(out, 0, sizeof(*out));
+    sd_journal *j = NULL;
+    int r = sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY);
+    if (r < 0) {
+        fprintf(stderr, "Failed to open journal: %s\n", strerror(-r));
+        return -1;
+    }
+    sd_journal_add_match(j, "MESSAGE_ID=" COREDUMP_MESSAGE_ID, 0);
+    out->entries = calloc(max_entries ? max_entries : 1, sizeof(CoredumpEntry));
+    if (!out->entries) {
+        sd_journal_close(j);
+        return -1;
+    }
+
+    sd_journal_seek_tail(j);
+    while (out->count < max_entries && !collector_cancel_requested(cancel) && sd_journal_previous(j) > 0) {
+        uint64_t realtime = 0;
+        sd_journal_get_realtime_usec(j, &realtime);
+        if (realtime < since_usec) break;
+
+        CoredumpEntry *e = &out->entries[out->count];
+        memset(e, 0, sizeof(*e));
+        char *ts = journal_get_field(j, "COREDUMP_TIMESTAMP");
+        e->time_usec = ts ? strtoull(ts, NULL, 10) : realtime;
+        free(ts);
+        e->pid = get_long_field(j, "COREDUMP_PID", -1);
+        e->uid = get_long_field(j, "COREDUMP_UID", -1);
+        // A crash can be in both the system journal and the user's
+        int seen = 0;
+        for (size_t i = 0; i < out->count && !seen; ++i) {
+            seen = out->entries[i].time_usec == e->time_usec && out->entries[i].pid == e->pid;
+        }
+        if (seen) continue;
+
+        e->signal = (int)get_long_field(j, "COREDUMP_SIGNAL", 0);
+        e->signal_name = journal_get_field(j, "COREDUMP_SIGNAL_NAME");
+        if (!e->signal_name && e->signal > 0 && sigabbrev_np(e->signal)) {
+            if (asprintf(&e->signal_name, "SIG%s", sigabbrev_np(e->signal)) < 0) e->signal_name = NULL;
+        }
+        e->exe = journal_get_field(j, "COREDUMP_EXE");
+        e->comm = journal_get_field(j, "COREDUMP_COMM");
+        e->cmdline = journal_get_field(j, "COREDUMP_CMDLINE");
+        e->unit = journal_get_field(j, "COREDUMP_USER_UNIT");
+        if (!e->unit) e->unit = journal_get_field(j, "COREDUMP_UNIT");
+        char *pkg = journal_get_field(j, "COREDUMP_PACKAGE_NAME");
+        char *ver = journal_get_field(j, "COREDUMP_PACKAGE_VERSION");
+        if (pkg && asprintf(&e->package, "%s %s", pkg, ver ? ver : "") < 0) e->package = NULL;
+        free(pkg);
+        free(ver);
+        e->filename = journal_get_field(j, "COREDUMP_FILENAME");
+        e->message = journal_get_field(j, "MESSAGE");
+        read_entry_dump(j, e, &read_budget);
+        out->count++;
+    }
+    sd_journal_close(j);
+    if (collector_cancel_requested(cancel)) {
+        coredump_list_free(out);
+        return -1;
+    }
+    return 0;
+}
+
+void coredump_list_free(CoredumpList *list) {
+    for (size_t i = 0; i < list->count; ++i) free_entry(&list->entries[i]);
+    free(list->entries);
+    memset(list, 0, sizeof(*list));
+}
+
+/* ---- Report section ---- */
+
+static const char* signal_cause(int signo, int code) {
+    switch (code) {
+    case SI_USER: return "sent by kill()";
+    case SI_TKILL: return "raised by the process itself (abort, raise)";
+    case SI_QUEUE: return "sent by sigqueue()";
+    case SI_KERNEL: return "sent by the kernel";
+    default: break;
+    }
+    switch (signo) {
+    case SIGSEGV:
+        if (code == SEGV_MAPERR) return "address not mapped";
+        if (code == SEGV_ACCERR) return "invalid permissions for the mapping";
+        break;
+    case SIGBUS:
+        if (code == BUS_ADRALN) return "invalid address alignment";
+        if (code == BUS_ADRERR) return "nonexistent physical address";
+        if (code == BUS_OBJERR) return "object-specific hardware error";
+        break;
+    case SIGFPE:
+        if (code == FPE_INTDIV) return "integer divide by zero";
+        if (code == FPE_INTOVF) return "integer overflow";
+        if (code == FPE_FLTDIV) return "floating-point divide by zero";
+        break;
+    case SIGILL:
+        if (code == ILL_ILLOPC) return "illegal opcode";
+        if (code == ILL_PRVOPC) return "privileged opcode";
+        break;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+static int has_fault_address(int signo, int code) {
+    return code > 0 && (signo == SIGSEGV || signo == SIGBUS || signo == SIGILL || signo == SIGFPE);
+}
+
+// The pc of a frame line, "#3  0x00007f0e2a8a3e8c name (module + 0x29e8c)"
+static int frame_pc(const char *line, size_t n, uint64_t *pc) {
+    size_t i = strspn(line, " \t");
+    if (i >= n || line[i] != '#') return -1;
+    for (++i; i < n && line[i] >= '0' && line[i] <= '9'; ++i) {}
+    while (i < n && line[i] == ' ') ++i;
+    if (i + 2 >= n || line[i] != '0' || line[i + 1] != 'x') return -1;
+    *pc = strtoull(line + i, NULL, 16);
+    return 0;
+}
+
+// The crashing thread's frames from systemd-coredump's message: the first "Stack trace
+// of thread" block, up to COREDUMP_MAX_TRACE_LINES lines. With pcs, collects the frames'
+// pcs (at most max) instead of appending; with sym, adds what the symbolizer found to
+// the frames, in order.
+static size_t walk_trace(char **buf, size_t *len, size_t *cap, const char *message, uint64_t *pcs, size_t max,
+                         const SymTrace *sym) {
+    const char *p = message ? strstr(message, "Stack trace of thread") : NULL;
+    size_t frames = 0;
+    if (!p) return 0;
+    for (size_t lines = 0; *p; ++lines) {
+        const char *nl = strchr(p, '\n');
+        size_t n = nl ? (size_t)(nl - p) : strlen(p);
+        if (lines > 0 && strspn(p, " \t") >= n) break; // the blank line after the block
+        if (lines == COREDUMP_MAX_TRACE_LINES) {
+            if (!pcs) buf_append(buf, len, cap, "  ...\n", 6);
+            break;
+        }
+        uint64_t pc;
+        int is_frame = frame_pc(p, n, &pc) == 0;
+        if (pcs) {
+            if (is_frame && frames < max) pcs[frames++] = pc;
+        } else if (is_frame && sym && frames < sym->count) {
+            const SymFrame *f = &sym->frames[frames++];
+            // systemd-coredump found no symbol where a full symbol table may have one
+            const char *na = memmem(p, n, " n/a (", 6);
+            if (na && f->function) {
+                buf_append(buf, len, cap, p, (size_t)(na - p) + 1);
+                buf_printf(buf, len, cap, "%s+0x%llx", f->function, (unsigned long long)f->function_offset);
+                buf_append(buf, len, cap, na + 4, n - (size_t)(na + 4 - p));
+            } else {
+                buf_append(buf, len, cap, p, n);
+            }
+            if (f->file) buf_printf(buf, len, cap, " at %s:%d", f->file, f->line);
+            buf_append(buf, len, cap, "\n", 1);
+        } else {
+            buf_append(buf, len, cap, p, n);
+            buf_append(buf, len, cap, "\n", 1);
+        }
+        p = nl ? nl + 1 : p + n;
+    }
+    return frames;
+}
+
+static void append_trace(char **buf, size_t *len, size_t *cap, const CoredumpEntry *e) {
+    uint64_t pcs[COREDUMP_MAX_TRACE_LINES];
+    size_t n = e->notes.nmaps > 0 ? walk_trace(NULL, NULL, NULL, e->message, pcs, COREDUMP_MAX_TRACE_LINES, NULL) : 0;
+    SymTrace sym = { NULL, 0 };
+    if (n > 0) symbolize_addresses(&e->notes, e->time_usec, pcs, n, &sym);
+    walk_trace(buf, len, cap, e->message, NULL, 0, sym.count > 0 ? &sym : NULL);
+    sym_trace_free(&sym);
+}
+
+// Without a stack trace from systemd-coredump, unwind the stored dump here
+// within *budget, the part of the total read budget the notes left over
+static void append_unwound(char **buf, size_t *len, size_t *cap, const CoredumpEntry *e, size_t *budget) {
+    SymTrace sym;
+    if (symbolize_core(e->filename, e->exe, COREDUMP_MAX_TRACE_LINES, budget, &sym) != 0) {
+        if (errno == EFBIG) buf_printf(buf, len, cap, "Stack trace: not unwound, the dump is over the read budget\n");
+        return;
+    }
+    buf_printf(buf, len, cap, "Stack trace of the crashing thread:\n");
+    for (size_t i = 0; i < sym.count; ++i) {
+        const SymFrame *f = &sym.frames[i];
+        const char *module = f->module ? strrchr(f->module, '/') : NULL;
+        module = module ? module + 1 : f->module ? f->module : "n/a";
+        buf_printf(buf, len, cap, "#%-2zu 0x%016llx ", i, (unsigned long long)f->pc);
+        if (f->function) buf_printf(buf, len, cap, "%s+0x%llx", f->function, (unsigned long long)f->function_offset);
+        else buf_append(buf, len, cap, "n/a", 3);
+        buf_printf(buf, len, cap, " (%s + 0x%llx)", module, (unsigned long long)f->module_offset);
+        if (f->file) buf_printf(buf, len, cap, " at %s:%d", f->file, f->line);
+        buf_append(buf, len, cap, "\n", 1);
+    }
+    sym_trace_free(&sym);
+}
+
+static void append_dump_state(char **buf, size_t *len, size_t *cap, const CoredumpEntry *e) {
+    const char *where = e->filename ? e->filename : "in the journal";
+    switch (e->dump) {
+    case COREDUMP_DUMP_READ:
+        buf_printf(buf, len, cap, "Dump: %s (notes read from the first %.1f KB%s)\n", where,
+                   e->notes.bytes_read / 1024.0, e->notes.truncated ? ", cut off by the read budget" : "");
+        break;
+    case COREDUMP_DUMP_MISSING: buf_printf(buf, len, cap, "Dump: %s (no longer on disk)\n", where); break;
+    case COREDUMP_DUMP_UNREADABLE: buf_printf(buf, len, cap, "Dump: %s (not readable without root)\n", where); break;
+    case COREDUMP_DUMP_SKIPPED: buf_printf(buf, len, cap, "Dump: %s (not read, over the read budget)\n", where); break;
+    case COREDUMP_DUMP_INVALID: buf_printf(buf, len, cap, "Dump: %s (not a readable ELF core)\n", where); break;
+    default: buf_printf(buf, len, cap, "Dump: not stored\n"); break;
+    }
+}
+
+static void append_entry(char **buf, size_t *len, size_t *cap, const CoredumpEntry *e, int *unwinds,
+                         size_t *budget) {
+    const char *what = e->exe ? e->exe : e->comm ? e->comm : "unknown process";
+    buf_printf(buf, len, cap, "== Crash: %s (%s) ==\n", what, e->signal_name ? e->signal_name : "unknown signal");
+
+    // systemd-coredump's first line ("Process N (comm) of user U dumped core.")
+    if (e->message) {
+        size_t n = strcspn(e->message, "\n");
+        buf_append(buf, len, cap, e->message, n);
+        buf_append(buf, len, cap, "\n", 1);
+    } else {
+        buf_printf(buf, len, cap, "Process %ld (%s) of user %ld dumped core.\n", e->pid, e->comm ? e->comm : "?", e->uid);
+    }
+    time_t secs = (time_t)(e->time_usec / 1000000ULL);
+    struct tm tm;
+    char ts[32];
+    localtime_r(&secs, &tm);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+    buf_printf(buf, len, cap, "Time: %s\n", ts);
+    if (e->cmdline) buf_printf(buf, len, cap, "Command line: %.900s\n", e->cmdline);
+    if (e->unit) buf_printf(buf, len, cap, "Unit: %s\n", e->unit);
+    if (e->package) buf_printf(buf, len, cap, "Package: %s\n", e->package);
+
+    const CoreNotes *n = &e->notes;
+    if (n->have_siginfo) {
+        const char *cause = signal_cause(n->signo, n->code);
+        char addr[48] = "";
+        if (has_fault_address(n->signo, n->code)) snprintf(addr, sizeof(addr), " at 0x%llx", (unsigned long long)n->fault_addr);
+        buf_printf(buf, len, cap, "Fault: %s%s%s%s\n", e->signal_name ? e->signal_name : "signal",
+                   cause ? ", " : "", cause ? cause : "", addr);
+    }
+    if (n->have_regs) {
+        const CoreMapping *m = core_notes_find_mapping(n, n->pc);
+        if (m) {
+            SymTrace sym;
+            char where[1024] = "";
+            if (symbolize_addresses(n, e->time_usec, &n->pc, 1, &sym) == 0 && sym.count == 1) {
+                sym_frame_describe(&sym.frames[0], where, sizeof(where));
+            }
+            sym_trace_free(&sym);
+            buf_printf(buf, len, cap, "Crashed at: 0x%llx in %s + 0x%llx%s%s%s\n", (unsigned long long)n->pc, m->path,
+                       (unsigned long long)(n->pc - m->start + m->offset), where[0] ? " (" : "", where,
+                       where[0] ? ")" : "");
+        } else {
+            buf_printf(buf, len, cap, "Crashed at: 0x%llx (outside any mapped file)\n", (unsigned long long)n->pc);
+        }
+    }
+    append_dump_state(buf, len, cap, e);
+    if (e->message && strstr(e->message, "Stack trace of thread")) {
+        append_trace(buf, len, cap, e);
+    } else if (e->filename && e->dump == COREDUMP_DUMP_READ && *unwinds < SYMBOLIZE_MAX_UNWINDS) {
+        ++*unwinds;
+        append_unwound(buf, len, cap, e, budget);
+    }
+    buf_append(buf, len, cap, "\n", 1);
+}
+
+char* collect_coredumps(const int *cancel, size_t *out_len) {
+    if (geteuid() != 0) {
+        // The dumps are root-only: leave it all to the helper when one is running
+        if (helper_available() || !journal_system_readable()) return NULL;
+    }
+    uint64_t now = (uint64_t)time(NULL) * 1000000ULL;
+    uint64_t age = (uint64_t)COREDUMP_MAX_AGE_DAYS * 86400ULL * 1000000ULL;
+    CoredumpList list;
+    if (coredump_list(COREDUMP_MAX_ENTRIES, now > age ? now - age : 0, COREDUMP_TOTAL_READ_BUDGET, cancel, &list) != 0) {
+        return NULL;
+    }
+
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    if (list.count == 0) {
+        buf_printf(&buf, &len, &cap, "No process crashes in the last %d days.\n", COREDUMP_MAX_AGE_DAYS);
+    } else {
+        buf_printf(&buf, &len, &cap, "%zu process crash%s in the last %d days, newest first%s.\n\n", list.count,
+                   list.count == 1 ? "" : "es", COREDUMP_MAX_AGE_DAYS,
+                   list.count == COREDUMP_MAX_ENTRIES ? " (older ones not shown)" : "");
+        // Unwinding decompresses whole dumps; it gets what reading the notes left
+        size_t budget = COREDUMP_TOTAL_READ_BUDGET;
+        for (size_t i = 0; i < list.count; ++i) {
+            size_t used = list.entries[i].notes.bytes_read;
+            budget -= used < budget ? used : budget;
+        }
+        // Symbolizing and unwinding are the slow part; a cancel is noticed between crashes
+        int unwinds = 0;
+        for (size_t i = 0; i < list.count && !collector_cancel_requested(cancel); ++i) {
+            append_entry(&buf, &len, &cap, &list.entries[i], &unwinds, &budget);
+        }
+    }
+    coredump_list_free(&list);
+    if (collector_cancel_requested(cancel)) {
+        free(buf);
+        return NULL;
+    }
+    if (out_len) *out_len = buf ? len : 0;
+    return buf;
+}
+
+char* coredump_state_token(void) {
+    sd_journal *j = NULL;
+    if (sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY) < 0) return NULL;
+    sd_journal_add_match(j, "MESSAGE_ID=" COREDUMP_MESSAGE_ID, 0);
+    char *token = NULL;
+    sd_journal_seek_tail(j);
+    if (sd_journal_previous(j) > 0) {
+        char *cursor = NULL;
+        if (sd_journal_get_cursor(j, &cursor) >= 0) {
+            token = strdup(cursor);
+            free(cursor);
+        }
+    }
+    sd_journal_close(j);
+    return token ? token : strdup("none");
+}
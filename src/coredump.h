@@ -0,0 +1,90 @@
+#ifndef COREDUMP_H
+#define COREDUMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Process crashes recorded by systemd-coredump. The crashes are listed from the journal
+// (the entries systemd-coredump writes carry the COREDUMP_* fields), so coredumpctl is
+// never run. A stored dump is decompressed as a stream, and only up to the end of its
+// ELF notes, which is where the signal, the registers and the file mappings are; the
+// memory image behind them is never read.
+
+// MESSAGE_ID of the journal entry systemd-coredump writes for every crash
+#define COREDUMP_MESSAGE_ID "fc2e22bc6ee647b6b90729ab34a250b1"
+
+typedef struct {
+    uint64_t start, end;     // mapped address range
+    uint64_t offset;         // file offset of start
+    char *path;
+} CoreMapping;
+
+// What the notes of an ELF core file say about the crashing thread
+typedef struct {
+    int have_siginfo;
+    int signo, code;
+    uint64_t fault_addr;     // only meaningful for SIGSEGV, SIGBUS, SIGILL and SIGFPE
+    int have_regs;
+    uint64_t pc, sp;
+    CoreMapping *maps;       // NT_FILE: the files mapped into the process
+    size_t nmaps;
+    size_t bytes_read;       // decompressed bytes it took
+    int truncated;           // the notes went on beyond the read budget
+} CoreNotes;
+
+typedef enum {
+    COREDUMP_DUMP_NONE,        // not stored (size limits, Storage=none)
+    COREDUMP_DUMP_READ,        // notes read (maybe truncated)
+    COREDUMP_DUMP_MISSING,     // the file was removed since, e.g. by vacuuming
+    COREDUMP_DUMP_UNREADABLE,  // not readable from this process
+    COREDUMP_DUMP_SKIPPED,     // the read budget was used up
+    COREDUMP_DUMP_INVALID,     // not an ELF core, or a corrupt stream
+} CoredumpDumpState;
+
+typedef struct {
+    uint64_t time_usec;
+    long pid, uid;
+    int signal;
+    char *signal_name;       // "SIGSEGV"
+    char *exe, *comm, *cmdline, *unit, *package;
+    char *filename;          // stored dump, NULL when stored in the journal or not at all
+    char *message;           // systemd-coredump's message, with its stack trace when it made one
+    CoredumpDumpState dump;
+    CoreNotes notes;
+} CoredumpEntry;
+
+typedef struct {
+    CoredumpEntry *entries;  // newest first
+    size_t count;
+} CoredumpList;
+
+// Read the newest max_entries crashes since since_usec (wall clock). The notes of each
+// crash's dump are read while read_budget (decompressed bytes over all dumps) lasts.
+// Returns 0, or -1 when the journal cannot be opened or *cancel was set (cancel may be NULL).
+int coredump_list(size_t max_entries, uint64_t since_usec, size_t read_budget, const int *cancel, CoredumpList *out);
+
+void coredump_list_free(CoredumpList *list);
+
+// Read the notes of a core dump file (.zst, .lz4, .xz or uncompressed), decompressing at
+// most budget bytes. Returns 0, or -1 with errno set (ENOEXEC: not an ELF core).
+int coredump_read_notes(const char *path, size_t budget, CoreNotes *out);
+
+// Same for a core (or the head of one) already in memory
+int coredump_parse_notes(const unsigned char *core, size_t len, CoreNotes *out);
+
+void core_notes_free(CoreNotes *notes);
+
+// The mapping addr falls into, or NULL
+const CoreMapping* core_notes_find_mapping(const CoreNotes *notes, uint64_t addr);
+
+// Report collector: one "== Crash: ... ==" section per crash, its stack trace symbolized
+// down to source lines where debug info is installed (see symbolize.h). Returns NULL when the
+// journal is not readable from this process, when the privileged helper is there to
+// read the root-only dumps as well, or once *cancel is set.
+char* collect_coredumps(const int *cancel, size_t *out_len);
+
+// Validity token for collect_coredumps(): the cursor of the newest crash. Caller frees;
+// NULL when the journal cannot be opened.
+char* coredump_state_token(void);
+
+#endif // COREDUMP_H
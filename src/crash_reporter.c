@@ -1,42 +1,95 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <errno.h>
 #include <sys/utsname.h>
 #include <curl/curl.h>
 #include <jansson.h>
 #include "config.h"
 #include "crash_reporter_gui.h"
-#include <gtk/gtk.h>
+#include "collector.h"
+#include "subprocess.h"
+#include "journal.h"
+#include "kmsg.h"
+#include "pacman_log.h"
+#include "logscan.h"
+#include "coredump.h"
+#include "units.h"
+#include "helper.h"
+#include "snapshot.h"
+#include "capture.h"
+#include "report.h"
+#include "http.h"
+#include "sse.h"
+#include "prompt.h"
+#include "severity.h"
+#include "fingerprint.h"
+#include "strbuf.h"
+#include "spool.h"
+#include "cli.h"
 #include <sys/stat.h>
 #include <fcntl.h>
 
 // File-scope flag controlling whether polkit has been authenticated for this run.
 static int polkit_authenticated = 0;
+// Cleared for unattended runs, where nobody can answer a polkit prompt
+static int escalation_allowed = 1;
 
-// Forward declaration for helper used before actual definition
-char* execute_command(const char* cmd);
+void set_privilege_escalation(int allowed) {
+    escalation_allowed = allowed;
+}
 
-// Trigger a one-time pkexec probe so the polkit agent prompts now (if needed).
-// This helps ensure the user only types their password once after seeing explanations.
-void preauthenticate_polkit(void) {
-    if (geteuid() == 0) return; // already root
-    if (polkit_authenticated) return;
+// Forward declaration for helper used before actual definition
+char* execute_command(const char *const argv[], size_t *out_len);
 
+// Locate pkexec, or NULL if polkit is not installed
+const char* find_pkexec(void) {
     const char *pkexec_paths[] = {"/usr/bin/pkexec", "/bin/pkexec", NULL};
-    const char *pkexec = NULL;
     for (int i = 0; pkexec_paths[i]; ++i) {
-        if (access(pkexec_paths[i], X_OK) == 0) { pkexec = pkexec_paths[i]; break; }
+        if (access(pkexec_paths[i], X_OK) == 0) return pkexec_paths[i];
+    }
+    return NULL;
+}
+
+// Start the privileged helper now so the polkit agent prompts now (if needed).
+// This helps ensure the user only types their password once after seeing explanations;
+// all later privileged reads go through the same helper process.
+void preauthenticate_polkit(void) {
+    if (geteuid() == 0 || !escalation_allowed) return; // already root, or not allowed to ask
+    // Collection runs on worker threads; only one of them may prompt
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&lock);
+    if (polkit_authenticated) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    if (helper_start() == 0) {
+        polkit_authenticated = 1;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    // Helper unavailable: fall back to a one-off probe so per-command pkexec calls
+    // at least share the cached authorization
+    const char *pkexec = find_pkexec();
+    if (!pkexec) {
+        pthread_mutex_unlock(&lock);
+        return;
     }
-    if (!pkexec) return;
 
-    char probe_cmd[256];
-    snprintf(probe_cmd, sizeof(probe_cmd), "%s /bin/sh -c 'echo POLKIT_OK'", pkexec);
-    char *probe_out = execute_command(probe_cmd);
+    const char *probe_argv[] = {pkexec, "/bin/echo", "POLKIT_OK", NULL};
+    char *probe_out = execute_command(probe_argv, NULL);
     if (probe_out && strstr(probe_out, "POLKIT_OK") != NULL) {
         polkit_authenticated = 1;
     }
     if (probe_out) free(probe_out);
+    pthread_mutex_unlock(&lock);
 }
 
 // Function to free SystemInfo memory
@@ -59,128 +112,92 @@ char* get_uptime();
 char* get_pacman_log_errors();
 char* get_journalctl_errors();
 char* get_dmesg_errors();
-int detect_errors(const char* text);
-char* create_github_issue(const char* title, const char* body);
+int detect_errors(const char* text, SeverityReport *counts);
 char* generate_ai_message(const char* system_info_json);
 
-// A helper function to execute shell commands and return output
-char* execute_command(const char* cmd) {
-    FILE *fp;
-    char path[1024];
-    char* result = strdup(""); // Initialize with an empty string
-    size_t total_len = 0;
-
-    // Open the command for reading.
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        fprintf(stderr, "Failed to run command: %s\n", cmd);
-        free(result);
+// A helper function to execute a command (argv array, no shell) and return its stdout.
+// stderr is discarded. If out_len is non-NULL it receives the byte length of the output.
+// Output beyond CAPTURE_DEFAULT_BUDGET keeps its head and tail only.
+char* execute_command(const char *const argv[], size_t *out_len) {
+    SpawnResult res;
+    if (out_len) *out_len = 0;
+    if (spawn_capture(argv, CAPTURE_DEFAULT_BUDGET, &res) != 0) {
+        fprintf(stderr, "Failed to run command: %s\n", argv[0]);
         return strdup("Error: Command failed to execute");
     }
-
-    // Read the output a line at a time - output it.
-    while (fgets(path, sizeof(path), fp) != NULL) {
-        size_t line_len = strlen(path);
-        // Check for potential realloc failure before reallocating
-        char* new_result = realloc(result, total_len + line_len + 1);
-        if (new_result == NULL) {
-            perror("realloc failed in execute_command");
-            free(result);
-            pclose(fp);
-            return strdup("Error: Memory allocation failure");
-        }
-        result = new_result;
-        strcpy(result + total_len, path);
-        total_len += line_len;
-    }
-    if (result != NULL) {
-        result[total_len] = '\0'; // Null-terminate the string
-    }
-
-    pclose(fp);
-    return result;
+    free(res.err);
+    if (out_len) *out_len = res.out_len;
+    return res.out;
 }
 
-// Escape single quotes in a shell argument for inclusion inside single quotes
-static char* escape_single_quotes(const char* s) {
-    if (!s) return NULL;
-    size_t len = strlen(s);
-    // worst case every char is a quote, need 4x space roughly, be generous
-    size_t bufsize = len * 4 + 1;
-    char *out = malloc(bufsize);
-    if (!out) return NULL;
-    char *p = out;
-    for (size_t i = 0; i < len; ++i) {
-        if (s[i] == '\'') {
-            // close quote, insert escaped sequence '\'' and reopen
-            strcpy(p, "'\\''");
-            p += 4;
-        } else {
-            *p++ = s[i];
-        }
-    }
-    *p = '\0';
-    return out;
-}
-
-// Execute a command with polkit (pkexec) when not root. Returns allocated string like execute_command.
-char* execute_privileged_command(const char* cmd) {
-    if (geteuid() == 0) {
-        return execute_command(cmd);
+// Build the argv used to run argv with polkit (pkexec) when not root. Returns an
+// allocated array borrowing the strings of argv (free only the array), or NULL when
+// no escalation is needed/possible and argv should be run as is.
+const char** wrap_privileged_argv(const char *const argv[]) {
+    if (geteuid() == 0 || !escalation_allowed) {
+        return NULL;
     }
 
     // (Pre-escalation explanatory dialogs are shown from the GUI at startup.)
 
     // Try pkexec path
-    const char *pkexec_paths[] = {"/usr/bin/pkexec", "/bin/pkexec", NULL};
-    const char *pkexec = NULL;
-    for (int i = 0; pkexec_paths[i]; ++i) {
-        if (access(pkexec_paths[i], X_OK) == 0) { pkexec = pkexec_paths[i]; break; }
-    }
+    const char *pkexec = find_pkexec();
     if (!pkexec) {
         // fallback: attempt normal command (will likely fail for privileged files)
-        return execute_command(cmd);
+        return NULL;
     }
 
-    // If not authenticated yet, run a lightweight pkexec probe (this may prompt once).
-    if (!polkit_authenticated) {
-        char probe_cmd[256];
-        snprintf(probe_cmd, sizeof(probe_cmd), "%s /bin/sh -c 'echo POLKIT_OK'", pkexec);
-        char *probe_out = execute_command(probe_cmd);
-        if (probe_out && strstr(probe_out, "POLKIT_OK") != NULL) {
-            polkit_authenticated = 1;
-        }
-        if (probe_out) free(probe_out);
-    }
+    size_t argc = 0;
+    while (argv[argc]) argc++;
+    const char **full = malloc((argc + 2) * sizeof(char*));
+    if (!full) return NULL;
+    full[0] = pkexec;
+    memcpy(full + 1, argv, (argc + 1) * sizeof(char*));
+    return full;
+}
 
-    char *escaped = escape_single_quotes(cmd);
-    if (!escaped) return execute_command(cmd);
+// Execute a command with polkit (pkexec) when not root, capturing stdout, stderr and the exit
+// status separately. Returns 0 on success (whatever the exit status), -1 if it could not start.
+int execute_privileged_capture(const char *const argv[], SpawnResult *res) {
+    // If not authenticated yet, run a lightweight pkexec probe (this may prompt once).
+    preauthenticate_polkit();
 
-    // Build: pkexec /bin/sh -c 'escaped' 2>&1
-    size_t full_len = strlen(pkexec) + strlen(" /bin/sh -c '' 2>&1") + strlen(escaped) + 1;
-    char *fullcmd = malloc(full_len);
-    if (!fullcmd) { free(escaped); return execute_command(cmd); }
-    snprintf(fullcmd, full_len, "%s /bin/sh -c '%s' 2>&1", pkexec, escaped);
+    const char **full = wrap_privileged_argv(argv);
+    int rc = spawn_capture(full ? full : argv, CAPTURE_DEFAULT_BUDGET, res);
+    free(full);
+    return rc;
+}
 
-    char *res = execute_command(fullcmd);
-    free(escaped);
-    free(fullcmd);
-    return res;
+// Execute a command with polkit (pkexec) when not root. Returns allocated string like execute_command.
+char* execute_privileged_command(const char *const argv[], size_t *out_len) {
+    SpawnResult res;
+    if (out_len) *out_len = 0;
+    if (execute_privileged_capture(argv, &res) != 0) {
+        fprintf(stderr, "Failed to run command: %s\n", argv[0]);
+        return strdup("Error: Command failed to execute");
+    }
+    free(res.err);
+    if (out_len) *out_len = res.out_len;
+    return res.out;
 }
 
 char* get_hostname() {
     char *out = NULL;
+    size_t out_len = 0;
 
     // Try absolute path first only if it exists
     if (access("/bin/hostname", X_OK) == 0) {
-        out = execute_command("/bin/hostname");
+        const char *argv[] = {"/bin/hostname", NULL};
+        out = execute_command(argv, &out_len);
     }
-    if (out == NULL || strlen(out) == 0) {
-        out = execute_command("hostname");
+    if (out == NULL || out_len == 0) {
+        if (out) free(out);
+        const char *argv[] = {"hostname", NULL};
+        out = execute_command(argv, &out_len);
     }
 
     // If still empty or NULL, try reading /etc/hostname
-    if (out == NULL || strlen(out) == 0) {
+    if (out == NULL || out_len == 0) {
         if (out) free(out);
         FILE *f = fopen("/etc/hostname", "r");
         if (f) {
@@ -245,182 +262,381 @@ char* get_os_release() {
 }
 
 char* get_uptime() {
-    return execute_command("uptime");
+    const char *argv[] = {"uptime", NULL};
+    return execute_command(argv, NULL);
 }
 
 char* get_pacman_log_errors() {
-    return execute_privileged_command("grep -i \"error\" /var/log/pacman.log");
+    // pacman.log is normally world-readable; only fall back to grep through polkit if not
+    char *native = collect_pacman_errors(NULL, NULL);
+    if (native) return native;
+    preauthenticate_polkit();
+    char *helped = helper_collect("pacman", NULL);
+    if (helped) return helped;
+    const char *argv[] = {"grep", "-i", "error", "/var/log/pacman.log", NULL};
+    return execute_privileged_command(argv, NULL);
 }
 
 char* get_journalctl_errors() {
-    // journalctl can require privileges for some logs; use polkit if available
-    return execute_privileged_command("journalctl -b -p err..warning --no-pager");
+    // Read the journal natively when we can; otherwise journalctl through polkit
+    char *native = collect_journal_boot_errors(NULL, NULL);
+    if (native) return native;
+    preauthenticate_polkit();
+    char *helped = helper_collect("journal-boot", NULL);
+    if (helped) return helped;
+    const char *argv[] = {"journalctl", "-b", "-p", "err..warning", "--no-pager", NULL};
+    return execute_privileged_command(argv, NULL);
 }
 
 char* get_dmesg_errors() {
+    // Read /dev/kmsg directly when allowed (no dmesg_restrict or we have CAP_SYSLOG)
+    char *native = collect_kmsg_errors(NULL, NULL);
+    if (native) return native;
+    preauthenticate_polkit();
+    char *helped = helper_collect("kmsg", NULL);
+    if (helped) return helped;
+
     // dmesg often requires elevated privileges; try polkit first
-    char* output = execute_privileged_command("dmesg --level=err,warn");
-    if (output == NULL) {
-        return execute_command("dmesg");
+    const char *argv[] = {"dmesg", "--level=emerg,alert,crit,err,warn", NULL};
+    const char *fallback_argv[] = {"dmesg", NULL};
+    SpawnResult res;
+    if (execute_privileged_capture(argv, &res) != 0) {
+        return execute_command(fallback_argv, NULL);
     }
-    // if pkexec not available it may have returned the same error text; fallback
-    if (strstr(output, "not found") != NULL || strstr(output, "Operation not permitted") != NULL) {
-        free(output);
-        return execute_command("dmesg");
+    // pkexec missing/denied or dmesg restricted: fall back to an unprivileged read
+    if (res.exit_status != 0) {
+        spawn_result_free(&res);
+        return execute_command(fallback_argv, NULL);
     }
-    return output;
+    free(res.err);
+    return res.out;
 }
 
-int detect_errors(const char* text) {
-    const char* error_keywords[] = {"error", "fail", "warn", "critical"};
-    int num_keywords = sizeof(error_keywords) / sizeof(error_keywords[0]);
+int detect_errors(const char* text, SeverityReport *counts) {
+    SeverityReport report;
+    if (severity_scan(text, strlen(text), &report) != 0) { // err on the side of filing
+        if (counts) memset(counts, 0, sizeof(*counts));
+        return 1;
+    }
+    int worth = severity_worth_filing(&report);
+    if (counts) *counts = report;
+    else severity_report_free(&report);
+    return worth;
+}
 
-    for (int i = 0; i < num_keywords; i++) {
-        if (strstr(text, error_keywords[i]) != NULL) {
-            return 1; // True, error detected
-        }
+// Append a section, referencing content (which must outlive the report) and cutting it
+// to its head and tail when it is over the limit
+static void append_section(Report *r, const char *title, const char *content, size_t content_len, size_t section_limit) {
+    if (!content) {
+        content = "(no data)";
+        content_len = strlen(content);
+    }
+    report_begin_section(r, title);
+    if (content_len > section_limit) {
+        report_append_bounded(r, content, content_len, section_limit);
+    } else {
+        report_append(r, content, content_len);
     }
-    return 0; // False, no error detected
+    report_end_section(r);
 }
 
-// Helper to append a section into a growing buffer with per-section truncation
-static void append_section_with_limit(char **out_buf, size_t *out_len, size_t *out_cap, const char *title, const char *content, size_t section_limit) {
-    if (!title) title = "";
-    if (!content) content = "(no data)";
+// Every report section after the metadata header is independent, so all collectors run
+// at once. Privileged collectors run in-process when we have access, otherwise through
+// the privileged helper, and only as a last resort as a per-command pkexec. Sections come
+// from the process-wide snapshot: when the report is filed right after the window filled
+// its view, only sources whose validity token changed are re-read.
+static const CollectorSpec report_specs[] = {
+    // 2) Failed systemd units, listed by systemd over D-Bus
+    { "failed-units", "Systemd Failed Units",
+      (const char *const[]){"systemctl", "--failed", "--no-legend", "--no-pager", NULL}, 0, collect_failed_units,
+      failed_units_token, 0 },
+    // 3) Journal errors (all time, most recent JOURNAL_MAX_ENTRIES), read via sd-journal
+    { "journal", "Journalctl (errors)",
+      (const char *const[]){"journalctl", "-p", "err..emerg", "-n", JOURNAL_MAX_ENTRIES_STR, "-o", "short-iso", "--no-pager", NULL}, 1,
+      collect_journal_errors, journal_state_token, 1 },
+    // 4) Kernel warnings and worse, read from /dev/kmsg
+    { "kmsg", "Kernel dmesg (emerg..warn)", (const char *const[]){"dmesg", "--level=emerg,alert,crit,err,warn", NULL}, 1,
+      collect_kmsg_errors, kmsg_state_token, 1 },
+    // 5) Process crashes from systemd-coredump, one section per crash, read from the journal
+    // and the dumps' ELF notes (there is deliberately no coredumpctl fallback)
+    { "coredumps", "Process Crashes (systemd-coredump)", NULL, 1, collect_coredumps, coredump_state_token, 0 },
+    // 6) Pacman log errors with the transaction they belong to (incremental, indexed parse).
+    // Not deduplicated: each error keeps its own transaction and timestamp.
+    { "pacman", "Pacman Log Errors", (const char *const[]){"grep", "-I", "-n", "-i", "error", PACMAN_LOG_PATH, NULL}, 1, collect_pacman_errors,
+      pacman_log_state_token, 0 },
+    // 7) Search /var/log for 'error' across many logs (limit search depth). The native
+    // scanner also reads rotated .gz/.xz/.zst logs.
+    { "varlog", "Other /var/log Matches (grep -i 'error')",
+      (const char *const[]){"find", "/var/log", "-maxdepth", "3", "-type", "f", "-readable", "-exec", "grep", "-I", "-n", "-i", "error", "{}", "+", NULL}, 1,
+      collect_varlog_matches, varlog_state_token, 1 },
+    // 8) Status of each failed unit with its recent journal lines; does not wait on section
+    // 2. Not deduplicated: the per-unit blocks only make sense whole.
+    { "unit-status", "Detailed Failed Unit Statuses", NULL, 1, collect_failed_unit_statuses, failed_units_token, 0 },
+};
+#define REPORT_NSPECS (sizeof(report_specs) / sizeof(report_specs[0]))
+#define REPORT_UNIT_STATUS_IDX (REPORT_NSPECS - 1)
+
+typedef struct {
+    ReportSectionFn on_section;
+    void *user;
+    const int *cancel;
+    size_t section_limit;
+} GatherProgress;
+
+// Append one collector's output the way it appears in the report. Returns 0 when the
+// section is left out (no failed units to show statuses for).
+static int append_report_section(Report *r, size_t idx, const char *out, size_t len, const int *cancel,
+                                 size_t section_limit) {
+    // Unit statuses are only reported when there were failed units to inspect
+    if (idx == REPORT_UNIT_STATUS_IDX && (!out || len == 0)) return 0;
+    if (out) {
+        append_section(r, report_specs[idx].title, out, len, section_limit);
+    } else {
+        int cancelled = cancel && __atomic_load_n(cancel, __ATOMIC_ACQUIRE);
+        const char *note = cancelled ? "(cancelled)" : "(none)";
+        append_section(r, report_specs[idx].title, note, strlen(note), section_limit);
+    }
+    return 1;
+}
+
+static void gather_collector_done(size_t index, const char *output, size_t len, void *user) {
+    GatherProgress *gp = user;
+    Report *section = report_new();
+    int shown = section && append_report_section(section, index, output, len, gp->cancel, gp->section_limit);
+    size_t tlen = 0;
+    const char *text = shown ? report_text(section, &tlen) : NULL;
+    gp->on_section(index + 1, REPORT_NSPECS + 1, report_specs[index].title,
+                   shown ? REPORT_SECTION_READY : REPORT_SECTION_SKIPPED, text, tlen, gp->user);
+    report_free(section);
+}
 
-    size_t title_len = strlen(title);
-    size_t content_len = strlen(content);
-    // compute added size (with separators)
-    size_t add = title_len + 4 + (content_len > section_limit ? section_limit + 32 : content_len) + 4;
-    if (*out_len + add + 1 > *out_cap) {
-        size_t newcap = (*out_cap == 0) ? (add + 1024) : (*out_cap * 2 + add);
-        char *n = realloc(*out_buf, newcap);
-        if (!n) return;
-        *out_buf = n;
-        *out_cap = newcap;
+static void release_snapshot_output(void *out) {
+    snapshot_output_release(out);
+}
+
+// A saved text report ("== title ==" sections, as -o writes it) split back into its
+// sections, read in place of the machine's sources when CRASH_REPORTER_REPORT_INPUT names
+// one, so that tests file the same crash on every machine and every run
+static Report* load_report_input(const char *path, ReportSectionFn on_section, void *user) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot read report input %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf_append(&buf, &len, &cap, chunk, n);
+    fclose(f);
+    Report *report = buf ? report_new() : NULL;
+    if (!report || report_own(report, buf) != 0) {
+        report_free(report);
+        free(buf);
+        return NULL;
     }
 
-    // Append header
-    size_t p = *out_len;
-    int wrote = snprintf(*out_buf + p, *out_cap - p, "== %s ==\n", title);
-    if (wrote < 0) return;
-    p += wrote;
+    // Header line offsets first, so each section knows where it ends
+    size_t *heads = NULL, nheads = 0, heads_cap = 0;
+    for (size_t p = 0; p < len;) {
+        const char *nl = memchr(buf + p, '\n', len - p);
+        size_t e = nl ? (size_t)(nl - buf) : len;
+        if (e - p >= 6 && memcmp(buf + p, "== ", 3) == 0 && memcmp(buf + e - 3, " ==", 3) == 0) {
+            if (nheads == heads_cap) {
+                size_t newcap = heads_cap ? heads_cap * 2 : 16;
+                size_t *h = realloc(heads, newcap * sizeof(size_t));
+                if (!h) break;
+                heads = h;
+                heads_cap = newcap;
+            }
+            heads[nheads++] = p;
+        }
+        p = e + 1;
+    }
+    for (size_t i = 0; i < nheads; ++i) {
+        const char *h = buf + heads[i];
+        const char *title_end = memchr(h, '\n', len - heads[i]);
+        size_t hlen = title_end ? (size_t)(title_end - h) : len - heads[i];
+        char title[256];
+        snprintf(title, sizeof(title), "%.*s", (int)(hlen - 6), h + 3);
+        size_t body = heads[i] + hlen + (title_end ? 1 : 0);
+        size_t end = i + 1 < nheads ? heads[i + 1] : len;
+        // The blank line after each body is report_end_section()'s
+        if (end > body && buf[end - 1] == '\n' && (end - 1 == body || buf[end - 2] == '\n')) end--;
+        report_begin_section(report, title);
+        report_append(report, buf + body, end - body);
+        report_end_section(report);
+        if (on_section) {
+            on_section(i, nheads, title, REPORT_SECTION_READY, buf + heads[i], end - heads[i], user);
+        }
+    }
+    free(heads);
+    return report;
+}
 
-    // Append content, possibly truncated
-    if (content_len > section_limit) {
-        // copy head portion and add truncation note
-        memcpy(*out_buf + p, content, section_limit);
-        p += section_limit;
-        const char *note = "\n... (truncated)\n";
-        size_t nl = strlen(note);
-        memcpy(*out_buf + p, note, nl);
-        p += nl;
-    } else {
-        memcpy(*out_buf + p, content, content_len);
-        p += content_len;
+Report* gather_report(SystemInfo* info, ReportSectionFn on_section, void *user, const int *cancel) {
+    const char *input = getenv("CRASH_REPORTER_REPORT_INPUT");
+    if (input && input[0]) return load_report_input(input, on_section, user);
+
+    const size_t SECTION_LIMIT = CAPTURE_DEFAULT_BUDGET; // 200KB per section
+    const size_t total = REPORT_NSPECS + 1;
+    Report *report = report_new();
+    if (!report) return NULL;
+
+    if (on_section) {
+        on_section(0, total, "System Metadata", REPORT_SECTION_PENDING, NULL, 0, user);
+        for (size_t i = 0; i < REPORT_NSPECS; ++i) {
+            on_section(i + 1, total, report_specs[i].title, REPORT_SECTION_PENDING, NULL, 0, user);
+        }
     }
 
-    // trailing newline
-    (*out_buf)[p++] = '\n';
-    (*out_buf)[p] = '\0';
-    *out_len = p;
+    // 1) Basic metadata header
+    report_begin_section(report, "System Metadata");
+    report_printf(report, "Hostname: %s\nKernel: %s\nOS Release: %s\nUptime: %s\n\n",
+                  info && info->hostname ? info->hostname : "(unknown)",
+                  info && info->kernel ? info->kernel : "(unknown)",
+                  info && info->os_release ? info->os_release : "(unknown)",
+                  info && info->uptime ? info->uptime : "(unknown)");
+    report_end_section(report);
+    if (on_section) {
+        size_t len = 0;
+        char *text = report_flatten(report, &len);
+        on_section(0, total, "System Metadata", REPORT_SECTION_READY, text, len, user);
+        free(text);
+    }
+
+    // 2..8) Collected in parallel; each section is reported as soon as it is done and the
+    // report is assembled in the usual order once the slowest one finishes. The report
+    // refers to the snapshot's copy of each output rather than copying it again.
+    GatherProgress gp = { on_section, user, cancel, SECTION_LIMIT };
+    CollectorProgress progress = { on_section ? gather_collector_done : NULL, &gp, cancel, NULL };
+    SnapshotOutput **outputs = snapshot_collect(report_specs, REPORT_NSPECS, &progress);
+    for (size_t i = 0; i < REPORT_NSPECS; ++i) {
+        SnapshotOutput *out = outputs ? outputs[i] : NULL;
+        if (out && report_hold(report, out, release_snapshot_output) != 0) {
+            snapshot_output_release(out);
+            out = NULL;
+        }
+        append_report_section(report, i, out ? out->data : NULL, out ? out->len : 0, cancel, SECTION_LIMIT);
+    }
+    free(outputs);
+    return report;
 }
 
 // Gather and format errors from multiple sources. Limits each section to ~200KB by default.
 char* gather_all_errors(SystemInfo* info) {
-    const size_t SECTION_LIMIT = 200 * 1024; // 200KB per section
-    char *buffer = NULL;
-    size_t buflen = 0, bufcap = 0;
+    Report *report = gather_report(info, NULL, NULL, NULL);
+    char *text = report ? report_flatten(report, NULL) : NULL;
+    report_free(report);
+    return text;
+}
 
-    // 1) Basic metadata header
-    char meta[1024];
-    snprintf(meta, sizeof(meta), "Hostname: %s\nKernel: %s\nOS Release: %s\nUptime: %s\n\n",
-             info && info->hostname ? info->hostname : "(unknown)",
-             info && info->kernel ? info->kernel : "(unknown)",
-             info && info->os_release ? info->os_release : "(unknown)",
-             info && info->uptime ? info->uptime : "(unknown)");
-    append_section_with_limit(&buffer, &buflen, &bufcap, "System Metadata", meta, SECTION_LIMIT);
-
-    // 2) Failed systemd units
-    char *svc = execute_command("systemctl --failed --no-legend --no-pager 2>/dev/null || true");
-    append_section_with_limit(&buffer, &buflen, &bufcap, "Systemd Failed Units", svc ? svc : "(none)", SECTION_LIMIT);
-    if (svc) free(svc);
-
-    // 3) Journalctl errors (all time)
-    char *journal = execute_privileged_command("journalctl -p err..emerg --no-pager 2>/dev/null || true");
-    append_section_with_limit(&buffer, &buflen, &bufcap, "Journalctl (errors)", journal ? journal : "(none)", SECTION_LIMIT);
-    if (journal) free(journal);
-
-    // 4) Dmesg errors/warnings
-    char *dmesg = execute_privileged_command("dmesg --level=err,warn 2>/dev/null || true");
-    append_section_with_limit(&buffer, &buflen, &bufcap, "Kernel dmesg (err,warn)", dmesg ? dmesg : "(none)", SECTION_LIMIT);
-    if (dmesg) free(dmesg);
-
-    // 5) Pacman log errors
-    char *pac = execute_privileged_command("grep -I -n -i \"error\" /var/log/pacman.log 2>/dev/null || true");
-    append_section_with_limit(&buffer, &buflen, &bufcap, "Pacman Log Errors", pac ? pac : "(none)", SECTION_LIMIT);
-    if (pac) free(pac);
-
-    // 6) Grep /var/log for 'error' across many logs (limit search depth)
-    char *others = execute_privileged_command("find /var/log -type f -maxdepth 3 -readable -exec grep -I -n -i \"error\" {} + 2>/dev/null || true");
-    append_section_with_limit(&buffer, &buflen, &bufcap, "Other /var/log Matches (grep -i 'error')", others ? others : "(none)", SECTION_LIMIT);
-    if (others) free(others);
-
-    // 7) Any systemctl status messages for failed units (verbose)
-    char *unit_list = execute_command("systemctl --failed --no-legend --no-pager | awk '{print $1}' 2>/dev/null || true");
-    if (unit_list && strlen(unit_list) > 0) {
-        // For each unit (space/newline separated), gather 'systemctl status' (limit)
-        append_section_with_limit(&buffer, &buflen, &bufcap, "Failed Unit Statuses (truncated)", "Collecting unit statuses...", SECTION_LIMIT);
-        // We'll run a safe loop and append statuses; to avoid shell quoting issues, write to a temp file and read lines
-        char tmpf[] = "/tmp/crashrep_units_XXXXXX";
-        int fd = mkstemp(tmpf);
-        if (fd >= 0) {
-            write(fd, unit_list, strlen(unit_list));
-            close(fd);
-            char cmd[512];
-            snprintf(cmd, sizeof(cmd), "while read u; do systemctl status --no-pager --full $u 2>/dev/null || true; echo \"---\"; done < %s 2>/dev/null || true", tmpf);
-            char *units_status = execute_privileged_command(cmd);
-            if (units_status) {
-                append_section_with_limit(&buffer, &buflen, &bufcap, "Detailed Failed Unit Statuses", units_status, SECTION_LIMIT);
-                free(units_status);
-            }
-            unlink(tmpf);
+// The fingerprint summary as a fenced block of at most ~4000 bytes, cut after a whole line.
+// The fence is longer than any backtick run in the text so the summary cannot close it.
+static gchar* fence_summary(const char *summary) {
+    const size_t SUMMARY_LIMIT = 4000;
+    if (!summary) summary = "";
+    size_t len = strlen(summary);
+    if (len > SUMMARY_LIMIT) {
+        size_t cut = SUMMARY_LIMIT;
+        while (cut > 0 && summary[cut - 1] != '\n') cut--;
+        if (cut > 0) {
+            len = cut;
+        } else {
+            // A single overlong line: cut it at a character boundary
+            len = SUMMARY_LIMIT;
+            while (len > 0 && ((unsigned char)summary[len] & 0xC0) == 0x80) len--;
         }
     }
-    if (unit_list) free(unit_list);
+    while (len > 0 && summary[len - 1] == '\n') len--;
+    size_t run = 0, longest = 0;
+    for (size_t i = 0; i < len; ++i) {
+        run = summary[i] == '`' ? run + 1 : 0;
+        if (run > longest) longest = run;
+    }
+    size_t flen = longest >= 3 ? longest + 1 : 3;
+    gchar *fence = g_strnfill(flen, '`');
+    gchar *block = g_strdup_printf("%s\n%.*s\n%s\n", fence, (int)len, summary, fence);
+    g_free(fence);
+    return block;
+}
 
-    // If nothing was collected, produce a short note
-    if (!buffer) {
-        buffer = strdup("(no errors found or failed to collect error data)");
+// GitHub limits issue body size (65536). Truncate parts if necessary. The fingerprint goes
+// at the end, whole, so the search API finds the issue for later reports of the same crash.
+// The body refers to the report's text and takes the AI message; neither is copied.
+Report* build_issue_body(const Report *report, char *ai_message, const Fingerprint *fp) {
+    const size_t GITHUB_BODY_LIMIT = 65536;
+    static const char mid[] = "\n```\n\n## AI Generated Summary\n";
+    static const char trunc_suffix[] = "\n... (truncated)";
+    Report *body = report_new();
+    if (!body || report_own(body, ai_message) != 0) {
+        free(ai_message);
+        report_free(body);
+        return NULL;
     }
 
-    return buffer;
-}
+    gchar *tail;
+    if (fp->id[0]) {
+        gchar *block = fence_summary(fp->summary);
+        tail = g_strdup_printf("\n\n## Crash Fingerprint\n`%s`\n%s", fp->id, block);
+        g_free(block);
+    } else {
+        tail = g_strdup("\n");
+    }
 
-// Struct to hold response data from curl
-struct MemoryStruct {
-  char *memory;
-  size_t size;
-};
+    report_printf(body, "@%s\n\n## System Information\n```\n", GITHUB_PING_USERS);
+    size_t fixed = report_length(body) + strlen(mid) + strlen(tail);
+    size_t available = GITHUB_BODY_LIMIT > fixed ? GITHUB_BODY_LIMIT - fixed : 0;
 
-// Callback function for curl to write received data
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    struct MemoryStruct *mem = (struct MemoryStruct *)userp;
+    // Split available roughly between system info and ai message
+    size_t sys_allow = available / 2;
+    size_t ai_allow = available - sys_allow;
+    size_t suffix_len = strlen(trunc_suffix);
 
-    char *ptr = realloc(mem->memory, mem->size + realsize + 1);
-    if(ptr == NULL) {
-      /* out of memory! */
-      printf("not enough memory (realloc returned NULL)\n");
-      return 0;
+    if (report_length(report) > sys_allow) {
+        size_t take = sys_allow > suffix_len ? sys_allow - suffix_len : 0;
+        report_append_range(body, report, 0, report_char_boundary(report, take));
+        report_append(body, trunc_suffix, suffix_len);
+    } else {
+        report_append_range(body, report, 0, report_length(report));
+    }
+    report_append(body, mid, strlen(mid));
+
+    size_t ai_len = strlen(ai_message);
+    if (ai_len > ai_allow) {
+        size_t take = ai_allow > suffix_len ? ai_allow - suffix_len : 0;
+        while (take > 0 && ((unsigned char)ai_message[take] & 0xC0) == 0x80) take--;
+        report_append(body, ai_message, take);
+        report_append(body, trunc_suffix, suffix_len);
+    } else {
+        report_append(body, ai_message, ai_len);
     }
 
-    mem->memory = ptr;
-    memcpy(&(mem->memory[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->memory[mem->size] = 0;
+    // The fingerprint text is small; it moves into the body's own storage
+    report_append_copy(body, tail, strlen(tail));
+    g_free(tail);
+    return body;
+}
+
+// Comment for a repeat of a known crash, with this machine's details
+char* build_repeat_comment(const SystemInfo *info, const Fingerprint *fp) {
+    gchar *block = fence_summary(fp->summary);
+    gchar *text = g_strdup_printf("Seen again on `%s` (kernel %s, %s, up %s).\n\nFingerprint `%s`:\n%s",
+                                  info->hostname ? info->hostname : "(unknown)",
+                                  info->kernel ? info->kernel : "(unknown)",
+                                  info->os_release ? info->os_release : "(unknown)",
+                                  info->uptime ? info->uptime : "(unknown)", fp->id, block);
+    g_free(block);
+    char *comment = strdup(text);
+    g_free(text);
+    return comment;
+}
 
-    return realsize;
+char* build_issue_title(const SystemInfo *info) {
+    char title[256];
+    snprintf(title, sizeof(title), "Automated Bug Report: System Errors Detected on %s",
+             info->hostname ? info->hostname : "(unknown)");
+    return strdup(title);
 }
 
 // Runtime-stored API keys (set via GUI at runtime)
@@ -526,167 +742,528 @@ void load_runtime_keys(void) {
     json_decref(root);
 }
 
-char* create_github_issue(const char* title, const char* body) {
-    CURL *curl;
-    CURLcode res;
-    struct MemoryStruct chunk;
-    json_t *root;
-    char *json_data;
-    char auth_header[256];
-    struct curl_slist *headers = NULL;
-    char url[512];
+const char* get_github_api_base(void) {
+    const char *env = getenv("CRASH_REPORTER_GITHUB_API");
+    return env && env[0] ? env : GITHUB_API_BASE;
+}
+
+// Why the last GitHub call on this thread failed; set before its done callback runs
+static __thread ApiError last_api_error;
+
+ApiError api_last_error(void) {
+    return last_api_error;
+}
+
+// Failures worth retrying later: no connection, timeouts, server errors, rate limits
+static ApiError classify_response(const HttpResponse *resp) {
+    if (resp->cancelled) return API_ERROR_CANCELLED;
+    if (resp->result != CURLE_OK) return API_ERROR_NETWORK;
+    if (resp->status >= 500 || resp->status == 429) return API_ERROR_NETWORK;
+    if (resp->status == 403 && resp->body && strstr(resp->body, "rate limit")) return API_ERROR_NETWORK;
+    return resp->status >= 200 && resp->status < 300 ? API_OK : API_ERROR_REJECTED;
+}
+
+// Completion state of a GitHub call
+typedef struct {
+    ApiResultFn done;
+    void *user;
+    char what[64];           // "issue created", "comment added": what html_url points at
+    char fingerprint[FINGERPRINT_ID_SIZE]; // searches only
+} ApiCall;
+
+// payload (malloc'd, may be NULL for a GET) is handed to the request
+static HttpRequest* start_api_call(const char *url, const char *const *headers, char *payload, size_t payload_len,
+                                   HttpDoneFn on_done, HttpDataFn on_data, HttpProgressFn progress, void *user) {
+    HttpRequestOptions opts = {0};
+    opts.url = url;
+    opts.headers = headers;
+    opts.body = payload;
+    opts.body_len = payload_len;
+    opts.take_body = 1;
+    opts.on_done = on_done;
+    opts.on_data = on_data;
+    opts.on_progress = progress;
+    opts.user = user;
+    return http_request_start(&opts);
+}
+
+static void github_issue_done(const HttpResponse *resp, void *user) {
+    ApiCall *call = user;
     char *created_url = NULL;
+    ApiError err = classify_response(resp);
+    if (resp->cancelled) {
+        fprintf(stderr, "GitHub request cancelled (%s)\n", call->what);
+    } else if (resp->result != CURLE_OK) {
+        fprintf(stderr, "GitHub request failed: %s\n", resp->error);
+    } else if (err != API_OK) {
+        fprintf(stderr, "GitHub API returned HTTP %ld: %.500s\n", resp->status, resp->body);
+    } else {
+        printf("GitHub API response: %s\n", resp->body);
+        json_t *response_root = json_loads(resp->body, 0, NULL);
+        if (response_root) {
+            json_t *html_url_obj = json_object_get(response_root, "html_url");
+            if (json_is_string(html_url_obj)) {
+                const char *urlstr = json_string_value(html_url_obj);
+                printf("GitHub %s: %s\n", call->what, urlstr);
+                created_url = strdup(urlstr);
+            } else {
+                printf("Failed to get issue URL from response.\n");
+                err = API_ERROR_REJECTED;
+            }
+            json_decref(response_root);
+        } else {
+            printf("Failed to parse GitHub API response.\n");
+            err = API_ERROR_REJECTED;
+        }
+    }
+    last_api_error = err;
+    call->done(created_url, call->user);
+    free(call);
+}
 
-    chunk.memory = malloc(1);  /* will be grown as needed by realloc */
-    chunk.size = 0;    /* no data at this point */
+static int github_token_configured(const char *token) {
+    return token && token[0] && strcmp(token, "your_github_token_here") != 0;
+}
 
+// prefix, r as a JSON string, suffix: one allocation of the exact size, no copy of r
+// beyond the escaped text itself. Caller frees.
+static char* json_payload(const char *prefix, const Report *r, const char *suffix, size_t *out_len) {
+    size_t plen = strlen(prefix), slen = strlen(suffix);
+    size_t len = plen + report_json_length(r) + slen;
+    char *out = malloc(len + 1);
+    if (!out) return NULL;
+    memcpy(out, prefix, plen);
+    char *p = report_json_write(r, out + plen);
+    memcpy(p, suffix, slen + 1);
+    *out_len = len;
+    return out;
+}
+
+// POST a JSON payload (malloc'd, handed over) to the GitHub API; done gets the html_url
+// of what was created
+static HttpRequest* github_post(const char *url, char *json_data, size_t json_len, const char *what, ApiResultFn done,
+                                HttpProgressFn progress, void *user) {
     const char *effective_token = get_effective_github_token();
-    if (!effective_token || strcmp(effective_token, "your_github_token_here") == 0) {
+    char auth_header[256];
+    snprintf(auth_header, sizeof(auth_header), "Authorization: token %s", effective_token);
+    const char *headers[] = {auth_header, "User-Agent: AcreetionOS-Crash-Reporter", "Content-Type: application/json",
+                             "Accept: application/vnd.github+json", NULL};
+
+    ApiCall *call = json_data ? calloc(1, sizeof(ApiCall)) : NULL;
+    HttpRequest *req = NULL;
+    if (call) {
+        call->done = done;
+        call->user = user;
+        snprintf(call->what, sizeof(call->what), "%s", what);
+        req = start_api_call(url, headers, json_data, json_len, github_issue_done, NULL, progress, call);
+        if (!req) free(call);
+    } else {
+        free(json_data);
+    }
+    if (!req) {
+        fprintf(stderr, "Failed to start GitHub request\n");
+        last_api_error = API_ERROR_NETWORK;
+        done(NULL, user);
+    }
+    return req;
+}
+
+HttpRequest* create_github_issue_async(const char* title, const Report* body, ApiResultFn done,
+                                       HttpProgressFn progress, void *user) {
+    if (!github_token_configured(get_effective_github_token())) {
         fprintf(stderr, "GitHub token not configured. Please set it via the GUI or edit src/config.h.\n");
         fprintf(stderr, "Generate a Personal Access Token from GitHub settings with 'repo' scope for creating issues.\n");
-        free(chunk.memory);
+        last_api_error = API_ERROR_CONFIG;
+        done(NULL, user);
         return NULL;
     }
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
-
-    if(curl) {
-        snprintf(url, sizeof(url), "https://api.github.com/repos/%s/%s/issues", GITHUB_REPO_OWNER, GITHUB_REPO_NAME);
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-
-        snprintf(auth_header, sizeof(auth_header), "Authorization: token %s", effective_token);
-        headers = curl_slist_append(headers, auth_header);
-        headers = curl_slist_append(headers, "User-Agent: AcreetionOS-Crash-Reporter");
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-        // Construct JSON payload
-        root = json_object();
-        json_object_set_new(root, "title", json_string(title));
-        json_object_set_new(root, "body", json_string(body));
+    char url[512];
+    snprintf(url, sizeof(url), "%s/repos/%s/%s/issues", get_github_api_base(), GITHUB_REPO_OWNER, GITHUB_REPO_NAME);
+
+    // {"title":...,"body":...}, the body escaped straight from its slices
+    Report *title_r = report_new();
+    char *head = NULL, *json_data = NULL;
+    size_t head_len = 0, json_len = 0;
+    if (title_r) {
+        report_append(title_r, title, strlen(title));
+        head = json_payload("{\"title\":", title_r, ",\"body\":", &head_len);
+        report_free(title_r);
+    }
+    if (head) json_data = json_payload(head, body, "}", &json_len);
+    free(head);
+    return github_post(url, json_data, json_len, "issue created", done, progress, user);
+}
 
-        json_data = json_dumps(root, 0);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
+HttpRequest* github_comment_issue_async(const char* issue_url, const char* body, ApiResultFn done,
+                                        HttpProgressFn progress, void *user) {
+    if (!github_token_configured(get_effective_github_token())) {
+        fprintf(stderr, "GitHub token not configured; cannot comment on %s\n", issue_url);
+        last_api_error = API_ERROR_CONFIG;
+        done(NULL, user);
+        return NULL;
+    }
+    // The issue number is the last path component of its html_url
+    const char *slash = issue_url ? strrchr(issue_url, '/') : NULL;
+    long number = slash ? strtol(slash + 1, NULL, 10) : 0;
+    if (number <= 0) {
+        fprintf(stderr, "Not a GitHub issue URL: %s\n", issue_url ? issue_url : "(null)");
+        last_api_error = API_ERROR_REJECTED;
+        done(NULL, user);
+        return NULL;
+    }
 
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
+    char url[512];
+    snprintf(url, sizeof(url), "%s/repos/%s/%s/issues/%ld/comments", get_github_api_base(), GITHUB_REPO_OWNER,
+             GITHUB_REPO_NAME, number);
+    json_t *root = json_object();
+    json_object_set_new(root, "body", json_string(body));
+    char *json_data = json_dumps(root, 0);
+    json_decref(root);
+    return github_post(url, json_data, json_data ? strlen(json_data) : 0, "comment added", done, progress, user);
+}
 
-        res = curl_easy_perform(curl);
-        if(res != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+// Percent-encode a query string value
+static void url_encode(const char *in, char *out, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t o = 0;
+    for (const unsigned char *c = (const unsigned char*)in; *c && o + 4 < size; ++c) {
+        if (isalnum(*c) || *c == '-' || *c == '_' || *c == '.' || *c == '~') {
+            out[o++] = (char)*c;
         } else {
-            printf("GitHub API response: %s\n", chunk.memory);
-            json_t *response_root = json_loads(chunk.memory, 0, NULL);
-            if (response_root) {
-                json_t *html_url_obj = json_object_get(response_root, "html_url");
-                if (json_is_string(html_url_obj)) {
-                    const char *urlstr = json_string_value(html_url_obj);
-                    printf("GitHub issue created: %s\n", urlstr);
-                    created_url = strdup(urlstr);
-                } else {
-                    printf("Failed to get issue URL from response.\n");
-                }
-                json_decref(response_root);
-            } else {
-                printf("Failed to parse GitHub API response.\n");
-            }
+            out[o++] = '%';
+            out[o++] = hex[*c >> 4];
+            out[o++] = hex[*c & 15];
         }
+    }
+    out[o] = '\0';
+}
 
+// Search results are full-text matches, so the fingerprint must really be in the issue
+// body. An open issue is preferred over a closed one.
+static void github_search_done(const HttpResponse *resp, void *user) {
+    ApiCall *call = user;
+    char *found = NULL;
+    last_api_error = classify_response(resp);
+    if (resp->cancelled) {
+        fprintf(stderr, "GitHub search cancelled\n");
+    } else if (resp->result != CURLE_OK) {
+        fprintf(stderr, "GitHub search failed: %s\n", resp->error);
+    } else if (resp->status != 200) {
+        fprintf(stderr, "GitHub search returned HTTP %ld: %.200s\n", resp->status, resp->body);
+    } else {
+        json_t *root = json_loads(resp->body, 0, NULL);
+        json_t *item;
+        size_t i;
+        const char *open_url = NULL, *closed_url = NULL;
+        json_array_foreach(json_object_get(root, "items"), i, item) {
+            const char *body = json_string_value(json_object_get(item, "body"));
+            const char *html_url = json_string_value(json_object_get(item, "html_url"));
+            if (!body || !html_url || !strstr(body, call->fingerprint)) continue;
+            const char *state = json_string_value(json_object_get(item, "state"));
+            if (state && strcmp(state, "open") == 0) {
+                if (!open_url) open_url = html_url;
+            } else if (!closed_url) {
+                closed_url = html_url;
+            }
+        }
+        const char *url = open_url ? open_url : closed_url;
+        if (url) {
+            printf("Fingerprint %s already filed: %s\n", call->fingerprint, url);
+            found = strdup(url);
+        }
         json_decref(root);
-        free(json_data);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
     }
-    free(chunk.memory);
-    curl_global_cleanup();
-    return created_url; // may be NULL on failure
+    call->done(found, call->user);
+    free(call);
 }
 
-char* generate_ai_message(const char* system_info_json) {
-    CURL *curl;
-    CURLcode res;
-    struct MemoryStruct chunk;
-    json_t *root, *contents_array, *part_object, *text_object, *candidate_array, *content_object, *ai_text_object;
-    char *json_data;
-    struct curl_slist *headers = NULL;
-    char url[512];
-    char* ai_message = NULL;
+HttpRequest* github_find_issue_async(const char* fingerprint, ApiResultFn done, HttpProgressFn progress, void *user) {
+    char query[256], encoded[768], url[1024];
+    snprintf(query, sizeof(query), "\"%s\" in:body repo:%s/%s is:issue", fingerprint, GITHUB_REPO_OWNER, GITHUB_REPO_NAME);
+    url_encode(query, encoded, sizeof(encoded));
+    snprintf(url, sizeof(url), "%s/search/issues?q=%s&per_page=10", get_github_api_base(), encoded);
+
+    // Public repositories can be searched without a token (at a lower rate limit)
+    const char *token = get_effective_github_token();
+    char auth_header[256];
+    snprintf(auth_header, sizeof(auth_header), "Authorization: token %s", github_token_configured(token) ? token : "");
+    const char *headers[] = {"User-Agent: AcreetionOS-Crash-Reporter", "Accept: application/vnd.github+json",
+                             github_token_configured(token) ? auth_header : NULL, NULL};
+
+    ApiCall *call = calloc(1, sizeof(ApiCall));
+    HttpRequest *req = NULL;
+    if (call) {
+        call->done = done;
+        call->user = user;
+        snprintf(call->fingerprint, sizeof(call->fingerprint), "%s", fingerprint);
+        req = start_api_call(url, headers, NULL, 0, github_search_done, NULL, progress, call);
+        if (!req) free(call);
+    }
+    if (!req) {
+        fprintf(stderr, "Failed to start GitHub search\n");
+        last_api_error = API_ERROR_NETWORK;
+        done(NULL, user);
+    }
+    return req;
+}
+
+// Streaming Gemini call: SSE events are parsed as they arrive and the text of every
+// candidates[0].content.parts[] entry is appended to the message and passed on as a delta.
+typedef struct {
+    SseParser sse;
+    char *text;              // message assembled from the deltas
+    size_t text_len;
+    size_t text_cap;
+    char error_head[512];    // start of a non-SSE body (API errors come as plain JSON)
+    size_t error_len;
+    ApiResultFn done;
+    ApiDeltaFn delta;
+    void *user;
+} GeminiStream;
+
+static int gemini_append(GeminiStream *g, const char *text, size_t len) {
+    if (g->text_len + len + 1 > g->text_cap) {
+        size_t cap = g->text_cap ? g->text_cap * 2 : 4096;
+        while (cap < g->text_len + len + 1) cap *= 2;
+        char *p = realloc(g->text, cap);
+        if (!p) return -1;
+        g->text = p;
+        g->text_cap = cap;
+    }
+    memcpy(g->text + g->text_len, text, len);
+    g->text_len += len;
+    g->text[g->text_len] = '\0';
+    return 0;
+}
 
-    chunk.memory = malloc(1);  /* will be grown as needed by realloc */
-    chunk.size = 0;    /* no data at this point */
+static int gemini_event(const char *data, size_t len, void *user) {
+    GeminiStream *g = user;
+    json_t *event = json_loadb(data, len, 0, NULL);
+    if (!event) return 0; // skip what we cannot parse, keep streaming
+    json_t *err = json_object_get(event, "error");
+    if (err) {
+        json_t *msg = json_object_get(err, "message");
+        fprintf(stderr, "Gemini API error: %s\n", json_is_string(msg) ? json_string_value(msg) : "(no message)");
+    }
+    json_t *candidates = json_object_get(event, "candidates");
+    json_t *content = json_object_get(json_array_get(candidates, 0), "content");
+    json_t *parts = json_object_get(content, "parts");
+    size_t i;
+    json_t *part;
+    json_array_foreach(parts, i, part) {
+        json_t *text = json_object_get(part, "text");
+        if (!json_is_string(text)) continue;
+        const char *s = json_string_value(text);
+        size_t n = json_string_length(text);
+        if (gemini_append(g, s, n) != 0) {
+            json_decref(event);
+            return -1;
+        }
+        fwrite(s, 1, n, stdout);
+        fflush(stdout);
+        if (g->delta) g->delta(s, n, g->user);
+    }
+    json_decref(event);
+    return 0;
+}
+
+static int gemini_data(const char *data, size_t len, void *user) {
+    GeminiStream *g = user;
+    if (g->text_len == 0 && g->error_len < sizeof(g->error_head) - 1) {
+        size_t k = sizeof(g->error_head) - 1 - g->error_len;
+        if (k > len) k = len;
+        memcpy(g->error_head + g->error_len, data, k);
+        g->error_len += k;
+        g->error_head[g->error_len] = '\0';
+    }
+    return sse_feed(&g->sse, data, len);
+}
 
+static void ai_message_done(const HttpResponse *resp, void *user) {
+    GeminiStream *g = user;
+    sse_finish(&g->sse);
+    if (g->text_len > 0) printf("\n");
+    char *ai_message = NULL;
+    if (resp->cancelled) {
+        ai_message = strdup("AI message generation cancelled.");
+    } else if (g->text_len == 0 && resp->result != CURLE_OK) {
+        fprintf(stderr, "Gemini request failed: %s\n", resp->error);
+        ai_message = strdup("Error generating AI message");
+    } else if (g->text_len == 0 && resp->status != 200) {
+        fprintf(stderr, "Gemini API returned HTTP %ld: %s\n", resp->status, g->error_head);
+        ai_message = strdup("Error generating AI message");
+    } else if (g->text_len == 0) {
+        ai_message = strdup("Failed to parse AI message from response.");
+    } else {
+        // A stream cut short still leaves a usable partial summary
+        if (resp->result != CURLE_OK) fprintf(stderr, "Gemini stream ended early: %s\n", resp->error);
+        ai_message = g->text;
+        g->text = NULL;
+    }
+    free(g->text);
+    g->done(ai_message, g->user);
+    free(g);
+}
+
+HttpRequest* generate_ai_message_async(const char* system_info_json, ApiResultFn done, ApiDeltaFn delta,
+                                       HttpProgressFn progress, void *user) {
     const char *effective_gemini = get_effective_gemini_key();
     if (!effective_gemini || strcmp(effective_gemini, "your_gemini_api_key_here") == 0) {
         fprintf(stderr, "Gemini API key not configured. Please set it via the GUI or edit src/config.h.\n");
         fprintf(stderr, "Obtain your Gemini API key from Google AI Studio: https://aistudio.google.com/, click 'Get API key'.\n");
-        free(chunk.memory);
-        return strdup("AI message generation skipped due to missing API key.");
+        done(strdup("AI message generation skipped due to missing API key."), user);
+        return NULL;
     }
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+    char url[512];
+    snprintf(url, sizeof(url), "https://generativelanguage.googleapis.com/v1/models/gemini-pro:streamGenerateContent?alt=sse&key=%s", effective_gemini);
+    const char *headers[] = {"Content-Type: application/json", "Accept: text/event-stream", NULL};
+
+    // Fit the report into the prompt budget
+    PromptStats pstats;
+    size_t prompt_len = 0;
+    char *prompt = prompt_pack(system_info_json, strlen(system_info_json), GEMINI_PROMPT_TOKEN_BUDGET, &pstats, &prompt_len);
+    if (prompt && pstats.lines_dropped > 0) {
+        printf("Prompt packed from ~%zu to ~%zu tokens (%zu of %zu lines left out)\n",
+               pstats.tokens_in, pstats.tokens_out, pstats.lines_dropped, pstats.lines_in);
+    }
 
-    if(curl) {
-        snprintf(url, sizeof(url), "https://generativelanguage.googleapis.com/v1/models/gemini-pro:generateContent?key=%s", effective_gemini);
-        curl_easy_setopt(curl, CURLOPT_URL, url);
+    // Construct JSON payload for Gemini API: {"contents":[{"parts":[{"text":...}]}]}
+    Report *text = report_new();
+    char *json_data = NULL;
+    size_t json_len = 0;
+    if (text) {
+        report_append(text, prompt ? prompt : system_info_json, prompt ? prompt_len : strlen(system_info_json));
+        json_data = json_payload("{\"contents\":[{\"parts\":[{\"text\":", text, "}]}]}", &json_len);
+        report_free(text);
+    }
+    free(prompt);
+
+    GeminiStream *g = json_data ? calloc(1, sizeof(GeminiStream)) : NULL;
+    HttpRequest *req = NULL;
+    if (g) {
+        sse_init(&g->sse, gemini_event, g);
+        g->done = done;
+        g->delta = delta;
+        g->user = user;
+        req = start_api_call(url, headers, json_data, json_len, ai_message_done, gemini_data, progress, g);
+        if (!req) free(g);
+    } else {
+        free(json_data);
+    }
+    if (!req) {
+        fprintf(stderr, "Failed to start Gemini request\n");
+        done(strdup("Error generating AI message"), user);
+    }
+    return req;
+}
 
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+// The blocking variants run the request on a main context private to the calling thread
+// until it completes. The context lives as long as the thread, so its connections stay
+// open for the next call.
+typedef struct {
+    GMainContext *ctx;
+    GMainLoop *loop;
+    char *result;
+    int finished;
+} SyncCall;
+
+static pthread_key_t sync_context_key;
+static pthread_once_t sync_context_once = PTHREAD_ONCE_INIT;
+
+static void sync_context_free(void *data) {
+    GMainContext *ctx = data;
+    http_context_release(ctx);
+    g_main_context_unref(ctx);
+}
 
-        // Construct JSON payload for Gemini API
-        root = json_object();
-        contents_array = json_array();
-        part_object = json_object();
-        text_object = json_string(system_info_json);
-        json_object_set_new(part_object, "text", text_object);
-        json_array_append_new(contents_array, part_object);
-        json_object_set_new(root, "contents", contents_array);
+static void sync_context_key_init(void) {
+    pthread_key_create(&sync_context_key, sync_context_free);
+}
 
-        json_data = json_dumps(root, 0);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
+static void sync_call_begin(SyncCall *s) {
+    memset(s, 0, sizeof(*s));
+    pthread_once(&sync_context_once, sync_context_key_init);
+    GMainContext *ctx = pthread_getspecific(sync_context_key);
+    if (!ctx) {
+        ctx = g_main_context_new();
+        pthread_setspecific(sync_context_key, ctx);
+    }
+    s->ctx = ctx;
+    s->loop = g_main_loop_new(s->ctx, FALSE);
+    g_main_context_push_thread_default(s->ctx);
+}
 
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
+static void sync_call_done(char *result, void *user) {
+    SyncCall *s = user;
+    s->result = result;
+    s->finished = 1;
+    g_main_loop_quit(s->loop);
+}
 
-        res = curl_easy_perform(curl);
-        if(res != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-            ai_message = strdup("Error generating AI message");
-        } else {
-            printf("Gemini API response: %s\n", chunk.memory);
-            json_t *response_root = json_loads(chunk.memory, 0, NULL);
-            if (response_root) {
-                candidate_array = json_object_get(response_root, "candidates");
-                if (json_is_array(candidate_array) && json_array_size(candidate_array) > 0) {
-                    content_object = json_object_get(json_array_get(candidate_array, 0), "content");
-                    if (content_object) {
-                        ai_text_object = json_object_get(content_object, "text");
-                        if (json_is_string(ai_text_object)) {
-                            ai_message = strdup(json_string_value(ai_text_object));
-                        }
-                    }
-                }
-                json_decref(response_root);
-            }
-            if (ai_message == NULL) {
-                ai_message = strdup("Failed to parse AI message from response.");
-            }
-        }
+static char* sync_call_end(SyncCall *s) {
+    if (!s->finished) g_main_loop_run(s->loop);
+    g_main_context_pop_thread_default(s->ctx);
+    g_main_loop_unref(s->loop);
+    return s->result;
+}
 
-        json_decref(root);
-        free(json_data);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
-    }
-    free(chunk.memory);
-    curl_global_cleanup();
+char* create_github_issue(const char* title, const Report* body) {
+    SyncCall s;
+    sync_call_begin(&s);
+    create_github_issue_async(title, body, sync_call_done, NULL, &s);
+    return sync_call_end(&s); // may be NULL on failure
+}
 
-    return ai_message;
+char* github_find_issue(const char* fingerprint) {
+    SyncCall s;
+    sync_call_begin(&s);
+    github_find_issue_async(fingerprint, sync_call_done, NULL, &s);
+    return sync_call_end(&s);
 }
 
-int main(int argc, char *argv[]) {
-    gtk_init(&argc, &argv);
+char* github_comment_issue(const char* issue_url, const char* body) {
+    SyncCall s;
+    sync_call_begin(&s);
+    github_comment_issue_async(issue_url, body, sync_call_done, NULL, &s);
+    return sync_call_end(&s);
+}
+
+char* generate_ai_message(const char* system_info_json) {
+    SyncCall s;
+    sync_call_begin(&s);
+    generate_ai_message_async(system_info_json, sync_call_done, NULL, NULL, &s);
+    return sync_call_end(&s);
+}
+
+// The GUI module: $CRASH_REPORTER_GUI_MODULE, else next to the executable (a build tree),
+// else the installed one
+static void* load_gui_module(void) {
+    const char *env = getenv("CRASH_REPORTER_GUI_MODULE");
+    if (env && env[0]) return dlopen(env, RTLD_NOW);
+    char exe[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n > 0) {
+        exe[n] = '\0';
+        char *slash = strrchr(exe, '/');
+        char path[PATH_MAX + 32];
+        snprintf(path, sizeof(path), "%.*s/crash-reporter-gui.so", slash ? (int)(slash - exe) : 0, exe);
+        void *module = dlopen(path, RTLD_NOW);
+        if (module) return module;
+    }
+    return dlopen(CRASH_REPORTER_GUI_MODULE_PATH, RTLD_NOW);
+}
+
+static int run_gui(int argc, char *argv[]) {
+    void *module = load_gui_module();
+    CrashReporterGuiMainFn gui_main = module ? (CrashReporterGuiMainFn)dlsym(module, CRASH_REPORTER_GUI_ENTRY) : NULL;
+    if (!gui_main) {
+        fprintf(stderr, "The graphical interface is not available (%s).\nRun with --headless for a text or JSON report.\n",
+                dlerror());
+        return CLI_EXIT_USAGE;
+    }
+
     SystemInfo info = {0};
 
     // Load any saved runtime API keys from disk
@@ -703,9 +1280,28 @@ int main(int argc, char *argv[]) {
     info.journalctl_errors = NULL;
     info.dmesg_errors = NULL;
 
-    create_and_show_gui(argc, argv, &info);
-
+    int rc = 0;
+    if (gui_main(argc, argv, &info) != 0) {
+        fprintf(stderr, "Cannot open a display. Run with --headless for a text or JSON report.\n");
+        rc = CLI_EXIT_USAGE;
+    }
     free_system_info(&info);
+    // The module stays loaded: GTK cannot be unloaded safely
+    return rc;
+}
 
-    return 0;
+int main(int argc, char *argv[]) {
+    // Privileged helper mode (launched by ourselves through pkexec): no GTK, just serve requests
+    if (argc > 1 && strcmp(argv[1], HELPER_ARG) == 0) {
+        return helper_main();
+    }
+
+    // Command line modes run without ever loading GTK
+    int rc = cli_main(argc, argv);
+    if (rc < 0) rc = run_gui(argc, argv);
+
+    // Closing the channel makes the privileged helper exit
+    helper_stop();
+    http_cleanup();
+    return rc;
 }
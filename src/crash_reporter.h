@@ -1,7 +1,12 @@
 #ifndef CRASH_REPORTER_H
 #define CRASH_REPORTER_H
 
+#include <stddef.h>
 #include <sys/utsname.h>
+#include "http.h"
+#include "fingerprint.h"
+#include "report.h"
+#include "severity.h"
 
 // Structure to hold system information
 typedef struct {
@@ -25,11 +30,46 @@ char* get_uptime();
 char* get_pacman_log_errors();
 char* get_journalctl_errors();
 char* get_dmesg_errors();
-int detect_errors(const char* text);
+// Classify the report with the severity matcher and return whether it is worth filing
+// (see SEVERITY_FILE_MIN_LEVEL in config.h). When counts is not NULL it receives the
+// per-section counts, to be released with severity_report_free().
+int detect_errors(const char* text, SeverityReport *counts);
 // Creates a GitHub issue and returns an allocated string containing the issue URL (html_url) on success.
-// Caller must free() the returned string. Returns NULL on failure.
-char* create_github_issue(const char* title, const char* body);
+// Caller must free() the returned string. Returns NULL on failure. The body is serialized
+// from its slices; it is not needed once the call returns (for the async variant too).
+char* create_github_issue(const char* title, const Report* body);
 char* generate_ai_message(const char* system_info_json);
+char* github_find_issue(const char* fingerprint);
+char* github_comment_issue(const char* issue_url, const char* body);
+
+// Non-blocking variants on the thread-default GLib main context. done runs exactly once
+// and owns the string it is given: the issue URL (NULL on failure) or the AI message
+// (an explanatory text on failure). It runs immediately when no key is configured or the
+// request cannot start; the returned request (NULL then) can be passed to http_request_cancel().
+typedef void (*ApiResultFn)(char *result, void *user);
+HttpRequest* create_github_issue_async(const char* title, const Report* body, ApiResultFn done,
+                                       HttpProgressFn progress, void *user);
+// Why the last failed GitHub call made on this thread failed, like errno: only meaningful
+// inside or right after a done callback that got NULL (or a search that found nothing).
+typedef enum {
+    API_OK,
+    API_ERROR_CONFIG,        // no token configured
+    API_ERROR_NETWORK,       // transient: no connection, timeout, 5xx, rate limited
+    API_ERROR_REJECTED,      // the API refused the request or answered nonsense
+    API_ERROR_CANCELLED,
+} ApiError;
+ApiError api_last_error(void);
+// Find an issue already filed with this crash fingerprint (see fingerprint.h) through the
+// search API. done gets its html_url, or NULL when there is none or the search failed.
+HttpRequest* github_find_issue_async(const char* fingerprint, ApiResultFn done, HttpProgressFn progress, void *user);
+// Comment on an existing issue; done gets the comment's html_url (NULL on failure).
+HttpRequest* github_comment_issue_async(const char* issue_url, const char* body, ApiResultFn done,
+                                        HttpProgressFn progress, void *user);
+// The summary is streamed: every piece of text is echoed to stdout and passed to delta
+// (may be NULL) as soon as it arrives; done still gets the whole message.
+typedef void (*ApiDeltaFn)(const char *text, size_t len, void *user);
+HttpRequest* generate_ai_message_async(const char* system_info_json, ApiResultFn done, ApiDeltaFn delta,
+                                       HttpProgressFn progress, void *user);
 
 // Runtime API key management (set at runtime from GUI or loaded from disk)
 void set_runtime_github_token(const char* token);
@@ -39,6 +79,8 @@ void save_runtime_keys(const char* github_token, const char* gemini_key);
 
 // Accessors used internally
 const char* get_effective_github_token(void);
+// GITHUB_API_BASE, or $CRASH_REPORTER_GITHUB_API when set (e.g. a local mock server)
+const char* get_github_api_base(void);
 const char* get_effective_gemini_key(void);
 
 // Access runtime-only stored tokens (NULL if not set)
@@ -47,10 +89,46 @@ const char* get_runtime_gemini_key(void);
 
 // Gather and format all system errors into a single allocated string. Caller must free.
 char* gather_all_errors(SystemInfo* info);
+
+// Issue text for a report (caller frees): the title, the body with the report, AI summary
+// and fingerprint cut to GitHub's size limit, and the comment added to an existing issue
+// when the same crash happens again. The body takes ai_message (malloc'd) and refers to
+// the report's text, so the report must outlive it and have its text taken already.
+char* build_issue_title(const SystemInfo *info);
+Report* build_issue_body(const Report *report, char *ai_message, const Fingerprint *fp);
+char* build_repeat_comment(const SystemInfo *info, const Fingerprint *fp);
+
+typedef enum {
+    REPORT_SECTION_PENDING,  // announced before collection starts, text is NULL
+    REPORT_SECTION_READY,    // text holds the formatted section ("== title ==" and body)
+    REPORT_SECTION_SKIPPED,  // the section is left out of the report
+} ReportSectionState;
+
+// Called for every report section: first PENDING for all of them in report order, then
+// READY or SKIPPED for each one as soon as its collector finishes. All calls come from
+// the thread running gather_report(); text is only valid during the call.
+typedef void (*ReportSectionFn)(size_t index, size_t total, const char *title, ReportSectionState state,
+                                const char *text, size_t len, void *user);
+
+// The report as gathered, with per-section progress: collector output is handed to the
+// report and referenced, not copied (see report.h). When *cancel becomes nonzero, running
+// collectors are stopped, gather_report() returns without waiting for them and their
+// sections read "(cancelled)". on_section and cancel may be NULL. Free with
+// report_free(); NULL when out of memory. When $CRASH_REPORTER_REPORT_INPUT names a saved
+// text report (for tests), its sections are returned instead and nothing is collected.
+Report* gather_report(SystemInfo* info, ReportSectionFn on_section, void *user, const int *cancel);
 // Show four explanatory dialogs to the user before any privilege escalation.
 // This should be called once at startup (after GTK is initialized).
 void show_escalation_explanation_dialogs(void);
 // Pre-authenticate polkit (perform a probe so the auth agent prompts once).
 void preauthenticate_polkit(void);
+// Allow or forbid polkit prompts (allowed by default). When forbidden, privileged sources
+// are read with whatever access the process has.
+void set_privilege_escalation(int allowed);
+// Locate pkexec, or NULL if polkit is not installed.
+const char* find_pkexec(void);
+// Build the pkexec argv used to run argv with elevated privileges. Returns NULL when argv
+// should be run unchanged; otherwise the caller frees the returned array (not its strings).
+const char** wrap_privileged_argv(const char *const argv[]);
 
 #endif // CRASH_REPORTER_H
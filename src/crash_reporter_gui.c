@@ -9,6 +9,10 @@
 #include "config.h"
 #include "crash_reporter.h"
 #include "crash_reporter.h" // for set_runtime_* and save/load
+#include "fingerprint.h"
+#include "severity.h"
+#include "history.h"
+#include "spool.h"
 
 typedef struct {
     SystemInfo *info;
@@ -17,6 +21,9 @@ typedef struct {
     GtkToggleButton *save;
 } GUIContext;
 
+// Sends reports queued while offline, for as long as the window is open
+static SpoolDrainer *spool_drainer;
+
 // Callback for GitHub Token button
 void on_github_token_button_clicked(GtkButton *button, gpointer user_data) {
     g_app_info_launch_default_for_uri("https://github.com/settings/tokens/new?scopes=repo&description=AcreetionOS_Crash_Reporter_Token", NULL, NULL);
@@ -83,6 +90,8 @@ void on_set_api_keys_clicked(GtkButton *button, gpointer user_data) {
         if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(save_chk))) {
             save_runtime_keys(g_tok && g_tok[0] ? g_tok : NULL, gm_tok && gm_tok[0] ? gm_tok : NULL);
         }
+        // Reports queued for want of a token can go now
+        spool_drainer_kick(spool_drainer);
     }
 
     gtk_widget_destroy(dialog);
@@ -106,114 +115,506 @@ void on_file_bug_button_clicked(GtkButton *button, gpointer user_data) {
     on_report_bug_button_clicked(NULL, c->info);
 }
 
-// Callback for Report Bug button
-void on_report_bug_button_clicked(GtkButton *button, gpointer user_data) {
-    g_print("Report Bug button clicked!\n");
-    SystemInfo* info = (SystemInfo*)user_data;
+/* ---- Background collection for the system text view ---- */
 
-    // Gather a comprehensive, organized collection of errors from the system
-    char *all_info = gather_all_errors(info);
-    if (!all_info) {
-        g_printerr("Failed to gather system errors\n");
-        return;
+// State of the one collection view in the main window. Workers only touch `cancel`
+// and post SectionMessages; everything else is used on the main thread.
+typedef struct {
+    GtkTextBuffer *buffer;
+    GtkTextMark **starts;   // start of each section slot (left gravity)
+    GtkTextMark **ends;     // end of the slot's placeholder (left gravity)
+    GtkWidget **labels;     // per-source progress labels
+    size_t total;
+    GtkWidget *progress_box;
+    GtkWidget *spinner;
+    GtkWidget *cancel_btn;
+    GtkWidget *file_btn;
+    gint cancel;
+    gboolean running;
+} CollectionView;
+
+static CollectionView collection_view;
+
+typedef struct {
+    size_t index;
+    size_t total;
+    ReportSectionState state;
+    char *title;
+    char *text;
+    size_t len;
+} SectionMessage;
+
+static void set_section_label(size_t index, const char *title, const char *status) {
+    CollectionView *v = &collection_view;
+    if (index >= v->total || !v->labels[index]) return;
+    gchar *txt = g_strdup_printf("%s: %s", title, status);
+    gtk_label_set_text(GTK_LABEL(v->labels[index]), txt);
+    g_free(txt);
+}
+
+// Lay out one placeholder slot per section, in report order
+static void begin_sections(size_t total) {
+    CollectionView *v = &collection_view;
+    gtk_text_buffer_set_text(v->buffer, "", -1);
+    for (size_t i = 0; i < v->total; ++i) {
+        if (v->labels[i]) gtk_widget_destroy(v->labels[i]);
     }
+    g_free(v->starts);
+    g_free(v->ends);
+    g_free(v->labels);
+    v->total = total;
+    v->starts = g_new0(GtkTextMark*, total);
+    v->ends = g_new0(GtkTextMark*, total);
+    v->labels = g_new0(GtkWidget*, total);
+}
 
-    if (detect_errors(all_info)) {
-        g_print("Errors detected. Generating AI message and uploading to GitHub...\n");
+static void add_section_slot(size_t index, const char *title) {
+    CollectionView *v = &collection_view;
+    if (index >= v->total) return;
+    GtkTextIter end;
+    gtk_text_buffer_get_end_iter(v->buffer, &end);
+    v->starts[index] = gtk_text_buffer_create_mark(v->buffer, NULL, &end, TRUE);
+    gchar *placeholder = g_strdup_printf("== %s ==\n(collecting...)\n", title);
+    gtk_text_buffer_insert(v->buffer, &end, placeholder, -1);
+    g_free(placeholder);
+    v->ends[index] = gtk_text_buffer_create_mark(v->buffer, NULL, &end, TRUE);
+
+    if (index == 0) return; // the metadata header has no collector behind it
+    v->labels[index] = gtk_label_new(NULL);
+    gtk_widget_set_halign(v->labels[index], GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(v->progress_box), v->labels[index], FALSE, FALSE, 0);
+    gtk_widget_show(v->labels[index]);
+    set_section_label(index, title, "collecting...");
+}
 
-        char* ai_message = generate_ai_message(all_info);
-        if (ai_message == NULL) {
-            g_printerr("Failed to generate AI message.\n");
-            free(all_info);
-            return;
-        }
+// Swap a slot's placeholder for the finished section. The text goes in at the slot
+// start first, so marks of neighbouring slots (all left gravity) keep their order.
+static void fill_section_slot(size_t index, const char *text, size_t len) {
+    CollectionView *v = &collection_view;
+    if (index >= v->total || !v->starts[index]) return;
+    GtkTextIter at, end;
+    gtk_text_buffer_get_iter_at_mark(v->buffer, &at, v->starts[index]);
+    if (text && len > 0) {
+        gtk_text_buffer_insert(v->buffer, &at, text, (gint)len);
+    }
+    gtk_text_buffer_get_iter_at_mark(v->buffer, &end, v->ends[index]);
+    gtk_text_buffer_delete(v->buffer, &at, &end);
+}
 
-        char issue_title[256];
-        snprintf(issue_title, sizeof(issue_title), "Automated Bug Report: System Errors Detected on %s", info->hostname ? info->hostname : "(unknown)");
-
-        // GitHub limits issue body size (65536). Truncate parts if necessary.
-        const size_t GITHUB_BODY_LIMIT = 65536;
-        const char *header_fmt = "@%s\n\n## System Information\n```\n";
-        const char *mid_fmt = "\n```\n\n## AI Generated Summary\n";
-        const char *tail_fmt = "\n";
-
-        size_t header_len = strlen(header_fmt) + strlen(GITHUB_PING_USERS);
-        size_t mid_len = strlen(mid_fmt);
-        size_t tail_len = strlen(tail_fmt);
-
-        size_t available = (GITHUB_BODY_LIMIT > header_len + mid_len + tail_len) ? (GITHUB_BODY_LIMIT - header_len - mid_len - tail_len) : 0;
-
-        // Split available roughly between system info and ai message
-        size_t sys_allow = available / 2;
-        size_t ai_allow = available - sys_allow;
-
-        // Prepare truncated copies if necessary
-        char *sys_part;
-        const char *trunc_suffix = "\n... (truncated)";
-        size_t suffix_len = strlen(trunc_suffix);
-        if (strlen(all_info) > sys_allow) {
-            size_t take = sys_allow > suffix_len ? sys_allow - suffix_len : 0;
-            sys_part = malloc(take + suffix_len + 1);
-            if (sys_part) {
-                memcpy(sys_part, all_info, take);
-                memcpy(sys_part + take, trunc_suffix, suffix_len);
-                sys_part[take + suffix_len] = '\0';
-            }
+static gboolean section_message_idle(gpointer data) {
+    SectionMessage *m = data;
+    if (m->state == REPORT_SECTION_PENDING) {
+        if (m->index == 0) begin_sections(m->total);
+        add_section_slot(m->index, m->title);
+    } else {
+        fill_section_slot(m->index, m->state == REPORT_SECTION_READY ? m->text : NULL, m->len);
+        if (m->state == REPORT_SECTION_SKIPPED) {
+            set_section_label(m->index, m->title, "nothing to report");
+        } else if (g_atomic_int_get(&collection_view.cancel) && m->text && strstr(m->text, "(cancelled)")) {
+            set_section_label(m->index, m->title, "cancelled");
         } else {
-            sys_part = strdup(all_info);
+            gchar *status = g_strdup_printf("done (%.1f KB)", m->len / 1024.0);
+            set_section_label(m->index, m->title, status);
+            g_free(status);
         }
+    }
+    g_free(m->title);
+    g_free(m->text);
+    g_free(m);
+    return G_SOURCE_REMOVE;
+}
 
-        char *ai_part;
-        if (strlen(ai_message) > ai_allow) {
-            size_t take = ai_allow > suffix_len ? ai_allow - suffix_len : 0;
-            ai_part = malloc(take + suffix_len + 1);
-            if (ai_part) {
-                memcpy(ai_part, ai_message, take);
-                memcpy(ai_part + take, trunc_suffix, suffix_len);
-                ai_part[take + suffix_len] = '\0';
-            }
-        } else {
-            ai_part = strdup(ai_message);
-        }
+// Runs on collector threads: hand the section over to the main loop
+static void post_section(size_t index, size_t total, const char *title, ReportSectionState state,
+                         const char *text, size_t len, void *user) {
+    (void)user;
+    SectionMessage *m = g_new0(SectionMessage, 1);
+    m->index = index;
+    m->total = total;
+    m->state = state;
+    m->title = g_strdup(title);
+    // GtkTextBuffer refuses invalid UTF-8, which raw log bytes may contain
+    m->text = text ? g_utf8_make_valid(text, (gssize)len) : NULL;
+    m->len = m->text ? strlen(m->text) : 0;
+    g_idle_add(section_message_idle, m);
+}
 
-        size_t body_needed = header_len + strlen(sys_part) + mid_len + strlen(ai_part) + tail_len + 1;
-        char *issue_body = (char*)malloc(body_needed);
-        if (issue_body) {
-            snprintf(issue_body, body_needed, "@%s\n\n## System Information\n```\n%s\n```\n\n## AI Generated Summary\n%s\n",
-                     GITHUB_PING_USERS, sys_part, ai_part);
-            char *issue_url = create_github_issue(issue_title, issue_body);
-            if (issue_url) {
-                // Show dialog with link and option to open in default browser
-                gchar *msg = g_strdup_printf("GitHub issue created:\n%s", issue_url);
-                GtkWidget *dlg = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_NONE, "%s", msg);
-                gtk_dialog_add_buttons(GTK_DIALOG(dlg), "_Open in browser", 1, "_Copy link", 2, "_Close", GTK_RESPONSE_CLOSE, NULL);
-                int resp = gtk_dialog_run(GTK_DIALOG(dlg));
-                if (resp == 1) {
-                    g_app_info_launch_default_for_uri(issue_url, NULL, NULL);
-                } else if (resp == 2) {
-                    GtkClipboard *cb = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
-                    gtk_clipboard_set_text(cb, issue_url, -1);
-                    gtk_clipboard_store(cb);
-                    GtkWidget *ok = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK, "Issue URL copied to clipboard.");
-                    gtk_dialog_run(GTK_DIALOG(ok));
-                    gtk_widget_destroy(ok);
-                }
-                gtk_widget_destroy(dlg);
-                g_free(msg);
-                free(issue_url);
-            }
-            free(issue_body);
-        } else {
-            g_printerr("Failed to allocate memory for issue body\n");
-        }
-        free(sys_part);
-        free(ai_part);
+// Keep a report in the local history, fingerprinted when it has something worth filing
+static void record_history(const SystemInfo *info, Report *report) {
+    size_t len;
+    const char *text = report_text(report, &len);
+    SeverityReport sev;
+    if (!text || severity_scan(text, len, &sev) != 0) return;
+    Fingerprint fp = {0};
+    if (severity_worth_filing(&sev)) fingerprint_report(text, len, &fp);
+    history_add(info->hostname, text, len, &sev, &fp);
+    fingerprint_free(&fp);
+    severity_report_free(&sev);
+}
+
+static void collection_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    (void)cancellable;
+    SystemInfo *info = task_data;
+    Report *all = gather_report(info, post_section, NULL, &collection_view.cancel);
+    // Filing reuses the snapshot, so this is the one place the GUI records a report
+    if (all && !g_atomic_int_get(&collection_view.cancel)) record_history(info, all);
+    report_free(all); // sections were shown as they arrived; the snapshot keeps them for the report
+    g_task_return_boolean(task, TRUE);
+}
+
+static void collection_done(GObject *source, GAsyncResult *res, gpointer user_data) {
+    (void)source;
+    (void)user_data;
+    g_task_propagate_boolean(G_TASK(res), NULL);
+    CollectionView *v = &collection_view;
+    v->running = FALSE;
+    gtk_spinner_stop(GTK_SPINNER(v->spinner));
+    gtk_widget_hide(v->spinner);
+    gtk_widget_hide(v->cancel_btn);
+    gtk_widget_set_sensitive(v->file_btn, TRUE);
+}
 
+static void on_cancel_collection_clicked(GtkButton *button, gpointer user_data) {
+    (void)user_data;
+    g_atomic_int_set(&collection_view.cancel, 1);
+    gtk_widget_set_sensitive(GTK_WIDGET(button), FALSE);
+}
+
+// Collect every section on a worker thread; the view fills in as sections finish
+static void start_collection(SystemInfo *info) {
+    CollectionView *v = &collection_view;
+    if (v->running) return;
+    v->running = TRUE;
+    g_atomic_int_set(&v->cancel, 0);
+    gtk_widget_set_sensitive(v->file_btn, FALSE);
+    gtk_widget_set_sensitive(v->cancel_btn, TRUE);
+    gtk_widget_show(v->cancel_btn);
+    gtk_widget_show(v->spinner);
+    gtk_spinner_start(GTK_SPINNER(v->spinner));
+
+    GTask *task = g_task_new(NULL, NULL, collection_done, NULL);
+    g_task_set_task_data(task, info, NULL);
+    g_task_run_in_thread(task, collection_thread);
+    g_object_unref(task);
+}
+
+/* ---- Filing the report ---- */
+
+// The report runs as a chain of main-loop callbacks: gather on a worker (normally served
+// from the snapshot the view just filled), then the Gemini and GitHub requests without
+// blocking the loop. A crash whose fingerprint was filed before (found in the local index
+// or by searching GitHub) gets a comment on that issue instead of a new one. Only the
+// main thread touches this state.
+typedef struct {
+    SystemInfo *info;
+    Report *report;         // as gathered; its text is taken once and shared by every step
+    Fingerprint fp;         // id is empty when the report could not be fingerprinted
+    char *known_url;        // issue already filed for this fingerprint
+    char *issue_title;      // what is being sent, kept to queue it if GitHub is unreachable
+    Report *issue_body;     // slices of report and the AI summary
+    char *comment;
+    HttpRequest *req;       // request in flight, NULL between steps
+    GtkWidget *status;
+    GtkWidget *cancel_btn;
+    GtkTextBuffer *summary;  // AI summary as it streams in
+    GtkWidget *summary_frame;
+    gboolean running;
+    gboolean cancelled;
+} ReportFlow;
+
+static ReportFlow report_flow;
+
+static void report_set_status(const char *text) {
+    if (report_flow.status) gtk_label_set_text(GTK_LABEL(report_flow.status), text);
+}
+
+static void report_finish(const char *status) {
+    ReportFlow *r = &report_flow;
+    report_free(r->issue_body);
+    report_free(r->report);
+    r->issue_body = NULL;
+    r->report = NULL;
+    fingerprint_free(&r->fp);
+    free(r->known_url);
+    r->known_url = NULL;
+    free(r->issue_title);
+    free(r->comment);
+    r->issue_title = r->comment = NULL;
+    r->req = NULL;
+    r->running = FALSE;
+    report_set_status(status);
+    if (r->cancel_btn) gtk_widget_hide(r->cancel_btn);
+    if (collection_view.file_btn) gtk_widget_set_sensitive(collection_view.file_btn, TRUE);
+}
+
+static void report_progress(double dl_now, double dl_total, double ul_now, double ul_total, void *user) {
+    const char *step = user;
+    char text[160];
+    if (ul_total > 0 && ul_now < ul_total) {
+        snprintf(text, sizeof(text), "%s: sending %.0f of %.0f KB", step, ul_now / 1024, ul_total / 1024);
+    } else if (dl_now > 0) {
+        snprintf(text, sizeof(text), "%s: receiving %.0f KB", step, dl_now / 1024);
+    } else {
+        snprintf(text, sizeof(text), "%s: waiting for the server", step);
+    }
+    report_set_status(text);
+}
+
+static void show_issue_dialog(const char *heading, const char *issue_url) {
+    // Show dialog with link and option to open in default browser
+    gchar *msg = g_strdup_printf("%s:\n%s", heading, issue_url);
+    GtkWidget *dlg = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_NONE, "%s", msg);
+    gtk_dialog_add_buttons(GTK_DIALOG(dlg), "_Open in browser", 1, "_Copy link", 2, "_Close", GTK_RESPONSE_CLOSE, NULL);
+    int resp = gtk_dialog_run(GTK_DIALOG(dlg));
+    if (resp == 1) {
+        g_app_info_launch_default_for_uri(issue_url, NULL, NULL);
+    } else if (resp == 2) {
+        GtkClipboard *cb = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+        gtk_clipboard_set_text(cb, issue_url, -1);
+        gtk_clipboard_store(cb);
+        GtkWidget *ok = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK, "Issue URL copied to clipboard.");
+        gtk_dialog_run(GTK_DIALOG(ok));
+        gtk_widget_destroy(ok);
+    }
+    gtk_widget_destroy(dlg);
+    g_free(msg);
+}
+
+// GitHub could not be reached: keep the report in the spool for the drainer to send
+static void report_queue(const SpoolReport *q) {
+    if (spool_store(q) != 0) {
+        report_finish("GitHub is unreachable and the report could not be saved; see the terminal output.");
+        return;
+    }
+    gchar *msg = g_strdup_printf("GitHub is unreachable; the report was saved and will be sent automatically "
+                                 "(%zu waiting).", spool_depth());
+    report_finish(msg);
+    g_free(msg);
+    spool_drainer_kick(spool_drainer);
+}
+
+static void report_issue_done(char *issue_url, void *user) {
+    (void)user;
+    ReportFlow *r = &report_flow;
+    r->req = NULL;
+    if (r->cancelled) {
+        free(issue_url);
+        report_finish("Report cancelled.");
+        return;
+    }
+    if (!issue_url && api_last_error() == API_ERROR_NETWORK) {
+        // Only a report that has to wait is put together as one string
+        char *body = report_flatten(r->issue_body, NULL);
+        SpoolReport q = { r->issue_title, body, NULL, r->comment, r->fp.id[0] ? r->fp.id : NULL };
+        report_queue(&q);
+        free(body);
+        return;
+    }
+    if (issue_url && r->fp.id[0]) fingerprint_index_record(r->fp.id, issue_url);
+    report_finish(issue_url ? "Issue filed." : "Filing the issue failed; see the terminal output.");
+    if (issue_url) show_issue_dialog("GitHub issue created", issue_url);
+    free(issue_url);
+}
+
+static void report_ai_done(char *ai_message, void *user) {
+    (void)user;
+    ReportFlow *r = &report_flow;
+    r->req = NULL;
+    if (r->cancelled || !ai_message) {
+        if (!ai_message) g_printerr("Failed to generate AI message.\n");
         free(ai_message);
+        report_finish(r->cancelled ? "Report cancelled." : "Generating the AI summary failed.");
+        return;
+    }
+
+    r->issue_body = build_issue_body(r->report, ai_message, &r->fp);
+    r->issue_title = build_issue_title(r->info);
+    if (!r->issue_body || !r->issue_title) {
+        g_printerr("Failed to allocate memory for issue body\n");
+        report_finish("Building the issue failed.");
+        return;
+    }
+    if (r->fp.id[0]) r->comment = build_repeat_comment(r->info, &r->fp);
+    report_set_status("Creating the GitHub issue...");
+    HttpRequest *req = create_github_issue_async(r->issue_title, r->issue_body, report_issue_done, report_progress, "GitHub");
+    // done may already have run (no token, or the request could not start)
+    if (r->running) r->req = req;
+}
+
+// Streamed piece of the AI summary; arrives on the main loop
+static void report_ai_delta(const char *text, size_t len, void *user) {
+    (void)user;
+    ReportFlow *r = &report_flow;
+    if (!r->summary) return;
+    if (!gtk_widget_get_visible(r->summary_frame)) {
+        gtk_widget_show(r->summary_frame);
+        report_set_status("Gemini is writing the summary...");
+    }
+    GtkTextIter end;
+    gtk_text_buffer_get_end_iter(r->summary, &end);
+    if (g_utf8_validate(text, (gssize)len, NULL)) {
+        gtk_text_buffer_insert(r->summary, &end, text, (gint)len);
     } else {
+        gchar *valid = g_utf8_make_valid(text, (gssize)len);
+        gtk_text_buffer_insert(r->summary, &end, valid, -1);
+        g_free(valid);
+    }
+}
+
+static void report_start_ai(void) {
+    ReportFlow *r = &report_flow;
+    g_print("Errors detected. Generating AI message and uploading to GitHub...\n");
+    report_set_status("Generating the AI summary...");
+    HttpRequest *req = generate_ai_message_async(report_text(r->report, NULL), report_ai_done, report_ai_delta, report_progress, "Gemini");
+    if (r->running && !r->req) r->req = req;
+}
+
+static void report_comment_done(char *comment_url, void *user) {
+    (void)user;
+    ReportFlow *r = &report_flow;
+    r->req = NULL;
+    if (r->cancelled) {
+        free(comment_url);
+        report_finish("Report cancelled.");
+        return;
+    }
+    if (!comment_url && api_last_error() == API_ERROR_NETWORK) {
+        SpoolReport q = { NULL, NULL, r->known_url, r->comment, r->fp.id };
+        report_queue(&q);
+        return;
+    }
+    if (!comment_url) {
+        report_finish("Commenting on the existing issue failed; see the terminal output.");
+        return;
+    }
+    fingerprint_index_record(r->fp.id, r->known_url);
+    gchar *url = g_strdup(r->known_url);
+    report_finish("Known issue: added this occurrence to it.");
+    show_issue_dialog("This crash was already reported; the new occurrence was added to", url);
+    g_free(url);
+    free(comment_url);
+}
+
+// Repeat of a crash already filed: add a short comment with this machine's details
+// instead of a new issue (the AI summary is skipped too)
+static void report_comment_known(void) {
+    ReportFlow *r = &report_flow;
+    r->comment = build_repeat_comment(r->info, &r->fp);
+    report_set_status("Adding this occurrence to the existing issue...");
+    HttpRequest *req = github_comment_issue_async(r->known_url, r->comment, report_comment_done, report_progress, "GitHub");
+    if (r->running && !r->req) r->req = req;
+}
+
+static void report_search_done(char *issue_url, void *user) {
+    (void)user;
+    ReportFlow *r = &report_flow;
+    r->req = NULL;
+    if (r->cancelled) {
+        free(issue_url);
+        report_finish("Report cancelled.");
+        return;
+    }
+    if (issue_url) {
+        r->known_url = issue_url;
+        report_comment_known();
+    } else {
+        report_start_ai();
+    }
+}
+
+static void report_gather_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    (void)source;
+    (void)cancellable;
+    g_task_return_pointer(task, gather_report(task_data, NULL, NULL, NULL), (GDestroyNotify)report_free);
+}
+
+static void report_gathered(GObject *source, GAsyncResult *res, gpointer user_data) {
+    (void)source;
+    (void)user_data;
+    ReportFlow *r = &report_flow;
+    r->report = g_task_propagate_pointer(G_TASK(res), NULL);
+    if (r->cancelled) {
+        report_finish("Report cancelled.");
+        return;
+    }
+    size_t len = 0;
+    const char *text = r->report ? report_text(r->report, &len) : NULL;
+    if (!text) {
+        g_printerr("Failed to gather system errors\n");
+        report_finish("Gathering system errors failed.");
+        return;
+    }
+    if (!detect_errors(text, NULL)) {
         g_print("No significant errors detected.\n");
+        report_finish("No significant errors detected.");
+        return;
     }
-    free(all_info);
+
+    if (fingerprint_report(text, len, &r->fp) != 0 || r->fp.components == 0) {
+        // Nothing that identifies the crash; file it without duplicate checks
+        fingerprint_free(&r->fp);
+        report_start_ai();
+        return;
+    }
+    g_print("Crash fingerprint: %s\n%s", r->fp.id, r->fp.summary);
+    long seen = 0;
+    r->known_url = fingerprint_index_lookup(r->fp.id, &seen);
+    if (r->known_url) {
+        g_print("Already filed from this machine (%ld times): %s\n", seen, r->known_url);
+        report_comment_known();
+        return;
+    }
+    report_set_status("Looking for an existing issue...");
+    HttpRequest *req = github_find_issue_async(r->fp.id, report_search_done, report_progress, "GitHub search");
+    if (r->running && !r->req) r->req = req;
+}
+
+static void report_spool_depth(size_t depth, void *user) {
+    (void)user;
+    if (report_flow.running || depth == 0) return;
+    gchar *msg = g_strdup_printf("%zu report%s saved while offline waiting to be sent.", depth, depth == 1 ? "" : "s");
+    report_set_status(msg);
+    g_free(msg);
+}
+
+static void on_cancel_report_clicked(GtkButton *button, gpointer user_data) {
+    (void)user_data;
+    ReportFlow *r = &report_flow;
+    if (!r->running) return;
+    r->cancelled = TRUE;
+    gtk_widget_set_sensitive(GTK_WIDGET(button), FALSE);
+    report_set_status("Cancelling...");
+    if (r->req) {
+        HttpRequest *req = r->req;
+        r->req = NULL;
+        http_request_cancel(req); // runs the step's done callback, which ends the flow
+    }
+}
+
+// Callback for Report Bug button: the network requests run on the main loop, so the
+// window stays responsive while the AI summary and the GitHub issue are created.
+void on_report_bug_button_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    g_print("Report Bug button clicked!\n");
+    ReportFlow *r = &report_flow;
+    if (r->running) return;
+    r->info = (SystemInfo*)user_data;
+    r->running = TRUE;
+    r->cancelled = FALSE;
+    r->req = NULL;
+    if (collection_view.file_btn) gtk_widget_set_sensitive(collection_view.file_btn, FALSE);
+    if (r->cancel_btn) {
+        gtk_widget_set_sensitive(r->cancel_btn, TRUE);
+        gtk_widget_show(r->cancel_btn);
+    }
+    report_set_status("Gathering system errors...");
+    if (r->summary) gtk_text_buffer_set_text(r->summary, "", -1);
+
+    GTask *task = g_task_new(NULL, NULL, report_gathered, NULL);
+    g_task_set_task_data(task, r->info, NULL);
+    g_task_run_in_thread(task, report_gather_thread);
+    g_object_unref(task);
 }
 
 // Show four explanatory dialogs (called once at startup). If the user cancels any dialog,
@@ -356,6 +757,32 @@ void create_and_show_gui(int argc, char *argv[], SystemInfo* info) {
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
     gtk_box_pack_start(GTK_BOX(right_vbox), scrolled_window, TRUE, TRUE, 0);
 
+    // Per-source collection progress, filled in by the background collection
+    GtkWidget *progress_frame = gtk_frame_new("Collection progress");
+    gtk_box_pack_start(GTK_BOX(right_vbox), progress_frame, FALSE, FALSE, 0);
+    GtkWidget *progress_hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_container_add(GTK_CONTAINER(progress_frame), progress_hbox);
+    GtkWidget *progress_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_box_pack_start(GTK_BOX(progress_hbox), progress_box, TRUE, TRUE, 0);
+    GtkWidget *spinner = gtk_spinner_new();
+    gtk_box_pack_start(GTK_BOX(progress_hbox), spinner, FALSE, FALSE, 0);
+    GtkWidget *cancel_btn = gtk_button_new_with_label("Cancel");
+    gtk_widget_set_valign(cancel_btn, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(progress_hbox), cancel_btn, FALSE, FALSE, 0);
+    g_signal_connect(cancel_btn, "clicked", G_CALLBACK(on_cancel_collection_clicked), NULL);
+
+    // AI summary, shown once the first streamed text arrives
+    GtkWidget *summary_frame = gtk_frame_new("AI summary");
+    gtk_box_pack_start(GTK_BOX(right_vbox), summary_frame, FALSE, FALSE, 0);
+    GtkWidget *summary_view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(summary_view), FALSE);
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(summary_view), GTK_WRAP_WORD_CHAR);
+    GtkWidget *summary_scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_size_request(summary_scroll, -1, 160);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(summary_scroll), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(summary_scroll), summary_view);
+    gtk_container_add(GTK_CONTAINER(summary_frame), summary_scroll);
+
     // API key entry area on the right
     GtkWidget *keys_frame = gtk_frame_new("API Keys (enter once)");
     gtk_box_pack_start(GTK_BOX(right_vbox), keys_frame, FALSE, FALSE, 0);
@@ -399,6 +826,16 @@ void create_and_show_gui(int argc, char *argv[], SystemInfo* info) {
 
     g_signal_connect(file_btn, "clicked", G_CALLBACK(on_file_bug_button_clicked), NULL);
 
+    // Report status and cancel, used while the AI summary and the issue are being created
+    GtkWidget *report_hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_box_pack_start(GTK_BOX(keys_box), report_hbox, FALSE, FALSE, 0);
+    GtkWidget *report_status = gtk_label_new("");
+    gtk_widget_set_halign(report_status, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(report_hbox), report_status, TRUE, TRUE, 0);
+    GtkWidget *report_cancel_btn = gtk_button_new_with_label("Cancel");
+    gtk_box_pack_start(GTK_BOX(report_hbox), report_cancel_btn, FALSE, FALSE, 0);
+    g_signal_connect(report_cancel_btn, "clicked", G_CALLBACK(on_cancel_report_clicked), NULL);
+
     // Show startup informational dialog explaining resources and steps
     GtkWidget *start = gtk_message_dialog_new(GTK_WINDOW(window), GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK,
         "This tool will collect system logs and optionally create a GitHub issue. The services used (journalctl, dmesg, pacman logs) are local system resources and are free to read on your machine.\n\nSteps:\n1) Review the Gemini API page (left-top) and GitHub token page (left-bottom).\n2) Enter your API keys on the right and click 'File A Bug Report'.\n3) If necessary, authenticate the privilege prompt (polkit) that appears once.\n\nClick OK to continue and the pages will be shown in the left panes.");
@@ -412,12 +849,6 @@ void create_and_show_gui(int argc, char *argv[], SystemInfo* info) {
     gtk_box_pack_start(GTK_BOX(right_vbox), set_keys_btn, FALSE, FALSE, 0);
     g_signal_connect(set_keys_btn, "clicked", G_CALLBACK(on_set_api_keys_clicked), info);
 
-    // Populate system/error text view with organized errors (monospace)
-    char *errors_all = gather_all_errors(info);
-    if (errors_all) {
-        gtk_text_buffer_set_text(buffer, errors_all, -1);
-        free(errors_all);
-    }
     // Use CSS to force a monospace font for better alignment in the text view
     gtk_widget_set_name(text_view, "system_text_view");
     GtkCssProvider *mono_provider = gtk_css_provider_new();
@@ -428,6 +859,38 @@ void create_and_show_gui(int argc, char *argv[], SystemInfo* info) {
 
     gtk_widget_show_all(window);
 
+    // Populate system/error text view with organized errors (monospace) in the background;
+    // sections appear as their collectors finish.
+    collection_view.buffer = buffer;
+    collection_view.progress_box = progress_box;
+    collection_view.spinner = spinner;
+    collection_view.cancel_btn = cancel_btn;
+    collection_view.file_btn = file_btn;
+    report_flow.status = report_status;
+    report_flow.cancel_btn = report_cancel_btn;
+    report_flow.summary = gtk_text_view_get_buffer(GTK_TEXT_VIEW(summary_view));
+    report_flow.summary_frame = summary_frame;
+    gtk_widget_hide(report_cancel_btn);
+    gtk_widget_hide(summary_frame);
+    start_collection(info);
+    spool_drainer = spool_drainer_start(report_spool_depth, NULL);
+
     gtk_main();
+    spool_drainer_stop(spool_drainer);
+    spool_drainer = NULL;
+    // Let a still running collection stop its children
+    g_atomic_int_set(&collection_view.cancel, 1);
+    // Drop a report still in flight; its widgets went away with the window
+    report_flow.status = report_flow.cancel_btn = collection_view.file_btn = NULL;
+    report_flow.summary = NULL;
+    if (report_flow.req) {
+        report_flow.cancelled = TRUE;
+        http_request_cancel(report_flow.req);
+    }
 }
 
+int crash_reporter_gui_main(int argc, char *argv[], SystemInfo *info) {
+    if (!gtk_init_check(&argc, &argv)) return -1;
+    create_and_show_gui(argc, argv, info);
+    return 0;
+}
@@ -5,4 +5,11 @@
 
 void create_and_show_gui(int argc, char *argv[], SystemInfo* info);
 
+// The GUI is built as a module (crash-reporter-gui.so) that the executable loads only
+// when a window is wanted, so runs without one never load GTK. Its entry point
+// initializes GTK and runs the window; it returns 0, or -1 when there is no display.
+#define CRASH_REPORTER_GUI_ENTRY "crash_reporter_gui_main"
+typedef int (*CrashReporterGuiMainFn)(int argc, char *argv[], SystemInfo *info);
+int crash_reporter_gui_main(int argc, char *argv[], SystemInfo *info);
+
 #endif // CRASH_REPORTER_GUI_H
\ No newline at end of file
@@ -0,0 +1,137 @@
+/* Streaming decoders
+ * One step interface over zlib, liblzma, libzstd and the lz4 frame format.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <lzma.h>
+#include <zstd.h>
+#include <lz4frame.h>
+#include "decompress.h"
+#include "strbuf.h"
+
+struct Decoder {
+    Compression kind;
+    z_stream z;
+    lzma_stream x;
+    ZSTD_DStream *zs;
+    int zs_frame_end;    // the last zstd frame decoded so far is complete
+    LZ4F_dctx *lz;
+};
+
+Compression compression_for_path(const char *path) {
+    if (has_suffix(path, ".gz")) return COMPRESSION_GZIP;
+    if (has_suffix(path, ".xz")) return COMPRESSION_XZ;
+    if (has_suffix(path, ".zst")) return COMPRESSION_ZSTD;
+    if (has_suffix(path, ".lz4")) return COMPRESSION_LZ4;
+    return COMPRESSION_NONE;
+}
+
+Decoder* decoder_new(Compression kind) {
+    Decoder *d = calloc(1, sizeof(Decoder));
+    if (!d) return NULL;
+    d->kind = kind;
+    int ok;
+    switch (kind) {
+    case COMPRESSION_GZIP:
+        ok = inflateInit2(&d->z, 15 + 32) == Z_OK; // auto-detect gzip header
+        break;
+    case COMPRESSION_XZ: {
+        lzma_stream init = LZMA_STREAM_INIT;
+        d->x = init;
+        ok = lzma_stream_decoder(&d->x, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+        break;
+    }
+    case COMPRESSION_ZSTD:
+        d->zs = ZSTD_createDStream();
+        ok = d->zs != NULL;
+        break;
+    case COMPRESSION_LZ4:
+        ok = !LZ4F_isError(LZ4F_createDecompressionContext(&d->lz, LZ4F_VERSION));
+        break;
+    default:
+        ok = 0;
+        break;
+    }
+    if (!ok) {
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+ssize_t decoder_step(Decoder *d, const unsigned char **in, size_t *in_len, int in_eof,
+                     unsigned char *out, size_t out_cap, int *done) {
+    switch (d->kind) {
+    case COMPRESSION_GZIP: {
+        d->z.next_in = (Bytef *)*in;
+        d->z.avail_in = (uInt)*in_len;
+        d->z.next_out = out;
+        d->z.avail_out = (uInt)out_cap;
+        int rc = inflate(&d->z, Z_NO_FLUSH);
+        size_t produced = out_cap - d->z.avail_out;
+        *in = d->z.next_in;
+        *in_len = d->z.avail_in;
+        if (rc == Z_STREAM_END) {
+            // logrotate may concatenate gzip members; keep going if more input follows
+            if (*in_len > 0 || !in_eof) inflateReset(&d->z);
+            else *done = 1;
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            return -1;
+        }
+        return (ssize_t)produced;
+    }
+    case COMPRESSION_XZ: {
+        d->x.next_in = *in;
+        d->x.avail_in = *in_len;
+        d->x.next_out = out;
+        d->x.avail_out = out_cap;
+        lzma_ret rc = lzma_code(&d->x, in_eof ? LZMA_FINISH : LZMA_RUN);
+        size_t produced = out_cap - d->x.avail_out;
+        *in = d->x.next_in;
+        *in_len = d->x.avail_in;
+        if (rc == LZMA_STREAM_END) *done = 1;
+        else if (rc != LZMA_OK && rc != LZMA_BUF_ERROR) return -1;
+        return (ssize_t)produced;
+    }
+    case COMPRESSION_ZSTD: {
+        ZSTD_inBuffer zin = { *in, *in_len, 0 };
+        ZSTD_outBuffer zout = { out, out_cap, 0 };
+        size_t rc = ZSTD_decompressStream(d->zs, &zout, &zin);
+        if (ZSTD_isError(rc)) return -1;
+        *in += zin.pos;
+        *in_len -= zin.pos;
+        // The end of input may only be seen on a later call, after the frame ended
+        if (rc == 0) d->zs_frame_end = 1;
+        else if (zin.pos > 0) d->zs_frame_end = 0;
+        if (d->zs_frame_end && *in_len == 0 && in_eof) *done = 1;
+        return (ssize_t)zout.pos;
+    }
+    case COMPRESSION_LZ4: {
+        size_t produced = out_cap, consumed = *in_len;
+        size_t rc = LZ4F_decompress(d->lz, out, &produced, *in, &consumed, NULL);
+        if (LZ4F_isError(rc)) return -1;
+        *in += consumed;
+        *in_len -= consumed;
+        // 0 means the frame is complete; systemd writes a single frame
+        if (rc == 0) *done = 1;
+        return (ssize_t)produced;
+    }
+    default:
+        return -1;
+    }
+}
+
+void decoder_free(Decoder *d) {
+    if (!d) return;
+    switch (d->kind) {
+    case COMPRESSION_GZIP: inflateEnd(&d->z); break;
+    case COMPRESSION_XZ: lzma_end(&d->x); break;
+    case COMPRESSION_ZSTD: ZSTD_freeDStream(d->zs); break;
+    case COMPRESSION_LZ4: LZ4F_freeDecompressionContext(d->lz); break;
+    default: break;
+    }
+    free(d);
+}
@@ -0,0 +1,35 @@
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Streaming decompression of the formats rotated logs and stored core dumps use.
+// Nothing is buffered beyond what the caller passes in, so a caller that only needs the
+// head of a file stops reading once it has it.
+
+typedef enum {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_XZ,
+    COMPRESSION_ZSTD,
+    COMPRESSION_LZ4,
+} Compression;
+
+// By file name suffix (.gz, .xz, .zst, .lz4)
+Compression compression_for_path(const char *path);
+
+typedef struct Decoder Decoder;
+
+// NULL for COMPRESSION_NONE or when out of memory
+Decoder* decoder_new(Compression kind);
+
+// Decompress from *in into out. Returns bytes produced (advancing *in / *in_len),
+// sets *done at the end of the stream, or returns -1 on a corrupt stream. in_eof
+// tells the decoder no input follows what is in *in.
+ssize_t decoder_step(Decoder *d, const unsigned char **in, size_t *in_len, int in_eof,
+                     unsigned char *out, size_t out_cap, int *done);
+
+void decoder_free(Decoder *d);
+
+#endif // DECOMPRESS_H
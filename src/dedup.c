@@ -0,0 +1,348 @@
+/* Log line templating and deduplication
+ * Templates are hashed with FNV-1a into an open-addressing table; an entry keeps the
+ * template, the first line it came from, a count and the first/last timestamps. Lines
+ * never need to be held beyond the one being processed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "dedup.h"
+#include "capture.h"
+#include "hash.h"
+
+#define DEDUP_TS_MAX 40
+// Timestamps are looked for this far into a line (after "path:line:" prefixes and the like)
+#define DEDUP_TS_SCAN 64
+
+typedef struct {
+    uint64_t hash;
+    uint64_t count;
+    size_t tmpl_len;
+    size_t line_len;
+    char *data;              // template followed by the first line
+    char first_ts[DEDUP_TS_MAX];
+    char last_ts[DEDUP_TS_MAX];
+} DedupEntry;
+
+struct Dedup {
+    DedupEntry *entries;     // in order of first appearance
+    size_t count;
+    size_t cap;
+    size_t *slots;           // entry index + 1, 0 = empty
+    size_t nslots;
+    size_t memory;
+    size_t memory_limit;
+    char *partial;           // incomplete last line of the previous chunk
+    size_t partial_len;
+    size_t partial_cap;
+    int passing;             // in the middle of a line too long to template
+    char *scratch;           // template of the current line
+    size_t scratch_cap;
+    Capture overflow;
+    DedupStats stats;
+};
+
+static int is_hexish(char c) {
+    return isxdigit((unsigned char)c) || c == '.' || c == ':' || c == '-' || c == '_';
+}
+
+static int digits(const char *s, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (!isdigit((unsigned char)s[i])) return 0;
+    }
+    return 1;
+}
+
+// Length of a timestamp starting at s, or 0: ISO 8601 ("2024-05-01T10:00:00+0000",
+// also with a space) or syslog ("May  1 10:00:00")
+static size_t timestamp_at(const char *s, size_t n) {
+    if (n >= 19 && digits(s, 4) && s[4] == '-' && digits(s + 5, 2) && s[7] == '-' && digits(s + 8, 2) &&
+        (s[10] == 'T' || s[10] == ' ') && digits(s + 11, 2) && s[13] == ':' && digits(s + 14, 2) &&
+        s[16] == ':' && digits(s + 17, 2)) {
+        size_t k = 19;
+        while (k < n && (isdigit((unsigned char)s[k]) || s[k] == '.' || s[k] == ':' || s[k] == '+' ||
+                         s[k] == '-' || s[k] == 'Z')) k++;
+        return k;
+    }
+    if (n >= 15 && isupper((unsigned char)s[0]) && islower((unsigned char)s[1]) && islower((unsigned char)s[2]) &&
+        s[3] == ' ' && (s[4] == ' ' || isdigit((unsigned char)s[4])) && isdigit((unsigned char)s[5]) && s[6] == ' ' &&
+        digits(s + 7, 2) && s[9] == ':' && digits(s + 10, 2) && s[12] == ':' && digits(s + 13, 2)) {
+        return 15;
+    }
+    return 0;
+}
+
+// Replace volatile tokens with '#'. Timestamps near the start of the line (including
+// syslog month names) are one value. A token that starts a word and is made of hex digits
+// and separators (and has a digit) is one value: addresses, UUIDs, times, IPs, versions.
+// Digit runs inside words ("eth0", "pid=123") are replaced on their own. The template
+// is never longer than the line.
+size_t dedup_template(const char *s, size_t n, char *out) {
+    size_t o = 0;
+    size_t i = 0;
+    while (i < n) {
+        int word_start = i == 0 || !isalnum((unsigned char)s[i - 1]);
+        size_t ts = word_start && i < DEDUP_TS_SCAN ? timestamp_at(s + i, n - i) : 0;
+        if (ts > 0) {
+            out[o++] = '#';
+            i += ts;
+            continue;
+        }
+        if (word_start && s[i] == '0' && i + 2 < n && (s[i + 1] == 'x' || s[i + 1] == 'X') &&
+            isxdigit((unsigned char)s[i + 2])) {
+            i += 2;
+            while (i < n && isxdigit((unsigned char)s[i])) i++;
+            out[o++] = '#';
+            continue;
+        }
+        if (word_start && isxdigit((unsigned char)s[i])) {
+            size_t j = i;
+            int digit = 0;
+            while (j < n && is_hexish(s[j])) {
+                if (isdigit((unsigned char)s[j])) digit = 1;
+                j++;
+            }
+            // Trailing separators belong to the text ("12:" in "line 12: ...")
+            while (j > i && !isxdigit((unsigned char)s[j - 1])) j--;
+            if (digit && (j == n || !isalnum((unsigned char)s[j]))) {
+                out[o++] = '#';
+                i = j;
+                continue;
+            }
+        }
+        if (isdigit((unsigned char)s[i])) {
+            while (i < n && isdigit((unsigned char)s[i])) i++;
+            out[o++] = '#';
+            continue;
+        }
+        out[o++] = s[i++];
+    }
+    return o;
+}
+
+static void find_timestamp(const char *s, size_t n, char *out) {
+    size_t limit = n < DEDUP_TS_SCAN ? n : DEDUP_TS_SCAN;
+    for (size_t i = 0; i < limit; ++i) {
+        if (i > 0 && isalnum((unsigned char)s[i - 1])) continue;
+        size_t k = timestamp_at(s + i, n - i);
+        if (k > 0) {
+            if (k >= DEDUP_TS_MAX) k = DEDUP_TS_MAX - 1;
+            memcpy(out, s + i, k);
+            out[k] = '\0';
+            return;
+        }
+    }
+    out[0] = '\0';
+}
+
+Dedup* dedup_new(size_t memory_limit) {
+    Dedup *d = calloc(1, sizeof(Dedup));
+    if (!d) return NULL;
+    d->memory_limit = memory_limit;
+    d->nslots = 1024;
+    d->slots = calloc(d->nslots, sizeof(size_t));
+    if (!d->slots) {
+        free(d);
+        return NULL;
+    }
+    capture_init(&d->overflow, memory_limit);
+    return d;
+}
+
+static int grow_slots(Dedup *d) {
+    size_t nslots = d->nslots * 2;
+    size_t *slots = calloc(nslots, sizeof(size_t));
+    if (!slots) return -1;
+    for (size_t e = 0; e < d->count; ++e) {
+        size_t k = (size_t)d->entries[e].hash & (nslots - 1);
+        while (slots[k]) k = (k + 1) & (nslots - 1);
+        slots[k] = e + 1;
+    }
+    free(d->slots);
+    d->slots = slots;
+    d->nslots = nslots;
+    return 0;
+}
+
+static int add_line(Dedup *d, const char *line, size_t len) {
+    d->stats.lines_in++;
+    if (len + 1 > d->scratch_cap) {
+        size_t cap = d->scratch_cap ? d->scratch_cap : 256;
+        while (cap < len + 1) cap *= 2;
+        char *p = realloc(d->scratch, cap);
+        if (!p) return -1;
+        d->scratch = p;
+        d->scratch_cap = cap;
+    }
+    size_t tlen = dedup_template(line, len, d->scratch);
+    uint64_t h = fnv1a(d->scratch, tlen);
+
+    size_t k = (size_t)h & (d->nslots - 1);
+    while (d->slots[k]) {
+        DedupEntry *e = &d->entries[d->slots[k] - 1];
+        if (e->hash == h && e->tmpl_len == tlen && memcmp(e->data, d->scratch, tlen) == 0) {
+            e->count++;
+            char ts[DEDUP_TS_MAX];
+            find_timestamp(line, len, ts);
+            if (ts[0]) memcpy(e->last_ts, ts, sizeof(ts));
+            return 0;
+        }
+        k = (k + 1) & (d->nslots - 1);
+    }
+
+    // New template; once the table is full the line goes to the head+tail overflow
+    if (d->count >= DEDUP_MAX_TEMPLATES || d->memory + tlen + len > d->memory_limit) {
+        d->stats.overflow_lines++;
+        if (capture_write(&d->overflow, line, len) != 0 || capture_write(&d->overflow, "\n", 1) != 0) return -1;
+        return 0;
+    }
+    if (d->count == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : 256;
+        DedupEntry *entries = realloc(d->entries, cap * sizeof(DedupEntry));
+        if (!entries) return -1;
+        d->entries = entries;
+        d->cap = cap;
+    }
+    DedupEntry *e = &d->entries[d->count];
+    e->data = malloc(tlen + len);
+    if (!e->data) return -1;
+    memcpy(e->data, d->scratch, tlen);
+    memcpy(e->data + tlen, line, len);
+    e->hash = h;
+    e->count = 1;
+    e->tmpl_len = tlen;
+    e->line_len = len;
+    find_timestamp(line, len, e->first_ts);
+    memcpy(e->last_ts, e->first_ts, sizeof(e->first_ts));
+    d->slots[k] = ++d->count;
+    d->memory += tlen + len + sizeof(DedupEntry);
+    if (d->count * 2 > d->nslots && grow_slots(d) != 0) return -1;
+    return 0;
+}
+
+// A line (or the first part of one) past DEDUP_MAX_LINE goes to the overflow as it is
+static int pass_through(Dedup *d, const char *a, size_t alen, const char *b, size_t blen) {
+    d->stats.lines_in++;
+    d->stats.overflow_lines++;
+    return capture_write(&d->overflow, a, alen) != 0 || capture_write(&d->overflow, b, blen) != 0 ? -1 : 0;
+}
+
+int dedup_write(Dedup *d, const char *data, size_t len) {
+    const char *end = data + len;
+    while (data < end) {
+        const char *nl = memchr(data, '\n', (size_t)(end - data));
+        size_t n = nl ? (size_t)(nl - data) : (size_t)(end - data);
+        if (d->passing) {
+            // The rest of a long line
+            if (capture_write(&d->overflow, data, n) != 0) return -1;
+            if (!nl) break;
+            if (capture_write(&d->overflow, "\n", 1) != 0) return -1;
+            d->passing = 0;
+        } else if (d->partial_len + n > DEDUP_MAX_LINE) {
+            int r = pass_through(d, d->partial, d->partial_len, data, n);
+            d->partial_len = 0;
+            if (r != 0) return -1;
+            if (!nl) {
+                d->passing = 1;
+                break;
+            }
+            if (capture_write(&d->overflow, "\n", 1) != 0) return -1;
+        } else if (!nl || d->partial_len > 0) {
+            if (d->partial_len + n > d->partial_cap) {
+                size_t cap = d->partial_cap ? d->partial_cap * 2 : 1024;
+                while (cap < d->partial_len + n) cap *= 2;
+                char *p = realloc(d->partial, cap);
+                if (!p) return -1;
+                d->partial = p;
+                d->partial_cap = cap;
+            }
+            memcpy(d->partial + d->partial_len, data, n);
+            d->partial_len += n;
+            if (!nl) break;
+            int r = add_line(d, d->partial, d->partial_len);
+            d->partial_len = 0;
+            if (r != 0) return -1;
+        } else if (add_line(d, data, n) != 0) {
+            return -1;
+        }
+        data = nl + 1;
+    }
+    return 0;
+}
+
+static void dedup_free(Dedup *d) {
+    for (size_t i = 0; i < d->count; ++i) free(d->entries[i].data);
+    free(d->entries);
+    free(d->slots);
+    free(d->partial);
+    free(d->scratch);
+    capture_free(&d->overflow);
+    free(d);
+}
+
+char* dedup_finish(Dedup *d, size_t *out_len, DedupStats *stats) {
+    if ((d->partial_len > 0 && add_line(d, d->partial, d->partial_len) != 0) ||
+        (d->passing && capture_write(&d->overflow, "\n", 1) != 0)) {
+        dedup_free(d);
+        return NULL;
+    }
+    d->stats.templates = d->count;
+
+    size_t cap = 1;
+    for (size_t i = 0; i < d->count; ++i) cap += d->entries[i].line_len + 1 + (d->entries[i].count > 1 ? 64 + 2 * DEDUP_TS_MAX : 0);
+    size_t overflow_len = 0;
+    char *overflow = NULL;
+    if (d->stats.overflow_lines > 0) {
+        overflow = capture_finish(&d->overflow, &overflow_len);
+        cap += overflow_len + 128;
+    }
+
+    char *out = malloc(cap);
+    if (!out) {
+        free(overflow);
+        dedup_free(d);
+        return NULL;
+    }
+    size_t p = 0;
+    for (size_t i = 0; i < d->count; ++i) {
+        const DedupEntry *e = &d->entries[i];
+        memcpy(out + p, e->data + e->tmpl_len, e->line_len);
+        p += e->line_len;
+        if (e->count > 1) {
+            int n;
+            if (e->first_ts[0]) {
+                n = snprintf(out + p, cap - p, "  [repeated %llu times, first %s, last %s]",
+                             (unsigned long long)e->count, e->first_ts, e->last_ts);
+            } else {
+                n = snprintf(out + p, cap - p, "  [repeated %llu times]", (unsigned long long)e->count);
+            }
+            if (n > 0) p += (size_t)n;
+        }
+        out[p++] = '\n';
+    }
+    if (overflow) {
+        int n = snprintf(out + p, cap - p, "... [%llu more lines with new patterns after the first %llu, or over %d bytes] ...\n",
+                         (unsigned long long)d->stats.overflow_lines, (unsigned long long)d->count, DEDUP_MAX_LINE);
+        if (n > 0) p += (size_t)n;
+        memcpy(out + p, overflow, overflow_len);
+        p += overflow_len;
+        free(overflow);
+    }
+    out[p] = '\0';
+    if (out_len) *out_len = p;
+    if (stats) *stats = d->stats;
+    dedup_free(d);
+    return out;
+}
+
+char* dedup_text(const char *text, size_t len, size_t *out_len, DedupStats *stats) {
+    Dedup *d = dedup_new(DEDUP_DEFAULT_MEMORY);
+    if (!d) return NULL;
+    if (dedup_write(d, text, len) != 0) {
+        dedup_free(d);
+        return NULL;
+    }
+    return dedup_finish(d, out_len, stats);
+}
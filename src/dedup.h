@@ -0,0 +1,46 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming line deduplication. Each line is reduced to a template by replacing the
+// volatile parts (numbers, hex values and addresses, UUIDs, PIDs, clock times) with a
+// placeholder, and lines are grouped by template. The output has one line per template in
+// order of first appearance: the first occurrence as it was, with the number of
+// occurrences and the first and last timestamps appended when it repeats.
+
+// Memory for stored templates; lines with new templates beyond it are kept head+tail
+// by a Capture of the same size and appended after the grouped lines
+#define DEDUP_DEFAULT_MEMORY (2 * 1024 * 1024)
+// Templates kept at most, whatever the memory; later new patterns go to the overflow too
+#define DEDUP_MAX_TEMPLATES 16384
+// Longer lines are not templated (nor carried whole between chunks) but passed through
+// unchanged to the overflow
+#define DEDUP_MAX_LINE (16 * 1024)
+
+typedef struct Dedup Dedup;
+
+typedef struct {
+    uint64_t lines_in;
+    uint64_t templates;      // distinct templates emitted
+    uint64_t overflow_lines; // lines that came after the table was full, or were too long
+} DedupStats;
+
+Dedup* dedup_new(size_t memory_limit);
+
+// Feed a chunk of text; lines may be split across calls. Returns 0, or -1 when out of memory.
+int dedup_write(Dedup *d, const char *data, size_t len);
+
+// Build the grouped text and free the deduplicator. stats may be NULL. Caller frees the
+// result (NULL only when out of memory).
+char* dedup_finish(Dedup *d, size_t *out_len, DedupStats *stats);
+
+// Template of one line (without its newline) into out, which must hold len bytes.
+// Returns the template length.
+size_t dedup_template(const char *line, size_t len, char *out);
+
+// Deduplicate text that is already in memory. Returns NULL when out of memory.
+char* dedup_text(const char *text, size_t len, size_t *out_len, DedupStats *stats);
+
+#endif // DEDUP_H
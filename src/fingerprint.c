@@ -0,0 +1,450 @@
+/* Crash fingerprinting
+ * Walks the assembled report once, collecting failed unit names, kernel call trace
+ * frames and the templates of error lines, then hashes the normalized components into a
+ * 128-bit id. The index of filed fingerprints is a small JSON file replaced atomically.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <jansson.h>
+#include "fingerprint.h"
+#include "dedup.h"
+#include "severity.h"
+#include "strbuf.h"
+#include "paths.h"
+#include "config.h"
+
+#define FINGERPRINT_INDEX_VERSION 1
+#define FAILED_UNITS_TITLE "Systemd Failed Units"
+#define METADATA_TITLE "System Metadata"
+#define HOST_PLACEHOLDER "<host>"
+
+typedef struct {
+    char *text;
+    Severity severity;
+    unsigned long count;     // occurrences, including the ones folded by the deduplicator
+} LineCandidate;
+
+typedef struct {
+    char **items;
+    size_t n, cap;
+} StrList;
+
+static int strlist_add_unique(StrList *l, const char *s, size_t len) {
+    for (size_t i = 0; i < l->n; ++i) {
+        if (strlen(l->items[i]) == len && memcmp(l->items[i], s, len) == 0) return 0;
+    }
+    if (l->n == l->cap) {
+        size_t c = l->cap ? l->cap * 2 : 8;
+        char **items = realloc(l->items, c * sizeof(char*));
+        if (!items) return -1;
+        l->items = items;
+        l->cap = c;
+    }
+    char *copy = strndup(s, len);
+    if (!copy) return -1;
+    l->items[l->n++] = copy;
+    return 0;
+}
+
+static void strlist_free(StrList *l) {
+    for (size_t i = 0; i < l->n; ++i) free(l->items[i]);
+    free(l->items);
+}
+
+static int by_string(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int by_text(const void *a, const void *b) {
+    return strcmp(((const LineCandidate*)a)->text, ((const LineCandidate*)b)->text);
+}
+
+// Most severe first, then most frequent; the text breaks ties so the choice is stable
+static int by_rank(const void *a, const void *b) {
+    const LineCandidate *x = a, *y = b;
+    if (x->severity != y->severity) return x->severity < y->severity ? 1 : -1;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcmp(x->text, y->text);
+}
+
+static int is_header(const char *p, size_t len) {
+    return len >= 6 && memcmp(p, "== ", 3) == 0 && memcmp(p + len - 3, " ==", 3) == 0;
+}
+
+static int header_is(const char *p, size_t len, const char *title) {
+    size_t tl = strlen(title);
+    return len == tl + 6 && memcmp(p + 3, title, tl) == 0;
+}
+
+// Unit name from a "systemctl --failed --no-legend" line ("● foo.service loaded failed ...")
+static int failed_unit(const char *p, size_t len, const char **name, size_t *name_len) {
+    size_t i = 0;
+    while (i < len && (p[i] == ' ' || p[i] == '*' || (unsigned char)p[i] >= 0x80)) i++;
+    size_t start = i;
+    while (i < len && !isspace((unsigned char)p[i])) i++;
+    if (i == start || p[start] == '(' || !memchr(p + start, '.', i - start)) return 0;
+    *name = p + start;
+    *name_len = i - start;
+    return 1;
+}
+
+// Function name of a call trace frame (" dump_stack_lvl+0x5d/0x80", " ? __schedule+0x..").
+// Returns 1 for a frame, 0 for a frame marked unreliable ("?"), -1 when the line is not a frame.
+static int trace_frame(const char *p, size_t len, const char **name, size_t *name_len) {
+    const char *off = NULL;
+    for (size_t i = 0; i + 3 <= len; ++i) {
+        if (p[i] == '+' && p[i + 1] == '0' && p[i + 2] == 'x') {
+            off = p + i;
+            break;
+        }
+    }
+    if (!off) return -1;
+    const char *s = off;
+    while (s > p && (isalnum((unsigned char)s[-1]) || s[-1] == '_' || s[-1] == '.')) s--;
+    if (s == off) return -1;
+    if (s - p >= 2 && s[-1] == ' ' && s[-2] == '?') return 0;
+    // Compiler clones (".isra.0", ".cold", ".constprop.0") differ between builds
+    const char *dot = memchr(s, '.', (size_t)(off - s));
+    *name = s;
+    *name_len = (size_t)((dot ? dot : off) - s);
+    return *name_len > 0 ? 1 : -1;
+}
+
+// Trace markers that do not end a call trace
+static int trace_marker(const char *p, size_t len) {
+    const char *lt = memchr(p, '<', len);
+    return lt && memchr(lt, '>', len - (size_t)(lt - p)) != NULL;
+}
+
+static int contains(const char *p, size_t len, const char *needle) {
+    size_t nl = strlen(needle);
+    for (size_t i = 0; i + nl <= len; ++i) {
+        if (memcmp(p + i, needle, nl) == 0) return 1;
+    }
+    return 0;
+}
+
+// Normalized template of an error line: the deduplicator's repeat note is dropped (its
+// count is returned instead), the host name replaced and volatile tokens templated.
+static char* line_template(const char *p, size_t len, const char *host, unsigned long *count) {
+    *count = 1;
+    for (size_t i = 0; i + 12 <= len; ++i) {
+        if (memcmp(p + i, "  [repeated ", 12) == 0) {
+            *count = strtoul(p + i + 12, NULL, 10);
+            if (*count == 0) *count = 1;
+            len = i;
+            break;
+        }
+    }
+    size_t host_len = host ? strlen(host) : 0;
+    size_t cap = len + 1;
+    if (host_len >= 3) cap += (len / host_len + 1) * strlen(HOST_PLACEHOLDER);
+    char *plain = malloc(cap);
+    char *tmpl = malloc(cap);
+    if (!plain || !tmpl) {
+        free(plain);
+        free(tmpl);
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < len;) {
+        if (host_len >= 3 && i + host_len <= len && memcmp(p + i, host, host_len) == 0) {
+            memcpy(plain + n, HOST_PLACEHOLDER, strlen(HOST_PLACEHOLDER));
+            n += strlen(HOST_PLACEHOLDER);
+            i += host_len;
+        } else {
+            plain[n++] = p[i++];
+        }
+    }
+    size_t tl = dedup_template(plain, n, tmpl);
+    free(plain);
+    // Whitespace runs are padding ("[   12.5]" vs "[ 1234.5]"); squeeze them and trim
+    size_t o = 0;
+    for (size_t i = 0; i < tl; ++i) {
+        if (isspace((unsigned char)tmpl[i])) {
+            if (o == 0 || tmpl[o - 1] == ' ') continue;
+            tmpl[o++] = ' ';
+        } else {
+            tmpl[o++] = tmpl[i];
+        }
+    }
+    if (o > 0 && tmpl[o - 1] == ' ') o--;
+    tmpl[o] = '\0';
+    return tmpl;
+}
+
+static void hash_part(uint64_t h[2], const char *kind, const char *s) {
+    static const uint64_t prime = 0x100000001b3ULL;
+    const char *parts[2] = {kind, s};
+    for (int k = 0; k < 2; ++k) {
+        // Include the terminator so "ab"+"c" and "a"+"bc" differ
+        for (const unsigned char *c = (const unsigned char*)parts[k];; ++c) {
+            h[0] = (h[0] ^ *c) * prime;
+            h[1] = (h[1] ^ (unsigned char)(*c + 0x5b)) * prime;
+            if (!*c) break;
+        }
+    }
+}
+
+int fingerprint_report(const char *report, size_t len, Fingerprint *out) {
+    memset(out, 0, sizeof(*out));
+    StrList units = {0}, frames = {0};
+    LineCandidate *lines = NULL;
+    size_t nlines = 0, lines_cap = 0;
+    char host[256] = "";
+    int in_metadata = 0, in_units = 0, in_trace = 0;
+    char *summary = NULL;
+    size_t slen = 0, scap = 0;
+    int rc = -1;
+
+    const char *p = report, *end = report + len;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        const char *next = nl ? nl + 1 : end;
+
+        if (is_header(p, n)) {
+            in_metadata = header_is(p, n, METADATA_TITLE);
+            in_units = header_is(p, n, FAILED_UNITS_TITLE);
+            in_trace = 0;
+            p = next;
+            continue;
+        }
+        if (in_metadata) {
+            if (n > 10 && memcmp(p, "Hostname: ", 10) == 0 && n - 10 < sizeof(host)) {
+                memcpy(host, p + 10, n - 10);
+                host[n - 10] = '\0';
+                if (strcmp(host, "(unknown)") == 0) host[0] = '\0';
+            }
+            p = next;
+            continue;
+        }
+        if (in_units) {
+            const char *name;
+            size_t name_len;
+            if (failed_unit(p, n, &name, &name_len)) {
+                char *tmpl = malloc(name_len + 1);
+                if (!tmpl) goto out;
+                size_t tl = dedup_template(name, name_len, tmpl);
+                int r = strlist_add_unique(&units, tmpl, tl);
+                free(tmpl);
+                if (r != 0) goto out;
+            }
+            p = next;
+            continue;
+        }
+
+        if (contains(p, n, "Call Trace:")) {
+            in_trace = 1;
+            p = next;
+            continue;
+        }
+        if (in_trace) {
+            const char *name;
+            size_t name_len;
+            int f = trace_frame(p, n, &name, &name_len);
+            if (f == 1 && frames.n < FINGERPRINT_MAX_FRAMES && strlist_add_unique(&frames, name, name_len) != 0) goto out;
+            if (f >= 0 || trace_marker(p, n)) {
+                p = next;
+                continue;
+            }
+            in_trace = 0;
+        }
+
+        Severity sev = severity_of_line(p, n);
+        if (sev >= SEVERITY_ERROR) {
+            if (nlines == lines_cap) {
+                size_t c = lines_cap ? lines_cap * 2 : 64;
+                LineCandidate *l2 = realloc(lines, c * sizeof(LineCandidate));
+                if (!l2) goto out;
+                lines = l2;
+                lines_cap = c;
+            }
+            LineCandidate *c = &lines[nlines];
+            c->text = line_template(p, n, host[0] ? host : NULL, &c->count);
+            if (!c->text) goto out;
+            c->severity = sev;
+            if (c->text[0]) nlines++;
+            else free(c->text);
+        }
+        p = next;
+    }
+
+    // Fold identical templates, then keep the top ones
+    if (nlines > 0) {
+        qsort(lines, nlines, sizeof(LineCandidate), by_text);
+        size_t w = 0;
+        for (size_t i = 1; i < nlines; ++i) {
+            if (strcmp(lines[i].text, lines[w].text) == 0) {
+                lines[w].count += lines[i].count;
+                if (lines[i].severity > lines[w].severity) lines[w].severity = lines[i].severity;
+                free(lines[i].text);
+            } else {
+                lines[++w] = lines[i];
+            }
+        }
+        nlines = w + 1;
+        qsort(lines, nlines, sizeof(LineCandidate), by_rank);
+    }
+    size_t top = nlines < FINGERPRINT_MAX_LINES ? nlines : FINGERPRINT_MAX_LINES;
+
+    // Readable summary, in rank order
+    if (units.n > 0) {
+        if (buf_append(&summary, &slen, &scap, "Failed units:", 13) != 0) goto out;
+        for (size_t i = 0; i < units.n; ++i) {
+            if (buf_append(&summary, &slen, &scap, i ? ", " : " ", i ? 2 : 1) != 0 ||
+                buf_append(&summary, &slen, &scap, units.items[i], strlen(units.items[i])) != 0) goto out;
+        }
+        if (buf_append(&summary, &slen, &scap, "\n", 1) != 0) goto out;
+    }
+    if (frames.n > 0) {
+        if (buf_append(&summary, &slen, &scap, "Kernel call trace:", 18) != 0) goto out;
+        for (size_t i = 0; i < frames.n; ++i) {
+            if (buf_append(&summary, &slen, &scap, i ? " < " : " ", i ? 3 : 1) != 0 ||
+                buf_append(&summary, &slen, &scap, frames.items[i], strlen(frames.items[i])) != 0) goto out;
+        }
+        if (buf_append(&summary, &slen, &scap, "\n", 1) != 0) goto out;
+    }
+    if (top > 0) {
+        if (buf_append(&summary, &slen, &scap, "Top errors:\n", 12) != 0) goto out;
+        for (size_t i = 0; i < top; ++i) {
+            char head[64];
+            int hn = snprintf(head, sizeof(head), "  [%s x%lu] ", severity_name(lines[i].severity), lines[i].count);
+            if (buf_append(&summary, &slen, &scap, head, (size_t)hn) != 0 ||
+                buf_append(&summary, &slen, &scap, lines[i].text, strlen(lines[i].text)) != 0 ||
+                buf_append(&summary, &slen, &scap, "\n", 1) != 0) goto out;
+        }
+    }
+    if (!summary && buf_append(&summary, &slen, &scap, "", 0) != 0) goto out;
+
+    // Hash: units and line templates sorted (their order in the report is incidental),
+    // frames in call order
+    uint64_t h[2] = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL};
+    qsort(units.items, units.n, sizeof(char*), by_string);
+    for (size_t i = 0; i < units.n; ++i) hash_part(h, "unit", units.items[i]);
+    for (size_t i = 0; i < frames.n; ++i) hash_part(h, "frame", frames.items[i]);
+    char **chosen = malloc((top ? top : 1) * sizeof(char*));
+    if (!chosen) goto out;
+    for (size_t i = 0; i < top; ++i) chosen[i] = lines[i].text;
+    qsort(chosen, top, sizeof(char*), by_string);
+    for (size_t i = 0; i < top; ++i) hash_part(h, "line", chosen[i]);
+    free(chosen);
+
+    snprintf(out->id, sizeof(out->id), FINGERPRINT_PREFIX "%016llx%016llx",
+             (unsigned long long)h[0], (unsigned long long)h[1]);
+    out->summary = summary;
+    out->components = units.n + frames.n + top;
+    summary = NULL;
+    rc = 0;
+
+out:
+    free(summary);
+    strlist_free(&units);
+    strlist_free(&frames);
+    for (size_t i = 0; i < nlines; ++i) free(lines[i].text);
+    free(lines);
+    return rc;
+}
+
+void fingerprint_free(Fingerprint *fp) {
+    free(fp->summary);
+    memset(fp, 0, sizeof(*fp));
+}
+
+// Path of the index in the state directory
+static int index_path(char *out, size_t size) {
+    char dir[PATH_MAX];
+    if (state_dir(NULL, dir, sizeof(dir)) != 0) return -1;
+    snprintf(out, size, "%s/fingerprints.json", dir);
+    return 0;
+}
+
+static json_t* load_index(const char *path) {
+    json_t *idx = json_load_file(path, 0, NULL);
+    if (idx && json_integer_value(json_object_get(idx, "version")) == FINGERPRINT_INDEX_VERSION &&
+        json_is_object(json_object_get(idx, "fingerprints"))) {
+        return idx;
+    }
+    json_decref(idx);
+    idx = json_object();
+    json_object_set_new(idx, "version", json_integer(FINGERPRINT_INDEX_VERSION));
+    json_object_set_new(idx, "fingerprints", json_object());
+    return idx;
+}
+
+static int save_index(const char *path, json_t *index) {
+    char tmpfile[PATH_MAX];
+    snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", path);
+    char *data = json_dumps(index, JSON_COMPACT);
+    if (!data) return -1;
+    int rc = -1;
+    int fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+        size_t len = strlen(data);
+        int ok = write(fd, data, len) == (ssize_t)len && fsync(fd) == 0;
+        close(fd);
+        if (ok && rename(tmpfile, path) == 0) rc = 0;
+        else unlink(tmpfile);
+    }
+    free(data);
+    return rc;
+}
+
+char* fingerprint_index_lookup(const char *id, long *count) {
+    char path[PATH_MAX];
+    if (count) *count = 0;
+    if (index_path(path, sizeof(path)) != 0) return NULL;
+    json_t *idx = load_index(path);
+    json_t *entry = json_object_get(json_object_get(idx, "fingerprints"), id);
+    char *url = NULL;
+    if (json_is_string(json_object_get(entry, "url"))) {
+        url = strdup(json_string_value(json_object_get(entry, "url")));
+        if (count) *count = (long)json_integer_value(json_object_get(entry, "count"));
+    }
+    json_decref(idx);
+    return url;
+}
+
+long fingerprint_index_record(const char *id, const char *issue_url) {
+    char path[PATH_MAX], lock_path[PATH_MAX + 8];
+    if (index_path(path, sizeof(path)) != 0) return -1;
+    // Read-modify-write under a lock: the GUI and a watcher may record at the same time
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+    int lock = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock >= 0) flock(lock, LOCK_EX);
+
+    json_t *idx = load_index(path);
+    json_t *all = json_object_get(idx, "fingerprints");
+    json_t *entry = json_object_get(all, id);
+    json_int_t now = (json_int_t)time(NULL);
+    json_int_t count = 1;
+    if (json_is_object(entry)) {
+        count = json_integer_value(json_object_get(entry, "count")) + 1;
+    } else {
+        entry = json_object();
+        json_object_set_new(entry, "first", json_integer(now));
+        json_object_set_new(all, id, entry);
+    }
+    json_object_set_new(entry, "url", json_string(issue_url));
+    json_object_set_new(entry, "count", json_integer(count));
+    json_object_set_new(entry, "last", json_integer(now));
+    int rc = save_index(path, idx);
+    json_decref(idx);
+
+    if (lock >= 0) close(lock);
+    if (rc != 0) {
+        fprintf(stderr, "Could not write the fingerprint index %s\n", path);
+        return -1;
+    }
+    return (long)count;
+}
@@ -0,0 +1,33 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stddef.h>
+
+// Crash fingerprints. A report is reduced to the things that identify the failure rather
+// than the machine or the moment: the names of the failed units, the function names of
+// kernel oops call traces and the templates of the most severe log lines (numbers,
+// addresses, timestamps and the host name taken out). These are sorted and hashed, so
+// the same failure gives the same fingerprint on every machine and every run.
+
+#define FINGERPRINT_PREFIX "crfp-"
+#define FINGERPRINT_ID_SIZE (sizeof(FINGERPRINT_PREFIX) + 32) // prefix, 32 hex digits, NUL
+
+typedef struct {
+    char id[FINGERPRINT_ID_SIZE];
+    char *summary;           // what went into the fingerprint, readable, for issue bodies
+    size_t components;       // units + frames + lines hashed; 0 means there was nothing to go on
+} Fingerprint;
+
+// Fingerprint an assembled report. Returns 0, or -1 when out of memory.
+int fingerprint_report(const char *report, size_t len, Fingerprint *out);
+void fingerprint_free(Fingerprint *fp);
+
+// Local index of fingerprints already filed, in $XDG_STATE_HOME/crash-reporter
+// (~/.local/state by default). Lookup returns the issue URL (caller frees) or NULL;
+// count (may be NULL) gets the number of times the fingerprint was recorded.
+char* fingerprint_index_lookup(const char *id, long *count);
+// Record an occurrence of a fingerprint filed as issue_url. Returns the new count, or -1
+// when the index cannot be written.
+long fingerprint_index_record(const char *id, const char *issue_url);
+
+#endif // FINGERPRINT_H
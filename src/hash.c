@@ -0,0 +1,18 @@
+/* FNV-1a hashing
+ * One implementation for the dedup table, the history records and the log tree token.
+ */
+
+#include "hash.h"
+
+uint64_t fnv1a_update(uint64_t h, const void *data, size_t n) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t fnv1a(const void *data, size_t n) {
+    return fnv1a_update(FNV1A_INIT, data, n);
+}
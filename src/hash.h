@@ -0,0 +1,16 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit FNV-1a, for hash tables and cheap content checks (not for anything adversarial)
+#define FNV1A_INIT 1469598103934665603ULL
+
+// Fold n bytes into h, a hash started at FNV1A_INIT
+uint64_t fnv1a_update(uint64_t h, const void *data, size_t n);
+
+// The hash of n bytes
+uint64_t fnv1a(const void *data, size_t n);
+
+#endif // HASH_H
@@ -0,0 +1,394 @@
+/* Privileged helper
+ * The GUI launches its own binary once through pkexec with HELPER_ARG and talks to it
+ * over a socketpair using small framed messages. The helper serves a fixed set of
+ * named collectors concurrently and exits when the GUI closes the channel.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "helper.h"
+#include "capture.h"
+#include "crash_reporter.h"
+#include "journal.h"
+#include "kmsg.h"
+#include "pacman_log.h"
+#include "logscan.h"
+#include "coredump.h"
+#include "units.h"
+
+#define HELPER_CHUNK 65536
+
+extern char **environ;
+
+// The journal's validity token, for a client that cannot read the journal itself
+static char* journal_token(const int *cancel, size_t *out_len) {
+    char *token = journal_state_token();
+    if (token && out_len) *out_len = strlen(token);
+    return token;
+}
+
+// Collectors the helper is willing to run as root. Nothing else can be requested.
+// Those with a stream function send their output while they produce it.
+static const struct {
+    const char *name;
+    char* (*fn)(const int *cancel, size_t *out_len);
+    int (*stream)(HelperChunkFn emit, void *user);
+} helper_collectors[] = {
+    { "journal", collect_journal_errors, NULL },
+    { "journal-boot", collect_journal_boot_errors, NULL },
+    { "journal-token", journal_token, NULL },
+    { "kmsg", collect_kmsg_errors, NULL },
+    { "pacman", collect_pacman_errors, NULL },
+    { "varlog", NULL, stream_varlog_matches },
+    { "coredumps", collect_coredumps, NULL },
+    { "unit-status", collect_failed_unit_statuses, NULL },
+};
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t r = read(fd, p, len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+// Write a whole frame. send() with MSG_NOSIGNAL keeps a dead peer from killing us with
+// SIGPIPE; plain write() is used when fd is not a socket (e.g. the helper run by hand).
+static int write_frame(int fd, uint32_t type, uint32_t id, const void *payload, size_t len) {
+    HelperFrame hdr = { type, id, (uint32_t)len };
+    struct { const void *p; size_t n; } parts[2] = { { &hdr, sizeof(hdr) }, { payload, len } };
+    for (int i = 0; i < 2; ++i) {
+        const char *p = parts[i].p;
+        size_t n = parts[i].n;
+        while (n > 0) {
+            ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+            if (w < 0 && errno == ENOTSOCK) w = write(fd, p, n);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return -1;
+            p += w;
+            n -= (size_t)w;
+        }
+    }
+    return 0;
+}
+
+/* ---- Helper (privileged) side ---- */
+
+static pthread_mutex_t helper_out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    uint32_t id;
+    char name[64];
+} HelperJob;
+
+static void helper_send(uint32_t type, uint32_t id, const void *payload, size_t len) {
+    pthread_mutex_lock(&helper_out_lock);
+    write_frame(STDOUT_FILENO, type, id, payload, len);
+    pthread_mutex_unlock(&helper_out_lock);
+}
+
+// Each chunk is its own frame so concurrent jobs interleave instead of queueing
+static void send_data(const char *data, size_t len, void *user) {
+    const HelperJob *job = user;
+    for (size_t off = 0; off < len; off += HELPER_CHUNK) {
+        size_t n = len - off < HELPER_CHUNK ? len - off : HELPER_CHUNK;
+        helper_send(HELPER_DATA, job->id, data + off, n);
+    }
+}
+
+static void* helper_job_main(void *arg) {
+    HelperJob *job = arg;
+    int32_t status = HELPER_STATUS_UNKNOWN;
+    for (size_t i = 0; i < sizeof(helper_collectors) / sizeof(helper_collectors[0]); ++i) {
+        if (strcmp(helper_collectors[i].name, job->name) != 0) continue;
+        if (helper_collectors[i].stream) {
+            status = helper_collectors[i].stream(send_data, job) == 0 ? HELPER_STATUS_OK : HELPER_STATUS_UNAVAILABLE;
+            break;
+        }
+        size_t len = 0;
+        char *out = helper_collectors[i].fn(NULL, &len);
+        if (!out) {
+            status = HELPER_STATUS_UNAVAILABLE;
+            break;
+        }
+        send_data(out, len, job);
+        free(out);
+        status = HELPER_STATUS_OK;
+        break;
+    }
+    helper_send(HELPER_END, job->id, &status, sizeof(status));
+    free(job);
+    return NULL;
+}
+
+int helper_main(void) {
+    uint32_t version = HELPER_PROTOCOL_VERSION;
+    helper_send(HELPER_HELLO, 0, &version, sizeof(version));
+
+    for (;;) {
+        HelperFrame hdr;
+        if (read_full(STDIN_FILENO, &hdr, sizeof(hdr)) != 0) break; // client went away
+        if (hdr.len > HELPER_MAX_PAYLOAD) break;
+        char payload[64];
+        char *big = NULL;
+        char *p = payload;
+        if (hdr.len >= sizeof(payload)) {
+            big = malloc(hdr.len);
+            if (!big) break;
+            p = big;
+        }
+        if (read_full(STDIN_FILENO, p, hdr.len) != 0) {
+            free(big);
+            break;
+        }
+        if (hdr.type == HELPER_COLLECT && hdr.len < sizeof(((HelperJob *)0)->name)) {
+            HelperJob *job = calloc(1, sizeof(HelperJob));
+            if (job) {
+                job->id = hdr.id;
+                memcpy(job->name, p, hdr.len);
+                pthread_t t;
+                if (pthread_create(&t, NULL, helper_job_main, job) == 0) {
+                    pthread_detach(t);
+                } else {
+                    free(job);
+                }
+            }
+        } else if (hdr.type == HELPER_COLLECT) {
+            int32_t status = HELPER_STATUS_UNKNOWN;
+            helper_send(HELPER_END, hdr.id, &status, sizeof(status));
+        }
+        free(big);
+    }
+    // In-flight jobs have nobody to report to any more
+    _exit(0);
+}
+
+/* ---- Client (GUI) side ---- */
+
+typedef struct HelperRequest {
+    uint32_t id;
+    HelperChunkFn on_chunk;
+    void *user;
+    int done;
+    int status;
+    struct HelperRequest *next;
+} HelperRequest;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_mutex_t write_lock;
+    int fd;
+    pid_t pid;
+    int running;
+    int starting;            // a helper_start() is waiting for authorization
+    pthread_t reader;
+    uint32_t next_id;
+    HelperRequest *pending;
+} client = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, -1, 0, 0, 0, 0, 1, NULL };
+
+static HelperRequest* find_request(uint32_t id) {
+    for (HelperRequest *r = client.pending; r; r = r->next) {
+        if (r->id == id) return r;
+    }
+    return NULL;
+}
+
+// Demultiplexes helper replies into the waiting requests
+static void* reader_main(void *arg) {
+    (void)arg;
+    char *payload = malloc(HELPER_MAX_PAYLOAD);
+    for (;;) {
+        HelperFrame hdr;
+        if (!payload || read_full(client.fd, &hdr, sizeof(hdr)) != 0) break;
+        if (hdr.len > HELPER_MAX_PAYLOAD || read_full(client.fd, payload, hdr.len) != 0) break;
+
+        pthread_mutex_lock(&client.lock);
+        HelperRequest *req = find_request(hdr.id);
+        pthread_mutex_unlock(&client.lock);
+        if (!req) continue;
+
+        if (hdr.type == HELPER_DATA) {
+            // Only this thread completes requests, so req stays valid until END
+            if (req->on_chunk) req->on_chunk(payload, hdr.len, req->user);
+        } else if (hdr.type == HELPER_END) {
+            int32_t status = HELPER_STATUS_UNAVAILABLE;
+            if (hdr.len == sizeof(status)) memcpy(&status, payload, sizeof(status));
+            pthread_mutex_lock(&client.lock);
+            req->status = status;
+            req->done = 1;
+            pthread_cond_broadcast(&client.cond);
+            pthread_mutex_unlock(&client.lock);
+        }
+    }
+    free(payload);
+
+    // Helper exited: fail everything still waiting
+    pthread_mutex_lock(&client.lock);
+    client.running = 0;
+    for (HelperRequest *r = client.pending; r; r = r->next) {
+        if (!r->done) {
+            r->status = -1;
+            r->done = 1;
+        }
+    }
+    pthread_cond_broadcast(&client.cond);
+    pthread_mutex_unlock(&client.lock);
+    return NULL;
+}
+
+// Launch and handshake without the client lock: the polkit prompt can take as long as
+// the user does, and helper_available() and running requests must not wait for it
+static int launch_helper(int *fd_out, pid_t *pid_out) {
+    const char *pkexec = find_pkexec();
+    char self[PATH_MAX];
+    ssize_t sl = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    int sv[2];
+    if (!pkexec || sl <= 0 || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) return -1;
+    self[sl] = '\0';
+
+    // The helper talks over its stdin/stdout, which pkexec passes through
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, sv[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, sv[1], STDOUT_FILENO);
+    char *const argv[] = { (char *)pkexec, self, (char *)HELPER_ARG, NULL };
+    pid_t pid;
+    int rc = posix_spawn(&pid, pkexec, &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(sv[1]);
+    if (rc != 0) {
+        close(sv[0]);
+        return -1;
+    }
+
+    // Blocks while the polkit agent asks for authorization; EOF means it was denied
+    HelperFrame hdr;
+    uint32_t version = 0;
+    if (read_full(sv[0], &hdr, sizeof(hdr)) != 0 || hdr.type != HELPER_HELLO || hdr.len != sizeof(version) ||
+        read_full(sv[0], &version, sizeof(version)) != 0 || version != HELPER_PROTOCOL_VERSION) {
+        close(sv[0]);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    *fd_out = sv[0];
+    *pid_out = pid;
+    return 0;
+}
+
+int helper_start(void) {
+    pthread_mutex_lock(&client.lock);
+    // A concurrent start is already asking; share its outcome instead of prompting twice
+    int waited = client.starting;
+    while (client.starting) pthread_cond_wait(&client.cond, &client.lock);
+    if (client.running || waited) {
+        int rc = client.running ? 0 : -1;
+        pthread_mutex_unlock(&client.lock);
+        return rc;
+    }
+    client.starting = 1;
+    pthread_mutex_unlock(&client.lock);
+
+    int fd;
+    pid_t pid;
+    int rc = launch_helper(&fd, &pid);
+
+    pthread_mutex_lock(&client.lock);
+    if (rc == 0) {
+        client.fd = fd;
+        client.pid = pid;
+        client.running = 1;
+        if (pthread_create(&client.reader, NULL, reader_main, NULL) != 0) {
+            client.running = 0;
+            close(fd);
+            client.fd = -1;
+            waitpid(pid, NULL, 0);
+            rc = -1;
+        }
+    }
+    client.starting = 0;
+    pthread_cond_broadcast(&client.cond);
+    pthread_mutex_unlock(&client.lock);
+    return rc;
+}
+
+int helper_available(void) {
+    pthread_mutex_lock(&client.lock);
+    int running = client.running;
+    pthread_mutex_unlock(&client.lock);
+    return running;
+}
+
+int helper_collect_stream(const char *name, HelperChunkFn on_chunk, void *user) {
+    HelperRequest req = { 0, on_chunk, user, 0, -1, NULL };
+
+    pthread_mutex_lock(&client.lock);
+    if (!client.running) {
+        pthread_mutex_unlock(&client.lock);
+        return -1;
+    }
+    req.id = client.next_id++;
+    req.next = client.pending;
+    client.pending = &req;
+    int fd = client.fd;
+    pthread_mutex_unlock(&client.lock);
+
+    pthread_mutex_lock(&client.write_lock);
+    int sent = write_frame(fd, HELPER_COLLECT, req.id, name, strlen(name));
+    pthread_mutex_unlock(&client.write_lock);
+
+    pthread_mutex_lock(&client.lock);
+    if (sent != 0) {
+        req.done = 1;
+        req.status = -1;
+    }
+    while (!req.done) pthread_cond_wait(&client.cond, &client.lock);
+    for (HelperRequest **pp = &client.pending; *pp; pp = &(*pp)->next) {
+        if (*pp == &req) {
+            *pp = req.next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client.lock);
+    return req.status == HELPER_STATUS_OK ? 0 : -1;
+}
+
+static void append_chunk(const char *data, size_t len, void *user) {
+    capture_write((Capture *)user, data, len);
+}
+
+char* helper_collect(const char *name, size_t *out_len) {
+    Capture cap;
+    capture_init(&cap, CAPTURE_DEFAULT_BUDGET);
+    if (helper_collect_stream(name, append_chunk, &cap) != 0) {
+        capture_free(&cap);
+        return NULL;
+    }
+    return capture_finish(&cap, out_len);
+}
+
+void helper_stop(void) {
+    pthread_mutex_lock(&client.lock);
+    int running = client.fd >= 0;
+    pthread_mutex_unlock(&client.lock);
+    if (!running) return;
+
+    shutdown(client.fd, SHUT_WR); // helper sees EOF and exits
+    pthread_join(client.reader, NULL);
+    close(client.fd);
+    client.fd = -1;
+    waitpid(client.pid, NULL, 0);
+}
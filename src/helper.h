@@ -0,0 +1,57 @@
+#ifndef HELPER_H
+#define HELPER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Command line switch that makes the binary act as the privileged helper
+#define HELPER_ARG "--privileged-helper"
+
+// Wire format: every message is a HelperFrame header followed by len payload bytes.
+// Both ends run on the same machine, so fields are in host byte order.
+typedef struct {
+    uint32_t type;
+    uint32_t id;     // request id chosen by the client, echoed in replies
+    uint32_t len;    // payload length
+} HelperFrame;
+
+enum {
+    HELPER_HELLO = 1,    // helper -> client once at startup, payload: protocol version (uint32)
+    HELPER_COLLECT = 2,  // client -> helper, payload: collector name
+    HELPER_DATA = 3,     // helper -> client, payload: the next chunk of output
+    HELPER_END = 4,      // helper -> client, payload: status (int32, see below)
+};
+
+enum {
+    HELPER_STATUS_OK = 0,
+    HELPER_STATUS_UNKNOWN = 1,      // no collector with that name
+    HELPER_STATUS_UNAVAILABLE = 2,  // collector could not read its source
+};
+
+#define HELPER_PROTOCOL_VERSION 1
+#define HELPER_MAX_PAYLOAD (1024 * 1024)
+
+typedef void (*HelperChunkFn)(const char *data, size_t len, void *user);
+
+// Launch this binary once through pkexec as the helper (prompts for authorization at most
+// once). Returns 0 if the helper is running, -1 if it could not be started or was denied.
+int helper_start(void);
+
+int helper_available(void);
+
+// Ask the helper to run a named collector; on_chunk is called for each chunk as it arrives.
+// Safe to call from several threads at once. Returns 0 on success, -1 otherwise.
+int helper_collect_stream(const char *name, HelperChunkFn on_chunk, void *user);
+
+// Convenience wrapper collecting the output into a head+tail capture of
+// CAPTURE_DEFAULT_BUDGET bytes. Returns NULL if the helper is not running or the
+// collector failed; caller frees.
+char* helper_collect(const char *name, size_t *out_len);
+
+// Close the channel; the helper exits when it sees EOF.
+void helper_stop(void);
+
+// Entry point of the helper process: serves requests on stdin/stdout until EOF.
+int helper_main(void);
+
+#endif // HELPER_H
@@ -0,0 +1,641 @@
+/* Report history
+ * history/index is a header and one fixed-size record per report, in the order they were
+ * added; ids and times only grow, so ranges are found by binary search in the mapped
+ * file. The reports themselves are zstd frames appended to NNNNNNNN.seg segments, a new
+ * one started every HISTORY_SEGMENT_BYTES. A report identical to the one before it is
+ * not stored again; its record points at the same frame. Writers hold an exclusive flock
+ * on history/lock, readers a shared one while they map the index.
+ *
+ * Retention works on whole segments: records older than HISTORY_MAX_AGE_DAYS and those
+ * in the oldest segments, while the store is over HISTORY_MAX_BYTES, are cut from the
+ * front of the index (rewritten and renamed into place), then the segments nothing
+ * points into any more are removed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include <systemd/sd-id128.h>
+#include "history.h"
+#include "paths.h"
+#include "hash.h"
+#include "config.h"
+
+#define HISTORY_MAGIC "CRHISTIX"
+#define HISTORY_FORMAT_VERSION 1
+#define HISTORY_SEGMENT_SUFFIX ".seg"
+// Larger reports are not kept (the collectors' budgets stay far below this)
+#define HISTORY_MAX_TEXT (64 * 1024 * 1024)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t next_id;
+    uint32_t segment;        // the one being appended to
+    uint32_t reserved;
+} HistoryHeader;
+
+typedef struct {
+    uint64_t id;
+    int64_t time;
+    uint64_t offset;         // of the frame in its segment
+    uint64_t hash;           // FNV-1a of the text, to spot an unchanged report
+    uint32_t segment;
+    uint32_t stored;         // frame bytes
+    uint32_t length;         // text bytes
+    uint32_t counts[3];      // warning, error and critical lines
+    uint8_t boot_id[16];
+    uint8_t fingerprint[16]; // all zero without one
+    char hostname[HISTORY_HOST_SIZE];
+} HistoryRecord;
+
+_Static_assert(sizeof(HistoryRecord) == 152, "history records are written as they are");
+
+typedef struct {
+    void *map;
+    size_t size;
+    const HistoryHeader *hdr;
+    const HistoryRecord *records;
+    size_t count;
+} HistoryIndex;
+
+static int lock_store(const char *dir, int op) {
+    char path[PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s/lock", dir);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd >= 0) flock(fd, op);
+    return fd;
+}
+
+static void segment_path(char *out, size_t size, const char *dir, uint32_t segment) {
+    snprintf(out, size, "%s/%08u" HISTORY_SEGMENT_SUFFIX, dir, segment);
+}
+
+static int parse_hex16(const char *s, uint8_t out[16]) {
+    if (strlen(s) != 32 || strspn(s, "0123456789abcdef") != 32) return -1;
+    for (int i = 0; i < 16; ++i) {
+        char pair[3] = {s[2 * i], s[2 * i + 1], '\0'};
+        out[i] = (uint8_t)strtoul(pair, NULL, 16);
+    }
+    return 0;
+}
+
+static void format_hex16(const uint8_t in[16], char out[33]) {
+    for (int i = 0; i < 16; ++i) snprintf(out + 2 * i, 3, "%02x", in[i]);
+}
+
+static int is_zero16(const uint8_t b[16]) {
+    for (int i = 0; i < 16; ++i) {
+        if (b[i]) return 0;
+    }
+    return 1;
+}
+
+static int valid_header(const HistoryHeader *h) {
+    return memcmp(h->magic, HISTORY_MAGIC, sizeof(h->magic)) == 0 && h->version == HISTORY_FORMAT_VERSION &&
+           h->record_size == sizeof(HistoryRecord);
+}
+
+static int write_all_at(int fd, const void *data, size_t len, off_t off) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+static int read_all_at(int fd, void *data, size_t len, off_t off) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+// Map the index as it is now. A missing index is an empty one; -1 means it is unreadable.
+static int index_open(const char *dir, HistoryIndex *idx) {
+    memset(idx, 0, sizeof(*idx));
+    char path[PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s/index", dir);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(HistoryHeader)) {
+        close(fd);
+        return 0;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    if (!valid_header(map)) {
+        munmap(map, size);
+        return -1;
+    }
+    idx->map = map;
+    idx->size = size;
+    idx->hdr = map;
+    idx->records = (const HistoryRecord *)((const char *)map + sizeof(HistoryHeader));
+    // A record torn by a crash at the end is not one
+    idx->count = (size - sizeof(HistoryHeader)) / sizeof(HistoryRecord);
+    return 0;
+}
+
+static void index_close(HistoryIndex *idx) {
+    if (idx->map) munmap(idx->map, idx->size);
+    memset(idx, 0, sizeof(*idx));
+}
+
+// Map the index for a query, or -1 with a message
+static int index_open_shared(HistoryIndex *idx) {
+    char dir[PATH_MAX];
+    if (state_dir("history", dir, sizeof(dir)) != 0) {
+        fprintf(stderr, "No history directory\n");
+        return -1;
+    }
+    int lock = lock_store(dir, LOCK_SH);
+    int rc = index_open(dir, idx);
+    if (lock >= 0) close(lock);
+    if (rc != 0) fprintf(stderr, "The history index in %s cannot be read\n", dir);
+    return rc;
+}
+
+typedef struct {
+    uint32_t number;
+    uint64_t size;
+} Segment;
+
+static int by_number(const void *a, const void *b) {
+    const Segment *x = a, *y = b;
+    return x->number < y->number ? -1 : x->number > y->number;
+}
+
+// The segment files in the directory, oldest first
+static Segment* list_segments(const char *dir, size_t *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+    Segment *segs = NULL;
+    size_t cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        char *end;
+        unsigned long n = strtoul(de->d_name, &end, 10);
+        struct stat st;
+        if (end == de->d_name || strcmp(end, HISTORY_SEGMENT_SUFFIX) != 0 || n == 0 || n >= UINT32_MAX ||
+            fstatat(dirfd(d), de->d_name, &st, 0) != 0) {
+            continue;
+        }
+        if (*count == cap) {
+            size_t c = cap ? cap * 2 : 16;
+            Segment *s = realloc(segs, c * sizeof(Segment));
+            if (!s) break;
+            segs = s;
+            cap = c;
+        }
+        segs[*count].number = (uint32_t)n;
+        segs[(*count)++].size = (uint64_t)st.st_size;
+    }
+    closedir(d);
+    if (*count > 0) qsort(segs, *count, sizeof(Segment), by_number);
+    return segs;
+}
+
+/* ---- Adding ---- */
+
+// Append the frame (unless the report is the same as the last one) and the record.
+// Called with the store locked.
+static int append_report(const char *dir, HistoryRecord *rec, const char *text, size_t len) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/index", dir);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    struct stat st;
+    HistoryHeader hdr;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(hdr) || read_all_at(fd, &hdr, sizeof(hdr), 0) != 0 || !valid_header(&hdr)) {
+        if (st.st_size > 0) fprintf(stderr, "Starting a new history index; %s is from another version\n", path);
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, HISTORY_MAGIC, sizeof(hdr.magic));
+        hdr.version = HISTORY_FORMAT_VERSION;
+        hdr.record_size = sizeof(HistoryRecord);
+        hdr.next_id = 1;
+        size_t nsegs;
+        Segment *segs = list_segments(dir, &nsegs);
+        hdr.segment = nsegs > 0 ? segs[nsegs - 1].number + 1 : 1;
+        free(segs);
+        st.st_size = sizeof(hdr);
+        if (ftruncate(fd, 0) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    size_t count = ((size_t)st.st_size - sizeof(hdr)) / sizeof(HistoryRecord);
+    off_t end = (off_t)(sizeof(hdr) + count * sizeof(HistoryRecord));
+
+    HistoryRecord last;
+    int have_last = count > 0 && read_all_at(fd, &last, sizeof(last), end - (off_t)sizeof(last)) == 0;
+    if (have_last && last.hash == rec->hash && last.length == rec->length && last.segment == hdr.segment) {
+        rec->segment = last.segment;
+        rec->offset = last.offset;
+        rec->stored = last.stored;
+    } else {
+        size_t bound = ZSTD_compressBound(len);
+        char *frame = malloc(bound);
+        size_t flen = frame ? ZSTD_compress(frame, bound, text, len, HISTORY_COMPRESSION_LEVEL) : 0;
+        if (!frame || ZSTD_isError(flen) || flen > UINT32_MAX) {
+            free(frame);
+            close(fd);
+            return -1;
+        }
+        char seg[PATH_MAX + 16];
+        segment_path(seg, sizeof(seg), dir, hdr.segment);
+        int sfd = open(seg, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+        struct stat sst;
+        if (sfd >= 0 && fstat(sfd, &sst) == 0 && sst.st_size >= HISTORY_SEGMENT_BYTES) {
+            close(sfd);
+            hdr.segment++;
+            segment_path(seg, sizeof(seg), dir, hdr.segment);
+            sfd = open(seg, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+            sst.st_size = 0;
+        }
+        int ok = sfd >= 0 && write_all_at(sfd, frame, flen, sst.st_size) == 0 && fdatasync(sfd) == 0;
+        if (sfd >= 0) close(sfd);
+        free(frame);
+        if (!ok) {
+            close(fd);
+            return -1;
+        }
+        rec->segment = hdr.segment;
+        rec->offset = (uint64_t)sst.st_size;
+        rec->stored = (uint32_t)flen;
+    }
+
+    // Times only grow so ranges can be searched; a clock set back files the report at
+    // the time of the one before
+    if (have_last && rec->time < last.time) rec->time = last.time;
+    rec->id = hdr.next_id++;
+    int rc = write_all_at(fd, rec, sizeof(*rec), end) == 0 && write_all_at(fd, &hdr, sizeof(hdr), 0) == 0 &&
+             fdatasync(fd) == 0 ? 0 : -1;
+    close(fd);
+    return rc;
+}
+
+// Drop what is too old or does not fit from the front. Called with the store locked.
+static void prune(const char *dir, int64_t now) {
+    HistoryIndex idx;
+    if (index_open(dir, &idx) != 0 || !idx.map) return;
+
+    // Whole segments go, oldest first, until the store fits; never the one in use
+    uint32_t newest = idx.hdr->segment;
+    size_t nsegs;
+    Segment *segs = list_segments(dir, &nsegs);
+    uint64_t total = idx.size;
+    for (size_t i = 0; i < nsegs; ++i) total += segs[i].size;
+    uint32_t drop_below = 0;
+    for (size_t i = 0; i < nsegs && segs[i].number < newest && total > HISTORY_MAX_BYTES; ++i) {
+        total -= segs[i].size;
+        drop_below = segs[i].number + 1;
+    }
+
+    // Records are in time and segment order, so what goes is a prefix
+    int64_t cutoff = now - (int64_t)HISTORY_MAX_AGE_DAYS * 86400;
+    size_t keep_from = 0;
+    while (keep_from < idx.count &&
+           (idx.records[keep_from].time < cutoff || idx.records[keep_from].segment < drop_below)) {
+        keep_from++;
+    }
+    HistoryHeader hdr = *idx.hdr;
+    uint32_t keep_segments = keep_from < idx.count ? idx.records[keep_from].segment : newest;
+    if (keep_from > 0) {
+        if (keep_from == idx.count) {
+            // Nothing left: start over in a fresh segment so the current one can go too
+            hdr.segment++;
+            keep_segments = hdr.segment;
+        }
+        char tmp[PATH_MAX + 16], path[PATH_MAX + 16];
+        snprintf(tmp, sizeof(tmp), "%s/.index-XXXXXX", dir);
+        snprintf(path, sizeof(path), "%s/index", dir);
+        int fd = mkstemp(tmp);
+        if (fd < 0) {
+            free(segs);
+            index_close(&idx);
+            return;
+        }
+        int ok = write_all_at(fd, &hdr, sizeof(hdr), 0) == 0 &&
+                 write_all_at(fd, idx.records + keep_from, (idx.count - keep_from) * sizeof(HistoryRecord),
+                              sizeof(hdr)) == 0 &&
+                 fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmp, path) != 0) {
+            unlink(tmp);
+            free(segs);
+            index_close(&idx);
+            return;
+        }
+        int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+        if (dfd >= 0) {
+            fsync(dfd);
+            close(dfd);
+        }
+    }
+    index_close(&idx);
+
+    // Only once the index no longer points into them
+    for (size_t i = 0; i < nsegs && segs[i].number < keep_segments; ++i) {
+        char seg[PATH_MAX + 16];
+        segment_path(seg, sizeof(seg), dir, segs[i].number);
+        unlink(seg);
+    }
+    free(segs);
+}
+
+int history_add(const char *hostname, const char *text, size_t len, const SeverityReport *sev, const Fingerprint *fp) {
+    char dir[PATH_MAX];
+    if (len > HISTORY_MAX_TEXT || state_dir("history", dir, sizeof(dir)) != 0) return -1;
+
+    HistoryRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.time = (int64_t)time(NULL);
+    rec.hash = fnv1a(text, len);
+    rec.length = (uint32_t)len;
+    for (int s = SEVERITY_WARNING; s < SEVERITY_LEVELS; ++s) {
+        size_t n = sev ? sev->counts[s] : 0;
+        rec.counts[s - SEVERITY_WARNING] = n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+    }
+    sd_id128_t boot;
+    if (sd_id128_get_boot(&boot) == 0) memcpy(rec.boot_id, boot.bytes, sizeof(rec.boot_id));
+    if (fp && fp->id[0]) parse_hex16(fp->id + strlen(FINGERPRINT_PREFIX), rec.fingerprint);
+    snprintf(rec.hostname, sizeof(rec.hostname), "%s", hostname ? hostname : "");
+
+    int lock = lock_store(dir, LOCK_EX);
+    int rc = append_report(dir, &rec, text, len);
+    if (rc == 0) prune(dir, rec.time);
+    if (lock >= 0) close(lock);
+    if (rc != 0) fprintf(stderr, "Could not add the report to the history in %s\n", dir);
+    return rc;
+}
+
+/* ---- Queries ---- */
+
+typedef struct {
+    int has_boot, has_fp;
+    uint8_t boot[16], fp[16];
+} QueryKeys;
+
+static int query_keys(const HistoryQuery *q, QueryKeys *k) {
+    memset(k, 0, sizeof(*k));
+    if (q->boot_id) {
+        if (parse_hex16(q->boot_id, k->boot) != 0) {
+            fprintf(stderr, "Not a boot ID: %s\n", q->boot_id);
+            return -1;
+        }
+        k->has_boot = 1;
+    }
+    if (q->fingerprint) {
+        size_t pl = strlen(FINGERPRINT_PREFIX);
+        if (strncmp(q->fingerprint, FINGERPRINT_PREFIX, pl) != 0 || parse_hex16(q->fingerprint + pl, k->fp) != 0) {
+            fprintf(stderr, "Not a fingerprint: %s\n", q->fingerprint);
+            return -1;
+        }
+        k->has_fp = 1;
+    }
+    return 0;
+}
+
+// First record at or after t
+static size_t lower_bound(const HistoryIndex *idx, int64_t t) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->records[mid].time < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Calls fn for each record matching q, in order
+static void for_each_match(const HistoryIndex *idx, const HistoryQuery *q, const QueryKeys *k,
+                           void (*fn)(const HistoryRecord *rec, void *user), void *user) {
+    for (size_t i = q->since ? lower_bound(idx, q->since) : 0; i < idx->count; ++i) {
+        const HistoryRecord *r = &idx->records[i];
+        if (q->until && r->time >= q->until) break;
+        if (q->hostname && strncmp(r->hostname, q->hostname, sizeof(r->hostname)) != 0) continue;
+        if (k->has_boot && memcmp(r->boot_id, k->boot, sizeof(k->boot)) != 0) continue;
+        if (k->has_fp && memcmp(r->fingerprint, k->fp, sizeof(k->fp)) != 0) continue;
+        fn(r, user);
+    }
+}
+
+static void to_entry(const HistoryRecord *r, HistoryEntry *e) {
+    memset(e, 0, sizeof(*e));
+    e->id = r->id;
+    e->time = r->time;
+    snprintf(e->hostname, sizeof(e->hostname), "%.*s", (int)sizeof(r->hostname) - 1, r->hostname);
+    format_hex16(r->boot_id, e->boot_id);
+    if (!is_zero16(r->fingerprint)) {
+        memcpy(e->fingerprint, FINGERPRINT_PREFIX, strlen(FINGERPRINT_PREFIX));
+        format_hex16(r->fingerprint, e->fingerprint + strlen(FINGERPRINT_PREFIX));
+    }
+    for (int s = SEVERITY_WARNING; s < SEVERITY_LEVELS; ++s) e->counts[s] = r->counts[s - SEVERITY_WARNING];
+    e->length = r->length;
+    e->stored = r->stored;
+}
+
+typedef struct {
+    const HistoryRecord **records;
+    size_t count;
+} MatchList;
+
+static void collect_match(const HistoryRecord *rec, void *user) {
+    MatchList *m = user;
+    m->records[m->count++] = rec;
+}
+
+// Pointers to the records matching q, into the mapping
+static int find_records(const HistoryIndex *idx, const HistoryQuery *q, MatchList *m) {
+    QueryKeys k;
+    m->records = NULL;
+    m->count = 0;
+    if (query_keys(q, &k) != 0) return -1;
+    if (idx->count == 0) return 0;
+    m->records = malloc(idx->count * sizeof(*m->records));
+    if (!m->records) return -1;
+    for_each_match(idx, q, &k, collect_match, m);
+    return 0;
+}
+
+int history_find(const HistoryQuery *q, HistoryEntry **out, size_t *count) {
+    *out = NULL;
+    *count = 0;
+    HistoryIndex idx;
+    if (index_open_shared(&idx) != 0) return -1;
+    MatchList m;
+    int rc = find_records(&idx, q, &m);
+    if (rc == 0 && m.count > 0) {
+        *out = malloc(m.count * sizeof(HistoryEntry));
+        if (*out) {
+            for (size_t i = 0; i < m.count; ++i) to_entry(m.records[i], &(*out)[i]);
+            *count = m.count;
+        } else {
+            rc = -1;
+        }
+    }
+    free(m.records);
+    index_close(&idx);
+    return rc;
+}
+
+static int by_fingerprint_boot(const void *a, const void *b) {
+    const HistoryRecord *x = *(const HistoryRecord *const *)a, *y = *(const HistoryRecord *const *)b;
+    int c = memcmp(x->fingerprint, y->fingerprint, sizeof(x->fingerprint));
+    return c ? c : memcmp(x->boot_id, y->boot_id, sizeof(x->boot_id));
+}
+
+static int by_hostname(const void *a, const void *b) {
+    const HistoryRecord *x = *(const HistoryRecord *const *)a, *y = *(const HistoryRecord *const *)b;
+    return strncmp(x->hostname, y->hostname, sizeof(x->hostname));
+}
+
+static int by_occurrences(const void *a, const void *b) {
+    const HistoryProblem *x = a, *y = b;
+    if (x->occurrences != y->occurrences) return x->occurrences > y->occurrences ? -1 : 1;
+    return x->last_seen > y->last_seen ? -1 : x->last_seen < y->last_seen;
+}
+
+int history_recurring(const HistoryQuery *q, size_t min_count, HistoryProblem **out, size_t *count) {
+    *out = NULL;
+    *count = 0;
+    HistoryIndex idx;
+    if (index_open_shared(&idx) != 0) return -1;
+    MatchList m;
+    int rc = find_records(&idx, q, &m);
+
+    // Reports without a fingerprint had nothing worth filing
+    size_t n = 0;
+    for (size_t i = 0; i < m.count; ++i) {
+        if (!is_zero16(m.records[i]->fingerprint)) m.records[n++] = m.records[i];
+    }
+    if (rc == 0 && n > 0) qsort(m.records, n, sizeof(*m.records), by_fingerprint_boot);
+
+    HistoryProblem *problems = NULL;
+    size_t nproblems = 0, cap = 0;
+    for (size_t i = 0; rc == 0 && i < n;) {
+        size_t j = i + 1;
+        while (j < n && memcmp(m.records[j]->fingerprint, m.records[i]->fingerprint, 16) == 0) j++;
+        if (j - i < (min_count ? min_count : 1)) {
+            i = j;
+            continue;
+        }
+        if (nproblems == cap) {
+            size_t c = cap ? cap * 2 : 16;
+            HistoryProblem *p = realloc(problems, c * sizeof(HistoryProblem));
+            if (!p) {
+                rc = -1;
+                break;
+            }
+            problems = p;
+            cap = c;
+        }
+        HistoryProblem *p = &problems[nproblems++];
+        memset(p, 0, sizeof(*p));
+        HistoryEntry e;
+        to_entry(m.records[i], &e);
+        memcpy(p->fingerprint, e.fingerprint, sizeof(p->fingerprint));
+        p->occurrences = j - i;
+        p->first_seen = m.records[i]->time;
+        for (size_t k = i; k < j; ++k) {
+            const HistoryRecord *r = m.records[k];
+            if (k == i || memcmp(r->boot_id, m.records[k - 1]->boot_id, sizeof(r->boot_id)) != 0) p->boots++;
+            if (r->time < p->first_seen) p->first_seen = r->time;
+            if (r->time >= p->last_seen) p->last_seen = r->time;
+            if (r->id > p->last_id) p->last_id = r->id;
+        }
+        qsort(m.records + i, j - i, sizeof(*m.records), by_hostname);
+        for (size_t k = i; k < j; ++k) {
+            if (k == i || by_hostname(&m.records[k], &m.records[k - 1]) != 0) p->hosts++;
+        }
+        i = j;
+    }
+    free(m.records);
+    index_close(&idx);
+    if (rc != 0) {
+        free(problems);
+        return -1;
+    }
+    if (nproblems > 0) qsort(problems, nproblems, sizeof(HistoryProblem), by_occurrences);
+    *out = problems;
+    *count = nproblems;
+    return 0;
+}
+
+char* history_read(uint64_t id, size_t *len, HistoryEntry *entry) {
+    char dir[PATH_MAX];
+    if (state_dir("history", dir, sizeof(dir)) != 0) return NULL;
+    HistoryIndex idx;
+    if (index_open_shared(&idx) != 0) return NULL;
+    // Ids grow with the position
+    size_t lo = 0, hi = idx.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx.records[mid].id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == idx.count || idx.records[lo].id != id) {
+        index_close(&idx);
+        return NULL;
+    }
+    HistoryRecord rec = idx.records[lo];
+    index_close(&idx);
+    if (entry) to_entry(&rec, entry);
+    if (rec.length > HISTORY_MAX_TEXT) return NULL;
+
+    char seg[PATH_MAX + 16];
+    segment_path(seg, sizeof(seg), dir, rec.segment);
+    int fd = open(seg, O_RDONLY | O_CLOEXEC);
+    char *frame = fd >= 0 ? malloc(rec.stored ? rec.stored : 1) : NULL;
+    char *text = frame ? malloc((size_t)rec.length + 1) : NULL;
+    int ok = text && read_all_at(fd, frame, rec.stored, (off_t)rec.offset) == 0;
+    if (ok) {
+        size_t n = ZSTD_decompress(text, rec.length, frame, rec.stored);
+        ok = !ZSTD_isError(n) && n == rec.length && fnv1a(text, n) == rec.hash;
+    }
+    if (fd >= 0) close(fd);
+    free(frame);
+    if (!ok) {
+        fprintf(stderr, "Report %llu in the history is damaged or was removed\n", (unsigned long long)id);
+        free(text);
+        return NULL;
+    }
+    text[rec.length] = '\0';
+    if (len) *len = rec.length;
+    return text;
+}
@@ -0,0 +1,63 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "severity.h"
+#include "fingerprint.h"
+
+// Local report history in $XDG_STATE_HOME/crash-reporter/history (~/.local/state by
+// default). Every report that is built is appended, compressed, to a data segment, and a
+// fixed-size record for it to an index: when, which host and boot, the fingerprint and
+// the severity counts. Queries read the index only; a report is decompressed when it is
+// asked for by ID. Old segments are removed to keep the store within HISTORY_MAX_BYTES
+// and HISTORY_MAX_AGE_DAYS (config.h).
+
+#define HISTORY_HOST_SIZE 64
+
+typedef struct {
+    uint64_t id;             // assigned in order, never reused
+    int64_t time;            // seconds since the epoch
+    char hostname[HISTORY_HOST_SIZE];
+    char boot_id[33];        // 32 hex digits
+    char fingerprint[FINGERPRINT_ID_SIZE]; // empty when the report had nothing worth filing
+    size_t counts[SEVERITY_LEVELS];
+    size_t length;           // report text
+    size_t stored;           // compressed
+} HistoryEntry;
+
+// Every field is optional: 0 or NULL matches anything
+typedef struct {
+    int64_t since;           // at or after
+    int64_t until;           // before
+    const char *hostname;
+    const char *boot_id;     // 32 hex digits
+    const char *fingerprint;
+} HistoryQuery;
+
+typedef struct {
+    char fingerprint[FINGERPRINT_ID_SIZE];
+    size_t occurrences;
+    size_t boots;            // distinct boots it was seen in
+    size_t hosts;
+    int64_t first_seen, last_seen;
+    uint64_t last_id;        // the newest report with it
+} HistoryProblem;
+
+// Record a report. fp may be NULL or without an id. Returns 0, or -1 when the store is not
+// writable (the report itself is not affected).
+int history_add(const char *hostname, const char *text, size_t len, const SeverityReport *sev, const Fingerprint *fp);
+
+// Reports matching q, oldest first, as an array the caller frees. Returns 0 (count may be
+// 0, *out NULL), or -1 when the index cannot be read.
+int history_find(const HistoryQuery *q, HistoryEntry **out, size_t *count);
+
+// Fingerprints of the reports matching q seen at least min_count times, most frequent
+// first. Same return convention as history_find().
+int history_recurring(const HistoryQuery *q, size_t min_count, HistoryProblem **out, size_t *count);
+
+// The text of report id (caller frees), with its entry when entry is not NULL. NULL when
+// there is no such report or its data cannot be read.
+char* history_read(uint64_t id, size_t *len, HistoryEntry *entry);
+
+#endif // HISTORY_H
@@ -0,0 +1,358 @@
+/* Asynchronous HTTP client
+ * One curl multi handle per GLib main context. curl tells us which sockets to watch
+ * and when to wake up (CURLMOPT_SOCKETFUNCTION / CURLMOPT_TIMERFUNCTION); the main
+ * context watches them and drives curl_multi_socket_action() from its callbacks.
+ * Each multi handle keeps its own connection cache; DNS results, TLS sessions and
+ * cookies live in one process-wide share handle, so even a new connection skips the
+ * lookup and resumes the TLS session.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "http.h"
+
+typedef struct HttpLoop {
+    GMainContext *ctx;
+    CURLM *multi;
+    GSource *timer;
+    HttpRequest *requests;   // in flight on this context
+    struct HttpLoop *next;
+} HttpLoop;
+
+struct HttpRequest {
+    HttpLoop *loop;
+    CURL *easy;
+    struct curl_slist *headers;
+    HttpResponse resp;
+    size_t body_cap;
+    char *post;              // POST body taken over from the caller
+    char errbuf[CURL_ERROR_SIZE];
+    HttpDoneFn on_done;
+    HttpProgressFn on_progress;
+    HttpDataFn on_data;
+    void *user;
+    HttpRequest *next;
+};
+
+typedef struct {
+    GSource *source;
+    curl_socket_t fd;
+    HttpLoop *loop;
+} SocketWatch;
+
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t loops_lock = PTHREAD_MUTEX_INITIALIZER;
+static HttpLoop *loops = NULL;
+
+// Process-wide share handle; requests on different threads use it concurrently
+static CURLSH *share = NULL;
+static pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userp) {
+    (void)handle;
+    (void)access;
+    (void)userp;
+    pthread_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userp) {
+    (void)handle;
+    (void)userp;
+    pthread_mutex_unlock(&share_locks[data]);
+}
+
+static void init_curl(void) {
+    curl_global_init(CURL_GLOBAL_ALL);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; ++i) pthread_mutex_init(&share_locks[i], NULL);
+    share = curl_share_init();
+    if (share) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+    }
+}
+
+static void check_completed(HttpLoop *loop);
+
+static gboolean on_socket_event(GIOChannel *ch, GIOCondition cond, gpointer data) {
+    (void)ch;
+    SocketWatch *w = data;
+    // The watch may be freed by socket_cb during the action below
+    HttpLoop *loop = w->loop;
+    curl_socket_t fd = w->fd;
+    int ev = 0;
+    if (cond & G_IO_IN) ev |= CURL_CSELECT_IN;
+    if (cond & G_IO_OUT) ev |= CURL_CSELECT_OUT;
+    if (cond & (G_IO_ERR | G_IO_HUP)) ev |= CURL_CSELECT_ERR;
+    int running = 0;
+    curl_multi_socket_action(loop->multi, fd, ev, &running);
+    check_completed(loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static int socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+    (void)easy;
+    HttpLoop *loop = userp;
+    SocketWatch *w = socketp;
+    if (w) {
+        g_source_destroy(w->source);
+        g_source_unref(w->source);
+        w->source = NULL;
+    }
+    if (what == CURL_POLL_REMOVE) {
+        g_free(w);
+        return 0;
+    }
+    if (!w) {
+        w = g_new0(SocketWatch, 1);
+        w->fd = s;
+        w->loop = loop;
+        curl_multi_assign(loop->multi, s, w);
+    }
+    GIOCondition cond = 0;
+    if (what & CURL_POLL_IN) cond |= G_IO_IN | G_IO_HUP | G_IO_ERR;
+    if (what & CURL_POLL_OUT) cond |= G_IO_OUT | G_IO_ERR;
+    GIOChannel *ch = g_io_channel_unix_new(s);
+    w->source = g_io_create_watch(ch, cond);
+    g_io_channel_unref(ch);
+    g_source_set_callback(w->source, (GSourceFunc)(void (*)(void))on_socket_event, w, NULL);
+    g_source_attach(w->source, loop->ctx);
+    return 0;
+}
+
+static gboolean on_timer(gpointer data) {
+    HttpLoop *loop = data;
+    GSource *self = loop->timer;
+    loop->timer = NULL; // timer_cb may install a new one during the action
+    int running = 0;
+    curl_multi_socket_action(loop->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_completed(loop);
+    if (self) g_source_unref(self);
+    return G_SOURCE_REMOVE;
+}
+
+static int timer_cb(CURLM *multi, long timeout_ms, void *userp) {
+    (void)multi;
+    HttpLoop *loop = userp;
+    if (loop->timer) {
+        g_source_destroy(loop->timer);
+        g_source_unref(loop->timer);
+        loop->timer = NULL;
+    }
+    if (timeout_ms >= 0) {
+        loop->timer = g_timeout_source_new((guint)timeout_ms);
+        g_source_set_callback(loop->timer, on_timer, loop, NULL);
+        g_source_attach(loop->timer, loop->ctx);
+    }
+    return 0;
+}
+
+// Find or create the multi handle for the calling thread's default main context
+static HttpLoop* loop_for_thread(void) {
+    GMainContext *ctx = g_main_context_ref_thread_default();
+    pthread_mutex_lock(&loops_lock);
+    HttpLoop *loop = loops;
+    while (loop && loop->ctx != ctx) loop = loop->next;
+    if (!loop) {
+        loop = g_new0(HttpLoop, 1);
+        loop->ctx = ctx;
+        ctx = NULL; // reference now owned by the loop
+        loop->multi = curl_multi_init();
+        curl_multi_setopt(loop->multi, CURLMOPT_SOCKETFUNCTION, socket_cb);
+        curl_multi_setopt(loop->multi, CURLMOPT_SOCKETDATA, loop);
+        curl_multi_setopt(loop->multi, CURLMOPT_TIMERFUNCTION, timer_cb);
+        curl_multi_setopt(loop->multi, CURLMOPT_TIMERDATA, loop);
+        // Requests to the same host share one HTTP/2 connection when the server offers it
+        curl_multi_setopt(loop->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        loop->next = loops;
+        loops = loop;
+    }
+    pthread_mutex_unlock(&loops_lock);
+    if (ctx) g_main_context_unref(ctx);
+    return loop;
+}
+
+static size_t write_cb(char *data, size_t size, size_t nmemb, void *userp) {
+    HttpRequest *req = userp;
+    size_t n = size * nmemb;
+    if (req->on_data) return req->on_data(data, n, req->user) == 0 ? n : 0;
+    HttpResponse *r = &req->resp;
+    if (r->body_len + n + 1 > req->body_cap) {
+        size_t cap = req->body_cap ? req->body_cap * 2 : 16384;
+        while (cap < r->body_len + n + 1) cap *= 2;
+        char *p = realloc(r->body, cap);
+        if (!p) return 0; // aborts the transfer with CURLE_WRITE_ERROR
+        r->body = p;
+        req->body_cap = cap;
+    }
+    memcpy(r->body + r->body_len, data, n);
+    r->body_len += n;
+    r->body[r->body_len] = '\0';
+    return n;
+}
+
+static int xferinfo_cb(void *userp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    HttpRequest *req = userp;
+    req->on_progress((double)dlnow, (double)dltotal, (double)ulnow, (double)ultotal, req->user);
+    return 0;
+}
+
+static void finish_request(HttpRequest *req, CURLcode result, int cancelled) {
+    HttpLoop *loop = req->loop;
+    curl_multi_remove_handle(loop->multi, req->easy);
+    for (HttpRequest **pp = &loop->requests; *pp; pp = &(*pp)->next) {
+        if (*pp == req) {
+            *pp = req->next;
+            break;
+        }
+    }
+
+    HttpResponse *r = &req->resp;
+    curl_easy_getinfo(req->easy, CURLINFO_RESPONSE_CODE, &r->status);
+    r->result = result;
+    r->cancelled = cancelled;
+    r->timed_out = result == CURLE_OPERATION_TIMEDOUT;
+    if (cancelled) {
+        snprintf(r->error, sizeof(r->error), "Request cancelled");
+    } else if (result != CURLE_OK) {
+        snprintf(r->error, sizeof(r->error), "%s", req->errbuf[0] ? req->errbuf : curl_easy_strerror(result));
+    }
+    if (!r->body) {
+        r->body = calloc(1, 1);
+        r->body_len = 0;
+    }
+
+    if (req->on_done) req->on_done(r, req->user);
+
+    curl_easy_cleanup(req->easy);
+    curl_slist_free_all(req->headers);
+    free(req->post);
+    free(r->body);
+    free(req);
+}
+
+static void check_completed(HttpLoop *loop) {
+    CURLMsg *msg;
+    int left = 0;
+    while ((msg = curl_multi_info_read(loop->multi, &left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        HttpRequest *req = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+        if (req) finish_request(req, msg->data.result, 0);
+    }
+}
+
+HttpRequest* http_request_start(const HttpRequestOptions *opts) {
+    pthread_once(&curl_once, init_curl);
+
+    char *taken = opts->take_body ? (char *)opts->body : NULL;
+    HttpRequest *req = calloc(1, sizeof(HttpRequest));
+    if (!req) {
+        free(taken);
+        return NULL;
+    }
+    req->post = taken;
+    req->easy = curl_easy_init();
+    if (!req->easy) {
+        free(req->post);
+        free(req);
+        return NULL;
+    }
+    req->on_done = opts->on_done;
+    req->on_progress = opts->on_progress;
+    req->on_data = opts->on_data;
+    req->user = opts->user;
+
+    CURL *e = req->easy;
+    curl_easy_setopt(e, CURLOPT_URL, opts->url);
+    curl_easy_setopt(e, CURLOPT_PRIVATE, req);
+    curl_easy_setopt(e, CURLOPT_ERRORBUFFER, req->errbuf);
+    curl_easy_setopt(e, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(e, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    // Wait for a connection that is still being set up rather than opening a parallel one
+    curl_easy_setopt(e, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(e, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(e, CURLOPT_COOKIEFILE, ""); // cookie engine on, no file
+    if (share) curl_easy_setopt(e, CURLOPT_SHARE, share);
+    curl_easy_setopt(e, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(e, CURLOPT_WRITEDATA, req);
+    curl_easy_setopt(e, CURLOPT_TIMEOUT_MS, opts->timeout_ms > 0 ? opts->timeout_ms : HTTP_DEFAULT_TIMEOUT_MS);
+    curl_easy_setopt(e, CURLOPT_CONNECTTIMEOUT_MS,
+                     opts->connect_timeout_ms > 0 ? opts->connect_timeout_ms : HTTP_DEFAULT_CONNECT_TIMEOUT_MS);
+    if (opts->headers) {
+        for (const char *const *h = opts->headers; *h; ++h) {
+            req->headers = curl_slist_append(req->headers, *h);
+        }
+        curl_easy_setopt(e, CURLOPT_HTTPHEADER, req->headers);
+    }
+    if (opts->body) {
+        curl_easy_setopt(e, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)opts->body_len);
+        if (req->post) {
+            curl_easy_setopt(e, CURLOPT_POSTFIELDS, req->post);
+        } else {
+            curl_easy_setopt(e, CURLOPT_COPYPOSTFIELDS, opts->body);
+        }
+    }
+    if (opts->on_progress) {
+        curl_easy_setopt(e, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(e, CURLOPT_XFERINFOFUNCTION, xferinfo_cb);
+        curl_easy_setopt(e, CURLOPT_XFERINFODATA, req);
+    }
+
+    HttpLoop *loop = loop_for_thread();
+    req->loop = loop;
+    req->next = loop->requests;
+    loop->requests = req;
+    if (curl_multi_add_handle(loop->multi, e) != CURLM_OK) {
+        loop->requests = req->next;
+        curl_easy_cleanup(e);
+        curl_slist_free_all(req->headers);
+        free(req->post);
+        free(req);
+        return NULL;
+    }
+    return req;
+}
+
+void http_request_cancel(HttpRequest *req) {
+    if (req) finish_request(req, CURLE_ABORTED_BY_CALLBACK, 1);
+}
+
+void http_context_release(GMainContext *ctx) {
+    pthread_mutex_lock(&loops_lock);
+    HttpLoop **pp = &loops;
+    while (*pp && (*pp)->ctx != ctx) pp = &(*pp)->next;
+    HttpLoop *loop = *pp;
+    if (loop) *pp = loop->next;
+    pthread_mutex_unlock(&loops_lock);
+    if (!loop) return;
+
+    while (loop->requests) http_request_cancel(loop->requests);
+    curl_multi_cleanup(loop->multi);
+    if (loop->timer) {
+        g_source_destroy(loop->timer);
+        g_source_unref(loop->timer);
+    }
+    g_main_context_unref(loop->ctx);
+    g_free(loop);
+}
+
+void http_cleanup(void) {
+    for (;;) {
+        pthread_mutex_lock(&loops_lock);
+        GMainContext *ctx = loops ? loops->ctx : NULL;
+        pthread_mutex_unlock(&loops_lock);
+        if (!ctx) break;
+        http_context_release(ctx);
+    }
+    if (share) {
+        curl_share_cleanup(share);
+        share = NULL;
+        curl_global_cleanup();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <stddef.h>
+#include <glib.h>
+
+// Asynchronous HTTP on top of the curl multi interface. Sockets and timers are watched
+// by the GLib main context that is the thread default when a request starts (the GTK
+// main loop in the GUI), so nothing blocks while a request is in flight.
+
+typedef struct HttpRequest HttpRequest;
+
+typedef struct {
+    long status;          // HTTP status code, 0 if no response arrived
+    int result;           // CURLcode of the transfer
+    int cancelled;        // http_request_cancel() was called
+    int timed_out;
+    char *body;           // response body, NUL-terminated (never NULL in callbacks; empty with on_data)
+    size_t body_len;
+    char error[256];      // human readable error, empty on success
+} HttpResponse;
+
+// Called once when the request finished, failed, timed out or was cancelled.
+// resp is only valid during the call.
+typedef void (*HttpDoneFn)(const HttpResponse *resp, void *user);
+// Transfer progress in bytes; totals are 0 while unknown.
+typedef void (*HttpProgressFn)(double dl_now, double dl_total, double ul_now, double ul_total, void *user);
+// Streaming receiver: gets the body chunk by chunk instead of it being collected into
+// HttpResponse.body. Return nonzero to abort the transfer.
+typedef int (*HttpDataFn)(const char *data, size_t len, void *user);
+
+typedef struct {
+    const char *url;
+    const char *const *headers;   // NULL-terminated "Name: value" lines, may be NULL
+    const char *body;             // POST body (copied unless take_body); NULL for GET
+    size_t body_len;
+    int take_body;                // body is malloc'd and now belongs to the request: sent
+                                  // without a copy, freed when done (or if it cannot start)
+    long timeout_ms;              // whole transfer, 0 = HTTP_DEFAULT_TIMEOUT_MS
+    long connect_timeout_ms;      // 0 = HTTP_DEFAULT_CONNECT_TIMEOUT_MS
+    HttpDoneFn on_done;
+    HttpProgressFn on_progress;   // may be NULL
+    HttpDataFn on_data;           // may be NULL
+    void *user;
+} HttpRequestOptions;
+
+#define HTTP_DEFAULT_TIMEOUT_MS (120 * 1000)
+#define HTTP_DEFAULT_CONNECT_TIMEOUT_MS (15 * 1000)
+
+// Start a request on the thread-default main context. Returns a handle usable with
+// http_request_cancel() until on_done has run, or NULL if the request could not be
+// started (on_done is not called then).
+HttpRequest* http_request_start(const HttpRequestOptions *opts);
+
+// Abort a request; on_done runs right away with cancelled set. Call it from the thread
+// that owns the request's main context, and not from within the request's own callbacks.
+void http_request_cancel(HttpRequest *req);
+
+// Release the transfer state (including open connections) kept for a main context once
+// nothing runs on it any more.
+void http_context_release(GMainContext *ctx);
+
+// Cancel whatever is left, close all connections and shut curl down. Call once at exit
+// from the main thread, after the other threads stopped making requests.
+void http_cleanup(void);
+
+#endif // HTTP_H
@@ -0,0 +1,236 @@
+/* Native journal reader
+ * Uses the sd-journal API with PRIORITY/_BOOT_ID matches instead of spawning
+ * journalctl and parsing its text output.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <grp.h>
+#include <systemd/sd-journal.h>
+#include <systemd/sd-id128.h>
+#include "journal.h"
+#include "helper.h"
+#include "collector.h"
+
+static const char *priority_names[8] = {"emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"};
+
+int journal_system_readable(void) {
+    if (geteuid() == 0) return 1;
+
+    // journald grants read ACLs on system journal files to these groups
+    const char *groups[] = {"systemd-journal", "adm", "wheel", NULL};
+    gid_t list[256];
+    int n = getgroups(sizeof(list) / sizeof(list[0]), list);
+    for (int g = 0; groups[g]; ++g) {
+        struct group *gr = getgrnam(groups[g]);
+        if (!gr) continue;
+        if (getegid() == gr->gr_gid) return 1;
+        for (int i = 0; i < n; ++i) {
+            if (list[i] == gr->gr_gid) return 1;
+        }
+    }
+    return 0;
+}
+
+const char* journal_field(sd_journal *j, const char *field, size_t *len) {
+    const void *data;
+    size_t n;
+    if (sd_journal_get_data(j, field, &data, &n) < 0) return NULL;
+    size_t prefix = strlen(field) + 1; // "FIELD="
+    if (n < prefix) return NULL;
+    *len = n - prefix;
+    return (const char *)data + prefix;
+}
+
+char* journal_get_field(sd_journal *j, const char *field) {
+    size_t len;
+    const char *value = journal_field(j, field, &len);
+    return value ? strndup(value, len) : NULL;
+}
+
+// Read the current entry into the next slot of out, growing it up to max_entries
+static int read_entry(sd_journal *j, size_t max_entries, JournalEntries *out) {
+    if (out->count == out->cap) {
+        size_t newcap = out->cap ? out->cap * 2 : 16;
+        if (newcap > max_entries) newcap = max_entries;
+        JournalEntry *n = realloc(out->entries, newcap * sizeof(JournalEntry));
+        if (!n) return -1;
+        out->entries = n;
+        out->cap = newcap;
+    }
+    JournalEntry *e = &out->entries[out->count];
+    memset(e, 0, sizeof(*e));
+    sd_journal_get_realtime_usec(j, &e->realtime_usec);
+    char *prio = journal_get_field(j, "PRIORITY");
+    e->priority = prio ? atoi(prio) : 6;
+    free(prio);
+    e->unit = journal_get_field(j, "_SYSTEMD_UNIT");
+    if (!e->unit) e->unit = journal_get_field(j, "SYSLOG_IDENTIFIER");
+    if (!e->unit) e->unit = journal_get_field(j, "_COMM");
+    e->message = journal_get_field(j, "MESSAGE");
+    out->count++;
+    return 0;
+}
+
+static void reverse_entries(JournalEntries *out) {
+    for (size_t a = 0, b = out->count ? out->count - 1 : 0; a < b; ++a, --b) {
+        JournalEntry tmp = out->entries[a];
+        out->entries[a] = out->entries[b];
+        out->entries[b] = tmp;
+    }
+}
+
+int journal_collect(int max_priority, int this_boot_only, size_t max_entries, const int *cancel, JournalEntries *out) {
+    memset(out, 0, sizeof(*out));
+
+    sd_journal *j = NULL;
+    int r = sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM);
+    if (r < 0) {
+        fprintf(stderr, "Failed to open journal: %s\n", strerror(-r));
+        return -1;
+    }
+
+    // Matches on the same field are OR'ed, different fields are AND'ed
+    char match[64];
+    for (int p = 0; p <= max_priority && p < 8; ++p) {
+        snprintf(match, sizeof(match), "PRIORITY=%d", p);
+        sd_journal_add_match(j, match, 0);
+    }
+    if (this_boot_only) {
+        sd_id128_t boot;
+        if (sd_id128_get_boot(&boot) == 0) {
+            char id[SD_ID128_STRING_MAX];
+            snprintf(match, sizeof(match), "_BOOT_ID=%s", sd_id128_to_string(boot, id));
+            sd_journal_add_match(j, match, 0);
+        }
+    }
+
+    // Walk backwards from the tail so the newest entries are the ones kept
+    sd_journal_seek_tail(j);
+    while (out->count < max_entries && !collector_cancel_requested(cancel) && sd_journal_previous(j) > 0) {
+        if (read_entry(j, max_entries, out) != 0) break;
+    }
+    sd_journal_close(j);
+    if (collector_cancel_requested(cancel)) {
+        journal_entries_free(out);
+        return -1;
+    }
+
+    // Restore chronological order
+    reverse_entries(out);
+    return 0;
+}
+
+int journal_collect_units(const char *const *units, size_t n, size_t max_per_unit, const int *cancel,
+                          JournalEntries *out) {
+    memset(out, 0, n * sizeof(JournalEntries));
+    sd_journal *j = NULL;
+    int r = sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM);
+    if (r < 0) {
+        fprintf(stderr, "Failed to open journal: %s\n", strerror(-r));
+        return -1;
+    }
+    char match[512];
+    for (size_t i = 0; i < n && !collector_cancel_requested(cancel); ++i) {
+        sd_journal_flush_matches(j);
+        snprintf(match, sizeof(match), "_SYSTEMD_UNIT=%s", units[i]);
+        sd_journal_add_match(j, match, 0);
+        sd_journal_add_disjunction(j);
+        snprintf(match, sizeof(match), "UNIT=%s", units[i]);
+        sd_journal_add_match(j, match, 0);
+        sd_journal_seek_tail(j);
+        while (out[i].count < max_per_unit && sd_journal_previous(j) > 0) {
+            if (read_entry(j, max_per_unit, &out[i]) != 0) break;
+        }
+        reverse_entries(&out[i]);
+    }
+    sd_journal_close(j);
+    if (collector_cancel_requested(cancel)) {
+        for (size_t i = 0; i < n; ++i) journal_entries_free(&out[i]);
+        return -1;
+    }
+    return 0;
+}
+
+char* journal_format_entries(const JournalEntries *entries, size_t *out_len) {
+    size_t cap = 4096, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) return NULL;
+    buf[0] = '\0';
+
+    for (size_t i = 0; i < entries->count; ++i) {
+        const JournalEntry *e = &entries->entries[i];
+        const char *unit = e->unit ? e->unit : "-";
+        const char *msg = e->message ? e->message : "";
+        const char *prio = (e->priority >= 0 && e->priority < 8) ? priority_names[e->priority] : "?";
+
+        char ts[32];
+        time_t secs = (time_t)(e->realtime_usec / 1000000);
+        struct tm tm;
+        localtime_r(&secs, &tm);
+        strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+
+        size_t need = strlen(ts) + strlen(unit) + strlen(prio) + strlen(msg) + 8;
+        if (len + need + 1 > cap) {
+            size_t newcap = cap * 2;
+            while (len + need + 1 > newcap) newcap *= 2;
+            char *n = realloc(buf, newcap);
+            if (!n) break;
+            buf = n;
+            cap = newcap;
+        }
+        len += (size_t)snprintf(buf + len, cap - len, "%s %s[%s]: %s\n", ts, unit, prio, msg);
+    }
+    if (out_len) *out_len = len;
+    return buf;
+}
+
+void journal_entries_free(JournalEntries *entries) {
+    for (size_t i = 0; i < entries->count; ++i) {
+        free(entries->entries[i].unit);
+        free(entries->entries[i].message);
+    }
+    free(entries->entries);
+    memset(entries, 0, sizeof(*entries));
+}
+
+static char* collect_formatted(int max_priority, int this_boot_only, const int *cancel, size_t *out_len) {
+    if (!journal_system_readable()) return NULL;
+    JournalEntries entries;
+    if (journal_collect(max_priority, this_boot_only, JOURNAL_MAX_ENTRIES, cancel, &entries) != 0) return NULL;
+    char *text = journal_format_entries(&entries, out_len);
+    journal_entries_free(&entries);
+    return text;
+}
+
+char* collect_journal_errors(const int *cancel, size_t *out_len) {
+    return collect_formatted(3, 0, cancel, out_len);
+}
+
+char* collect_journal_boot_errors(const int *cancel, size_t *out_len) {
+    return collect_formatted(4, 1, cancel, out_len);
+}
+
+char* journal_state_token(void) {
+    if (journal_system_readable()) {
+        sd_journal *j = NULL;
+        if (sd_journal_open(&j, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM) < 0) return NULL;
+        char match[32];
+        for (int p = 0; p <= 3; ++p) {
+            snprintf(match, sizeof(match), "PRIORITY=%d", p);
+            sd_journal_add_match(j, match, 0);
+        }
+        char *cursor = NULL;
+        sd_journal_seek_tail(j);
+        if (sd_journal_previous(j) > 0) sd_journal_get_cursor(j, &cursor);
+        sd_journal_close(j);
+        // cursor comes from libsystemd's allocator, which is plain malloc
+        return cursor ? cursor : strdup("empty");
+    }
+    // The privileged helper reads the cursor for us. The journal files' sizes and
+    // mtimes are no substitute: journald writes to them all the time.
+    return helper_available() ? helper_collect("journal-token", NULL) : NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <systemd/sd-journal.h>
+
+// One structured journal record, as read through sd-journal.
+typedef struct {
+    uint64_t realtime_usec;  // wall-clock timestamp
+    int priority;            // syslog priority (0 = emerg .. 7 = debug)
+    char *unit;              // _SYSTEMD_UNIT, falling back to SYSLOG_IDENTIFIER/_COMM
+    char *message;
+} JournalEntry;
+
+typedef struct {
+    JournalEntry *entries;   // chronological order
+    size_t count;
+    size_t cap;
+} JournalEntries;
+
+// Maximum number of (most recent) entries the report collectors keep.
+// The string form is passed to journalctl -n on the fallback path.
+#define JOURNAL_MAX_ENTRIES 4000
+#define JOURNAL_MAX_ENTRIES_STR "4000"
+
+// Returns 1 if this process can read the system journal directly
+// (root, or a member of a group journald grants read access to).
+int journal_system_readable(void);
+
+// Read the most recent max_entries records with PRIORITY <= max_priority. When
+// this_boot_only is set, only records from the current boot are considered.
+// Filtering is done with journal matches so journald's indexes do the work. Reading
+// stops once *cancel is set (cancel may be NULL).
+// Returns 0 on success, -1 if the journal could not be opened or reading was cancelled.
+int journal_collect(int max_priority, int this_boot_only, size_t max_entries, const int *cancel, JournalEntries *out);
+
+// Read the most recent max_per_unit records of each of n units: what the unit logged
+// itself (_SYSTEMD_UNIT) and what systemd logged about it (UNIT). out is an array of n,
+// filled in chronological order. One journal handle serves all the units.
+// Returns 0 on success, -1 if the journal could not be opened or *cancel was set.
+int journal_collect_units(const char *const *units, size_t n, size_t max_per_unit, const int *cancel,
+                          JournalEntries *out);
+
+// FIELD's value in j's current entry, or NULL if the entry does not have it. It points
+// into sd-journal's buffer and is valid until the next call on j.
+const char* journal_field(sd_journal *j, const char *field, size_t *len);
+// The same as an allocated string
+char* journal_get_field(sd_journal *j, const char *field);
+
+// Format entries as "timestamp unit[priority]: message" lines. Caller must free.
+char* journal_format_entries(const JournalEntries *entries, size_t *out_len);
+
+void journal_entries_free(JournalEntries *entries);
+
+// Report collectors: err..emerg for all time, and err..warning for this boot.
+// Return NULL when the system journal is not readable from this process, or once
+// *cancel is set (see CollectorSpec).
+char* collect_journal_errors(const int *cancel, size_t *out_len);
+char* collect_journal_boot_errors(const int *cancel, size_t *out_len);
+
+// Validity token for collect_journal_errors(): the cursor of the newest err..emerg
+// entry, read through the privileged helper when the journal is not readable from this
+// process. Caller frees; NULL if neither can read it.
+char* journal_state_token(void);
+
+#endif // JOURNAL_H
@@ -0,0 +1,289 @@
+/* Native kernel log reader
+ * Reads /dev/kmsg records without blocking, filters on the syslog level in each
+ * record header and tracks sequence numbers so ring-buffer overwrites are visible.
+ * Raw addresses in call traces are resolved against the running kernel's symbols.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include "kmsg.h"
+#include "symbolize.h"
+#include "collector.h"
+
+// Raw call trace addresses resolved per report
+#define KMSG_MAX_SYMBOLIZED 256
+// Reported levels: emerg, alert, crit, err and warn
+#define KMSG_REPORT_LEVEL 4
+
+static const char *level_names[8] = {"emerg", "alert", "crit", "err", "warn", "notice", "info", "debug"};
+
+static uint64_t clock_usec(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// Records look like "pri,seq,ts_usec,flags[,...];message\n[ KEY=VALUE\n...]"
+int kmsg_parse_record(const char *buf, size_t len, KmsgRecord *rec) {
+    const char *semi = memchr(buf, ';', len);
+    if (!semi) return -1;
+
+    unsigned long long pri, seq, ts;
+    if (sscanf(buf, "%llu,%llu,%llu", &pri, &seq, &ts) != 3) return -1;
+    rec->level = (int)(pri & 7);
+    rec->seq = seq;
+    rec->ts_usec = ts;
+
+    // Message runs to the first newline; continuation lines carry the dictionary
+    const char *msg = semi + 1;
+    const char *end = memchr(msg, '\n', len - (size_t)(msg - buf));
+    size_t msg_len = end ? (size_t)(end - msg) : len - (size_t)(msg - buf);
+    rec->message = strndup(msg, msg_len);
+    return rec->message ? 0 : -1;
+}
+
+int kmsg_read(int max_level, const int *cancel, KmsgLog *out) {
+    memset(out, 0, sizeof(*out));
+
+    int fd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    // Convert monotonic timestamps to wall clock with a single offset
+    out->boot_realtime_usec = clock_usec(CLOCK_REALTIME) - clock_usec(CLOCK_MONOTONIC);
+
+    char buf[KMSG_RECORD_MAX];
+    int have_seq = 0;
+    while (!collector_cancel_requested(cancel)) {
+        ssize_t r = read(fd, buf, sizeof(buf) - 1);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            // The reader fell behind and records were overwritten; the next read
+            // continues at the oldest record still present and the gap shows in seq.
+            if (errno == EPIPE) continue;
+            break; // EAGAIN: caught up with the ring buffer
+        }
+        if (r == 0) break;
+        buf[r] = '\0';
+
+        KmsgRecord rec;
+        if (kmsg_parse_record(buf, (size_t)r, &rec) != 0) continue;
+
+        if (!have_seq) {
+            out->first_seq = rec.seq;
+            have_seq = 1;
+        } else if (rec.seq > out->last_seq + 1) {
+            out->dropped += rec.seq - out->last_seq - 1;
+        }
+        out->last_seq = rec.seq;
+
+        if (rec.level > max_level) {
+            free(rec.message);
+            continue;
+        }
+        if (out->count == out->cap) {
+            size_t newcap = out->cap ? out->cap * 2 : 256;
+            KmsgRecord *n = realloc(out->records, newcap * sizeof(KmsgRecord));
+            if (!n) {
+                free(rec.message);
+                break;
+            }
+            out->records = n;
+            out->cap = newcap;
+        }
+        out->records[out->count++] = rec;
+    }
+    close(fd);
+    if (collector_cancel_requested(cancel)) {
+        kmsg_log_free(out);
+        return -1;
+    }
+    return 0;
+}
+
+char* kmsg_format(const KmsgLog *log, size_t *out_len) {
+    size_t cap = 4096, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) return NULL;
+    buf[0] = '\0';
+
+    for (size_t i = 0; i <= log->count; ++i) {
+        char line[1024];
+        const char *msg;
+        size_t msg_len;
+        int head;
+        if (i < log->count) {
+            const KmsgRecord *rec = &log->records[i];
+            time_t secs = (time_t)((log->boot_realtime_usec + rec->ts_usec) / 1000000ULL);
+            struct tm tm;
+            char ts[32];
+            localtime_r(&secs, &tm);
+            strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+            head = snprintf(line, sizeof(line), "%s [%5llu.%06llu] %s: ", ts,
+                            (unsigned long long)(rec->ts_usec / 1000000ULL),
+                            (unsigned long long)(rec->ts_usec % 1000000ULL),
+                            level_names[rec->level & 7]);
+            msg = rec->message;
+            msg_len = strlen(msg);
+        } else if (log->dropped > 0 || log->first_seq > 0) {
+            head = snprintf(line, sizeof(line), "(%llu earlier records already rotated out of the ring buffer, "
+                            "%llu overwritten while reading)",
+                            (unsigned long long)log->first_seq, (unsigned long long)log->dropped);
+            msg = "";
+            msg_len = 0;
+        } else {
+            break;
+        }
+
+        if (head < 0) continue;
+        if ((size_t)head >= sizeof(line)) head = (int)sizeof(line) - 1;
+        size_t need = (size_t)head + msg_len + 2;
+        if (len + need > cap) {
+            size_t newcap = cap * 2;
+            while (len + need > newcap) newcap *= 2;
+            char *n = realloc(buf, newcap);
+            if (!n) break;
+            buf = n;
+            cap = newcap;
+        }
+        memcpy(buf + len, line, (size_t)head);
+        len += (size_t)head;
+        memcpy(buf + len, msg, msg_len);
+        len += msg_len;
+        buf[len++] = '\n';
+        buf[len] = '\0';
+    }
+    if (out_len) *out_len = len;
+    return buf;
+}
+
+void kmsg_log_free(KmsgLog *log) {
+    for (size_t i = 0; i < log->count; ++i) free(log->records[i].message);
+    free(log->records);
+    memset(log, 0, sizeof(*log));
+}
+
+int kmsg_open_follow(void) {
+    int fd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    // SEEK_END moves the reader past every record already in the ring buffer
+    if (lseek(fd, 0, SEEK_END) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The next "[<ffffffff81012345>]" in p that has no symbol printed after it (kernels
+// without kallsyms, or traces printed with %px). NULL when there is none.
+static const char* next_raw_address(const char *p, const char **end, uint64_t *addr) {
+    while ((p = strstr(p, "[<")) != NULL) {
+        const char *hex = p + 2;
+        size_t n = strspn(hex, "0123456789abcdef");
+        if (n == 16 && hex[n] == '>' && hex[n + 1] == ']') {
+            const char *after = hex + n + 2;
+            while (*after == ' ') after++;
+            if (*after == '\0' || *after == '[') {
+                *addr = strtoull(hex, NULL, 16);
+                *end = hex + n + 2;
+                return p;
+            }
+        }
+        p += 2;
+    }
+    return NULL;
+}
+
+// Add the function after each raw address, when /proc/kallsyms shows addresses to this
+// process (root, kptr_restrict permitting)
+static void symbolize_records(KmsgLog *log) {
+    uint64_t addrs[KMSG_MAX_SYMBOLIZED];
+    size_t n = 0;
+    for (size_t i = 0; i < log->count && n < KMSG_MAX_SYMBOLIZED; ++i) {
+        const char *p = log->records[i].message, *end;
+        while (n < KMSG_MAX_SYMBOLIZED && (p = next_raw_address(p, &end, &addrs[n])) != NULL) {
+            n++;
+            p = end;
+        }
+    }
+    SymTrace sym;
+    if (n == 0 || symbolize_kernel_addresses(addrs, n, &sym) != 0) return;
+
+    size_t k = 0;
+    for (size_t i = 0; i < log->count && k < sym.count; ++i) {
+        const char *scan = log->records[i].message, *copied = scan, *end;
+        uint64_t addr;
+        char *out = NULL;
+        size_t out_len = 0;
+        FILE *f = NULL;
+        while (k < sym.count && next_raw_address(scan, &end, &addr) != NULL) {
+            const SymFrame *fr = &sym.frames[k++];
+            scan = end;
+            if (!fr->function) continue;
+            if (!f && !(f = open_memstream(&out, &out_len))) break;
+            fwrite(copied, 1, (size_t)(end - copied), f);
+            fprintf(f, " %s+0x%llx", fr->function, (unsigned long long)fr->function_offset);
+            copied = end;
+        }
+        if (!f) continue;
+        fputs(copied, f);
+        if (fclose(f) == 0 && out) {
+            free(log->records[i].message);
+            log->records[i].message = out;
+        } else {
+            free(out);
+        }
+    }
+    sym_trace_free(&sym);
+}
+
+char* collect_kmsg_errors(const int *cancel, size_t *out_len) {
+    KmsgLog log;
+    if (kmsg_read(KMSG_REPORT_LEVEL, cancel, &log) != 0) return NULL; // like dmesg --level=emerg,alert,crit,err,warn
+    symbolize_records(&log);
+    char *text = kmsg_format(&log, out_len);
+    kmsg_log_free(&log);
+    return text;
+}
+
+// The token follows the log from one descriptor opened past the newest record, so each
+// call reads only what was logged since the last one instead of the whole ring buffer
+static pthread_mutex_t token_lock = PTHREAD_MUTEX_INITIALIZER;
+static int token_fd = -1;
+static uint64_t token_seq;   // newest reported record seen
+static unsigned token_lost;  // times records were overwritten before they were read
+
+char* kmsg_state_token(void) {
+    pthread_mutex_lock(&token_lock);
+    if (token_fd < 0) token_fd = kmsg_open_follow();
+    if (token_fd < 0) {
+        pthread_mutex_unlock(&token_lock);
+        return NULL;
+    }
+    char buf[KMSG_RECORD_MAX];
+    for (;;) {
+        ssize_t r = read(token_fd, buf, sizeof(buf) - 1);
+        if (r < 0 && errno == EINTR) continue;
+        // Overwritten before they were read, possibly reported ones; reading goes on
+        // from the oldest record left
+        if (r < 0 && errno == EPIPE) {
+            token_lost++;
+            continue;
+        }
+        if (r <= 0) break;
+        buf[r] = '\0';
+        KmsgRecord rec;
+        if (kmsg_parse_record(buf, (size_t)r, &rec) != 0) continue;
+        if (rec.level <= KMSG_REPORT_LEVEL) token_seq = rec.seq;
+        free(rec.message);
+    }
+    char token[64];
+    snprintf(token, sizeof(token), "%u-%llu", token_lost, (unsigned long long)token_seq);
+    pthread_mutex_unlock(&token_lock);
+    return strdup(token);
+}
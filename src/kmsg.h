@@ -0,0 +1,58 @@
+#ifndef KMSG_H
+#define KMSG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Records are at most a few KB (message plus dictionary lines)
+#define KMSG_RECORD_MAX 8192
+
+// One kernel log record read from /dev/kmsg.
+typedef struct {
+    uint64_t seq;            // kernel sequence number
+    int level;               // syslog level (0 = emerg .. 7 = debug)
+    uint64_t ts_usec;        // monotonic timestamp from the record header
+    char *message;
+} KmsgRecord;
+
+typedef struct {
+    KmsgRecord *records;     // records at or below the requested level, in order
+    size_t count;
+    size_t cap;
+    uint64_t first_seq;      // first sequence number still in the ring buffer (records before it were rotated out)
+    uint64_t last_seq;       // last sequence number read
+    uint64_t dropped;        // records lost to ring-buffer overwrites (sequence gaps)
+    uint64_t boot_realtime_usec; // wall-clock time of boot, used to convert ts_usec
+} KmsgLog;
+
+// Read every record currently in the kernel ring buffer without blocking and keep
+// those with level <= max_level. Returns 0 on success, -1 if /dev/kmsg cannot be
+// opened (e.g. dmesg_restrict without CAP_SYSLOG) or *cancel was set while reading
+// (cancel may be NULL).
+int kmsg_read(int max_level, const int *cancel, KmsgLog *out);
+
+// Format records as "wall-clock [monotonic] level: message" lines, followed by a
+// note when records were dropped. Caller must free.
+char* kmsg_format(const KmsgLog *log, size_t *out_len);
+
+void kmsg_log_free(KmsgLog *log);
+
+// Open /dev/kmsg for following: the non-blocking descriptor is positioned after the
+// newest record, so reads return only records logged from now on. -1 on failure.
+int kmsg_open_follow(void);
+
+// Parse one record as read() returns it ("pri,seq,ts_usec,flags;message\n..."). Returns 0
+// and fills rec (message is allocated) on success.
+int kmsg_parse_record(const char *buf, size_t len, KmsgRecord *rec);
+
+// Report collector for emerg, alert, crit, err and warn records. Returns NULL when
+// /dev/kmsg is not readable from this process, or once *cancel is set.
+char* collect_kmsg_errors(const int *cancel, size_t *out_len);
+
+// Validity token for collect_kmsg_errors(). It changes whenever a record at one of
+// those levels is logged (or records are overwritten unread) after the first call,
+// and costs a read of only the records logged since the previous call. Caller frees;
+// NULL when /dev/kmsg is not readable.
+char* kmsg_state_token(void);
+
+#endif // KMSG_H
@@ -0,0 +1,515 @@
+/* Parallel /var/log scanner
+ * Files are spread over a worker pool sized to the online CPUs. Plain files are read
+ * in bounded chunks, rotated .gz/.xz/.zst/.lz4 files are decompressed as a stream, and
+ * matching uses a word-at-a-time case-insensitive search. Scanning stops once the
+ * output budget is full; a semaphore caps how many files are read at once.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "decompress.h"
+#include "logscan.h"
+#include "strbuf.h"
+#include "collector.h"
+#include "hash.h"
+
+#define LOGSCAN_READ_CHUNK 65536
+// Bytes inspected for NUL to decide a file is binary (like grep -I)
+#define LOGSCAN_BINARY_PROBE 4096
+// A "line" longer than this without a newline is scanned as is
+#define LOGSCAN_MAX_CARRY (1024 * 1024)
+
+typedef struct {
+    char *path;
+    Compression kind;
+    char *out;
+    size_t len;
+    size_t cap;
+    int scanned;
+    int done;           // finished (or never to be scanned); under emit_lock
+} ScanFile;
+
+typedef struct {
+    const LogScanOptions *opts;
+    ScanFile *files;
+    size_t nfiles;
+    size_t next;        // next file index to hand out (atomic)
+    size_t produced;    // bytes of matches produced so far (atomic)
+    int stop;           // set once the budget is full (atomic)
+    const int *cancel;  // opts->cancel
+    sem_t io_slots;
+    unsigned char needle[64];
+    size_t needle_len;
+    // Matches go out file by file in path order, as soon as a file and all before it are done
+    pthread_mutex_t emit_lock;
+    size_t emitted_files;
+    size_t emitted_bytes;
+    LogScanEmitFn emit;
+    void *user;
+} ScanState;
+
+static unsigned char fold_table[256];
+
+static void init_fold_table(void) {
+    for (int c = 0; c < 256; ++c) {
+        fold_table[c] = (unsigned char)((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+    }
+}
+
+static void add_file(ScanFile **files, size_t *n, size_t *cap, const char *path) {
+    if (*n == *cap) {
+        size_t newcap = *cap ? *cap * 2 : 64;
+        ScanFile *p = realloc(*files, newcap * sizeof(ScanFile));
+        if (!p) return;
+        *files = p;
+        *cap = newcap;
+    }
+    ScanFile *f = &(*files)[*n];
+    memset(f, 0, sizeof(*f));
+    f->path = strdup(path);
+    if (!f->path) return;
+    f->kind = compression_for_path(path);
+    (*n)++;
+}
+
+// Collect regular, readable files (symlinks are not followed, like find -type f)
+static void list_files(const char *dir, int depth, int max_depth, ScanFile **files, size_t *n, size_t *cap) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *de;
+    char path[4096];
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < max_depth) list_files(path, depth + 1, max_depth, files, n, cap);
+        } else if (S_ISREG(st.st_mode) && st.st_size > 0 && access(path, R_OK) == 0) {
+            add_file(files, n, cap, path);
+        }
+    }
+    closedir(d);
+}
+
+static int compare_files(const void *a, const void *b) {
+    return strcmp(((const ScanFile *)a)->path, ((const ScanFile *)b)->path);
+}
+
+// Whether scanning should stop: the budget is full or the scan was cancelled
+static int stopped(const ScanState *st) {
+    return __atomic_load_n(&st->stop, __ATOMIC_RELAXED) || collector_cancel_requested(st->cancel);
+}
+
+static int match_at(const ScanState *st, const char *p) {
+    for (size_t k = 1; k < st->needle_len; ++k) {
+        if (fold_table[(unsigned char)p[k]] != st->needle[k]) return 0;
+    }
+    return 1;
+}
+
+// Case-insensitive search for the needle. Candidates for the first byte are found
+// eight bytes at a time: OR-ing 0x20 folds ASCII case, then a zero-byte test on
+// (word ^ pattern) flags positions to verify.
+static const char* find_ci(const ScanState *st, const char *hay, size_t n) {
+    size_t m = st->needle_len;
+    if (m == 0 || n < m) return NULL;
+    const size_t last = n - m;
+    const unsigned char first = (unsigned char)(st->needle[0] | 0x20);
+    size_t i = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t pattern = ones * first;
+    for (; i + 8 <= last + 1; i += 8) {
+        uint64_t w;
+        memcpy(&w, hay + i, sizeof(w));
+        uint64_t x = (w | (ones * 0x20)) ^ pattern;
+        uint64_t z = (x - ones) & ~x & highs;
+        while (z) {
+            size_t b = (size_t)__builtin_ctzll(z) >> 3;
+            if (fold_table[(unsigned char)hay[i + b]] == st->needle[0] && match_at(st, hay + i + b)) return hay + i + b;
+            z &= z - 1;
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if (fold_table[(unsigned char)hay[i]] == st->needle[0] && match_at(st, hay + i)) return hay + i;
+    }
+    return NULL;
+}
+
+static size_t count_newlines(const char *p, const char *end) {
+    size_t n = 0;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        n++;
+        p++;
+    }
+    return n;
+}
+
+static int append_match(ScanState *st, ScanFile *f, size_t lineno, const char *line, size_t len) {
+    char prefix[64];
+    int pl = snprintf(prefix, sizeof(prefix), ":%zu:", lineno);
+    size_t plen = strlen(f->path);
+    size_t add = plen + (size_t)pl + len + 1;
+
+    // Claim the bytes before writing them, cutting the line to what is left of the budget
+    size_t used = __atomic_load_n(&st->produced, __ATOMIC_RELAXED), take;
+    do {
+        if (used >= st->opts->budget) {
+            __atomic_store_n(&st->stop, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        take = st->opts->budget - used < add ? st->opts->budget - used : add;
+    } while (!__atomic_compare_exchange_n(&st->produced, &used, used + take, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    if (take < add) {
+        __atomic_store_n(&st->stop, 1, __ATOMIC_RELAXED);
+        if (take <= plen + (size_t)pl + 1) return 0; // not even the line's location fits
+        len = take - plen - (size_t)pl - 1;
+        add = take;
+    }
+    if (f->len + add + 1 > f->cap) {
+        size_t newcap = f->cap ? f->cap * 2 : 4096;
+        while (f->len + add + 1 > newcap) newcap *= 2;
+        char *p = realloc(f->out, newcap);
+        if (!p) return 0;
+        f->out = p;
+        f->cap = newcap;
+    }
+    memcpy(f->out + f->len, f->path, plen);
+    memcpy(f->out + f->len + plen, prefix, (size_t)pl);
+    memcpy(f->out + f->len + plen + (size_t)pl, line, len);
+    f->len += add;
+    f->out[f->len - 1] = '\n';
+    f->out[f->len] = '\0';
+    if (used + take < st->opts->budget) return 1;
+    __atomic_store_n(&st->stop, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Scan a block of complete lines, updating *lineno. Returns 0 once the budget is full.
+static int scan_lines(ScanState *st, ScanFile *f, const char *data, size_t len, size_t *lineno) {
+    const char *cur = data;
+    const char *end = data + len;
+    while (cur < end) {
+        if (stopped(st)) return 0;
+        const char *hit = find_ci(st, cur, (size_t)(end - cur));
+        if (!hit) {
+            *lineno += count_newlines(cur, end);
+            break;
+        }
+        const char *ls = hit;
+        while (ls > cur && ls[-1] != '\n') ls--;
+        *lineno += count_newlines(cur, ls);
+        const char *le = memchr(hit, '\n', (size_t)(end - hit));
+        if (!le) le = end;
+        (*lineno)++;
+        if (!append_match(st, f, *lineno, ls, (size_t)(le - ls))) return 0;
+        cur = le < end ? le + 1 : end;
+    }
+    return 1;
+}
+
+static int looks_binary(const char *data, size_t len) {
+    return memchr(data, '\0', len < LOGSCAN_BINARY_PROBE ? len : LOGSCAN_BINARY_PROBE) != NULL;
+}
+
+// Scan the complete lines at the start of buf[0..*len) and keep the partial last line
+// there for the next block; a line longer than LOGSCAN_MAX_CARRY is scanned as is.
+// Returns 0 once the budget is full.
+static int scan_block(ScanState *st, ScanFile *f, char *buf, size_t *len, size_t *lineno) {
+    char *nl = memrchr(buf, '\n', *len);
+    size_t complete = nl ? (size_t)(nl - buf) + 1 : (*len > LOGSCAN_MAX_CARRY ? *len : 0);
+    if (complete == 0) return 1;
+    if (!scan_lines(st, f, buf, complete, lineno)) return 0;
+    memmove(buf, buf + complete, *len - complete);
+    *len -= complete;
+    return 1;
+}
+
+// Room for one more read chunk after len bytes
+static int reserve_chunk(char **buf, size_t len, size_t *cap) {
+    if (*cap - len >= LOGSCAN_READ_CHUNK) return 0;
+    size_t newcap = *cap ? *cap * 2 : LOGSCAN_READ_CHUNK * 2;
+    char *p = realloc(*buf, newcap);
+    if (!p) return -1;
+    *buf = p;
+    *cap = newcap;
+    return 0;
+}
+
+// Live logs are read with pread() into a bounded buffer rather than mapped: a log
+// truncated in place (copytruncate) while it is being scanned just reads short here,
+// where touching a mapped page past the new end would raise SIGBUS.
+static void scan_plain(ScanState *st, ScanFile *f, int fd, size_t size) {
+    char *buf = NULL;
+    size_t len = 0, cap = 0, lineno = 0;
+    off_t off = 0;
+    int probed = 0;
+    while ((size_t)off < size && !stopped(st)) {
+        if (reserve_chunk(&buf, len, &cap) != 0) break;
+        size_t want = size - (size_t)off < LOGSCAN_READ_CHUNK ? size - (size_t)off : LOGSCAN_READ_CHUNK;
+        sem_wait(&st->io_slots);
+        ssize_t r = pread(fd, buf + len, want, off);
+        sem_post(&st->io_slots);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break; // truncated under us
+        off += r;
+        len += (size_t)r;
+        if (!probed) {
+            if (looks_binary(buf, len)) {
+                len = 0;
+                break;
+            }
+            probed = 1;
+        }
+        if (!scan_block(st, f, buf, &len, &lineno)) {
+            len = 0;
+            break;
+        }
+    }
+    if (len > 0 && probed) scan_lines(st, f, buf, len, &lineno);
+    free(buf);
+}
+
+static void scan_compressed(ScanState *st, ScanFile *f, int fd) {
+    Decoder *d = decoder_new(f->kind);
+    if (!d) return;
+
+    unsigned char in[LOGSCAN_READ_CHUNK];
+    const unsigned char *inp = in;
+    size_t in_len = 0;
+    int in_eof = 0, done = 0, probed = 0;
+    size_t lineno = 0;
+    char *carry = NULL;
+    size_t carry_len = 0, carry_cap = 0;
+
+    while (!done && !stopped(st)) {
+        if (in_len == 0 && !in_eof) {
+            // Only the compressed reads hold an I/O slot; decompression runs freely
+            sem_wait(&st->io_slots);
+            ssize_t r = read(fd, in, sizeof(in));
+            sem_post(&st->io_slots);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) in_eof = 1;
+            else {
+                inp = in;
+                in_len = (size_t)r;
+            }
+        }
+        if (reserve_chunk(&carry, carry_len, &carry_cap) != 0) break;
+        ssize_t produced = decoder_step(d, &inp, &in_len, in_eof, (unsigned char *)carry + carry_len, LOGSCAN_READ_CHUNK, &done);
+        if (produced < 0) break;
+        if (produced == 0 && in_eof && in_len == 0) break; // truncated stream
+        carry_len += (size_t)produced;
+
+        if (!probed && (carry_len >= LOGSCAN_BINARY_PROBE || done || in_eof)) {
+            if (looks_binary(carry, carry_len)) {
+                carry_len = 0;
+                break;
+            }
+            probed = 1;
+        }
+        if (!probed) continue;
+
+        if (!scan_block(st, f, carry, &carry_len, &lineno)) {
+            carry_len = 0;
+            break;
+        }
+    }
+    // A short stream can end before enough was decompressed to probe it in the loop
+    if (carry_len > 0 && !probed) probed = !looks_binary(carry, carry_len);
+    if (carry_len > 0 && probed) scan_lines(st, f, carry, carry_len, &lineno);
+
+    free(carry);
+    decoder_free(d);
+}
+
+// Mark file i done and pass on every finished file at the front of the queue, honouring
+// the budget
+static void file_done(ScanState *st, size_t i) {
+    pthread_mutex_lock(&st->emit_lock);
+    st->files[i].done = 1;
+    while (st->emitted_files < st->nfiles && st->files[st->emitted_files].done) {
+        ScanFile *f = &st->files[st->emitted_files++];
+        size_t room = st->opts->budget - st->emitted_bytes;
+        size_t n = f->len < room ? f->len : room;
+        if (n > 0) {
+            st->emit(f->out, n, st->user);
+            st->emitted_bytes += n;
+        }
+        free(f->out);
+        f->out = NULL;
+        f->len = f->cap = 0;
+    }
+    pthread_mutex_unlock(&st->emit_lock);
+}
+
+static void* scan_worker(void *arg) {
+    ScanState *st = (ScanState *)arg;
+    for (;;) {
+        if (stopped(st)) break;
+        size_t i = __atomic_fetch_add(&st->next, 1, __ATOMIC_RELAXED);
+        if (i >= st->nfiles) break;
+        ScanFile *f = &st->files[i];
+        int fd = open(f->path, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+        if (fd >= 0) {
+            struct stat sb;
+            if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+                f->scanned = 1;
+                if (f->kind == COMPRESSION_NONE) scan_plain(st, f, fd, (size_t)sb.st_size);
+                else scan_compressed(st, f, fd);
+            }
+            close(fd);
+        }
+        file_done(st, i);
+    }
+    return NULL;
+}
+
+int logscan_stream(const LogScanOptions *opts, LogScanEmitFn emit, void *user) {
+    static pthread_once_t fold_once = PTHREAD_ONCE_INIT;
+    pthread_once(&fold_once, init_fold_table);
+
+    ScanState st;
+    memset(&st, 0, sizeof(st));
+    st.opts = opts;
+    st.emit = emit;
+    st.user = user;
+    st.cancel = opts->cancel;
+    st.needle_len = strlen(opts->pattern);
+    if (st.needle_len == 0 || st.needle_len >= sizeof(st.needle)) return -1;
+    for (size_t k = 0; k < st.needle_len; ++k) st.needle[k] = fold_table[(unsigned char)opts->pattern[k]];
+
+    size_t cap = 0;
+    list_files(opts->root, 1, opts->max_depth, &st.files, &st.nfiles, &cap);
+    if (st.nfiles > 1) qsort(st.files, st.nfiles, sizeof(ScanFile), compare_files);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t workers = opts->workers > 0 ? (size_t)opts->workers : (size_t)(ncpu > 0 ? ncpu : 1);
+    if (workers > st.nfiles) workers = st.nfiles;
+    int io = opts->io_concurrency > 0 ? opts->io_concurrency : LOGSCAN_IO_CONCURRENCY;
+    sem_init(&st.io_slots, 0, (unsigned)io);
+    pthread_mutex_init(&st.emit_lock, NULL);
+
+    pthread_t *threads = calloc(workers ? workers : 1, sizeof(pthread_t));
+    size_t started = 0;
+    for (size_t i = 0; threads && i < workers; ++i) {
+        if (pthread_create(&threads[started], NULL, scan_worker, &st) == 0) started++;
+    }
+    if (started == 0) scan_worker(&st); // no threads available: scan inline
+    for (size_t i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    free(threads);
+    sem_destroy(&st.io_slots);
+
+    // Files never handed out once the budget was full
+    size_t skipped = 0;
+    for (size_t i = 0; i < st.nfiles; ++i) {
+        if (!st.files[i].scanned) skipped++;
+        if (!st.files[i].done) file_done(&st, i);
+        free(st.files[i].path);
+    }
+    pthread_mutex_destroy(&st.emit_lock);
+    free(st.files);
+    if (collector_cancel_requested(st.cancel)) return -1;
+    if (st.stop) {
+        char note[160];
+        int n = snprintf(note, sizeof(note), "... (scan stopped after %zu KB of matches; %zu file(s) not scanned)\n",
+                         opts->budget / 1024, skipped);
+        emit(note, (size_t)n, user);
+    }
+    return 0;
+}
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} ScanOutput;
+
+static void append_output(const char *data, size_t len, void *user) {
+    ScanOutput *o = user;
+    buf_append(&o->buf, &o->len, &o->cap, data, len);
+}
+
+char* logscan_run(const LogScanOptions *opts, size_t *out_len) {
+    ScanOutput o = { NULL, 0, 0 };
+    if (logscan_stream(opts, append_output, &o) != 0) {
+        free(o.buf);
+        return NULL;
+    }
+    if (!o.buf) o.buf = strdup("");
+    if (out_len) *out_len = o.buf ? o.len : 0;
+    return o.buf;
+}
+
+// Fold path, size and mtime of every candidate file under dir into *hash
+static void hash_tree(const char *dir, int depth, int max_depth, uint64_t *hash) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *de;
+    char path[4096];
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < max_depth) hash_tree(path, depth + 1, max_depth, hash);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) continue;
+        // Journal files are binary (never matched) but written constantly
+        if (has_suffix(de->d_name, ".journal") || has_suffix(de->d_name, ".journal~")) continue;
+
+        uint64_t fields[2] = {(uint64_t)st.st_size,
+                              (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec};
+        uint64_t h = fnv1a_update(fnv1a(path, strlen(path)), fields, sizeof(fields));
+        *hash += h; // order-independent, readdir order is not stable
+    }
+    closedir(d);
+}
+
+char* logscan_state_token(const LogScanOptions *opts) {
+    uint64_t hash = 0;
+    hash_tree(opts->root, 1, opts->max_depth, &hash);
+    char token[32];
+    snprintf(token, sizeof(token), "%016llx", (unsigned long long)hash);
+    return strdup(token);
+}
+
+static const LogScanOptions varlog_options = {
+    .root = "/var/log",
+    .max_depth = 3,
+    .pattern = "error",
+    .budget = LOGSCAN_DEFAULT_BUDGET,
+    .workers = 0,
+    .io_concurrency = LOGSCAN_IO_CONCURRENCY,
+};
+
+char* collect_varlog_matches(const int *cancel, size_t *out_len) {
+    if (geteuid() != 0) return NULL;
+    LogScanOptions opts = varlog_options;
+    opts.cancel = cancel;
+    return logscan_run(&opts, out_len);
+}
+
+int stream_varlog_matches(LogScanEmitFn emit, void *user) {
+    if (geteuid() != 0) return -1;
+    return logscan_stream(&varlog_options, emit, user);
+}
+
+char* varlog_state_token(void) {
+    return logscan_state_token(&varlog_options);
+}
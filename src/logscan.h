@@ -0,0 +1,47 @@
+#ifndef LOGSCAN_H
+#define LOGSCAN_H
+
+#include <stddef.h>
+
+// Default output budget for the /var/log section (matches the report's section limit)
+#define LOGSCAN_DEFAULT_BUDGET (200 * 1024)
+
+typedef struct {
+    const char *root;        // directory to scan, e.g. "/var/log"
+    int max_depth;           // 1 = only files directly in root (like find -maxdepth)
+    const char *pattern;     // matched case-insensitively, e.g. "error"
+    size_t budget;           // stop scanning once this many bytes of matches were produced
+    int workers;             // worker threads; <= 0 means one per online CPU
+    int io_concurrency;      // files read at the same time; <= 0 means LOGSCAN_IO_CONCURRENCY
+    const int *cancel;       // the scan is abandoned once it is set, may be NULL
+} LogScanOptions;
+
+typedef void (*LogScanEmitFn)(const char *data, size_t len, void *user);
+
+// Scan every regular, readable, non-binary file under opts->root for lines containing
+// opts->pattern. Plain files are read in chunks; rotated .gz/.xz/.zst/.lz4 files are
+// decompressed as a stream. Output is grep-like ("path:line:text"), ordered by path.
+// Returns an allocated string (caller frees) or NULL on failure or cancellation.
+char* logscan_run(const LogScanOptions *opts, size_t *out_len);
+
+// The same scan, handing each file's matches to emit (one call at a time, from the
+// scanning threads) as soon as that file and every file before it are done. Returns 0,
+// or -1 when the pattern is unusable or the scan was cancelled (what was emitted by
+// then is only part of the matches).
+int logscan_stream(const LogScanOptions *opts, LogScanEmitFn emit, void *user);
+
+// Report collector for /var/log. Returns NULL when not running as root, so that the
+// caller falls back to a privileged scan instead of silently missing root-only logs,
+// and NULL once *cancel is set.
+char* collect_varlog_matches(const int *cancel, size_t *out_len);
+// Streaming form, for the privileged helper; -1 when not running as root
+int stream_varlog_matches(LogScanEmitFn emit, void *user);
+
+// Validity token for a scan: a hash over path, size and mtime of every file the scan
+// would visit (as far as this process can list them). Caller frees.
+char* logscan_state_token(const LogScanOptions *opts);
+
+// logscan_state_token() for the options collect_varlog_matches() uses.
+char* varlog_state_token(void);
+
+#endif // LOGSCAN_H
@@ -0,0 +1,318 @@
+/* pacman.log parser
+ * Memory-maps /var/log/pacman.log, splits it into ALPM transactions and keeps a
+ * persistent JSON index so later runs only parse the bytes appended since.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <jansson.h>
+#include "pacman_log.h"
+#include "strbuf.h"
+#include "paths.h"
+
+#define PACMAN_INDEX_VERSION 1
+
+static const char *package_actions[] = {"upgraded", "installed", "removed", "downgraded", "reinstalled", NULL};
+
+// Path of the index file in the cache directory
+static int index_path(char *out, size_t size) {
+    char dir[PATH_MAX];
+    if (cache_dir(NULL, dir, sizeof(dir)) != 0) return -1;
+    snprintf(out, size, "%s/pacman-index.json", dir);
+    return 0;
+}
+
+// The index is a cache: concurrent collectors (the GUI, a watcher, the helper) may each
+// save theirs, so every writer gets its own temporary file and the last rename wins
+// with a complete index
+static void save_index(const char *path, json_t *index) {
+    char tmpfile[PATH_MAX + 16];
+    snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", path);
+    char *data = json_dumps(index, JSON_COMPACT);
+    if (!data) return;
+    int fd = mkstemp(tmpfile);
+    if (fd >= 0) {
+        size_t len = strlen(data);
+        int ok = write(fd, data, len) == (ssize_t)len && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmpfile, path) != 0) unlink(tmpfile);
+    }
+    free(data);
+}
+
+// Load the index if it still describes this file (same inode, not truncated); otherwise start fresh
+static json_t* load_index(const char *path, const struct stat *st) {
+    json_t *idx = path ? json_load_file(path, 0, NULL) : NULL;
+    if (idx) {
+        json_int_t version = json_integer_value(json_object_get(idx, "version"));
+        json_int_t dev = json_integer_value(json_object_get(idx, "dev"));
+        json_int_t ino = json_integer_value(json_object_get(idx, "ino"));
+        json_int_t offset = json_integer_value(json_object_get(idx, "offset"));
+        if (version == PACMAN_INDEX_VERSION && dev == (json_int_t)st->st_dev && ino == (json_int_t)st->st_ino &&
+            offset <= (json_int_t)st->st_size &&
+            json_is_array(json_object_get(idx, "transactions")) && json_is_array(json_object_get(idx, "errors"))) {
+            return idx;
+        }
+        json_decref(idx);
+    }
+    idx = json_object();
+    json_object_set_new(idx, "version", json_integer(PACMAN_INDEX_VERSION));
+    json_object_set_new(idx, "dev", json_integer((json_int_t)st->st_dev));
+    json_object_set_new(idx, "ino", json_integer((json_int_t)st->st_ino));
+    json_object_set_new(idx, "offset", json_integer(0));
+    json_object_set_new(idx, "lines", json_integer(0));
+    json_object_set_new(idx, "open", json_integer(-1));
+    json_object_set_new(idx, "transactions", json_array());
+    json_object_set_new(idx, "errors", json_array());
+    return idx;
+}
+
+static int contains_error_ci(const char *p, size_t n) {
+    for (size_t i = 0; i + 5 <= n; ++i) {
+        if ((p[i] | 0x20) == 'e' && strncasecmp(p + i, "error", 5) == 0) return 1;
+    }
+    return 0;
+}
+
+// Split "[timestamp] [TAG] message" into its parts. Returns 0 on success.
+static int split_line(const char *line, size_t len, const char **ts, size_t *ts_len,
+                      const char **tag, size_t *tag_len, const char **msg, size_t *msg_len) {
+    if (len < 2 || line[0] != '[') return -1;
+    const char *e = memchr(line, ']', len);
+    if (!e) return -1;
+    *ts = line + 1;
+    *ts_len = (size_t)(e - line - 1);
+    const char *p = e + 1;
+    const char *end = line + len;
+    if (p < end && *p == ' ') p++;
+    if (p >= end || *p != '[') return -1;
+    const char *te = memchr(p, ']', (size_t)(end - p));
+    if (!te) return -1;
+    *tag = p + 1;
+    *tag_len = (size_t)(te - p - 1);
+    p = te + 1;
+    if (p < end && *p == ' ') p++;
+    *msg = p;
+    *msg_len = (size_t)(end - p);
+    return 0;
+}
+
+static json_t* find_transaction(json_t *txns, json_int_t start) {
+    for (size_t i = json_array_size(txns); i > 0; --i) {
+        json_t *t = json_array_get(txns, i - 1);
+        if (json_integer_value(json_object_get(t, "start")) == start) return t;
+    }
+    return NULL;
+}
+
+// Parse one "upgraded name (old -> new)" style message into the open transaction
+static void add_package(json_t *txn, const char *msg, size_t len) {
+    for (int a = 0; package_actions[a]; ++a) {
+        size_t al = strlen(package_actions[a]);
+        if (len <= al + 1 || strncmp(msg, package_actions[a], al) != 0 || msg[al] != ' ') continue;
+        const char *name = msg + al + 1;
+        const char *end = msg + len;
+        const char *paren = memchr(name, '(', (size_t)(end - name));
+        size_t name_len = paren ? (size_t)(paren - name) : (size_t)(end - name);
+        while (name_len > 0 && name[name_len - 1] == ' ') name_len--;
+        json_t *pkg = json_object();
+        json_object_set_new(pkg, "action", json_string(package_actions[a]));
+        json_object_set_new(pkg, "name", json_stringn(name, name_len));
+        if (paren) {
+            const char *close = memchr(paren, ')', (size_t)(end - paren));
+            size_t vlen = close ? (size_t)(close - paren - 1) : (size_t)(end - paren - 1);
+            json_object_set_new(pkg, "version", json_stringn(paren + 1, vlen));
+        }
+        json_array_append_new(json_object_get(txn, "packages"), pkg);
+        return;
+    }
+}
+
+// Parse [from, to) of the mapped log into the index. Only complete lines are consumed;
+// returns the offset just past the last one.
+static size_t parse_region(json_t *idx, const char *map, size_t from, size_t to) {
+    json_t *txns = json_object_get(idx, "transactions");
+    json_t *errors = json_object_get(idx, "errors");
+    json_int_t lineno = json_integer_value(json_object_get(idx, "lines"));
+    json_int_t open_start = json_integer_value(json_object_get(idx, "open"));
+    json_t *open_txn = open_start >= 0 ? find_transaction(txns, open_start) : NULL;
+    json_int_t last_start = -1;
+    if (json_array_size(txns) > 0) {
+        last_start = json_integer_value(json_object_get(json_array_get(txns, json_array_size(txns) - 1), "start"));
+    }
+
+    size_t off = from;
+    while (off < to) {
+        const char *line = map + off;
+        const char *nl = memchr(line, '\n', to - off);
+        if (!nl) break; // partial last line: pick it up next run
+        size_t len = (size_t)(nl - line);
+        lineno++;
+
+        const char *ts, *tag, *msg;
+        size_t ts_len, tag_len, msg_len;
+        if (split_line(line, len, &ts, &ts_len, &tag, &tag_len, &msg, &msg_len) == 0 &&
+            tag_len == 4 && strncmp(tag, "ALPM", 4) == 0) {
+            if (msg_len == 19 && strncmp(msg, "transaction started", 19) == 0) {
+                open_txn = json_object();
+                json_object_set_new(open_txn, "start", json_integer((json_int_t)off));
+                json_object_set_new(open_txn, "end", json_integer(-1));
+                json_object_set_new(open_txn, "time", json_stringn(ts, ts_len));
+                json_object_set_new(open_txn, "status", json_string("open"));
+                json_object_set_new(open_txn, "packages", json_array());
+                json_array_append_new(txns, open_txn);
+                last_start = (json_int_t)off;
+            } else if (open_txn && msg_len > 12 && strncmp(msg, "transaction ", 12) == 0) {
+                // completed / failed / interrupted
+                json_object_set_new(open_txn, "status", json_stringn(msg + 12, msg_len - 12));
+                json_object_set_new(open_txn, "end", json_integer((json_int_t)off));
+                open_txn = NULL;
+            } else if (open_txn) {
+                add_package(open_txn, msg, msg_len);
+            }
+        }
+
+        if (contains_error_ci(line, len)) {
+            json_t *err = json_object();
+            json_object_set_new(err, "offset", json_integer((json_int_t)off));
+            json_object_set_new(err, "line", json_integer(lineno));
+            json_object_set_new(err, "text", json_stringn(line, len));
+            json_object_set_new(err, "txn", json_integer(last_start));
+            json_object_set_new(err, "during", open_txn ? json_true() : json_false());
+            json_array_append_new(errors, err);
+        }
+        off += len + 1;
+    }
+
+    json_object_set_new(idx, "lines", json_integer(lineno));
+    json_object_set_new(idx, "open", json_integer(open_txn ? json_integer_value(json_object_get(open_txn, "start")) : -1));
+    return off;
+}
+
+// Keep only the newest max entries of array key in idx
+static void trim_array(json_t *idx, const char *key, size_t max) {
+    json_t *arr = json_object_get(idx, key);
+    size_t n = json_array_size(arr);
+    if (n <= max) return;
+    json_t *kept = json_array();
+    for (size_t i = n - max; i < n; ++i) json_array_append(kept, json_array_get(arr, i));
+    json_object_set_new(idx, key, kept);
+}
+
+static void buf_appendf_transaction(char **buf, size_t *len, size_t *cap, json_t *txn, int during) {
+    char head[512];
+    json_t *pkgs = json_object_get(txn, "packages");
+    int n = snprintf(head, sizeof(head), "-- %s transaction started %s (%s), %zu package(s):",
+                     during ? "During" : "After", json_string_value(json_object_get(txn, "time")),
+                     json_string_value(json_object_get(txn, "status")), json_array_size(pkgs));
+    buf_append(buf, len, cap, head, (size_t)n < sizeof(head) ? (size_t)n : sizeof(head) - 1);
+    size_t shown = json_array_size(pkgs) < PACMAN_REPORT_MAX_PACKAGES ? json_array_size(pkgs) : PACMAN_REPORT_MAX_PACKAGES;
+    for (size_t i = 0; i < shown; ++i) {
+        json_t *p = json_array_get(pkgs, i);
+        const char *ver = json_string_value(json_object_get(p, "version"));
+        n = snprintf(head, sizeof(head), "%s %s %s (%s)", i ? "," : "",
+                     json_string_value(json_object_get(p, "action")),
+                     json_string_value(json_object_get(p, "name")), ver ? ver : "?");
+        buf_append(buf, len, cap, head, (size_t)n < sizeof(head) ? (size_t)n : sizeof(head) - 1);
+    }
+    if (json_array_size(pkgs) > shown) {
+        n = snprintf(head, sizeof(head), ", ... and %zu more", json_array_size(pkgs) - shown);
+        buf_append(buf, len, cap, head, (size_t)n);
+    }
+    buf_append(buf, len, cap, "\n", 1);
+}
+
+static char* format_errors(json_t *idx, size_t *out_len) {
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    buf_append(&buf, &len, &cap, "", 0);
+
+    json_t *txns = json_object_get(idx, "transactions");
+    json_t *errors = json_object_get(idx, "errors");
+    json_int_t prev_txn = -2;
+    int prev_during = -1;
+    for (size_t i = 0; i < json_array_size(errors); ++i) {
+        json_t *err = json_array_get(errors, i);
+        json_int_t start = json_integer_value(json_object_get(err, "txn"));
+        int during = json_is_true(json_object_get(err, "during"));
+        if (start != prev_txn || during != prev_during) {
+            json_t *txn = start >= 0 ? find_transaction(txns, start) : NULL;
+            if (txn) {
+                buf_appendf_transaction(&buf, &len, &cap, txn, during);
+            } else if (start >= 0) {
+                const char *note = "-- (transaction no longer indexed)\n";
+                buf_append(&buf, &len, &cap, note, strlen(note));
+            }
+            prev_txn = start;
+            prev_during = during;
+        }
+        char lineno[32];
+        int n = snprintf(lineno, sizeof(lineno), "%lld:", (long long)json_integer_value(json_object_get(err, "line")));
+        buf_append(&buf, &len, &cap, lineno, (size_t)n);
+        json_t *text = json_object_get(err, "text");
+        if (json_is_string(text)) buf_append(&buf, &len, &cap, json_string_value(text), json_string_length(text));
+        buf_append(&buf, &len, &cap, "\n", 1);
+    }
+    if (out_len) *out_len = len;
+    return buf;
+}
+
+char* pacman_log_errors_with_context(const char *log_path, size_t *out_len) {
+    int fd = open(log_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char path[PATH_MAX];
+    int have_path = index_path(path, sizeof(path)) == 0;
+    json_t *idx = load_index(have_path ? path : NULL, &st);
+    size_t from = (size_t)json_integer_value(json_object_get(idx, "offset"));
+    size_t size = (size_t)st.st_size;
+
+    if (size > from) {
+        // Map the whole file; only pages past the indexed offset are actually touched
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            json_decref(idx);
+            return NULL;
+        }
+        madvise((char *)map + (from & ~(size_t)(sysconf(_SC_PAGESIZE) - 1)),
+                size - (from & ~(size_t)(sysconf(_SC_PAGESIZE) - 1)), MADV_SEQUENTIAL);
+        size_t end = parse_region(idx, (const char *)map, from, size);
+        munmap(map, size);
+        json_object_set_new(idx, "offset", json_integer((json_int_t)end));
+        trim_array(idx, "transactions", PACMAN_INDEX_MAX_TRANSACTIONS);
+        trim_array(idx, "errors", PACMAN_INDEX_MAX_ERRORS);
+        if (have_path) save_index(path, idx);
+    }
+    close(fd);
+
+    char *text = format_errors(idx, out_len);
+    json_decref(idx);
+    return text;
+}
+
+char* collect_pacman_errors(const int *cancel, size_t *out_len) {
+    return pacman_log_errors_with_context(PACMAN_LOG_PATH, out_len);
+}
+
+char* pacman_log_state_token(void) {
+    struct stat st;
+    if (stat(PACMAN_LOG_PATH, &st) != 0) return NULL;
+    char token[96];
+    snprintf(token, sizeof(token), "%llu:%llu:%lld:%lld.%09ld",
+             (unsigned long long)st.st_dev, (unsigned long long)st.st_ino, (long long)st.st_size,
+             (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    return strdup(token);
+}
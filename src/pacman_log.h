@@ -0,0 +1,31 @@
+#ifndef PACMAN_LOG_H
+#define PACMAN_LOG_H
+
+#include <stddef.h>
+
+#define PACMAN_LOG_PATH "/var/log/pacman.log"
+
+// Limits on what the on-disk index keeps (oldest entries are dropped first)
+#define PACMAN_INDEX_MAX_TRANSACTIONS 200
+#define PACMAN_INDEX_MAX_ERRORS 500
+// Packages listed per transaction in the report
+#define PACMAN_REPORT_MAX_PACKAGES 30
+
+// Bring the persistent index (~/.cache/crash-reporter/pacman-index.json) up to date
+// with log_path, parsing only the bytes appended since the last run. The log is split
+// into transactions ([ALPM] transaction started .. completed/failed) with the package
+// versions they changed, and every line mentioning "error" is linked to the transaction
+// it happened in or, outside a transaction, to the one just before it.
+// Returns a report section listing errors with their transaction context (caller frees),
+// or NULL if the log cannot be read.
+char* pacman_log_errors_with_context(const char *log_path, size_t *out_len);
+
+// Report collector for PACMAN_LOG_PATH. Returns NULL when the log is not readable. Only
+// the bytes appended since the last run are parsed, so cancel is not looked at.
+char* collect_pacman_errors(const int *cancel, size_t *out_len);
+
+// Validity token for collect_pacman_errors(): device, inode, size and mtime of the log.
+// Caller frees; NULL if the log does not exist.
+char* pacman_log_state_token(void);
+
+#endif // PACMAN_LOG_H
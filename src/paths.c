@@ -0,0 +1,48 @@
+/* Per-user state and cache directories
+ * One place that resolves the XDG base directories and creates what is missing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "paths.h"
+
+// mkdir -p with mode 0700; 0 when path ends up a directory
+static int make_dirs(char *path) {
+    for (char *p = path + 1; *p; ++p) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(path, 0700);
+        *p = '/';
+    }
+    struct stat st;
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) return -1;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode) ? 0 : -1;
+}
+
+static int app_dir(const char *env, const char *fallback, const char *sub, char *out, size_t size) {
+    const char *xdg = getenv(env);
+    char dir[PATH_MAX];
+    int n;
+    if (xdg && xdg[0]) {
+        n = snprintf(dir, sizeof(dir), "%s/crash-reporter%s%s", xdg, sub ? "/" : "", sub ? sub : "");
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || !home[0]) return -1;
+        n = snprintf(dir, sizeof(dir), "%s/%s/crash-reporter%s%s", home, fallback, sub ? "/" : "", sub ? sub : "");
+    }
+    if (n < 0 || (size_t)n >= sizeof(dir) || (size_t)n >= size || make_dirs(dir) != 0) return -1;
+    memcpy(out, dir, (size_t)n + 1);
+    return 0;
+}
+
+int state_dir(const char *sub, char *out, size_t size) {
+    return app_dir("XDG_STATE_HOME", ".local/state", sub, out, size);
+}
+
+int cache_dir(const char *sub, char *out, size_t size) {
+    return app_dir("XDG_CACHE_HOME", ".cache", sub, out, size);
+}
@@ -0,0 +1,15 @@
+#ifndef PATHS_H
+#define PATHS_H
+
+#include <stddef.h>
+
+// Per-user directories of the reporter. state_dir() is $XDG_STATE_HOME/crash-reporter
+// (~/.local/state/crash-reporter by default) for what must survive: the history, the
+// spool, the fingerprint index. cache_dir() is $XDG_CACHE_HOME/crash-reporter
+// (~/.cache/crash-reporter) for what can be rebuilt. With sub not NULL the path is
+// that subdirectory. Missing directories are created, the XDG base included, mode 0700.
+// Returns 0 with the path in out, or -1 when there is no home or it cannot be created.
+int state_dir(const char *sub, char *out, size_t size);
+int cache_dir(const char *sub, char *out, size_t size);
+
+#endif // PATHS_H
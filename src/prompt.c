@@ -0,0 +1,196 @@
+/* Token-budgeted prompt packer
+ * Every line gets a score from its severity and its position in the section (logs are
+ * chronological, so later means more recent). Lines are admitted best score first until
+ * the budget is spent, then each section is written back in its original order with a
+ * note for the lines that did not make it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prompt.h"
+#include "severity.h"
+#include "strbuf.h"
+
+#define PROMPT_METADATA_TITLE "System Metadata"
+// Budget held back for the per-section notes and the closing summary
+#define PROMPT_NOTE_TOKENS 24
+#define PROMPT_SUMMARY_TOKENS 48
+
+typedef struct {
+    const char *p;
+    size_t len;              // without the newline
+    size_t section;
+    double score;
+    Severity severity;
+    int keep;
+} PackLine;
+
+typedef struct {
+    const char *header;      // "== title ==" line, NULL for text before the first header
+    size_t header_len;
+    size_t first;            // index of the first line in the lines array
+    size_t count;
+    int always;              // kept whole regardless of the budget
+    size_t dropped;
+    size_t dropped_err;      // error or worse among the dropped lines
+    size_t dropped_warn;
+} PackSection;
+
+size_t prompt_estimate_tokens(size_t bytes) {
+    return (bytes + 3) / 4;
+}
+
+static int is_header(const char *p, size_t len) {
+    return len >= 6 && memcmp(p, "== ", 3) == 0 && memcmp(p + len - 3, " ==", 3) == 0;
+}
+
+static int by_score_desc(const void *a, const void *b) {
+    const PackLine *x = *(PackLine *const *)a;
+    const PackLine *y = *(PackLine *const *)b;
+    if (x->score != y->score) return x->score < y->score ? 1 : -1;
+    return x->p < y->p ? 1 : (x->p > y->p ? -1 : 0); // later in the report first
+}
+
+char* prompt_pack(const char *report, size_t len, size_t token_budget, PromptStats *stats, size_t *out_len) {
+    PromptStats st = {0};
+    st.tokens_in = prompt_estimate_tokens(len);
+
+    // Split into sections and lines
+    size_t lines_cap = 256, sections_cap = 16, nlines = 0, nsections = 0;
+    PackLine *lines = malloc(lines_cap * sizeof(PackLine));
+    PackSection *sections = malloc(sections_cap * sizeof(PackSection));
+    if (!lines || !sections) {
+        free(lines);
+        free(sections);
+        return NULL;
+    }
+    const char *p = report, *end = report + len;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        if (is_header(p, n) || nsections == 0) {
+            if (nsections == sections_cap) {
+                PackSection *s2 = realloc(sections, sections_cap * 2 * sizeof(PackSection));
+                if (!s2) goto oom;
+                sections = s2;
+                sections_cap *= 2;
+            }
+            PackSection *s = &sections[nsections++];
+            memset(s, 0, sizeof(*s));
+            s->first = nlines;
+            if (is_header(p, n)) {
+                s->header = p;
+                s->header_len = n;
+                s->always = n == strlen("== " PROMPT_METADATA_TITLE " ==") &&
+                            memcmp(p + 3, PROMPT_METADATA_TITLE, strlen(PROMPT_METADATA_TITLE)) == 0;
+                p = nl ? nl + 1 : end;
+                continue;
+            }
+        }
+        if (nlines == lines_cap) {
+            PackLine *l2 = realloc(lines, lines_cap * 2 * sizeof(PackLine));
+            if (!l2) goto oom;
+            lines = l2;
+            lines_cap *= 2;
+        }
+        PackLine *l = &lines[nlines++];
+        l->p = p;
+        l->len = n;
+        l->section = nsections - 1;
+        l->severity = severity_of_line(p, n);
+        l->keep = 0;
+        sections[nsections - 1].count++;
+        p = nl ? nl + 1 : end;
+    }
+    st.lines_in = nlines;
+
+    size_t out_cap = 0, olen = 0;
+    char *out = NULL;
+
+    if (st.tokens_in <= token_budget) {
+        out = malloc(len + 1);
+        if (!out) goto oom;
+        memcpy(out, report, len);
+        out[len] = '\0';
+        olen = len;
+        st.tokens_out = st.tokens_in;
+    } else {
+        // Headers, notes and forced sections are paid for first
+        size_t used = PROMPT_SUMMARY_TOKENS;
+        for (size_t s = 0; s < nsections; ++s) {
+            used += prompt_estimate_tokens(sections[s].header_len + 1) + PROMPT_NOTE_TOKENS;
+            if (!sections[s].always) continue;
+            for (size_t i = sections[s].first; i < sections[s].first + sections[s].count; ++i) {
+                lines[i].keep = 1;
+                used += prompt_estimate_tokens(lines[i].len + 1);
+            }
+        }
+
+        // Severity dominates; within a severity, the newest lines of each section win
+        PackLine **order = malloc((nlines ? nlines : 1) * sizeof(PackLine*));
+        if (!order) goto oom;
+        size_t norder = 0;
+        for (size_t i = 0; i < nlines; ++i) {
+            if (lines[i].keep) continue;
+            const PackSection *s = &sections[lines[i].section];
+            double recency = (double)(i - s->first + 1) / (double)s->count;
+            lines[i].score = lines[i].severity * 2.0 + recency;
+            order[norder++] = &lines[i];
+        }
+        qsort(order, norder, sizeof(PackLine*), by_score_desc);
+        for (size_t k = 0; k < norder; ++k) {
+            size_t t = prompt_estimate_tokens(order[k]->len + 1);
+            if (used + t > token_budget) continue; // a shorter line further down may still fit
+            order[k]->keep = 1;
+            used += t;
+        }
+        free(order);
+
+        for (size_t s = 0; s < nsections; ++s) {
+            PackSection *sec = &sections[s];
+            if (sec->header && (buf_append(&out, &olen, &out_cap, sec->header, sec->header_len) != 0 ||
+                                buf_append(&out, &olen, &out_cap, "\n", 1) != 0)) goto oom_out;
+            for (size_t i = sec->first; i < sec->first + sec->count; ++i) {
+                if (!lines[i].keep) {
+                    sec->dropped++;
+                    if (lines[i].severity >= SEVERITY_ERROR) sec->dropped_err++;
+                    else if (lines[i].severity == SEVERITY_WARNING) sec->dropped_warn++;
+                    continue;
+                }
+                if (buf_append(&out, &olen, &out_cap, lines[i].p, lines[i].len) != 0 ||
+                    buf_append(&out, &olen, &out_cap, "\n", 1) != 0) goto oom_out;
+            }
+            if (sec->dropped > 0) {
+                char note[160];
+                int n = snprintf(note, sizeof(note), "[... %zu of %zu lines left out (%zu errors, %zu warnings) ...]\n",
+                                 sec->dropped, sec->count, sec->dropped_err, sec->dropped_warn);
+                if (n > 0 && buf_append(&out, &olen, &out_cap, note, (size_t)n) != 0) goto oom_out;
+                st.lines_dropped += sec->dropped;
+            }
+        }
+        if (st.lines_dropped > 0) {
+            char summary[256];
+            int n = snprintf(summary, sizeof(summary),
+                             "\n[Report packed from about %zu to %zu tokens: %zu of %zu lines left out, "
+                             "keeping the most severe and most recent lines of each section.]\n",
+                             st.tokens_in, prompt_estimate_tokens(olen), st.lines_dropped, st.lines_in);
+            if (n > 0 && buf_append(&out, &olen, &out_cap, summary, (size_t)n) != 0) goto oom_out;
+        }
+        if (!out && buf_append(&out, &olen, &out_cap, "", 0) != 0) goto oom_out;
+        st.tokens_out = prompt_estimate_tokens(olen);
+    }
+
+    free(lines);
+    free(sections);
+    if (stats) *stats = st;
+    if (out_len) *out_len = olen;
+    return out;
+
+oom_out:
+    free(out);
+oom:
+    free(lines);
+    free(sections);
+    return NULL;
+}
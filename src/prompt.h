@@ -0,0 +1,26 @@
+#ifndef PROMPT_H
+#define PROMPT_H
+
+#include <stddef.h>
+
+// Prompt packing for the AI summary: fit a gathered report into a token budget by keeping
+// the most severe and most recent lines of every section, in their original order, and
+// replacing what does not fit with a short note of what was left out.
+
+typedef struct {
+    size_t tokens_in;        // estimate for the whole report
+    size_t tokens_out;       // estimate for the packed prompt
+    size_t lines_in;
+    size_t lines_dropped;
+} PromptStats;
+
+// Rough token count for text sent to the model (about 4 bytes per token).
+size_t prompt_estimate_tokens(size_t bytes);
+
+// Pack report (as built by gather_all_errors(): "== title ==" sections) into about
+// token_budget tokens. A report that already fits is copied unchanged. The System
+// Metadata section is always kept whole. stats may be NULL. Caller frees; NULL when
+// out of memory.
+char* prompt_pack(const char *report, size_t len, size_t token_budget, PromptStats *stats, size_t *out_len);
+
+#endif // PROMPT_H
@@ -0,0 +1,388 @@
+/* Segmented report
+ * A report is an array of iovecs over memory it holds (snapshot outputs, a small arena
+ * for headers and markers) or borrows (literals, another report). Building,
+ * cutting and serializing it only moves slices around; the bytes are copied once at
+ * most, when something needs the whole report as one string or as a JSON string.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "report.h"
+#include "capture.h"
+
+// Arena blocks for copied text; a longer copy gets a block of its own
+#define REPORT_ARENA_BLOCK 4096
+
+typedef struct {
+    void *obj;
+    void (*release)(void *obj);
+} ReportHold;
+
+struct Report {
+    struct iovec *iov;
+    size_t niov, iov_cap;
+    size_t len;
+    ReportHold *holds;       // memory slices point into, released with the report or by report_text()
+    size_t nholds, holds_cap;
+    void **arena;            // blocks holding copied text and section titles
+    size_t narena, arena_cap;
+    size_t arena_used;       // in the last block
+    size_t arena_size;
+    ReportSection *sections;
+    size_t nsections, sections_cap;
+    int in_section;
+    char *text;              // set once report_text() compacted the report
+    int broken;              // out of memory at some point
+};
+
+static int grow(void **items, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return 0;
+    size_t n = *cap ? *cap * 2 : 16;
+    while (n < need) n *= 2;
+    void *p = realloc(*items, n * size);
+    if (!p) return -1;
+    *items = p;
+    *cap = n;
+    return 0;
+}
+
+Report* report_new(void) {
+    return calloc(1, sizeof(Report));
+}
+
+void report_free(Report *r) {
+    if (!r) return;
+    for (size_t i = 0; i < r->nholds; ++i) r->holds[i].release(r->holds[i].obj);
+    for (size_t i = 0; i < r->narena; ++i) free(r->arena[i]);
+    free(r->holds);
+    free(r->arena);
+    free(r->iov);
+    free(r->sections);
+    free(r);
+}
+
+int report_hold(Report *r, void *obj, void (*release)(void *obj)) {
+    if (grow((void **)&r->holds, &r->holds_cap, r->nholds + 1, sizeof(ReportHold)) != 0) return -1;
+    r->holds[r->nholds].obj = obj;
+    r->holds[r->nholds].release = release;
+    r->nholds++;
+    return 0;
+}
+
+int report_own(Report *r, void *buf) {
+    return report_hold(r, buf, free);
+}
+
+void report_append(Report *r, const char *data, size_t len) {
+    if (r->broken || len == 0) return;
+    r->len += len;
+    // Pieces that follow each other in memory stay one slice
+    if (r->niov > 0) {
+        struct iovec *last = &r->iov[r->niov - 1];
+        if ((const char *)last->iov_base + last->iov_len == data) {
+            last->iov_len += len;
+            return;
+        }
+    }
+    if (grow((void **)&r->iov, &r->iov_cap, r->niov + 1, sizeof(struct iovec)) != 0) {
+        r->broken = 1;
+        return;
+    }
+    r->iov[r->niov].iov_base = (void *)data;
+    r->iov[r->niov].iov_len = len;
+    r->niov++;
+}
+
+// n bytes of arena, contiguous with the previous allocation when the block has room
+static char* arena_alloc(Report *r, size_t n) {
+    if (r->narena == 0 || r->arena_size - r->arena_used < n) {
+        size_t size = n > REPORT_ARENA_BLOCK ? n : REPORT_ARENA_BLOCK;
+        char *block = malloc(size);
+        if (!block || grow((void **)&r->arena, &r->arena_cap, r->narena + 1, sizeof(void *)) != 0) {
+            free(block);
+            r->broken = 1;
+            return NULL;
+        }
+        r->arena[r->narena++] = block;
+        r->arena_size = size;
+        r->arena_used = 0;
+    }
+    char *p = (char *)r->arena[r->narena - 1] + r->arena_used;
+    r->arena_used += n;
+    return p;
+}
+
+void report_append_copy(Report *r, const char *data, size_t len) {
+    if (r->broken || len == 0) return;
+    char *p = arena_alloc(r, len);
+    if (!p) return;
+    memcpy(p, data, len);
+    report_append(r, p, len);
+}
+
+void report_printf(Report *r, const char *fmt, ...) {
+    if (r->broken) return;
+    char small[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(small, sizeof(small), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n < sizeof(small)) {
+        report_append_copy(r, small, (size_t)n);
+        return;
+    }
+    char *p = arena_alloc(r, (size_t)n + 1);
+    if (!p) return;
+    va_start(ap, fmt);
+    vsnprintf(p, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    r->arena_used--; // the NUL is not part of the text; the next copy may overwrite it
+    report_append(r, p, (size_t)n);
+}
+
+void report_append_bounded(Report *r, const char *data, size_t len, size_t budget) {
+    CaptureCut cut;
+    capture_cut(data, len, budget, &cut);
+    report_append(r, data, cut.head_len);
+    report_append_copy(r, cut.marker, cut.marker_len);
+    report_append(r, data + cut.tail_off, cut.tail_len);
+}
+
+void report_append_range(Report *r, const Report *src, size_t offset, size_t len) {
+    for (size_t i = 0; i < src->niov && len > 0; ++i) {
+        size_t n = src->iov[i].iov_len;
+        if (offset >= n) {
+            offset -= n;
+            continue;
+        }
+        size_t take = n - offset < len ? n - offset : len;
+        report_append(r, (const char *)src->iov[i].iov_base + offset, take);
+        len -= take;
+        offset = 0;
+    }
+}
+
+void report_begin_section(Report *r, const char *title) {
+    if (r->broken) return;
+    if (!title) title = "";
+    if (grow((void **)&r->sections, &r->sections_cap, r->nsections + 1, sizeof(ReportSection)) != 0) {
+        r->broken = 1;
+        return;
+    }
+    size_t tlen = strlen(title);
+    char *t = arena_alloc(r, tlen + 1);
+    if (!t) return;
+    memcpy(t, title, tlen + 1);
+    ReportSection *s = &r->sections[r->nsections++];
+    s->title = t;
+    s->offset = r->len;
+    report_printf(r, "== %s ==\n", title);
+    s->body_offset = r->len;
+    s->body_len = 0;
+    s->len = r->len - s->offset;
+    r->in_section = 1;
+}
+
+void report_end_section(Report *r) {
+    if (r->broken || !r->in_section) return;
+    ReportSection *s = &r->sections[r->nsections - 1];
+    s->body_len = r->len - s->body_offset;
+    report_append(r, "\n", 1);
+    s->len = r->len - s->offset;
+    r->in_section = 0;
+}
+
+size_t report_length(const Report *r) {
+    return r->len;
+}
+
+size_t report_nsections(const Report *r) {
+    return r->nsections;
+}
+
+const ReportSection* report_section(const Report *r, size_t i) {
+    return i < r->nsections ? &r->sections[i] : NULL;
+}
+
+const struct iovec* report_iov(const Report *r, size_t *count) {
+    *count = r->niov;
+    return r->iov;
+}
+
+static int byte_at(const Report *r, size_t offset) {
+    for (size_t i = 0; i < r->niov; ++i) {
+        if (offset < r->iov[i].iov_len) return ((const unsigned char *)r->iov[i].iov_base)[offset];
+        offset -= r->iov[i].iov_len;
+    }
+    return -1;
+}
+
+size_t report_char_boundary(const Report *r, size_t offset) {
+    if (offset >= r->len) return r->len;
+    // A UTF-8 sequence has at most three continuation bytes
+    for (size_t back = 0; back < 4 && back <= offset; ++back) {
+        int c = byte_at(r, offset - back);
+        if ((c & 0xC0) != 0x80) return offset - back;
+    }
+    return offset;
+}
+
+static void copy_out(const Report *r, char *dst) {
+    for (size_t i = 0; i < r->niov; ++i) {
+        memcpy(dst, r->iov[i].iov_base, r->iov[i].iov_len);
+        dst += r->iov[i].iov_len;
+    }
+    *dst = '\0';
+}
+
+char* report_flatten(const Report *r, size_t *len) {
+    if (r->broken) return NULL;
+    char *out = malloc(r->len + 1);
+    if (!out) return NULL;
+    copy_out(r, out);
+    if (len) *len = r->len;
+    return out;
+}
+
+const char* report_text(Report *r, size_t *len) {
+    if (r->broken) return NULL;
+    if (!r->text || r->niov != 1 || r->iov[0].iov_base != r->text) {
+        size_t total = r->len;
+        char *text = report_flatten(r, NULL);
+        if (!text || grow((void **)&r->holds, &r->holds_cap, 1, sizeof(ReportHold)) != 0) {
+            free(text);
+            return NULL;
+        }
+        // Everything now lives in text; the held buffers (and an older text) go. The
+        // arena stays, it holds the section titles.
+        for (size_t i = 0; i < r->nholds; ++i) r->holds[i].release(r->holds[i].obj);
+        r->holds[0].obj = text;
+        r->holds[0].release = free;
+        r->nholds = 1;
+        r->niov = 0;
+        r->len = 0;
+        report_append(r, text, total);
+        r->text = text;
+    }
+    if (len) *len = r->len;
+    return r->text;
+}
+
+int report_write(const Report *r, FILE *out) {
+    if (r->broken) return -1;
+    for (size_t i = 0; i < r->niov; ++i) {
+        if (fwrite(r->iov[i].iov_base, 1, r->iov[i].iov_len, out) != r->iov[i].iov_len) return -1;
+    }
+    return 0;
+}
+
+/* ---- JSON string escaping ---- */
+
+// Counts (out == NULL) or writes the escaped text. A UTF-8 sequence split between two
+// slices is carried over in seq.
+typedef struct {
+    char *out;
+    size_t n;
+    unsigned char seq[4];
+    int have, need;
+} JsonEscape;
+
+static void esc_put(JsonEscape *e, const void *p, size_t n) {
+    if (e->out) memcpy(e->out + e->n, p, n);
+    e->n += n;
+}
+
+static void esc_invalid(JsonEscape *e) {
+    esc_put(e, "\xef\xbf\xbd", 3); // U+FFFD
+    e->have = e->need = 0;
+}
+
+// Continuation bytes, without overlong forms, surrogates or code points past U+10FFFF
+static int continuation_ok(const JsonEscape *e, unsigned char c) {
+    if ((c & 0xC0) != 0x80) return 0;
+    if (e->have != 1) return 1;
+    switch (e->seq[0]) {
+        case 0xE0: return c >= 0xA0;
+        case 0xED: return c < 0xA0;
+        case 0xF0: return c >= 0x90;
+        case 0xF4: return c < 0x90;
+        default: return 1;
+    }
+}
+
+static void esc_bytes(JsonEscape *e, const unsigned char *p, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = p[i];
+        if (e->need) {
+            if (!continuation_ok(e, c)) {
+                esc_invalid(e); // c starts over
+                continue;
+            }
+            e->seq[e->have++] = c;
+            i++;
+            if (e->have == e->need) {
+                esc_put(e, e->seq, (size_t)e->have);
+                e->have = e->need = 0;
+            }
+            continue;
+        }
+        // Runs of plain ASCII go out as they are
+        size_t j = i;
+        while (j < len && p[j] >= 0x20 && p[j] < 0x80 && p[j] != '"' && p[j] != '\\') j++;
+        if (j > i) {
+            esc_put(e, p + i, j - i);
+            i = j;
+            continue;
+        }
+        i++;
+        if (c < 0x80) {
+            char esc[6] = {'\\', 0, 0, 0, 0, 0};
+            switch (c) {
+                case '"': esc[1] = '"'; break;
+                case '\\': esc[1] = '\\'; break;
+                case '\b': esc[1] = 'b'; break;
+                case '\f': esc[1] = 'f'; break;
+                case '\n': esc[1] = 'n'; break;
+                case '\r': esc[1] = 'r'; break;
+                case '\t': esc[1] = 't'; break;
+                default:
+                    memcpy(esc + 1, "u00", 3);
+                    esc[4] = hex[c >> 4];
+                    esc[5] = hex[c & 15];
+                    esc_put(e, esc, 6);
+                    continue;
+            }
+            esc_put(e, esc, 2);
+        } else if (c >= 0xC2 && c <= 0xF4) {
+            e->seq[0] = c;
+            e->have = 1;
+            e->need = c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        } else {
+            esc_invalid(e);
+        }
+    }
+}
+
+static size_t json_escape(const Report *r, char *out) {
+    JsonEscape e = {out, 0, {0}, 0, 0};
+    esc_put(&e, "\"", 1);
+    for (size_t i = 0; i < r->niov; ++i) esc_bytes(&e, r->iov[i].iov_base, r->iov[i].iov_len);
+    if (e.need) esc_invalid(&e); // cut off in the middle of a sequence
+    esc_put(&e, "\"", 1);
+    return e.n;
+}
+
+size_t report_json_length(const Report *r) {
+    return json_escape(r, NULL);
+}
+
+char* report_json_write(const Report *r, char *dst) {
+    return dst + json_escape(r, dst);
+}
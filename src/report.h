@@ -0,0 +1,84 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/uio.h>
+
+// A report as a list of slices of memory rather than one string. Collector output is
+// handed over once and referenced from then on, so cutting a section to its budget,
+// putting an issue body together and serializing it as JSON move pointers, not bytes.
+// Lengths are kept as the report grows and each "== title ==" section is recorded.
+//
+// Appending never fails visibly: when memory runs out the report is marked broken and
+// report_text()/report_flatten() return NULL.
+
+typedef struct Report Report;
+
+typedef struct {
+    const char *title;
+    size_t offset;           // where the "== title ==" line starts
+    size_t len;              // header, body and the blank line after it
+    size_t body_offset;      // the section's text without its header and blank line
+    size_t body_len;
+} ReportSection;
+
+Report* report_new(void);
+void report_free(Report *r);
+
+// Hand over a malloc'd buffer that slices will point into; it is freed with the report.
+// Returns -1, leaving buf with the caller, when out of memory.
+int report_own(Report *r, void *buf);
+
+// Keep obj (shared memory such as a snapshot output) alive while slices point into it:
+// release(obj) runs when the report is freed or its text is taken. Returns -1, leaving
+// obj with the caller, when out of memory.
+int report_hold(Report *r, void *obj, void (*release)(void *obj));
+
+// Reference len bytes that live at least as long as the report: literals, owned or
+// held buffers, or another report's text.
+void report_append(Report *r, const char *data, size_t len);
+
+// Copy short text (headers, markers) into storage of the report's own
+void report_append_copy(Report *r, const char *data, size_t len);
+void report_printf(Report *r, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Reference data cut to budget the way capture_bounded_copy() cuts it: its head, a skip
+// marker, its tail.
+void report_append_bounded(Report *r, const char *data, size_t len, size_t budget);
+
+// Reference bytes offset..offset+len of src, which must outlive r and must not have its
+// text taken (report_text()) afterwards
+void report_append_range(Report *r, const Report *src, size_t offset, size_t len);
+
+// Everything appended between these two is one section: "== title ==\n", the body, "\n"
+void report_begin_section(Report *r, const char *title);
+void report_end_section(Report *r);
+
+size_t report_length(const Report *r);
+size_t report_nsections(const Report *r);
+const ReportSection* report_section(const Report *r, size_t i);
+
+// The slices in order, for writev()
+const struct iovec* report_iov(const Report *r, size_t *count);
+
+// Largest offset <= offset that does not split a UTF-8 sequence
+size_t report_char_boundary(const Report *r, size_t offset);
+
+// The report as one NUL-terminated string. The first call copies it together once;
+// the slices are moved onto that copy and the buffers they pointed into are freed or
+// released, so the report holds nothing but the text. NULL when out of memory.
+const char* report_text(Report *r, size_t *len);
+
+// A copy as one NUL-terminated string the caller frees
+char* report_flatten(const Report *r, size_t *len);
+
+int report_write(const Report *r, FILE *out);
+
+// The report as a JSON string, quotes included: report_json_length() bytes written to
+// dst by report_json_write(), which returns the end. Bytes that are not UTF-8 become
+// U+FFFD, also when a sequence is split across slices.
+size_t report_json_length(const Report *r);
+char* report_json_write(const Report *r, char *dst);
+
+#endif // REPORT_H
@@ -0,0 +1,203 @@
+/* Aho-Corasick severity matcher
+ * The keyword trie is turned into a full DFA over lowercased bytes: every state has a
+ * transition for every byte and carries the highest severity of the keywords ending
+ * there (including those reached through failure links). Scanning is then one table
+ * lookup per byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "severity.h"
+#include "config.h"
+
+typedef struct {
+    const char *keyword;
+    Severity severity;
+} SeverityKeyword;
+
+static const SeverityKeyword keywords[] = { SEVERITY_KEYWORDS };
+#define NKEYWORDS (sizeof(keywords) / sizeof(keywords[0]))
+
+typedef struct {
+    int (*next)[256];        // transitions
+    unsigned char *out;      // severity matched on entering the state
+    int nstates;
+} Automaton;
+
+static Automaton automaton;
+static pthread_once_t automaton_once = PTHREAD_ONCE_INIT;
+
+static void build_automaton(void) {
+    int max_states = 1;
+    for (size_t k = 0; k < NKEYWORDS; ++k) max_states += (int)strlen(keywords[k].keyword);
+    int (*next)[256] = malloc((size_t)max_states * sizeof(*next));
+    unsigned char *out = calloc((size_t)max_states, 1);
+    int *fail = calloc((size_t)max_states, sizeof(int));
+    int *queue = malloc((size_t)max_states * sizeof(int));
+    if (!next || !out || !fail || !queue) {
+        free(next);
+        free(out);
+        free(fail);
+        free(queue);
+        return; // severity_of_line/severity_scan then find nothing
+    }
+    memset(next, -1, (size_t)max_states * sizeof(*next));
+
+    // Trie
+    int nstates = 1;
+    for (size_t k = 0; k < NKEYWORDS; ++k) {
+        int s = 0;
+        for (const char *c = keywords[k].keyword; *c; ++c) {
+            unsigned char b = (unsigned char)tolower((unsigned char)*c);
+            if (next[s][b] < 0) next[s][b] = nstates++;
+            s = next[s][b];
+        }
+        if (out[s] < keywords[k].severity) out[s] = (unsigned char)keywords[k].severity;
+    }
+
+    // Failure links breadth first, filling in the missing transitions as we go
+    int head = 0, tail = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (next[0][b] < 0) {
+            next[0][b] = 0;
+        } else {
+            fail[next[0][b]] = 0;
+            queue[tail++] = next[0][b];
+        }
+    }
+    while (head < tail) {
+        int s = queue[head++];
+        if (out[s] < out[fail[s]]) out[s] = out[fail[s]];
+        for (int b = 0; b < 256; ++b) {
+            int t = next[s][b];
+            if (t < 0) {
+                next[s][b] = next[fail[s]][b];
+            } else {
+                fail[t] = next[fail[s]][b];
+                queue[tail++] = t;
+            }
+        }
+    }
+
+    // Case folding: upper-case input follows the lower-case transitions
+    for (int s = 0; s < nstates; ++s) {
+        for (int b = 'A'; b <= 'Z'; ++b) next[s][b] = next[s][b - 'A' + 'a'];
+    }
+
+    free(fail);
+    free(queue);
+    automaton.next = next;
+    automaton.out = out;
+    automaton.nstates = nstates;
+}
+
+static const Automaton* get_automaton(void) {
+    pthread_once(&automaton_once, build_automaton);
+    return automaton.next ? &automaton : NULL;
+}
+
+Severity severity_of_line(const char *line, size_t len) {
+    const Automaton *a = get_automaton();
+    if (!a) return SEVERITY_NONE;
+    int s = 0;
+    unsigned char best = 0;
+    for (size_t i = 0; i < len; ++i) {
+        s = a->next[s][(unsigned char)line[i]];
+        if (a->out[s] > best) best = a->out[s];
+    }
+    return (Severity)best;
+}
+
+static int is_header(const char *p, size_t len) {
+    return len >= 6 && memcmp(p, "== ", 3) == 0 && memcmp(p + len - 3, " ==", 3) == 0;
+}
+
+static int add_section(SeverityReport *r, size_t *cap, const char *title, size_t title_len) {
+    if (r->nsections == *cap) {
+        size_t c = *cap ? *cap * 2 : 16;
+        SeveritySection *s = realloc(r->sections, c * sizeof(SeveritySection));
+        if (!s) return -1;
+        r->sections = s;
+        *cap = c;
+    }
+    SeveritySection *sec = &r->sections[r->nsections++];
+    memset(sec, 0, sizeof(*sec));
+    if (title_len >= sizeof(sec->title)) title_len = sizeof(sec->title) - 1;
+    memcpy(sec->title, title, title_len);
+    return 0;
+}
+
+int severity_scan(const char *text, size_t len, SeverityReport *out) {
+    memset(out, 0, sizeof(*out));
+    const Automaton *a = get_automaton();
+    size_t sections_cap = 0, hits_cap = 0;
+    if (add_section(out, &sections_cap, "", 0) != 0) return -1;
+
+    size_t i = 0;
+    while (i < len) {
+        const char *nl = memchr(text + i, '\n', len - i);
+        size_t end = nl ? (size_t)(nl - text) : len;
+        if (text[i] == '=' && is_header(text + i, end - i)) {
+            // Section titles such as "Journalctl (errors)" are not hits
+            if (i == 0) out->nsections = 0; // no text before the first header
+            if (add_section(out, &sections_cap, text + i + 3, end - i - 6) != 0) goto oom;
+        } else if (a) {
+            int s = 0;
+            unsigned char best = 0;
+            for (size_t k = i; k < end; ++k) {
+                s = a->next[s][(unsigned char)text[k]];
+                if (a->out[s] > best) best = a->out[s];
+            }
+            SeveritySection *sec = &out->sections[out->nsections - 1];
+            sec->counts[best]++;
+            out->counts[best]++;
+            if (best) {
+                if (out->nhits == SEVERITY_MAX_HITS) {
+                    out->hits_dropped++;
+                } else {
+                    if (out->nhits == hits_cap) {
+                        size_t c = hits_cap ? hits_cap * 2 : 64;
+                        SeverityHit *h = realloc(out->hits, c * sizeof(SeverityHit));
+                        if (!h) goto oom;
+                        out->hits = h;
+                        hits_cap = c;
+                    }
+                    out->hits[out->nhits].offset = i;
+                    out->hits[out->nhits].section = out->nsections - 1;
+                    out->hits[out->nhits].severity = (Severity)best;
+                    out->nhits++;
+                }
+            }
+        }
+        i = end + 1;
+    }
+    return 0;
+
+oom:
+    severity_report_free(out);
+    return -1;
+}
+
+void severity_report_free(SeverityReport *report) {
+    free(report->sections);
+    free(report->hits);
+    memset(report, 0, sizeof(*report));
+}
+
+int severity_worth_filing(const SeverityReport *report) {
+    size_t hits = 0;
+    for (int s = SEVERITY_FILE_MIN_LEVEL; s < SEVERITY_LEVELS; ++s) hits += report->counts[s];
+    return hits >= SEVERITY_FILE_MIN_HITS;
+}
+
+const char* severity_name(Severity s) {
+    switch (s) {
+        case SEVERITY_WARNING: return "warning";
+        case SEVERITY_ERROR: return "error";
+        case SEVERITY_CRITICAL: return "critical";
+        default: return "none";
+    }
+}
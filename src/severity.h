@@ -0,0 +1,55 @@
+#ifndef SEVERITY_H
+#define SEVERITY_H
+
+#include <stddef.h>
+
+// Case-insensitive multi-keyword severity matching. The keyword table (SEVERITY_KEYWORDS
+// in config.h) is compiled once into an Aho-Corasick automaton, so a report is classified
+// in a single pass whatever the number of keywords. A line counts once, at the highest
+// severity of the keywords it contains.
+
+typedef enum {
+    SEVERITY_NONE,
+    SEVERITY_WARNING,
+    SEVERITY_ERROR,
+    SEVERITY_CRITICAL,
+    SEVERITY_LEVELS
+} Severity;
+
+typedef struct {
+    size_t offset;           // start of the line in the scanned text
+    size_t section;          // index into SeverityReport.sections
+    Severity severity;
+} SeverityHit;
+
+typedef struct {
+    char title[128];         // from the "== title ==" line, empty before the first one
+    size_t counts[SEVERITY_LEVELS];
+} SeveritySection;
+
+typedef struct {
+    SeveritySection *sections;
+    size_t nsections;
+    size_t counts[SEVERITY_LEVELS];  // lines per severity over the whole text
+    SeverityHit *hits;               // matching lines in order, at most SEVERITY_MAX_HITS
+    size_t nhits;
+    size_t hits_dropped;             // matching lines beyond that (still counted)
+} SeverityReport;
+
+#define SEVERITY_MAX_HITS 4096
+
+// Highest keyword severity in one line
+Severity severity_of_line(const char *line, size_t len);
+
+// Classify every line of a report ("== title ==" header lines are section boundaries and
+// are not matched themselves). Returns 0, or -1 when out of memory.
+int severity_scan(const char *text, size_t len, SeverityReport *out);
+
+void severity_report_free(SeverityReport *report);
+
+// Whether the report has enough hits at or above SEVERITY_FILE_MIN_LEVEL to be filed
+int severity_worth_filing(const SeverityReport *report);
+
+const char* severity_name(Severity s);
+
+#endif // SEVERITY_H
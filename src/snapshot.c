@@ -0,0 +1,203 @@
+/* Collection snapshot cache
+ * Keeps the last output of every collector together with a validity token so the
+ * GUI view and a bug report filed right after it share one collection.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "snapshot.h"
+
+typedef struct {
+    char *name;
+    SnapshotOutput *output;  // the snapshot's reference
+    char *token;          // NULL if the source has no token
+    time_t collected_at;  // CLOCK_MONOTONIC seconds
+} SnapshotEntry;
+
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+static SnapshotEntry *entries = NULL;
+static size_t nentries = 0;
+
+// Maps the engine's indices (into the stale subset) back to the caller's
+typedef struct {
+    const CollectorProgress *outer;
+    const size_t *index_map;
+} StaleProgress;
+
+static void stale_done(size_t index, const char *output, size_t len, void *user) {
+    StaleProgress *sp = user;
+    sp->outer->on_done(sp->index_map[index], output, len, sp->outer->user);
+}
+
+static time_t now_monotonic(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static SnapshotEntry* find_entry(const char *name) {
+    for (size_t i = 0; i < nentries; ++i) {
+        if (strcmp(entries[i].name, name) == 0) return &entries[i];
+    }
+    return NULL;
+}
+
+// Takes output (malloc'd, NUL-terminated); the caller gets the first reference
+static SnapshotOutput* output_new(char *data, size_t len) {
+    SnapshotOutput *o = malloc(sizeof(SnapshotOutput));
+    if (!o) return NULL;
+    o->data = data;
+    o->len = len;
+    o->refs = 1;
+    return o;
+}
+
+static SnapshotOutput* output_ref(SnapshotOutput *o) {
+    __atomic_add_fetch(&o->refs, 1, __ATOMIC_RELAXED);
+    return o;
+}
+
+void snapshot_output_release(SnapshotOutput *o) {
+    if (!o || __atomic_sub_fetch(&o->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    free((char *)o->data);
+    free(o);
+}
+
+static int entry_valid(const SnapshotEntry *e, const char *token, time_t now) {
+    if (!e || !e->output) return 0;
+    time_t age = now - e->collected_at;
+    if (age > SNAPSHOT_MAX_AGE) return 0;
+    if (!token || !e->token) return !token && !e->token && age <= SNAPSHOT_TOKENLESS_MAX_AGE;
+    return strcmp(token, e->token) == 0;
+}
+
+static void store_entry(const char *name, SnapshotOutput *output, char *token, time_t now) {
+    SnapshotEntry *e = find_entry(name);
+    if (!e) {
+        SnapshotEntry *n = realloc(entries, (nentries + 1) * sizeof(SnapshotEntry));
+        if (!n) {
+            free(token);
+            return;
+        }
+        entries = n;
+        e = &entries[nentries++];
+        memset(e, 0, sizeof(*e));
+        e->name = strdup(name);
+    }
+    // Whoever still holds the previous output keeps it until they release it
+    snapshot_output_release(e->output);
+    free(e->token);
+    e->output = output_ref(output);
+    e->token = token;
+    e->collected_at = now;
+}
+
+SnapshotOutput** snapshot_collect(const CollectorSpec *specs, size_t n, const CollectorProgress *progress) {
+    SnapshotOutput **results = calloc(n, sizeof(SnapshotOutput*));
+    char **tokens = calloc(n, sizeof(char*));
+    CollectorSpec *stale = calloc(n, sizeof(CollectorSpec));
+    size_t *stale_idx = calloc(n, sizeof(size_t));
+    unsigned char *cached = calloc(n, 1);
+    if (!results || !tokens || !stale || !stale_idx || !cached) {
+        free(results);
+        free(tokens);
+        free(stale);
+        free(stale_idx);
+        free(cached);
+        return NULL;
+    }
+
+    // Only sources with a cached section have their token checked up front; the others
+    // take theirs inside their collector job. Either way the token is taken before the
+    // source is read, so a change during collection shows up next time.
+    pthread_mutex_lock(&snapshot_lock);
+    time_t now = now_monotonic();
+    for (size_t i = 0; i < n; ++i) {
+        SnapshotEntry *e = find_entry(specs[i].name);
+        cached[i] = e && e->output && now - e->collected_at <= SNAPSHOT_MAX_AGE;
+    }
+    pthread_mutex_unlock(&snapshot_lock);
+    for (size_t i = 0; i < n; ++i) {
+        if (cached[i] && specs[i].token) tokens[i] = specs[i].token();
+    }
+
+    pthread_mutex_lock(&snapshot_lock);
+    now = now_monotonic();
+    size_t nstale = 0;
+    for (size_t i = 0; i < n; ++i) {
+        SnapshotEntry *e = cached[i] ? find_entry(specs[i].name) : NULL;
+        if (entry_valid(e, tokens[i], now)) {
+            results[i] = output_ref(e->output);
+            continue;
+        }
+        stale[nstale] = specs[i];
+        stale_idx[nstale++] = i;
+    }
+    // Collection itself runs unlocked; concurrent callers may both refresh a source,
+    // which costs time but never correctness
+    pthread_mutex_unlock(&snapshot_lock);
+
+    if (progress && progress->on_done) {
+        for (size_t i = 0, k = 0; i < n; ++i) {
+            if (k < nstale && stale_idx[k] == i) {
+                k++;
+                continue;
+            }
+            progress->on_done(i, results[i]->data, results[i]->len, progress->user);
+        }
+    }
+
+    if (nstale > 0) {
+        StaleProgress sp = { progress, stale_idx };
+        size_t *lens = calloc(nstale, sizeof(size_t));
+        char **stale_tokens = calloc(nstale, sizeof(char*));
+        CollectorProgress inner = { progress && progress->on_done ? stale_done : NULL, &sp,
+                                    progress ? progress->cancel : NULL, stale_tokens };
+        for (size_t k = 0; stale_tokens && k < nstale; ++k) {
+            stale_tokens[k] = tokens[stale_idx[k]]; // already taken for a section that changed
+            tokens[stale_idx[k]] = NULL;
+        }
+        char **fresh = lens && stale_tokens ? run_collectors_parallel(stale, nstale, lens, &inner) : NULL;
+        pthread_mutex_lock(&snapshot_lock);
+        now = now_monotonic();
+        for (size_t k = 0; k < nstale; ++k) {
+            size_t i = stale_idx[k];
+            if (!fresh || !fresh[k]) continue;
+            results[i] = output_new(fresh[k], lens[k]);
+            if (!results[i]) {
+                free(fresh[k]);
+                continue;
+            }
+            store_entry(specs[i].name, results[i], stale_tokens[k], now);
+            stale_tokens[k] = NULL; // owned by the snapshot now
+        }
+        pthread_mutex_unlock(&snapshot_lock);
+        for (size_t k = 0; stale_tokens && k < nstale; ++k) free(stale_tokens[k]);
+        free(stale_tokens);
+        free(fresh);
+        free(lens);
+    }
+
+    for (size_t i = 0; i < n; ++i) free(tokens[i]);
+    free(tokens);
+    free(stale);
+    free(stale_idx);
+    free(cached);
+    return results;
+}
+
+void snapshot_invalidate(void) {
+    pthread_mutex_lock(&snapshot_lock);
+    for (size_t i = 0; i < nentries; ++i) {
+        free(entries[i].name);
+        snapshot_output_release(entries[i].output);
+        free(entries[i].token);
+    }
+    free(entries);
+    entries = NULL;
+    nentries = 0;
+    pthread_mutex_unlock(&snapshot_lock);
+}
@@ -0,0 +1,34 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include "collector.h"
+
+// A cached section is never reused after this many seconds, whatever its token says
+#define SNAPSHOT_MAX_AGE 600
+// Sources without a validity token are reused for this long
+#define SNAPSHOT_TOKENLESS_MAX_AGE 60
+
+// One collector's output, shared by the snapshot and everyone it was handed to. It is
+// read-only; each holder gives its reference back with snapshot_output_release().
+typedef struct {
+    const char *data;        // NUL-terminated
+    size_t len;
+    int refs;                // managed by snapshot.c
+} SnapshotOutput;
+
+// Like run_collectors_parallel(), but backed by a process-wide snapshot: every section
+// is stored with its collection time and the source's validity token (journal cursor,
+// kmsg sequence, log size/mtime, ...). A later call reuses sections whose token is
+// unchanged and only re-runs the collectors whose sources changed. Reused sections are
+// reported to progress right away. Outputs are not copied in or out of the snapshot:
+// the returned array (free it) holds a reference to each, NULL where a collector failed.
+// Thread-safe.
+SnapshotOutput** snapshot_collect(const CollectorSpec *specs, size_t n, const CollectorProgress *progress);
+
+void snapshot_output_release(SnapshotOutput *out);
+
+// Drop every cached section so the next collection rescans everything.
+void snapshot_invalidate(void);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,468 @@
+/* Offline report spool
+ * Each queued report is <created>-<pid>-<sequence>.json.gz in the spool directory. An
+ * upload holds an exclusive flock on its file, so several reporter processes can drain
+ * the same spool without sending a report twice. Reports GitHub refuses outright are
+ * moved to spool/rejected instead of being retried forever.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <jansson.h>
+#include <gio/gio.h>
+#include "spool.h"
+#include "crash_reporter.h"
+#include "fingerprint.h"
+#include "paths.h"
+#include "strbuf.h"
+#include "config.h"
+
+#define SPOOL_FORMAT_VERSION 1
+#define SPOOL_SUFFIX ".json.gz"
+#define SPOOL_MAX_FILE (16 * 1024 * 1024)
+
+static int is_entry(const char *name) {
+    return name[0] != '.' && has_suffix(name, SPOOL_SUFFIX);
+}
+
+static int by_name(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Queued entries, oldest first (names start with the creation time)
+static char** list_entries(const char *dir, size_t *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+    char **names = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (!is_entry(de->d_name)) continue;
+        if (n == cap) {
+            size_t c = cap ? cap * 2 : 16;
+            char **nn = realloc(names, c * sizeof(char*));
+            if (!nn) break;
+            names = nn;
+            cap = c;
+        }
+        if (!(names[n] = strdup(de->d_name))) break;
+        n++;
+    }
+    closedir(d);
+    if (names) qsort(names, n, sizeof(char*), by_name);
+    *count = n;
+    return names;
+}
+
+static void free_names(char **names, size_t n) {
+    for (size_t i = 0; i < n; ++i) free(names[i]);
+    free(names);
+}
+
+size_t spool_depth(void) {
+    char dir[PATH_MAX];
+    if (state_dir("spool", dir, sizeof(dir)) != 0) return 0;
+    size_t n;
+    char **names = list_entries(dir, &n);
+    free_names(names, n);
+    return n;
+}
+
+static void set_string(json_t *obj, const char *key, const char *value) {
+    if (value) json_object_set_new(obj, key, json_string(value));
+}
+
+int spool_store(const SpoolReport *report) {
+    char dir[PATH_MAX];
+    if (state_dir("spool", dir, sizeof(dir)) != 0) return -1;
+
+    json_t *root = json_object();
+    json_object_set_new(root, "version", json_integer(SPOOL_FORMAT_VERSION));
+    json_object_set_new(root, "created", json_integer((json_int_t)time(NULL)));
+    set_string(root, "title", report->title);
+    set_string(root, "body", report->body);
+    set_string(root, "issue_url", report->issue_url);
+    set_string(root, "comment", report->comment);
+    set_string(root, "fingerprint", report->fingerprint);
+    char *data = json_dumps(root, JSON_COMPACT);
+    json_decref(root);
+    if (!data) return -1;
+
+    char tmp[PATH_MAX + 16], path[PATH_MAX + 64];
+    snprintf(tmp, sizeof(tmp), "%s/.tmp-XXXXXX", dir);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(data);
+        return -1;
+    }
+    // gzclose closes the descriptor it was given; keep ours for the fsync
+    int rc = -1;
+    gzFile gz = gzdopen(dup(fd), "wb");
+    if (gz) {
+        size_t len = strlen(data);
+        int ok = gzwrite(gz, data, (unsigned)len) == (int)len;
+        if (gzclose(gz) == Z_OK && ok && fsync(fd) == 0) rc = 0;
+    }
+    close(fd);
+    free(data);
+
+    if (rc == 0) {
+        static unsigned sequence;
+        snprintf(path, sizeof(path), "%s/%010lld-%d-%04u" SPOOL_SUFFIX, dir, (long long)time(NULL), (int)getpid(),
+                 __atomic_fetch_add(&sequence, 1, __ATOMIC_RELAXED));
+        rc = rename(tmp, path);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "Could not write the report to the spool in %s\n", dir);
+        unlink(tmp);
+        return -1;
+    }
+    // Make the rename itself durable
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    printf("Report queued for sending later: %s\n", path);
+    return 0;
+}
+
+static json_t* load_entry(int fd) {
+    gzFile gz = gzdopen(dup(fd), "rb");
+    if (!gz) return NULL;
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    int n;
+    do {
+        if (len + 65536 > cap) {
+            size_t c = cap ? cap * 2 : 131072;
+            char *b = c <= SPOOL_MAX_FILE ? realloc(buf, c) : NULL;
+            if (!b) {
+                len = 0;
+                break;
+            }
+            buf = b;
+            cap = c;
+        }
+        n = gzread(gz, buf + len, 65536);
+        if (n > 0) len += (size_t)n;
+    } while (n > 0);
+    gzclose(gz);
+    json_t *root = len > 0 ? json_loadb(buf, len, 0, NULL) : NULL;
+    free(buf);
+    if (root && json_integer_value(json_object_get(root, "version")) != SPOOL_FORMAT_VERSION) {
+        json_decref(root);
+        root = NULL;
+    }
+    return root;
+}
+
+/* ---- Draining ---- */
+
+typedef struct SpoolUpload SpoolUpload;
+
+struct SpoolDrainer {
+    GMainContext *ctx;
+    GSource *timer;          // pending retry or drain
+    GNetworkMonitor *monitor;
+    gulong monitor_handler;
+    unsigned failures;       // consecutive transient failures, for the backoff
+    int backing_off;
+    int stopping;
+    SpoolUpload *uploads[SPOOL_MAX_UPLOADS];
+    size_t nuploads;
+    SpoolDepthFn on_depth;
+    void *user;
+};
+
+struct SpoolUpload {
+    SpoolDrainer *d;
+    char path[PATH_MAX + 64];
+    char name[NAME_MAX + 1];
+    int fd;                  // locked while the upload runs
+    json_t *entry;
+    char *target;            // issue being commented on
+    HttpRequest *req;
+};
+
+static void drain(SpoolDrainer *d);
+
+static const char* entry_string(const SpoolUpload *u, const char *key) {
+    return json_string_value(json_object_get(u->entry, key));
+}
+
+static void report_depth(SpoolDrainer *d) {
+    if (d->on_depth && !d->stopping) d->on_depth(spool_depth(), d->user);
+}
+
+static gboolean timer_fired(gpointer data) {
+    SpoolDrainer *d = data;
+    g_source_unref(d->timer);
+    d->timer = NULL;
+    d->backing_off = 0;
+    drain(d);
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule(SpoolDrainer *d, unsigned seconds) {
+    if (d->timer) {
+        g_source_destroy(d->timer);
+        g_source_unref(d->timer);
+    }
+    d->timer = seconds ? g_timeout_source_new_seconds(seconds) : g_idle_source_new();
+    g_source_set_callback(d->timer, timer_fired, d, NULL);
+    g_source_attach(d->timer, d->ctx);
+}
+
+// Exponential backoff with equal jitter: between half and all of base * 2^(failures-1)
+static void back_off(SpoolDrainer *d) {
+    if (d->backing_off) return;
+    d->failures++;
+    unsigned delay = SPOOL_RETRY_BASE_SEC;
+    for (unsigned i = 1; i < d->failures && delay < SPOOL_RETRY_MAX_SEC; ++i) delay *= 2;
+    if (delay > SPOOL_RETRY_MAX_SEC) delay = SPOOL_RETRY_MAX_SEC;
+    delay = delay / 2 + (unsigned)g_random_int_range(0, (gint32)(delay / 2 + 1));
+    d->backing_off = 1;
+    printf("Sending queued reports failed; retrying in %u seconds\n", delay);
+    schedule(d, delay);
+}
+
+static void upload_finish(SpoolUpload *u, ApiError result) {
+    SpoolDrainer *d = u->d;
+    if (result == API_OK) {
+        unlink(u->path);
+        printf("Queued report %s sent\n", u->name);
+    } else if (result == API_ERROR_REJECTED) {
+        char dir[PATH_MAX + 64], dest[PATH_MAX + NAME_MAX + 80];
+        snprintf(dir, sizeof(dir), "%.*s/rejected", (int)(strrchr(u->path, '/') - u->path), u->path);
+        mkdir(dir, 0700);
+        snprintf(dest, sizeof(dest), "%s/%s", dir, u->name);
+        rename(u->path, dest);
+        fprintf(stderr, "GitHub refused queued report %s; moved to %s\n", u->name, dest);
+    }
+    close(u->fd); // drops the lock
+    json_decref(u->entry);
+    free(u->target);
+    for (size_t i = 0; i < d->nuploads; ++i) {
+        if (d->uploads[i] == u) {
+            d->uploads[i] = d->uploads[--d->nuploads];
+            break;
+        }
+    }
+    free(u);
+
+    if (d->stopping) return;
+    if (result == API_ERROR_NETWORK || result == API_ERROR_CONFIG) {
+        back_off(d);
+    } else if (result != API_ERROR_CANCELLED) {
+        if (result == API_OK) d->failures = 0;
+        if (!d->backing_off) schedule(d, 0);
+    }
+    report_depth(d);
+}
+
+static void upload_done(char *url, void *user) {
+    SpoolUpload *u = user;
+    u->req = NULL;
+    ApiError err = url ? API_OK : api_last_error();
+    const char *fp = entry_string(u, "fingerprint");
+    if (url && fp) fingerprint_index_record(fp, u->target ? u->target : url);
+    free(url);
+    upload_finish(u, err);
+}
+
+static void upload_comment(SpoolUpload *u, const char *issue_url) {
+    const char *comment = entry_string(u, "comment");
+    if (!comment) comment = entry_string(u, "body");
+    u->target = strdup(issue_url);
+    HttpRequest *req = github_comment_issue_async(issue_url, comment ? comment : "", upload_done, NULL, u);
+    // done may already have run and freed the upload
+    if (req) u->req = req;
+}
+
+static void upload_create(SpoolUpload *u) {
+    const char *title = entry_string(u, "title");
+    const char *body = entry_string(u, "body");
+    if (!title || !body) {
+        upload_finish(u, API_ERROR_REJECTED);
+        return;
+    }
+    Report *r = report_new();
+    if (!r) {
+        upload_finish(u, API_ERROR_NETWORK);
+        return;
+    }
+    report_append(r, body, strlen(body));
+    HttpRequest *req = create_github_issue_async(title, r, upload_done, NULL, u);
+    report_free(r); // serialized by now
+    if (req) u->req = req;
+}
+
+static void upload_search_done(char *issue_url, void *user) {
+    SpoolUpload *u = user;
+    u->req = NULL;
+    ApiError err = api_last_error();
+    if (issue_url) {
+        upload_comment(u, issue_url);
+        free(issue_url);
+    } else if (err == API_ERROR_NETWORK || err == API_ERROR_CANCELLED) {
+        upload_finish(u, err);
+    } else {
+        upload_create(u);
+    }
+}
+
+// Same order as an interactive report: a known issue gets a comment, anything else a new issue
+static void upload_start(SpoolUpload *u) {
+    const char *issue_url = entry_string(u, "issue_url");
+    const char *fp = entry_string(u, "fingerprint");
+    if (issue_url) {
+        upload_comment(u, issue_url);
+        return;
+    }
+    if (fp) {
+        char *known = fingerprint_index_lookup(fp, NULL);
+        if (known) {
+            upload_comment(u, known);
+            free(known);
+            return;
+        }
+        HttpRequest *req = github_find_issue_async(fp, upload_search_done, NULL, u);
+        if (req) u->req = req;
+        return;
+    }
+    upload_create(u);
+}
+
+static int uploading(const SpoolDrainer *d, const char *name) {
+    for (size_t i = 0; i < d->nuploads; ++i) {
+        if (strcmp(d->uploads[i]->name, name) == 0) return 1;
+    }
+    return 0;
+}
+
+// Whether a report with this fingerprint is already being sent. Two at once would both
+// miss the index and the search and file the same crash twice; the later one waits and
+// then finds the issue the first one recorded.
+static int fingerprint_uploading(const SpoolDrainer *d, const char *fp) {
+    for (size_t i = 0; i < d->nuploads; ++i) {
+        const char *other = entry_string(d->uploads[i], "fingerprint");
+        if (other && strcmp(other, fp) == 0) return 1;
+    }
+    return 0;
+}
+
+// Whether the locked fd is still the entry at path. Another process may have sent it,
+// and unlinked or replaced it, between our open() and flock().
+static int still_spooled(int fd, const char *path) {
+    struct stat locked, named;
+    if (fstat(fd, &locked) != 0 || locked.st_nlink == 0) return 0;
+    return stat(path, &named) == 0 && named.st_dev == locked.st_dev && named.st_ino == locked.st_ino;
+}
+
+static void drain(SpoolDrainer *d) {
+    char dir[PATH_MAX];
+    if (d->stopping || d->backing_off || state_dir("spool", dir, sizeof(dir)) != 0) return;
+    size_t n;
+    char **names = list_entries(dir, &n);
+    for (size_t i = 0; i < n && d->nuploads < SPOOL_MAX_UPLOADS && !d->backing_off; ++i) {
+        if (uploading(d, names[i])) continue;
+        SpoolUpload *u = calloc(1, sizeof(SpoolUpload));
+        if (!u) break;
+        u->d = d;
+        snprintf(u->name, sizeof(u->name), "%s", names[i]);
+        snprintf(u->path, sizeof(u->path), "%s/%s", dir, names[i]);
+        u->fd = open(u->path, O_RDONLY | O_CLOEXEC);
+        // Another process is sending it, or has already sent it
+        if (u->fd < 0 || flock(u->fd, LOCK_EX | LOCK_NB) != 0 || !still_spooled(u->fd, u->path)) {
+            if (u->fd >= 0) close(u->fd);
+            free(u);
+            continue;
+        }
+        u->entry = load_entry(u->fd);
+        const char *fp = entry_string(u, "fingerprint");
+        if (fp && !entry_string(u, "issue_url") && fingerprint_uploading(d, fp)) {
+            // Picked up again by the drain that follows the other upload
+            close(u->fd);
+            json_decref(u->entry);
+            free(u);
+            continue;
+        }
+        d->uploads[d->nuploads++] = u;
+        if (!u->entry) {
+            fprintf(stderr, "Unreadable spooled report %s\n", u->path);
+            upload_finish(u, API_ERROR_REJECTED);
+            continue;
+        }
+        upload_start(u);
+    }
+    free_names(names, n);
+    report_depth(d);
+}
+
+static void network_changed(GNetworkMonitor *monitor, gboolean available, gpointer data) {
+    (void)monitor;
+    SpoolDrainer *d = data;
+    if (!available) return;
+    // Connectivity is back: retry right away and forget the accumulated backoff
+    d->failures = 0;
+    d->backing_off = 0;
+    schedule(d, 0);
+}
+
+SpoolDrainer* spool_drainer_start(SpoolDepthFn on_depth, void *user) {
+    SpoolDrainer *d = calloc(1, sizeof(SpoolDrainer));
+    if (!d) return NULL;
+    d->ctx = g_main_context_ref_thread_default();
+    d->on_depth = on_depth;
+    d->user = user;
+    d->monitor = g_network_monitor_get_default();
+    if (d->monitor) {
+        g_object_ref(d->monitor);
+        d->monitor_handler = g_signal_connect(d->monitor, "network-changed", G_CALLBACK(network_changed), d);
+    }
+    schedule(d, 0);
+    return d;
+}
+
+void spool_drainer_kick(SpoolDrainer *d) {
+    if (!d) return;
+    d->backing_off = 0;
+    schedule(d, 0);
+}
+
+void spool_drainer_stop(SpoolDrainer *d) {
+    if (!d) return;
+    d->stopping = 1;
+    if (d->monitor) {
+        g_signal_handler_disconnect(d->monitor, d->monitor_handler);
+        g_object_unref(d->monitor);
+    }
+    if (d->timer) {
+        g_source_destroy(d->timer);
+        g_source_unref(d->timer);
+    }
+    // Cancelling runs each upload's done callback, which frees it
+    while (d->nuploads > 0) {
+        SpoolUpload *u = d->uploads[d->nuploads - 1];
+        if (u->req) {
+            HttpRequest *req = u->req;
+            u->req = NULL;
+            http_request_cancel(req);
+        } else {
+            upload_finish(u, API_ERROR_CANCELLED);
+        }
+    }
+    g_main_context_unref(d->ctx);
+    free(d);
+}
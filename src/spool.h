@@ -0,0 +1,39 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stddef.h>
+
+// Offline spool. A report that could not be sent because the network (or GitHub) was
+// unavailable is written to $XDG_STATE_HOME/crash-reporter/spool as one gzip-compressed
+// JSON file, atomically (temporary file, fsync, rename), so it survives crashes and
+// reboots. A drainer on the GLib main loop sends spooled reports in the background,
+// backing off exponentially (with jitter) while sending fails and starting over as soon
+// as the network comes back.
+
+typedef struct {
+    const char *title;       // new issue: title and body
+    const char *body;
+    const char *issue_url;   // or a comment on this issue (comment must be set)
+    const char *comment;     // also used when the fingerprint turns out to be filed already
+    const char *fingerprint; // may be NULL
+} SpoolReport;
+
+// Queue a report. Returns 0, or -1 when it could not be written.
+int spool_store(const SpoolReport *report);
+
+// Number of reports waiting to be sent
+size_t spool_depth(void);
+
+typedef void (*SpoolDepthFn)(size_t depth, void *user);
+
+typedef struct SpoolDrainer SpoolDrainer;
+
+// Start draining on the thread-default main context. on_depth (may be NULL) is called
+// with the queue depth whenever it may have changed.
+SpoolDrainer* spool_drainer_start(SpoolDepthFn on_depth, void *user);
+// Try again now, e.g. after a report was queued or a token was configured
+void spool_drainer_kick(SpoolDrainer *d);
+// Cancel uploads in flight (their reports stay queued) and free the drainer
+void spool_drainer_stop(SpoolDrainer *d);
+
+#endif // SPOOL_H
@@ -0,0 +1,97 @@
+/* Server-sent events parser
+ * Only the "data" field matters to us; event names, ids and retry hints are ignored.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sse.h"
+
+void sse_init(SseParser *p, SseEventFn on_event, void *user) {
+    memset(p, 0, sizeof(*p));
+    p->on_event = on_event;
+    p->user = user;
+}
+
+static int grow(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 0;
+    size_t cap2 = *cap ? *cap * 2 : 1024;
+    while (cap2 < need) cap2 *= 2;
+    char *b = realloc(*buf, cap2);
+    if (!b) return -1;
+    *buf = b;
+    *cap = cap2;
+    return 0;
+}
+
+static int dispatch(SseParser *p) {
+    if (p->data_len == 0) return 0;
+    p->data[p->data_len] = '\0';
+    int stop = p->on_event(p->data, p->data_len, p->user);
+    p->data_len = 0;
+    return stop;
+}
+
+// One line without its terminator
+static int handle_line(SseParser *p, const char *s, size_t n) {
+    if (n > 0 && s[n - 1] == '\r') n--;
+    if (n == 0) return dispatch(p);
+    if (s[0] == ':') return 0; // comment / keep-alive
+
+    const char *colon = memchr(s, ':', n);
+    size_t name_len = colon ? (size_t)(colon - s) : n;
+    if (name_len != 4 || memcmp(s, "data", 4) != 0) return 0;
+    const char *value = colon ? colon + 1 : s + n;
+    if (value < s + n && *value == ' ') value++;
+    size_t value_len = (size_t)(s + n - value);
+
+    // Multiple data lines form one event joined by newlines; +2 for the '\n' and the NUL
+    if (grow(&p->data, &p->data_cap, p->data_len + value_len + 2) != 0) return -1;
+    if (p->data_len > 0) p->data[p->data_len++] = '\n';
+    memcpy(p->data + p->data_len, value, value_len);
+    p->data_len += value_len;
+    return 0;
+}
+
+int sse_feed(SseParser *p, const char *buf, size_t len) {
+    if (p->stopped) return -1;
+    const char *end = buf + len;
+    while (buf < end) {
+        const char *nl = memchr(buf, '\n', (size_t)(end - buf));
+        if (!nl) {
+            // Keep the partial line for the next chunk
+            if (grow(&p->line, &p->line_cap, p->line_len + (size_t)(end - buf)) != 0) {
+                p->stopped = 1;
+                return -1;
+            }
+            memcpy(p->line + p->line_len, buf, (size_t)(end - buf));
+            p->line_len += (size_t)(end - buf);
+            break;
+        }
+        int r;
+        if (p->line_len > 0) {
+            if (grow(&p->line, &p->line_cap, p->line_len + (size_t)(nl - buf)) != 0) {
+                p->stopped = 1;
+                return -1;
+            }
+            memcpy(p->line + p->line_len, buf, (size_t)(nl - buf));
+            r = handle_line(p, p->line, p->line_len + (size_t)(nl - buf));
+            p->line_len = 0;
+        } else {
+            r = handle_line(p, buf, (size_t)(nl - buf));
+        }
+        if (r != 0) {
+            p->stopped = 1;
+            return -1;
+        }
+        buf = nl + 1;
+    }
+    return 0;
+}
+
+void sse_finish(SseParser *p) {
+    if (!p->stopped && (p->line_len == 0 || handle_line(p, p->line, p->line_len) == 0)) dispatch(p);
+    free(p->line);
+    free(p->data);
+    p->line = p->data = NULL;
+    p->line_len = p->line_cap = p->data_len = p->data_cap = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef SSE_H
+#define SSE_H
+
+#include <stddef.h>
+
+// Incremental parser for text/event-stream bodies. Bytes are fed as they arrive from
+// the network; complete lines are handled in place and only a line split across two
+// chunks is copied, so a long stream is never buffered as a whole.
+
+// Called for every complete event with its data lines joined by '\n' (NUL-terminated,
+// valid only during the call). Return nonzero to stop parsing.
+typedef int (*SseEventFn)(const char *data, size_t len, void *user);
+
+typedef struct {
+    char *line;              // partial line carried over from the previous chunk
+    size_t line_len;
+    size_t line_cap;
+    char *data;              // data of the event being assembled
+    size_t data_len;
+    size_t data_cap;
+    int stopped;
+    SseEventFn on_event;
+    void *user;
+} SseParser;
+
+void sse_init(SseParser *p, SseEventFn on_event, void *user);
+
+// Parse the next chunk. Returns 0, or -1 when out of memory or the callback asked to stop.
+int sse_feed(SseParser *p, const char *buf, size_t len);
+
+// Dispatch an event left unterminated at the end of the stream and free the buffers.
+void sse_finish(SseParser *p);
+
+#endif // SSE_H
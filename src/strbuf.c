@@ -0,0 +1,48 @@
+/* Growable string buffer
+ * The append and printf helpers the collectors build their text with, and the small
+ * string tests several modules share.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "strbuf.h"
+
+// Room for need more bytes and the NUL, doubling from 4 KB
+static int reserve(char **buf, size_t *len, size_t *cap, size_t need) {
+    if (*len + need + 1 <= *cap) return 0;
+    size_t c = *cap ? *cap * 2 : 4096;
+    while (c < *len + need + 1) c *= 2;
+    char *b = realloc(*buf, c);
+    if (!b) return -1;
+    *buf = b;
+    *cap = c;
+    return 0;
+}
+
+int buf_append(char **buf, size_t *len, size_t *cap, const char *s, size_t n) {
+    if (reserve(buf, len, cap, n) != 0) return -1;
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return 0;
+}
+
+int buf_printf(char **buf, size_t *len, size_t *cap, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0 || reserve(buf, len, cap, (size_t)n) != 0) return -1;
+    va_start(ap, fmt);
+    vsnprintf(*buf + *len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    *len += (size_t)n;
+    return 0;
+}
+
+int has_suffix(const char *s, const char *suffix) {
+    size_t n = strlen(s), k = strlen(suffix);
+    return n > k && strcmp(s + n - k, suffix) == 0;
+}
@@ -0,0 +1,20 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <stddef.h>
+
+// Growable NUL-terminated string held as buffer, length and capacity, for building
+// report sections and summaries. *buf starts NULL with *len and *cap 0; the caller
+// frees it. On allocation failure the text so far is left as it was.
+
+// Append n bytes. Returns 0, or -1 when out of memory.
+int buf_append(char **buf, size_t *len, size_t *cap, const char *s, size_t n);
+
+// Append printf output, whatever its length. Returns 0, or -1 when out of memory.
+int buf_printf(char **buf, size_t *len, size_t *cap, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+// Whether s ends in suffix, with something before it
+int has_suffix(const char *s, const char *suffix);
+
+#endif // STRBUF_H
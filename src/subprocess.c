@@ -0,0 +1,169 @@
+/* Subprocess engine
+ * posix_spawn with argv arrays (no /bin/sh), stdout and stderr on separate pipes,
+ * read in large chunks into geometrically growing or budget-bounded buffers.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include "subprocess.h"
+#include "capture.h"
+
+#define SPAWN_READ_CHUNK 65536
+
+extern char **environ;
+
+int spawn_start(const char *const argv[], pid_t *pid, int *out_fd, int *err_fd) {
+    int outp[2], errp[2];
+    if (pipe2(outp, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        return -1;
+    }
+    if (pipe2(errp, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        close(outp[0]);
+        close(outp[1]);
+        return -1;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, outp[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, errp[1], STDERR_FILENO);
+
+    int rc = posix_spawnp(pid, argv[0], &fa, NULL, (char *const *)argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(outp[1]);
+    close(errp[1]);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to run command %s: %s\n", argv[0], strerror(rc));
+        close(outp[0]);
+        close(errp[0]);
+        return -1;
+    }
+    *out_fd = outp[0];
+    *err_fd = errp[0];
+    return 0;
+}
+
+int spawn_wait(pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return -1;
+}
+
+static void abandoned_exited(GPid pid, gint status, gpointer user) {
+    (void)status;
+    (void)user;
+    g_spawn_close_pid(pid);
+}
+
+void spawn_abandon(pid_t pid) {
+    // A child watch checks with WNOHANG, so nothing blocks on a child that is still busy
+    g_child_watch_add((GPid)pid, abandoned_exited, NULL);
+}
+
+int spawn_buffer_fill(SpawnBuffer *buf, int fd) {
+    if (buf->cap - buf->len < SPAWN_READ_CHUNK + 1) {
+        size_t newcap = buf->cap ? buf->cap * 2 : SPAWN_READ_CHUNK * 2;
+        while (newcap - buf->len < SPAWN_READ_CHUNK + 1) newcap *= 2;
+        char *n = realloc(buf->data, newcap);
+        if (!n) {
+            perror("realloc failed in spawn_buffer_fill");
+            return -1;
+        }
+        buf->data = n;
+        buf->cap = newcap;
+    }
+    ssize_t r = read(fd, buf->data + buf->len, SPAWN_READ_CHUNK);
+    if (r < 0) return (errno == EINTR || errno == EAGAIN) ? 1 : -1;
+    if (r == 0) return 0;
+    buf->len += (size_t)r;
+    buf->data[buf->len] = '\0';
+    return 1;
+}
+
+char* spawn_buffer_finish(SpawnBuffer *buf) {
+    if (!buf->data) {
+        buf->data = malloc(1);
+        if (!buf->data) return NULL;
+        buf->cap = 1;
+        buf->len = 0;
+    }
+    buf->data[buf->len] = '\0';
+    return buf->data;
+}
+
+int spawn_capture(const char *const argv[], size_t budget, SpawnResult *res) {
+    memset(res, 0, sizeof(*res));
+    res->exit_status = -1;
+
+    pid_t pid;
+    int fds[2];
+    if (spawn_start(argv, &pid, &fds[0], &fds[1]) != 0) return -1;
+
+    Capture bufs[2];
+    capture_init(&bufs[0], budget);
+    capture_init(&bufs[1], budget);
+    int open_fds = 2;
+    while (open_fds > 0) {
+        struct pollfd pfds[2];
+        int idx[2];
+        nfds_t np = 0;
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i] < 0) continue;
+            pfds[np].fd = fds[i];
+            pfds[np].events = POLLIN;
+            pfds[np].revents = 0;
+            idx[np++] = i;
+        }
+        if (poll(pfds, np, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        for (nfds_t k = 0; k < np; ++k) {
+            if (!(pfds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            int i = idx[k];
+            if (capture_fill(&bufs[i], fds[i]) <= 0) {
+                close(fds[i]);
+                fds[i] = -1;
+                open_fds--;
+            }
+        }
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+
+    res->exit_status = spawn_wait(pid);
+    res->out = capture_finish(&bufs[0], &res->out_len);
+    res->skipped_bytes = bufs[0].skipped_bytes;
+    res->skipped_lines = bufs[0].skipped_lines;
+    res->err = capture_finish(&bufs[1], &res->err_len);
+    if (!res->out || !res->err) {
+        spawn_result_free(res);
+        return -1;
+    }
+    return 0;
+}
+
+void spawn_result_free(SpawnResult *res) {
+    free(res->out);
+    free(res->err);
+    res->out = res->err = NULL;
+    res->out_len = res->err_len = 0;
+}
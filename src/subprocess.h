@@ -0,0 +1,52 @@
+#ifndef SUBPROCESS_H
+#define SUBPROCESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Growable byte buffer filled with large read() chunks. data is always NUL-terminated
+// once at least one read has happened (or after spawn_buffer_finish()).
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} SpawnBuffer;
+
+// Result of running a child process to completion.
+typedef struct {
+    char *out;          // captured stdout, NUL-terminated (never NULL after success)
+    size_t out_len;
+    char *err;          // captured stderr, NUL-terminated (never NULL after success)
+    size_t err_len;
+    int exit_status;    // exit code, 128+signal if killed, -1 if it could not be started
+    uint64_t skipped_bytes; // stdout bytes dropped between head and tail (see capture.h)
+    uint64_t skipped_lines;
+} SpawnResult;
+
+// Start argv[0] (looked up in PATH, no shell) with stdin on /dev/null and stdout/stderr
+// connected to pipes. Returns 0 and fills pid/out_fd/err_fd on success, -1 on failure.
+int spawn_start(const char *const argv[], pid_t *pid, int *out_fd, int *err_fd);
+
+// Reap pid and translate its status into an exit code (128+signal when killed).
+int spawn_wait(pid_t pid);
+
+// Stop waiting for pid, which may still be running (a root child that cannot be
+// signalled). It is reaped whenever it exits, by the default main context.
+void spawn_abandon(pid_t pid);
+
+// Read one chunk from fd into buf, growing it geometrically.
+// Returns 1 if data was read (or the read should be retried), 0 on EOF, -1 on error.
+int spawn_buffer_fill(SpawnBuffer *buf, int fd);
+
+// Make sure buf->data is allocated and NUL-terminated, returning it.
+char* spawn_buffer_finish(SpawnBuffer *buf);
+
+// Run argv to completion, capturing stdout and stderr separately. Each stream keeps at
+// most budget bytes (head and tail, see capture.h) however much the child writes.
+// Returns 0 on success (whatever the exit status), -1 if the process could not be started.
+int spawn_capture(const char *const argv[], size_t budget, SpawnResult *res);
+
+void spawn_result_free(SpawnResult *res);
+
+#endif // SUBPROCESS_H
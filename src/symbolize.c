@@ -0,0 +1,553 @@
+/* Symbolizer
+ * Builds symbol cache entries with libdwfl (elfutils) and resolves addresses against
+ * them. Addresses from a core's notes are resolved without libdwfl at all once the
+ * modules they fall into are cached; unwinding a whole core needs its memory image and
+ * is left to libdwfl.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <elf.h>
+#include <gelf.h>
+#include <elfutils/libdwfl.h>
+#include <elfutils/libdwelf.h>
+#include "symbolize.h"
+#include "symcache.h"
+#include "decompress.h"
+#include "config.h"
+
+#define BUILD_ID_MAX 64
+#define CORE_COPY_CHUNK (64 * 1024)
+
+static pthread_once_t elf_once = PTHREAD_ONCE_INIT;
+
+static void init_libelf(void) {
+    elf_version(EV_CURRENT);
+}
+
+static void hex_id(const unsigned char *bits, size_t len, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    if (len > BUILD_ID_MAX) len = BUILD_ID_MAX;
+    for (size_t i = 0; i < len; ++i) {
+        out[2 * i] = digits[bits[i] >> 4];
+        out[2 * i + 1] = digits[bits[i] & 0xf];
+    }
+    out[2 * len] = '\0';
+}
+
+// SYMBOLIZE_DEBUG_DIR/.build-id/ab/cdef....debug
+static void debug_file_path(const char *build_id, char *out, size_t size) {
+    snprintf(out, size, "%s/.build-id/%.2s/%s.debug", SYMBOLIZE_DEBUG_DIR, build_id, build_id[0] ? build_id + 2 : "");
+}
+
+static int try_debug_file(const char *path, char **debuginfo_file_name) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    *debuginfo_file_name = strdup(path);
+    return fd;
+}
+
+// Debug files by build-id, then by .gnu_debuglink next to where the distribution puts
+// them; debuginfod only when configured, as it may download hundreds of megabytes
+static int find_debuginfo(Dwfl_Module *mod, void **userdata, const char *modname, Dwarf_Addr base,
+                          const char *file_name, const char *debuglink_file, GElf_Word debuglink_crc,
+                          char **debuginfo_file_name) {
+    char path[PATH_MAX];
+    const unsigned char *bits;
+    GElf_Addr vaddr;
+    int len = dwfl_module_build_id(mod, &bits, &vaddr);
+    if (len > 1) {
+        char id[2 * BUILD_ID_MAX + 1];
+        hex_id(bits, (size_t)len, id);
+        debug_file_path(id, path, sizeof(path));
+        int fd = try_debug_file(path, debuginfo_file_name);
+        if (fd >= 0) return fd;
+    }
+    if (debuglink_file && file_name && strchr(debuglink_file, '/') == NULL) {
+        const char *slash = strrchr(file_name, '/');
+        int dirlen = slash ? (int)(slash - file_name) : 0;
+        snprintf(path, sizeof(path), "%s%.*s/%s", SYMBOLIZE_DEBUG_DIR, dirlen, file_name, debuglink_file);
+        int fd = try_debug_file(path, debuginfo_file_name);
+        if (fd >= 0) return fd;
+    }
+#if SYMBOLIZE_DEBUGINFOD
+    return dwfl_standard_find_debuginfo(mod, userdata, modname, base, file_name, debuglink_file, debuglink_crc,
+                                        debuginfo_file_name);
+#else
+    return -1;
+#endif
+}
+
+static const Dwfl_Callbacks offline_callbacks = {
+    .find_elf = dwfl_build_id_find_elf,
+    .find_debuginfo = find_debuginfo,
+    .section_address = dwfl_offline_section_address,
+};
+
+static const Dwfl_Callbacks core_callbacks = {
+    .find_elf = dwfl_build_id_find_elf,
+    .find_debuginfo = find_debuginfo,
+};
+
+// Lowest address the binary maps, page aligned: where its first mapping starts
+static uint64_t elf_load_base(Elf *elf) {
+    size_t nphdr;
+    uint64_t base = UINT64_MAX;
+    if (!elf || elf_getphdrnum(elf, &nphdr) != 0) return 0;
+    for (size_t i = 0; i < nphdr; ++i) {
+        GElf_Phdr ph;
+        if (gelf_getphdr(elf, (int)i, &ph) && ph.p_type == PT_LOAD && ph.p_vaddr < base) base = ph.p_vaddr;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    return base == UINT64_MAX ? 0 : base & ~(uint64_t)(page > 0 ? page - 1 : 4095);
+}
+
+/* ---- Building cache entries ---- */
+
+// Parse the symbols and line table of mod into the cache entry for build_id
+static int build_entry(Dwfl_Module *mod, const char *build_id) {
+    GElf_Addr bias = 0;
+    Elf *elf = dwfl_module_getelf(mod, &bias);
+    if (!elf) return -1;
+
+    // Lines first: looking for DWARF is what finds the separate debug file, which may
+    // also bring a full symbol table
+    SymCacheBuilder *b = symcache_builder_new(elf_load_base(elf));
+    if (!b) return -1;
+    unsigned flags = 0;
+    Dwarf_Die *cu = NULL;
+    Dwarf_Addr dwbias = 0;
+    while ((cu = dwfl_module_nextcu(mod, cu, &dwbias)) != NULL) {
+        Dwarf_Lines *lines;
+        size_t nlines;
+        if (dwarf_getsrclines(cu, &lines, &nlines) != 0) continue;
+        for (size_t i = 0; i < nlines; ++i) {
+            Dwarf_Line *l = dwarf_onesrcline(lines, i);
+            Dwarf_Addr addr;
+            int lineno = 0;
+            bool end = false;
+            if (!l || dwarf_lineaddr(l, &addr) != 0) continue;
+            dwarf_lineno(l, &lineno);
+            dwarf_lineendsequence(l, &end);
+            symcache_builder_add_line(b, addr + dwbias - bias, dwarf_linesrc(l, NULL, NULL), end ? 0 : lineno);
+            flags |= SYMCACHE_HAVE_LINES;
+        }
+    }
+
+    int nsyms = dwfl_module_getsymtab(mod);
+    for (int i = 1; i < nsyms; ++i) {
+        GElf_Sym sym;
+        GElf_Addr addr;
+        GElf_Word shndx;
+        Elf *symelf;
+        Dwarf_Addr symbias;
+        const char *name = dwfl_module_getsym_info(mod, i, &sym, &addr, &shndx, &symelf, &symbias);
+        int type = name ? GELF_ST_TYPE(sym.st_info) : STT_NOTYPE;
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) || shndx == SHN_UNDEF || addr < bias) continue;
+        symcache_builder_add_symbol(b, addr - bias, sym.st_size, name);
+    }
+
+    const char *mainfile = NULL, *debugfile = NULL;
+    dwfl_module_info(mod, NULL, NULL, NULL, NULL, NULL, &mainfile, &debugfile);
+    if (debugfile && (!mainfile || strcmp(debugfile, mainfile) != 0)) flags |= SYMCACHE_HAVE_DEBUGINFO;
+
+    int rc = symcache_builder_write(b, build_id, flags);
+    symcache_builder_free(b);
+    return rc;
+}
+
+// The cache entry for build_id. A table built before the debug file was installed is
+// rebuilt through build(), as is a missing one.
+static SymCache* open_entry(const char *build_id, int (*build)(void *arg, const char *build_id), void *arg) {
+    SymCache *c = symcache_open(build_id);
+    if (c && !(symcache_flags(c) & SYMCACHE_HAVE_DEBUGINFO)) {
+        char path[PATH_MAX];
+        debug_file_path(build_id, path, sizeof(path));
+        if (access(path, R_OK) == 0) {
+            symcache_close(c);
+            c = NULL;
+        }
+    }
+    if (!c && build(arg, build_id) == 0) c = symcache_open(build_id);
+    return c;
+}
+
+/* ---- Frames ---- */
+
+static SymFrame* add_frame(SymTrace *t, size_t *cap, uint64_t pc) {
+    if (t->count == *cap) {
+        size_t n = *cap ? *cap * 2 : 16;
+        SymFrame *f = realloc(t->frames, n * sizeof(SymFrame));
+        if (!f) return NULL;
+        t->frames = f;
+        *cap = n;
+    }
+    SymFrame *f = &t->frames[t->count++];
+    memset(f, 0, sizeof(*f));
+    f->pc = pc;
+    return f;
+}
+
+static void fill_frame(SymFrame *f, const SymCache *c, uint64_t link_addr) {
+    SymCacheResult r;
+    if (!c || symcache_lookup(c, link_addr, &r) != 0) return;
+    if (r.function) {
+        f->function = strdup(r.function);
+        f->function_offset = r.function_offset;
+    }
+    if (r.file) {
+        f->file = strdup(r.file);
+        f->line = r.line;
+    }
+}
+
+void sym_trace_free(SymTrace *trace) {
+    for (size_t i = 0; i < trace->count; ++i) {
+        free(trace->frames[i].module);
+        free(trace->frames[i].function);
+        free(trace->frames[i].file);
+    }
+    free(trace->frames);
+    memset(trace, 0, sizeof(*trace));
+}
+
+void sym_frame_describe(const SymFrame *frame, char *buf, size_t size) {
+    int n = 0;
+    buf[0] = '\0';
+    if (frame->function) n = snprintf(buf, size, "%s+0x%llx", frame->function, (unsigned long long)frame->function_offset);
+    if (frame->file && n >= 0 && (size_t)n < size) {
+        snprintf(buf + n, size - (size_t)n, "%sat %s:%d", n > 0 ? " " : "", frame->file, frame->line);
+    }
+}
+
+/* ---- Addresses of a crashed process ---- */
+
+typedef struct {
+    const char *path;
+    SymCache *cache;
+    uint64_t base;      // where the module's first mapping starts in the process
+} OpenModule;
+
+static int build_offline(void *arg, const char *build_id) {
+    const char *path = arg;
+    Dwfl *dwfl = dwfl_begin(&offline_callbacks);
+    if (!dwfl) return -1;
+    dwfl_report_begin(dwfl);
+    Dwfl_Module *mod = dwfl_report_offline(dwfl, path, path, -1);
+    dwfl_report_end(dwfl, NULL, NULL);
+    int rc = mod ? build_entry(mod, build_id) : -1;
+    dwfl_end(dwfl);
+    return rc;
+}
+
+// The build-id of the file at path, unless it changed after crash_usec
+static int file_build_id(const char *path, uint64_t crash_usec, char *out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    int rc = -1;
+    // An upgrade since the crash leaves a different binary under the same name
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_mtime * 1000000ULL <= crash_usec) {
+        Elf *elf = elf_begin(fd, ELF_C_READ_MMAP, NULL);
+        const void *id;
+        ssize_t len = elf ? dwelf_elf_gnu_build_id(elf, &id) : -1;
+        if (len > 1) {
+            hex_id(id, (size_t)len, out);
+            rc = 0;
+        }
+        if (elf) elf_end(elf);
+    }
+    close(fd);
+    return rc;
+}
+
+static OpenModule* module_for(OpenModule *mods, size_t *nmods, size_t max, const CoreNotes *notes,
+                              const CoreMapping *m, uint64_t crash_usec) {
+    for (size_t i = 0; i < *nmods; ++i) {
+        if (strcmp(mods[i].path, m->path) == 0) return &mods[i];
+    }
+    if (*nmods == max) return NULL;
+    OpenModule *om = &mods[(*nmods)++];
+    om->path = m->path;
+    om->cache = NULL;
+    om->base = m->start;
+    for (size_t i = 0; i < notes->nmaps; ++i) {
+        const CoreMapping *o = &notes->maps[i];
+        if (o->offset == 0 && o->start < om->base && strcmp(o->path, m->path) == 0) om->base = o->start;
+    }
+    char id[2 * BUILD_ID_MAX + 1];
+    if (m->path[0] == '/' && file_build_id(m->path, crash_usec, id) == 0) {
+        om->cache = open_entry(id, build_offline, (void *)m->path);
+    }
+    return om;
+}
+
+int symbolize_addresses(const CoreNotes *notes, uint64_t crash_usec, const uint64_t *pcs, size_t n, SymTrace *out) {
+    memset(out, 0, sizeof(*out));
+    pthread_once(&elf_once, init_libelf);
+    OpenModule mods[SYMBOLIZE_MAX_MODULES];
+    size_t nmods = 0, cap = 0;
+    int rc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        SymFrame *f = add_frame(out, &cap, pcs[i]);
+        if (!f) {
+            rc = -1;
+            break;
+        }
+        // A return address is just past the call; look up the call itself
+        uint64_t pc = i > 0 && pcs[i] > 0 ? pcs[i] - 1 : pcs[i];
+        const CoreMapping *m = core_notes_find_mapping(notes, pc);
+        if (!m) continue;
+        OpenModule *om = module_for(mods, &nmods, SYMBOLIZE_MAX_MODULES, notes, m, crash_usec);
+        f->module = strdup(m->path);
+        if (!om) continue;
+        f->module_offset = pcs[i] - om->base;
+        if (om->cache) fill_frame(f, om->cache, pc - om->base + symcache_load_base(om->cache));
+    }
+    for (size_t i = 0; i < nmods; ++i) symcache_close(mods[i].cache);
+    return rc;
+}
+
+/* ---- Kernel ---- */
+
+// The kernel's build-id from its notes in /sys/kernel/notes
+static int kernel_build_id(char *out) {
+    unsigned char notes[4096];
+    int fd = open("/sys/kernel/notes", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t len = read(fd, notes, sizeof(notes));
+    close(fd);
+    for (size_t off = 0; len > 0 && off + sizeof(Elf64_Nhdr) <= (size_t)len;) {
+        Elf64_Nhdr nh;
+        memcpy(&nh, notes + off, sizeof(nh));
+        size_t name_off = off + sizeof(nh);
+        size_t desc_off = name_off + ((nh.n_namesz + 3) & ~3u);
+        if (desc_off + nh.n_descsz > (size_t)len) break;
+        if (nh.n_type == NT_GNU_BUILD_ID && nh.n_namesz == 4 && memcmp(notes + name_off, "GNU", 4) == 0 &&
+            nh.n_descsz > 1) {
+            memcpy(out, "kernel-", 7);
+            hex_id(notes + desc_off, nh.n_descsz, out + 7);
+            return 0;
+        }
+        off = desc_off + ((nh.n_descsz + 3) & ~3u);
+    }
+    return -1;
+}
+
+// Where _text is in this boot; 0 when the addresses are hidden
+static uint64_t kernel_text(void) {
+    FILE *f = fopen("/proc/kallsyms", "re");
+    if (!f) return 0;
+    char line[512];
+    uint64_t text = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long addr;
+        char type, name[256];
+        if (sscanf(line, "%llx %c %255s", &addr, &type, name) == 3 && strcmp(name, "_text") == 0) {
+            text = addr;
+            break;
+        }
+    }
+    fclose(f);
+    return text;
+}
+
+// Symbols relative to _text, so the entry holds across boots despite KASLR
+static int build_kernel(void *arg, const char *build_id) {
+    uint64_t text = *(const uint64_t *)arg;
+    FILE *f = fopen("/proc/kallsyms", "re");
+    if (!f) return -1;
+    SymCacheBuilder *b = symcache_builder_new(0);
+    char line[512];
+    while (b && fgets(line, sizeof(line), f)) {
+        unsigned long long addr;
+        char type, name[256];
+        // Module symbols move with every load
+        if (strchr(line, '[')) continue;
+        if (sscanf(line, "%llx %c %255s", &addr, &type, name) != 3 || addr < text) continue;
+        if (type == 't' || type == 'T' || type == 'w' || type == 'W') symcache_builder_add_symbol(b, addr - text, 0, name);
+    }
+    fclose(f);
+    int rc = b ? symcache_builder_write(b, build_id, 0) : -1;
+    symcache_builder_free(b);
+    return rc;
+}
+
+int symbolize_kernel_addresses(const uint64_t *addrs, size_t n, SymTrace *out) {
+    memset(out, 0, sizeof(*out));
+    char id[2 * BUILD_ID_MAX + 8];
+    uint64_t text = kernel_text();
+    if (text == 0 || kernel_build_id(id) != 0) return -1;
+    SymCache *c = open_entry(id, build_kernel, &text);
+    size_t cap = 0;
+    int rc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        SymFrame *f = add_frame(out, &cap, addrs[i]);
+        if (!f) {
+            rc = -1;
+            break;
+        }
+        if (addrs[i] < text) continue;
+        f->module = strdup("kernel");
+        f->module_offset = addrs[i] - text;
+        fill_frame(f, c, addrs[i] - text);
+    }
+    symcache_close(c);
+    return rc;
+}
+
+/* ---- Core files ---- */
+
+// A compressed core decompressed into an anonymous file, as libelf wants a descriptor.
+// What it takes (decompressed, or the file itself) comes off *budget.
+static int open_core(const char *path, size_t *budget) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    // A compressed file over the budget decompresses to more still
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size > *budget) {
+        close(fd);
+        errno = EFBIG;
+        return -1;
+    }
+    Compression kind = compression_for_path(path);
+    if (kind == COMPRESSION_NONE) {
+        *budget -= (size_t)st.st_size;
+        return fd;
+    }
+
+    Decoder *d = decoder_new(kind);
+    int mfd = memfd_create("core", MFD_CLOEXEC);
+    unsigned char *in = malloc(CORE_COPY_CHUNK), *buf = malloc(CORE_COPY_CHUNK);
+    int ok = d && mfd >= 0 && in && buf, done = 0, in_eof = 0, err = ENOMEM;
+    const unsigned char *inp = in;
+    size_t in_len = 0, total = 0;
+    while (ok && !done) {
+        if (in_len == 0 && !in_eof) {
+            ssize_t r = read(fd, in, CORE_COPY_CHUNK);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) in_eof = 1;
+            inp = in;
+            in_len = r > 0 ? (size_t)r : 0;
+        }
+        ssize_t produced = decoder_step(d, &inp, &in_len, in_eof, buf, CORE_COPY_CHUNK, &done);
+        if (produced < 0 || (produced == 0 && in_eof && in_len == 0 && !done)) {
+            ok = 0;
+            err = ENOEXEC;
+        } else if ((total += (size_t)produced) > *budget) {
+            ok = 0;
+            err = EFBIG;
+        } else if (produced > 0 && write(mfd, buf, (size_t)produced) != produced) {
+            ok = 0;
+            err = errno;
+        }
+    }
+    free(in);
+    free(buf);
+    decoder_free(d);
+    close(fd);
+    if (!ok) {
+        if (mfd >= 0) close(mfd);
+        errno = err;
+        return -1;
+    }
+    *budget -= total;
+    return mfd;
+}
+
+typedef struct {
+    Dwfl *dwfl;
+    SymTrace *trace;
+    size_t cap, max_frames;
+    int failed;
+} UnwindState;
+
+static int build_from_module(void *arg, const char *build_id) {
+    return build_entry(arg, build_id);
+}
+
+static int on_frame(Dwfl_Frame *frame, void *arg) {
+    UnwindState *u = arg;
+    Dwarf_Addr pc;
+    bool activation = false;
+    if (!dwfl_frame_pc(frame, &pc, &activation)) return DWARF_CB_ABORT;
+    SymFrame *f = add_frame(u->trace, &u->cap, pc);
+    if (!f) {
+        u->failed = 1;
+        return DWARF_CB_ABORT;
+    }
+    uint64_t lookup = activation || pc == 0 ? pc : pc - 1;
+    Dwfl_Module *mod = dwfl_addrmodule(u->dwfl, lookup);
+    if (mod) {
+        Dwarf_Addr start = 0;
+        const char *mainfile = NULL;
+        const char *name = dwfl_module_info(mod, NULL, &start, NULL, NULL, NULL, &mainfile, NULL);
+        // The path the file was found at, rather than the name the core has for it
+        if (mainfile || name) f->module = strdup(mainfile ? mainfile : name);
+        f->module_offset = pc - start;
+        const unsigned char *bits;
+        GElf_Addr vaddr, bias = 0;
+        int len = dwfl_module_build_id(mod, &bits, &vaddr);
+        if (len > 1 && dwfl_module_getelf(mod, &bias)) {
+            char id[2 * BUILD_ID_MAX + 1];
+            hex_id(bits, (size_t)len, id);
+            SymCache *c = open_entry(id, build_from_module, mod);
+            fill_frame(f, c, lookup - bias);
+            symcache_close(c);
+        }
+    }
+    return u->trace->count < u->max_frames ? DWARF_CB_OK : DWARF_CB_ABORT;
+}
+
+// The first thread in a core is the one that crashed
+static int on_thread(Dwfl_Thread *thread, void *arg) {
+    // Stops with an error where the unwinder loses track; the frames so far stand
+    dwfl_thread_getframes(thread, on_frame, arg);
+    return DWARF_CB_ABORT;
+}
+
+int symbolize_core(const char *path, const char *exe, size_t max_frames, size_t *budget, SymTrace *out) {
+    memset(out, 0, sizeof(*out));
+    pthread_once(&elf_once, init_libelf);
+    int fd = open_core(path, budget);
+    if (fd < 0) return -1;
+    Elf *core = elf_begin(fd, ELF_C_READ_MMAP, NULL);
+    GElf_Ehdr ehdr;
+    if (!core || !gelf_getehdr(core, &ehdr) || ehdr.e_type != ET_CORE) {
+        if (core) elf_end(core);
+        close(fd);
+        errno = ENOEXEC;
+        return -1;
+    }
+
+    int rc = -1;
+    Dwfl *dwfl = dwfl_begin(&core_callbacks);
+    if (dwfl) {
+        dwfl_report_begin(dwfl);
+        int reported = dwfl_core_file_report(dwfl, core, exe);
+        dwfl_report_end(dwfl, NULL, NULL);
+        if (reported >= 0 && dwfl_core_file_attach(dwfl, core) >= 0) {
+            UnwindState u = { dwfl, out, 0, max_frames ? max_frames : 1, 0 };
+            dwfl_getthreads(dwfl, on_thread, &u);
+            rc = u.failed ? -1 : 0;
+            if (rc != 0) errno = ENOMEM;
+        } else {
+            fprintf(stderr, "Could not read core %s: %s\n", path, dwfl_errmsg(-1));
+            errno = ENOEXEC;
+        }
+        dwfl_end(dwfl);
+    }
+    elf_end(core);
+    close(fd);
+    if (rc != 0) sym_trace_free(out);
+    return rc;
+}
@@ -0,0 +1,50 @@
+#ifndef SYMBOLIZE_H
+#define SYMBOLIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "coredump.h"
+
+// Turns raw addresses into function, file and line. Binaries are identified by their
+// build-id: separate debug files are looked up under SYMBOLIZE_DEBUG_DIR/.build-id, and
+// the symbol and line tables parsed from a binary go into the symbol cache (see
+// symcache.h), so the DWARF of a binary is parsed once and not again for every crash.
+
+typedef struct {
+    uint64_t pc;
+    char *module;            // the file pc is in, NULL when outside any
+    uint64_t module_offset;  // pc relative to where the module is loaded
+    char *function;          // NULL when no symbol covers pc
+    uint64_t function_offset;
+    char *file;              // NULL without a line table
+    int line;
+} SymFrame;
+
+typedef struct {
+    SymFrame *frames;
+    size_t count;
+} SymTrace;
+
+// Symbolize the backtrace pcs (innermost first; the others are return addresses) of a
+// crashed process, using the file mappings from its core notes. Modules replaced on disk
+// after crash_usec are left unsymbolized. Returns 0, or -1 when out of memory.
+int symbolize_addresses(const CoreNotes *notes, uint64_t crash_usec, const uint64_t *pcs, size_t n, SymTrace *out);
+
+// Symbolize addresses in the running kernel image from /proc/kallsyms, cached by the
+// kernel's build-id. Returns 0, or -1 when the kernel hides its addresses (not root,
+// kptr_restrict).
+int symbolize_kernel_addresses(const uint64_t *addrs, size_t n, SymTrace *out);
+
+// Unwind the crashing thread of a core file (.zst, .lz4, .xz or uncompressed) and
+// symbolize up to max_frames frames. Compressed cores are decompressed into memory.
+// The bytes decompressed (or the size of an uncompressed core) are taken off *budget,
+// and a core that would need more is not read. exe is the crashed executable, or NULL.
+// Returns 0, or -1 with errno set (EFBIG: over the budget, ENOEXEC: not an ELF core).
+int symbolize_core(const char *path, const char *exe, size_t max_frames, size_t *budget, SymTrace *out);
+
+void sym_trace_free(SymTrace *trace);
+
+// "function+0x1f at file:line", or whichever part is known; "" when neither is
+void sym_frame_describe(const SymFrame *frame, char *buf, size_t size);
+
+#endif // SYMBOLIZE_H
@@ -0,0 +1,372 @@
+/* Symbol table cache
+ * <build-id>.sym files: a header, the symbols and the line table rows (16 bytes each,
+ * sorted by address) and a string table holding every name and file name once. Entries
+ * are written to a temporary file and renamed into place, so readers only ever map
+ * complete ones. A hit touches the file; the oldest entries are removed once there are
+ * more than SYMCACHE_MAX_ENTRIES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "symcache.h"
+#include "paths.h"
+#include "strbuf.h"
+#include "config.h"
+
+#define SYMCACHE_MAGIC "CRSYMTAB"
+#define SYMCACHE_FORMAT_VERSION 1
+#define SYMCACHE_SUFFIX ".sym"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t load_base;
+    uint64_t nsyms, nlines;
+    uint64_t syms_off, lines_off;
+    uint64_t strtab_off, strtab_size;
+} SymCacheHeader;
+
+typedef struct {
+    uint64_t addr;
+    uint32_t size;
+    uint32_t name;      // string table offset
+} SymCacheSym;
+
+typedef struct {
+    uint64_t addr;
+    uint32_t file;      // string table offset
+    uint32_t line;      // 0 ends a sequence
+} SymCacheLine;
+
+struct SymCache {
+    void *map;
+    size_t size;
+    const SymCacheHeader *hdr;
+    const SymCacheSym *syms;
+    const SymCacheLine *lines;
+    const char *strtab;
+};
+
+typedef struct {
+    SymCacheLine row;
+    size_t seq;         // insertion order, to keep rows at one address in table order
+} BuilderLine;
+
+struct SymCacheBuilder {
+    uint64_t load_base;
+    SymCacheSym *syms;
+    size_t nsyms, syms_cap;
+    BuilderLine *lines;
+    size_t nlines, lines_cap;
+    GString *strtab;
+    GHashTable *strings;  // string -> offset + 1
+    int failed;           // a row was lost (out of memory); the table must not be saved
+};
+
+static int valid_key(const char *key) {
+    size_t n = strlen(key);
+    return n > 0 && n <= 128 && strspn(key, "0123456789abcdefghijklmnopqrstuvwxyz-") == n;
+}
+
+/* ---- Building ---- */
+
+SymCacheBuilder* symcache_builder_new(uint64_t load_base) {
+    SymCacheBuilder *b = calloc(1, sizeof(SymCacheBuilder));
+    if (!b) return NULL;
+    b->load_base = load_base;
+    b->strtab = g_string_new("");
+    g_string_append_len(b->strtab, "", 1); // offset 0 is the empty string
+    b->strings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    return b;
+}
+
+static uint32_t intern(SymCacheBuilder *b, const char *s) {
+    gpointer found = g_hash_table_lookup(b->strings, s);
+    if (found) return (uint32_t)(GPOINTER_TO_SIZE(found) - 1);
+    size_t off = b->strtab->len;
+    if (off >= UINT32_MAX) {
+        b->failed = 1;
+        return 0;
+    }
+    g_string_append_len(b->strtab, s, (gssize)strlen(s) + 1);
+    // Keys point into the table, which may move; keep a copy owned by the hash table
+    g_hash_table_insert(b->strings, g_strdup(s), GSIZE_TO_POINTER(off + 1));
+    return (uint32_t)off;
+}
+
+void symcache_builder_add_symbol(SymCacheBuilder *b, uint64_t addr, uint64_t size, const char *name) {
+    if (!name || !name[0]) return;
+    if (b->nsyms == b->syms_cap) {
+        size_t cap = b->syms_cap ? b->syms_cap * 2 : 1024;
+        SymCacheSym *n = realloc(b->syms, cap * sizeof(SymCacheSym));
+        if (!n) {
+            b->failed = 1;
+            return;
+        }
+        b->syms = n;
+        b->syms_cap = cap;
+    }
+    SymCacheSym *s = &b->syms[b->nsyms++];
+    s->addr = addr;
+    s->size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+    s->name = intern(b, name);
+}
+
+void symcache_builder_add_line(SymCacheBuilder *b, uint64_t addr, const char *file, int line) {
+    if (b->nlines == b->lines_cap) {
+        size_t cap = b->lines_cap ? b->lines_cap * 2 : 4096;
+        BuilderLine *n = realloc(b->lines, cap * sizeof(BuilderLine));
+        if (!n) {
+            b->failed = 1;
+            return;
+        }
+        b->lines = n;
+        b->lines_cap = cap;
+    }
+    BuilderLine *l = &b->lines[b->nlines];
+    l->row.addr = addr;
+    l->row.file = line > 0 && file ? intern(b, file) : 0;
+    l->row.line = line > 0 ? (uint32_t)line : 0;
+    l->seq = b->nlines++;
+}
+
+static int by_symbol(const void *a, const void *b) {
+    const SymCacheSym *x = a, *y = b;
+    if (x->addr != y->addr) return x->addr < y->addr ? -1 : 1;
+    // Sized symbols first, so the one kept for an address is the most useful
+    if ((x->size == 0) != (y->size == 0)) return x->size == 0 ? 1 : -1;
+    return x->name < y->name ? -1 : x->name > y->name;
+}
+
+static int by_line(const void *a, const void *b) {
+    const BuilderLine *x = a, *y = b;
+    if (x->row.addr != y->row.addr) return x->row.addr < y->row.addr ? -1 : 1;
+    // A sequence ending where the next one starts: the start wins
+    if ((x->row.line == 0) != (y->row.line == 0)) return x->row.line == 0 ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+typedef struct {
+    char *name;
+    time_t mtime;
+} CacheFile;
+
+static int by_age(const void *a, const void *b) {
+    const CacheFile *x = a, *y = b;
+    return x->mtime < y->mtime ? -1 : x->mtime > y->mtime;
+}
+
+// Remove the least recently used entries beyond SYMCACHE_MAX_ENTRIES
+static void prune(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    CacheFile *files = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (de->d_name[0] == '.' || !has_suffix(de->d_name, SYMCACHE_SUFFIX)) continue;
+        struct stat st;
+        if (fstatat(dirfd(d), de->d_name, &st, 0) != 0) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            CacheFile *f = realloc(files, cap * sizeof(CacheFile));
+            if (!f) break;
+            files = f;
+        }
+        files[n].name = strdup(de->d_name);
+        files[n].mtime = st.st_mtime;
+        if (files[n].name) n++;
+    }
+    if (n > SYMCACHE_MAX_ENTRIES) {
+        qsort(files, n, sizeof(CacheFile), by_age);
+        for (size_t i = 0; i < n - SYMCACHE_MAX_ENTRIES; ++i) unlinkat(dirfd(d), files[i].name, 0);
+    }
+    for (size_t i = 0; i < n; ++i) free(files[i].name);
+    free(files);
+    closedir(d);
+}
+
+int symcache_builder_write(SymCacheBuilder *b, const char *key, unsigned flags) {
+    char dir[PATH_MAX];
+    // An incomplete table would stand for the binary until a debug file shows up
+    if (b->failed || !valid_key(key) || cache_dir("symcache", dir, sizeof(dir)) != 0) return -1;
+
+    qsort(b->syms, b->nsyms, sizeof(SymCacheSym), by_symbol);
+    size_t nsyms = 0;
+    for (size_t i = 0; i < b->nsyms; ++i) {
+        if (nsyms > 0 && b->syms[nsyms - 1].addr == b->syms[i].addr) continue; // aliases
+        b->syms[nsyms++] = b->syms[i];
+    }
+    qsort(b->lines, b->nlines, sizeof(BuilderLine), by_line);
+
+    SymCacheHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SYMCACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = SYMCACHE_FORMAT_VERSION;
+    hdr.flags = flags;
+    hdr.load_base = b->load_base;
+    hdr.nsyms = nsyms;
+    hdr.nlines = b->nlines;
+    hdr.syms_off = sizeof(hdr);
+    hdr.lines_off = hdr.syms_off + nsyms * sizeof(SymCacheSym);
+    hdr.strtab_off = hdr.lines_off + b->nlines * sizeof(SymCacheLine);
+    hdr.strtab_size = b->strtab->len;
+
+    char tmp[PATH_MAX + 16], path[PATH_MAX + 160];
+    snprintf(tmp, sizeof(tmp), "%s/.tmp-XXXXXX", dir);
+    snprintf(path, sizeof(path), "%s/%s" SYMCACHE_SUFFIX, dir, key);
+    int fd = mkstemp(tmp);
+    if (fd < 0) return -1;
+    int ok = write_all(fd, &hdr, sizeof(hdr)) == 0 &&
+             write_all(fd, b->syms, nsyms * sizeof(SymCacheSym)) == 0;
+    // Rows go out in chunks without the builder's sequence numbers
+    SymCacheLine chunk[1024];
+    for (size_t i = 0; ok && i < b->nlines;) {
+        size_t n = 0;
+        while (n < sizeof(chunk) / sizeof(chunk[0]) && i < b->nlines) chunk[n++] = b->lines[i++].row;
+        ok = write_all(fd, chunk, n * sizeof(SymCacheLine)) == 0;
+    }
+    ok = ok && write_all(fd, b->strtab->str, b->strtab->len) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    prune(dir);
+    return 0;
+}
+
+void symcache_builder_free(SymCacheBuilder *b) {
+    if (!b) return;
+    free(b->syms);
+    free(b->lines);
+    g_string_free(b->strtab, TRUE);
+    g_hash_table_destroy(b->strings);
+    free(b);
+}
+
+/* ---- Reading ---- */
+
+// Everything the lookups index must lie inside the mapping
+static int check_layout(const SymCacheHeader *h, size_t size) {
+    if (memcmp(h->magic, SYMCACHE_MAGIC, sizeof(h->magic)) != 0 || h->version != SYMCACHE_FORMAT_VERSION) return -1;
+    if (h->nsyms > size / sizeof(SymCacheSym) || h->nlines > size / sizeof(SymCacheLine)) return -1;
+    if (h->syms_off != sizeof(SymCacheHeader) ||
+        h->lines_off != h->syms_off + h->nsyms * sizeof(SymCacheSym) ||
+        h->strtab_off != h->lines_off + h->nlines * sizeof(SymCacheLine)) {
+        return -1;
+    }
+    if (h->strtab_size == 0 || h->strtab_size > size || h->strtab_off > size - h->strtab_size) return -1;
+    return 0;
+}
+
+SymCache* symcache_open(const char *key) {
+    char dir[PATH_MAX], path[PATH_MAX + 160];
+    if (!valid_key(key) || cache_dir("symcache", dir, sizeof(dir)) != 0) return NULL;
+    snprintf(path, sizeof(path), "%s/%s" SYMCACHE_SUFFIX, dir, key);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SymCacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    // Mark it as recently used for prune()
+    futimens(fd, NULL);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const SymCacheHeader *h = map;
+    const char *strtab = (const char *)map + h->strtab_off;
+    if (check_layout(h, size) != 0 || strtab[h->strtab_size - 1] != '\0') {
+        munmap(map, size);
+        return NULL;
+    }
+    SymCache *c = calloc(1, sizeof(SymCache));
+    if (!c) {
+        munmap(map, size);
+        return NULL;
+    }
+    c->map = map;
+    c->size = size;
+    c->hdr = h;
+    c->syms = (const SymCacheSym *)((const char *)map + h->syms_off);
+    c->lines = (const SymCacheLine *)((const char *)map + h->lines_off);
+    c->strtab = strtab;
+    return c;
+}
+
+uint64_t symcache_load_base(const SymCache *c) {
+    return c->hdr->load_base;
+}
+
+unsigned symcache_flags(const SymCache *c) {
+    return c->hdr->flags;
+}
+
+static const char* string_at(const SymCache *c, uint32_t off) {
+    return off > 0 && off < c->hdr->strtab_size ? c->strtab + off : NULL;
+}
+
+int symcache_lookup(const SymCache *c, uint64_t addr, SymCacheResult *out) {
+    memset(out, 0, sizeof(*out));
+
+    // Last symbol starting at or below addr
+    size_t lo = 0, hi = c->hdr->nsyms;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (c->syms[mid].addr <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0) {
+        const SymCacheSym *s = &c->syms[lo - 1];
+        if (s->size == 0 || addr - s->addr < s->size) {
+            out->function = string_at(c, s->name);
+            out->function_offset = addr - s->addr;
+        }
+    }
+
+    // Last line table row at or below addr, unless it ends a sequence
+    lo = 0;
+    hi = c->hdr->nlines;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (c->lines[mid].addr <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0 && c->lines[lo - 1].line > 0) {
+        out->file = string_at(c, c->lines[lo - 1].file);
+        out->line = (int)c->lines[lo - 1].line;
+    }
+    return out->function || out->file ? 0 : -1;
+}
+
+void symcache_close(SymCache *c) {
+    if (!c) return;
+    munmap(c->map, c->size);
+    free(c);
+}
@@ -0,0 +1,55 @@
+#ifndef SYMCACHE_H
+#define SYMCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Persistent symbol tables, one file per build-id under $XDG_CACHE_HOME/crash-reporter/symcache
+// (or ~/.cache). A file holds the function symbols and the line table of one binary,
+// sorted by address, in a flat layout that is mapped and binary searched as it is, so a
+// binary whose DWARF was parsed once is symbolized again without parsing anything.
+//
+// Addresses are the binary's own (link-time) addresses; load_base is the lowest address
+// it maps, which is where its first mapping starts in a process.
+
+typedef struct SymCache SymCache;
+typedef struct SymCacheBuilder SymCacheBuilder;
+
+#define SYMCACHE_HAVE_LINES 0x1      // the line table came from DWARF
+#define SYMCACHE_HAVE_DEBUGINFO 0x2  // a separate debug file was found for the binary
+
+typedef struct {
+    const char *function;   // NULL when no symbol covers the address
+    uint64_t function_offset;
+    const char *file;       // NULL when the line table does not cover it
+    int line;
+} SymCacheResult;
+
+SymCacheBuilder* symcache_builder_new(uint64_t load_base);
+
+// size 0 for symbols without one (hand-written assembly)
+void symcache_builder_add_symbol(SymCacheBuilder *b, uint64_t addr, uint64_t size, const char *name);
+
+// One line table row; line 0 ends a sequence
+void symcache_builder_add_line(SymCacheBuilder *b, uint64_t addr, const char *file, int line);
+
+// Sort and write the table as the entry for key (a hex build-id), replacing an older one
+// atomically. flags are SYMCACHE_HAVE_*. Returns 0, or -1 when the cache directory is
+// not writable or a symbol or line could not be added (nothing is written then).
+int symcache_builder_write(SymCacheBuilder *b, const char *key, unsigned flags);
+
+void symcache_builder_free(SymCacheBuilder *b);
+
+// Map the entry for key. NULL when there is none or it is from another format version.
+SymCache* symcache_open(const char *key);
+
+uint64_t symcache_load_base(const SymCache *c);
+unsigned symcache_flags(const SymCache *c);
+
+// Resolve a link-time address. Returns 0 when a symbol or a line was found, -1 otherwise.
+// The strings point into the mapping and live until symcache_close().
+int symcache_lookup(const SymCache *c, uint64_t addr, SymCacheResult *out);
+
+void symcache_close(SymCache *c);
+
+#endif // SYMCACHE_H
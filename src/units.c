@@ -0,0 +1,349 @@
+/* Failed systemd units over D-Bus
+ * The property requests for all units go out before the first reply is read; they run
+ * on a private main context so the caller's thread (a collector worker) needs no loop
+ * of its own.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <gio/gio.h>
+#include "units.h"
+#include "journal.h"
+#include "helper.h"
+#include "strbuf.h"
+#include "collector.h"
+#include "config.h"
+
+#define SYSTEMD_BUS_NAME "org.freedesktop.systemd1"
+#define SYSTEMD_PATH "/org/freedesktop/systemd1"
+#define SYSTEMD_MANAGER "org.freedesktop.systemd1.Manager"
+#define SYSTEMD_UNIT "org.freedesktop.systemd1.Unit"
+
+typedef struct {
+    GMainContext *ctx;
+    size_t pending;
+} Pipeline;
+
+typedef struct {
+    Pipeline *pipeline;
+    FailedUnit *unit;
+} PropertyCall;
+
+// Own connection to CRASH_REPORTER_SYSTEM_BUS when set, the shared system bus otherwise
+static GDBusConnection* system_bus(void) {
+    GError *err = NULL;
+    const char *address = getenv("CRASH_REPORTER_SYSTEM_BUS");
+    GDBusConnection *bus;
+    if (address && address[0]) {
+        bus = g_dbus_connection_new_for_address_sync(address,
+                                                     G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                     G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                     NULL, NULL, &err);
+    } else {
+        bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &err);
+    }
+    if (!bus) {
+        fprintf(stderr, "Could not connect to the system bus: %s\n", err ? err->message : "unknown error");
+        g_clear_error(&err);
+    }
+    return bus;
+}
+
+// Type-specific interface holding Result and, for services, the main process
+static const char* type_interface(const char *name) {
+    static const struct {
+        const char *suffix, *iface;
+    } types[] = {
+        { ".service", "org.freedesktop.systemd1.Service" },
+        { ".socket", "org.freedesktop.systemd1.Socket" },
+        { ".mount", "org.freedesktop.systemd1.Mount" },
+        { ".swap", "org.freedesktop.systemd1.Swap" },
+        { ".timer", "org.freedesktop.systemd1.Timer" },
+        { ".path", "org.freedesktop.systemd1.Path" },
+        { ".automount", "org.freedesktop.systemd1.Automount" },
+        { ".scope", "org.freedesktop.systemd1.Scope" },
+    };
+    const char *dot = strrchr(name, '.');
+    for (size_t i = 0; dot && i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (strcmp(dot, types[i].suffix) == 0) return types[i].iface;
+    }
+    return NULL;
+}
+
+static void on_properties(GObject *source, GAsyncResult *res, gpointer user_data) {
+    PropertyCall *call = user_data;
+    FailedUnit *u = call->unit;
+    GError *err = NULL;
+    GVariant *reply = g_dbus_connection_call_finish((GDBusConnection *)source, res, &err);
+    if (reply) {
+        GVariant *props = g_variant_get_child_value(reply, 0);
+        char *s = NULL;
+        if (!u->fragment_path && g_variant_lookup(props, "FragmentPath", "s", &s)) {
+            if (s && s[0]) u->fragment_path = strdup(s);
+            g_free(s);
+            s = NULL;
+        }
+        if (!u->result && g_variant_lookup(props, "Result", "s", &s)) {
+            if (s && s[0]) u->result = strdup(s);
+            g_free(s);
+        }
+        guint64 t;
+        if (g_variant_lookup(props, "InactiveEnterTimestamp", "t", &t)) u->failed_usec = t;
+        gint32 code, status;
+        if (g_variant_lookup(props, "ExecMainCode", "i", &code) &&
+            g_variant_lookup(props, "ExecMainStatus", "i", &status)) {
+            u->have_exec_main = code > 0;
+            u->exec_main_code = code;
+            u->exec_main_status = status;
+        }
+        guint32 v;
+        if (g_variant_lookup(props, "ExecMainPID", "u", &v)) u->exec_main_pid = v;
+        if (g_variant_lookup(props, "NRestarts", "u", &v)) u->restarts = v;
+        g_variant_unref(props);
+        g_variant_unref(reply);
+    } else {
+        fprintf(stderr, "Could not read the properties of %s: %s\n", u->name, err ? err->message : "unknown error");
+        g_clear_error(&err);
+    }
+    call->pipeline->pending--;
+    free(call);
+}
+
+static void get_all(GDBusConnection *bus, Pipeline *p, FailedUnit *u, const char *path, const char *iface) {
+    PropertyCall *call = malloc(sizeof(PropertyCall));
+    if (!call) return;
+    call->pipeline = p;
+    call->unit = u;
+    p->pending++;
+    g_dbus_connection_call(bus, SYSTEMD_BUS_NAME, path, "org.freedesktop.DBus.Properties", "GetAll",
+                           g_variant_new("(s)", iface), G_VARIANT_TYPE("(a{sv})"), G_DBUS_CALL_FLAGS_NONE,
+                           UNITS_DBUS_TIMEOUT_MS, NULL, on_properties, call);
+}
+
+int units_list_failed(int details, FailedUnitList *out) {
+    memset(out, 0, sizeof(*out));
+    GDBusConnection *bus = system_bus();
+    if (!bus) return -1;
+
+    const char *states[] = { "failed", NULL };
+    GError *err = NULL;
+    GVariant *reply = g_dbus_connection_call_sync(bus, SYSTEMD_BUS_NAME, SYSTEMD_PATH, SYSTEMD_MANAGER,
+                                                  "ListUnitsFiltered", g_variant_new("(^as)", states),
+                                                  G_VARIANT_TYPE("(a(ssssssouso))"), G_DBUS_CALL_FLAGS_NONE,
+                                                  UNITS_DBUS_TIMEOUT_MS, NULL, &err);
+    if (!reply) {
+        fprintf(stderr, "Could not list the failed units: %s\n", err ? err->message : "unknown error");
+        g_clear_error(&err);
+        g_object_unref(bus);
+        return -1;
+    }
+
+    GVariantIter *it;
+    g_variant_get(reply, "(a(ssssssouso))", &it);
+    const char *name, *desc, *load, *active, *sub, *following, *path, *job_type, *job_path;
+    guint32 job_id;
+    size_t cap = 0;
+    char **paths = NULL;
+    while (g_variant_iter_next(it, "(&s&s&s&s&s&s&ou&s&o)", &name, &desc, &load, &active, &sub, &following, &path,
+                               &job_id, &job_type, &job_path)) {
+        if (out->count == cap) {
+            size_t n = cap ? cap * 2 : 16;
+            FailedUnit *u = realloc(out->units, n * sizeof(FailedUnit));
+            char **p = realloc(paths, n * sizeof(char*));
+            if (u) out->units = u;
+            if (p) paths = p;
+            if (!u || !p) break;
+            cap = n;
+        }
+        FailedUnit *u = &out->units[out->count];
+        memset(u, 0, sizeof(*u));
+        u->name = strdup(name);
+        u->description = strdup(desc);
+        u->load_state = strdup(load);
+        u->active_state = strdup(active);
+        u->sub_state = strdup(sub);
+        paths[out->count++] = strdup(path);
+    }
+    g_variant_iter_free(it);
+    g_variant_unref(reply);
+
+    if (details && out->count > 0) {
+        // Replies are dispatched to the context that was the thread default when the
+        // calls were made
+        Pipeline p = { g_main_context_new(), 0 };
+        g_main_context_push_thread_default(p.ctx);
+        for (size_t i = 0; i < out->count; ++i) {
+            FailedUnit *u = &out->units[i];
+            if (!paths[i] || !u->name) continue;
+            get_all(bus, &p, u, paths[i], SYSTEMD_UNIT);
+            const char *iface = type_interface(u->name);
+            if (iface) get_all(bus, &p, u, paths[i], iface);
+        }
+        // Every call has a timeout, so this ends
+        while (p.pending > 0) g_main_context_iteration(p.ctx, TRUE);
+        g_main_context_pop_thread_default(p.ctx);
+        g_main_context_unref(p.ctx);
+    }
+    for (size_t i = 0; i < out->count; ++i) free(paths[i]);
+    free(paths);
+    g_object_unref(bus);
+    return 0;
+}
+
+void failed_unit_list_free(FailedUnitList *list) {
+    for (size_t i = 0; i < list->count; ++i) {
+        FailedUnit *u = &list->units[i];
+        free(u->name);
+        free(u->description);
+        free(u->load_state);
+        free(u->active_state);
+        free(u->sub_state);
+        free(u->fragment_path);
+        free(u->result);
+    }
+    free(list->units);
+    memset(list, 0, sizeof(*list));
+}
+
+/* ---- Report sections ---- */
+
+static const char* str_or(const char *s, const char *fallback) {
+    return s ? s : fallback;
+}
+
+char* collect_failed_units(const int *cancel, size_t *out_len) {
+    FailedUnitList list;
+    if (units_list_failed(0, &list) != 0) return NULL;
+
+    // Same layout as systemctl --failed, which the fingerprint reads unit names from
+    size_t w_name = 4, w_load = 4, w_active = 6, w_sub = 3;
+    for (size_t i = 0; i < list.count; ++i) {
+        const FailedUnit *u = &list.units[i];
+        size_t n;
+        if ((n = strlen(str_or(u->name, ""))) > w_name) w_name = n;
+        if ((n = strlen(str_or(u->load_state, ""))) > w_load) w_load = n;
+        if ((n = strlen(str_or(u->active_state, ""))) > w_active) w_active = n;
+        if ((n = strlen(str_or(u->sub_state, ""))) > w_sub) w_sub = n;
+    }
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    buf_printf(&buf, &len, &cap, "  %-*s %-*s %-*s %-*s %s\n", (int)w_name, "UNIT", (int)w_load, "LOAD",
+               (int)w_active, "ACTIVE", (int)w_sub, "SUB", "DESCRIPTION");
+    for (size_t i = 0; i < list.count; ++i) {
+        const FailedUnit *u = &list.units[i];
+        buf_printf(&buf, &len, &cap, "● %-*s %-*s %-*s %-*s %s\n", (int)w_name, str_or(u->name, "?"),
+                   (int)w_load, str_or(u->load_state, ""), (int)w_active, str_or(u->active_state, ""),
+                   (int)w_sub, str_or(u->sub_state, ""), str_or(u->description, ""));
+    }
+    buf_printf(&buf, &len, &cap, "\n%zu loaded units listed.\n", list.count);
+    failed_unit_list_free(&list);
+    if (out_len) *out_len = buf ? len : 0;
+    return buf;
+}
+
+static void append_time(char **buf, size_t *len, size_t *cap, const char *prefix, uint64_t usec) {
+    if (usec == 0) return;
+    time_t secs = (time_t)(usec / 1000000ULL);
+    struct tm tm;
+    char ts[32];
+    localtime_r(&secs, &tm);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+    buf_printf(buf, len, cap, "%s%s", prefix, ts);
+}
+
+// How the main process ended, as systemctl status words it
+static void append_exec_main(char **buf, size_t *len, size_t *cap, const FailedUnit *u) {
+    if (!u->have_exec_main) return;
+    buf_printf(buf, len, cap, "   Main PID: %u ", u->exec_main_pid);
+    if (u->exec_main_code == CLD_EXITED) {
+        buf_printf(buf, len, cap, "(code=exited, status=%d)\n", u->exec_main_status);
+    } else {
+        const char *sig = sigabbrev_np(u->exec_main_status);
+        buf_printf(buf, len, cap, "(code=%s, signal=%s%s)\n", u->exec_main_code == CLD_DUMPED ? "dumped" : "killed",
+                   sig ? "SIG" : "", sig ? sig : "?");
+    }
+}
+
+char* collect_failed_unit_statuses(const int *cancel, size_t *out_len) {
+    // Without journal access the lines would be missing; the helper has it
+    int readable = journal_system_readable();
+    if (!readable && helper_available()) return NULL;
+
+    FailedUnitList list;
+    if (units_list_failed(1, &list) != 0) return NULL;
+    if (list.count == 0) {
+        failed_unit_list_free(&list);
+        if (out_len) *out_len = 0;
+        return strdup("");
+    }
+
+    JournalEntries *lines = calloc(list.count, sizeof(JournalEntries));
+    const char **names = calloc(list.count, sizeof(char*));
+    int have_lines = 0;
+    if (lines && names && readable) {
+        for (size_t i = 0; i < list.count; ++i) names[i] = str_or(list.units[i].name, "");
+        have_lines = journal_collect_units(names, list.count, UNITS_JOURNAL_LINES, cancel, lines) == 0;
+    }
+    if (collector_cancel_requested(cancel)) {
+        if (have_lines) {
+            for (size_t i = 0; i < list.count; ++i) journal_entries_free(&lines[i]);
+        }
+        free(lines);
+        free(names);
+        failed_unit_list_free(&list);
+        return NULL;
+    }
+
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        const FailedUnit *u = &list.units[i];
+        buf_printf(&buf, &len, &cap, "× %s - %s\n", str_or(u->name, "?"), str_or(u->description, ""));
+        buf_printf(&buf, &len, &cap, "     Loaded: %s%s%s%s\n", str_or(u->load_state, "?"),
+                   u->fragment_path ? " (" : "", str_or(u->fragment_path, ""), u->fragment_path ? ")" : "");
+        buf_printf(&buf, &len, &cap, "     Active: %s", str_or(u->active_state, "?"));
+        if (u->result) buf_printf(&buf, &len, &cap, " (Result: %s)", u->result);
+        append_time(&buf, &len, &cap, " since ", u->failed_usec);
+        buf_append(&buf, &len, &cap, "\n", 1);
+        append_exec_main(&buf, &len, &cap, u);
+        if (u->restarts > 0) buf_printf(&buf, &len, &cap, "   Restarts: %u\n", u->restarts);
+        if (have_lines && lines[i].count > 0) {
+            size_t tlen = 0;
+            char *text = journal_format_entries(&lines[i], &tlen);
+            buf_append(&buf, &len, &cap, "\n", 1);
+            if (text) buf_append(&buf, &len, &cap, text, tlen);
+            free(text);
+        } else if (!readable) {
+            buf_printf(&buf, &len, &cap, "\n(journal not readable without root)\n");
+        }
+        buf_append(&buf, &len, &cap, "---\n", 4);
+    }
+    if (lines && have_lines) {
+        for (size_t i = 0; i < list.count; ++i) journal_entries_free(&lines[i]);
+    }
+    free(lines);
+    free(names);
+    failed_unit_list_free(&list);
+    if (out_len) *out_len = buf ? len : 0;
+    return buf;
+}
+
+char* failed_units_token(void) {
+    FailedUnitList list;
+    if (units_list_failed(0, &list) != 0) return NULL;
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        const FailedUnit *u = &list.units[i];
+        buf_printf(&buf, &len, &cap, "%s %s %s\n", str_or(u->name, "?"), str_or(u->active_state, ""),
+                   str_or(u->sub_state, ""));
+    }
+    failed_unit_list_free(&list);
+    return buf ? buf : strdup("none");
+}
@@ -0,0 +1,50 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Failed systemd units, asked of systemd over D-Bus rather than by running systemctl:
+// one ListUnitsFiltered call for the list, then the properties of every failed unit
+// requested all at once, so the replies come back in one round trip instead of one
+// systemctl process per unit. The recent journal lines of each unit are read through
+// sd-journal. The CRASH_REPORTER_SYSTEM_BUS environment variable points all of it at
+// another bus (a mock systemd in tests).
+
+typedef struct {
+    char *name, *description;
+    char *load_state, *active_state, *sub_state;
+    char *fragment_path;       // unit file, NULL for transient units
+    char *result;              // "exit-code", "timeout", ...; NULL for types without one
+    uint64_t failed_usec;      // when it last became inactive (wall clock), 0 if unknown
+    int have_exec_main;        // services: how the main process ended
+    int exec_main_code;        // CLD_EXITED, CLD_KILLED or CLD_DUMPED
+    int exec_main_status;      // exit status, or the signal
+    uint32_t exec_main_pid;
+    uint32_t restarts;
+} FailedUnit;
+
+typedef struct {
+    FailedUnit *units;         // in systemd's order
+    size_t count;
+} FailedUnitList;
+
+// List the failed units. With details, also fetch each unit's file, result and main
+// process. Returns 0, or -1 when systemd cannot be reached.
+int units_list_failed(int details, FailedUnitList *out);
+
+void failed_unit_list_free(FailedUnitList *list);
+
+// Report collectors: the list in systemctl --failed's layout, and a status block per
+// failed unit with its last UNITS_JOURNAL_LINES journal lines. Return NULL when the bus
+// cannot be reached; the status blocks also when the journal needs the privileged helper,
+// and once *cancel is set while their journal lines are read. The list is one bus call and
+// does not look at cancel.
+char* collect_failed_units(const int *cancel, size_t *out_len);
+char* collect_failed_unit_statuses(const int *cancel, size_t *out_len);
+
+// Validity token for both: the failed units with their states, from the list call
+// alone. Caller frees; NULL when the bus cannot be reached.
+char* failed_units_token(void);
+
+#endif // UNITS_H
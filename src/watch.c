@@ -0,0 +1,458 @@
+/* Resident error detection
+ * Each source is a descriptor watch on the caller's main context: the sd-journal inotify
+ * descriptor, /dev/kmsg opened past its newest record, and an inotify watch on the log
+ * directory. Only data that arrived since the last wakeup is matched.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <systemd/sd-journal.h>
+#include <gio/gio.h>
+#include "watch.h"
+#include "kmsg.h"
+#include "journal.h"
+#include "strbuf.h"
+#include "config.h"
+
+// The journal is matched on warning and above, like the boot section of the report
+#define WATCH_JOURNAL_MAX_PRIORITY 4
+#define WATCH_KMSG_MAX_LEVEL 4
+
+typedef struct {
+    char name[NAME_MAX + 1];
+    off_t offset;            // everything before this has been matched
+    ino_t ino;
+    int ignored;             // unreadable or binary
+} TailedFile;
+
+struct Watcher {
+    WatchOptions opts;
+    WatchTriggerFn on_trigger;
+    void *user;
+    GMainContext *ctx;
+    pid_t self;
+
+    sd_journal *journal;
+    GSource *journal_src;
+    GSource *journal_timer;  // only for journals on file systems without inotify
+    int kmsg_fd;
+    GSource *kmsg_src;
+    int inotify_fd;
+    GSource *inotify_src;
+    TailedFile *files;
+    size_t nfiles, files_cap;
+    char *read_buf;          // WATCH_READ_MAX bytes
+
+    gint64 *hit_times;       // ring of the last threshold hits (monotonic usec)
+    size_t hit_head, hit_count;
+    gint64 quiet_until;      // cooldown end
+    GSource *settle;
+    WatchTrigger pending;
+};
+
+static GSource* watch_fd(Watcher *w, int fd, GIOCondition cond, GIOFunc fn) {
+    GIOChannel *ch = g_io_channel_unix_new(fd);
+    GSource *src = g_io_create_watch(ch, cond);
+    g_io_channel_unref(ch);
+    g_source_set_callback(src, (GSourceFunc)(void (*)(void))fn, w, NULL);
+    g_source_attach(src, w->ctx);
+    return src;
+}
+
+static void drop_source(GSource **src) {
+    if (!*src) return;
+    g_source_destroy(*src);
+    g_source_unref(*src);
+    *src = NULL;
+}
+
+/* ---- Threshold ---- */
+
+static gboolean settle_done(gpointer data) {
+    Watcher *w = data;
+    g_source_unref(w->settle);
+    w->settle = NULL;
+    w->on_trigger(&w->pending, w->user);
+    return G_SOURCE_REMOVE;
+}
+
+static void fire(Watcher *w, const char *source, const char *line, size_t len, Severity s, gint64 now) {
+    memset(&w->pending, 0, sizeof(w->pending));
+    snprintf(w->pending.source, sizeof(w->pending.source), "%s", source);
+    if (len >= sizeof(w->pending.line)) len = sizeof(w->pending.line) - 1;
+    memcpy(w->pending.line, line, len);
+    w->pending.severity = s;
+    w->pending.lines = w->hit_count;
+    w->hit_count = 0;
+    w->quiet_until = now + (gint64)w->opts.cooldown_sec * G_USEC_PER_SEC;
+    fprintf(stderr, "Detected %s in %s: %s\n", severity_name(s), w->pending.source, w->pending.line);
+
+    w->settle = g_timeout_source_new(WATCH_SETTLE_MS);
+    g_source_set_callback(w->settle, settle_done, w, NULL);
+    g_source_attach(w->settle, w->ctx);
+}
+
+// Match one new line and trigger when the threshold is crossed
+static void feed(Watcher *w, const char *source, const char *line, size_t len) {
+    Severity s = severity_of_line(line, len);
+    if (s < WATCH_MIN_LEVEL) return;
+    if (w->settle) {
+        // Part of the burst that is about to be reported
+        w->pending.lines++;
+        if (s > w->pending.severity) w->pending.severity = s;
+        return;
+    }
+    gint64 now = g_get_monotonic_time();
+    if (now < w->quiet_until) return;
+
+    w->hit_times[w->hit_head] = now;
+    w->hit_head = (w->hit_head + 1) % w->opts.threshold;
+    if (w->hit_count < w->opts.threshold) w->hit_count++;
+    // Once the ring is full, the next slot to be overwritten holds the oldest of the last threshold hits
+    gint64 oldest = w->hit_times[w->hit_head];
+    int crossed = w->hit_count == w->opts.threshold && now - oldest <= (gint64)w->opts.window_sec * G_USEC_PER_SEC;
+    if (crossed || s == SEVERITY_CRITICAL) fire(w, source, line, len, s, now);
+}
+
+/* ---- Journal ---- */
+
+static void journal_read_new(Watcher *w) {
+    char line[2048];
+    while (sd_journal_next(w->journal) > 0) {
+        size_t len;
+        // Our own messages must not feed back into the matcher
+        const char *pid = journal_field(w->journal, "_PID", &len);
+        if (pid && (pid_t)strtol(pid, NULL, 10) == w->self) continue;
+        const char *msg = journal_field(w->journal, "MESSAGE", &len);
+        if (!msg) continue;
+        size_t msg_len = len;
+        const char *unit = journal_field(w->journal, "_SYSTEMD_UNIT", &len);
+        if (!unit) unit = journal_field(w->journal, "SYSLOG_IDENTIFIER", &len);
+        if (!unit) {
+            unit = "-";
+            len = 1;
+        }
+        int n = snprintf(line, sizeof(line), "%.*s: %.*s", (int)(len > 256 ? 256 : len), unit,
+                         (int)(msg_len > sizeof(line) ? sizeof(line) : msg_len), msg);
+        if (n < 0) continue;
+        feed(w, "journal", line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+    }
+}
+
+static gboolean journal_timer_fired(gpointer data);
+
+// sd-journal asks for a wakeup by time only when it cannot rely on inotify
+static void journal_arm_timer(Watcher *w) {
+    drop_source(&w->journal_timer);
+    uint64_t until;
+    if (sd_journal_get_timeout(w->journal, &until) < 0 || until == (uint64_t)-1) return;
+    gint64 now = g_get_monotonic_time();
+    guint ms = (gint64)until > now ? (guint)(((gint64)until - now + 999) / 1000) : 0;
+    w->journal_timer = g_timeout_source_new(ms);
+    g_source_set_callback(w->journal_timer, journal_timer_fired, w, NULL);
+    g_source_attach(w->journal_timer, w->ctx);
+}
+
+static gboolean on_journal_event(GIOChannel *ch, GIOCondition cond, gpointer data) {
+    (void)ch;
+    (void)cond;
+    Watcher *w = data;
+    // Acknowledges the wakeup; rotation and new files are handled by sd-journal itself
+    sd_journal_process(w->journal);
+    journal_read_new(w);
+    journal_arm_timer(w);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean journal_timer_fired(gpointer data) {
+    Watcher *w = data;
+    g_source_unref(w->journal_timer);
+    w->journal_timer = NULL;
+    on_journal_event(NULL, 0, w);
+    return G_SOURCE_REMOVE;
+}
+
+static int journal_start(Watcher *w) {
+    int r = sd_journal_open(&w->journal, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM);
+    if (r < 0) {
+        fprintf(stderr, "Not watching the journal: %s\n", strerror(-r));
+        w->journal = NULL;
+        return -1;
+    }
+    char match[32];
+    for (int p = 0; p <= WATCH_JOURNAL_MAX_PRIORITY; ++p) {
+        snprintf(match, sizeof(match), "PRIORITY=%d", p);
+        sd_journal_add_match(w->journal, match, 0);
+    }
+    // Stand on the newest entry so that next() only returns what is written from now on
+    sd_journal_seek_tail(w->journal);
+    sd_journal_previous(w->journal);
+
+    int fd = sd_journal_get_fd(w->journal);
+    int events = fd >= 0 ? sd_journal_get_events(w->journal) : -1;
+    if (fd < 0 || events < 0) {
+        fprintf(stderr, "Not watching the journal: %s\n", strerror(-(fd < 0 ? fd : events)));
+        sd_journal_close(w->journal);
+        w->journal = NULL;
+        return -1;
+    }
+    GIOCondition cond = 0;
+    if (events & POLLIN) cond |= G_IO_IN;
+    if (events & POLLOUT) cond |= G_IO_OUT;
+    w->journal_src = watch_fd(w, fd, cond, on_journal_event);
+    journal_arm_timer(w);
+    return 0;
+}
+
+/* ---- Kernel log ---- */
+
+static gboolean on_kmsg_event(GIOChannel *ch, GIOCondition cond, gpointer data) {
+    (void)ch;
+    (void)cond;
+    Watcher *w = data;
+    char buf[KMSG_RECORD_MAX];
+    for (;;) {
+        ssize_t r = read(w->kmsg_fd, buf, sizeof(buf) - 1);
+        if (r < 0) {
+            // EPIPE: records were overwritten before we got to them; carry on with the next
+            if (errno == EINTR || errno == EPIPE) continue;
+            break;
+        }
+        if (r == 0) break;
+        buf[r] = '\0';
+        KmsgRecord rec;
+        if (kmsg_parse_record(buf, (size_t)r, &rec) != 0) continue;
+        if (rec.level <= WATCH_KMSG_MAX_LEVEL) feed(w, "kernel", rec.message, strlen(rec.message));
+        free(rec.message);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static int kmsg_start(Watcher *w) {
+    w->kmsg_fd = kmsg_open_follow();
+    if (w->kmsg_fd < 0) {
+        fprintf(stderr, "Not watching the kernel log: %s\n", strerror(errno));
+        return -1;
+    }
+    w->kmsg_src = watch_fd(w, w->kmsg_fd, G_IO_IN, on_kmsg_event);
+    return 0;
+}
+
+/* ---- Log files ---- */
+
+// Live text logs only: rotated and compressed copies and the binary login records are skipped
+static int tailable(const char *name) {
+    static const char *const skip[] = {".gz", ".xz", ".zst", ".bz2", ".old", NULL};
+    static const char *const binary[] = {"wtmp", "btmp", "lastlog", "faillog", NULL};
+    if (name[0] == '.') return 0;
+    for (int i = 0; skip[i]; ++i) {
+        if (has_suffix(name, skip[i])) return 0;
+    }
+    for (int i = 0; binary[i]; ++i) {
+        if (strcmp(name, binary[i]) == 0) return 0;
+    }
+    const char *dot = strrchr(name, '.');
+    if (dot && dot[1] && strspn(dot + 1, "0123456789") == strlen(dot + 1)) return 0; // pacman.log.1
+    return 1;
+}
+
+static TailedFile* find_file(Watcher *w, const char *name) {
+    for (size_t i = 0; i < w->nfiles; ++i) {
+        if (strcmp(w->files[i].name, name) == 0) return &w->files[i];
+    }
+    return NULL;
+}
+
+static TailedFile* add_file(Watcher *w, const char *name, off_t offset, ino_t ino) {
+    if (w->nfiles == w->files_cap) {
+        size_t cap = w->files_cap ? w->files_cap * 2 : 32;
+        TailedFile *n = realloc(w->files, cap * sizeof(TailedFile));
+        if (!n) return NULL;
+        w->files = n;
+        w->files_cap = cap;
+    }
+    TailedFile *f = &w->files[w->nfiles++];
+    memset(f, 0, sizeof(*f));
+    snprintf(f->name, sizeof(f->name), "%s", name);
+    f->offset = offset;
+    f->ino = ino;
+    return f;
+}
+
+static void remove_file(Watcher *w, const char *name) {
+    TailedFile *f = find_file(w, name);
+    if (f) *f = w->files[--w->nfiles];
+}
+
+// Match the complete lines appended to f since the last read
+static void file_read_new(Watcher *w, TailedFile *f) {
+    if (f->ignored) return;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", WATCH_LOG_DIR, f->name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK);
+    if (fd < 0) {
+        if (errno == EACCES || errno == ELOOP) f->ignored = 1;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        f->ignored = 1;
+        close(fd);
+        return;
+    }
+    // A different inode was renamed over it, or it was truncated (copytruncate): start over
+    if (st.st_ino != f->ino || st.st_size < f->offset) {
+        f->ino = st.st_ino;
+        f->offset = 0;
+    }
+    // After a flood only the newest data is matched
+    if (st.st_size - f->offset > WATCH_READ_MAX) f->offset = st.st_size - WATCH_READ_MAX;
+
+    while (f->offset < st.st_size) {
+        size_t want = (size_t)(st.st_size - f->offset);
+        if (want > WATCH_READ_MAX) want = WATCH_READ_MAX;
+        ssize_t r = pread(fd, w->read_buf, want, f->offset);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        if (memchr(w->read_buf, '\0', (size_t)r)) {
+            f->ignored = 1;
+            break;
+        }
+        const char *p = w->read_buf, *end = w->read_buf + r;
+        const char *nl;
+        while ((nl = memchr(p, '\n', (size_t)(end - p)))) {
+            feed(w, f->name, p, (size_t)(nl - p));
+            p = nl + 1;
+        }
+        // A partial last line is matched once it is complete, unless it fills the buffer
+        if (p == w->read_buf && (size_t)r == WATCH_READ_MAX) {
+            feed(w, f->name, p, (size_t)r);
+            p = end;
+        }
+        f->offset += p - w->read_buf;
+        if (p != end) break;
+    }
+    close(fd);
+}
+
+static gboolean on_inotify_event(GIOChannel *ch, GIOCondition cond, gpointer data) {
+    (void)ch;
+    (void)cond;
+    Watcher *w = data;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t r = read(w->inotify_fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        for (char *p = buf; p < buf + r;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // Events were lost: check every file
+                for (size_t i = 0; i < w->nfiles; ++i) file_read_new(w, &w->files[i]);
+                continue;
+            }
+            if (ev->len == 0 || (ev->mask & IN_ISDIR) || !tailable(ev->name)) continue;
+            if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                remove_file(w, ev->name);
+                continue;
+            }
+            TailedFile *f = find_file(w, ev->name);
+            if (f && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                f->offset = 0;
+                f->ignored = 0;
+            }
+            // A file created between the initial listing and the watch is read from the start
+            if (!f) f = add_file(w, ev->name, 0, 0);
+            if (f) file_read_new(w, f);
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static int files_start(Watcher *w) {
+    w->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->inotify_fd < 0 ||
+        inotify_add_watch(w->inotify_fd, WATCH_LOG_DIR, IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        fprintf(stderr, "Not watching %s: %s\n", WATCH_LOG_DIR, strerror(errno));
+        if (w->inotify_fd >= 0) close(w->inotify_fd);
+        w->inotify_fd = -1;
+        return -1;
+    }
+    w->read_buf = malloc(WATCH_READ_MAX);
+    if (!w->read_buf) {
+        close(w->inotify_fd);
+        w->inotify_fd = -1;
+        return -1;
+    }
+    // Existing content was there before we started; follow from the current end
+    DIR *d = opendir(WATCH_LOG_DIR);
+    if (d) {
+        int dfd = dirfd(d);
+        struct dirent *de;
+        while ((de = readdir(d))) {
+            struct stat st;
+            if (!tailable(de->d_name) || fstatat(dfd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+            add_file(w, de->d_name, st.st_size, st.st_ino);
+        }
+        closedir(d);
+    }
+    w->inotify_src = watch_fd(w, w->inotify_fd, G_IO_IN, on_inotify_event);
+    return 0;
+}
+
+Watcher* watcher_start(const WatchOptions *opts, WatchTriggerFn on_trigger, void *user) {
+    Watcher *w = calloc(1, sizeof(Watcher));
+    if (!w) return NULL;
+    w->opts = *opts;
+    if (w->opts.threshold == 0) w->opts.threshold = 1;
+    w->hit_times = calloc(w->opts.threshold, sizeof(gint64));
+    if (!w->hit_times) {
+        free(w);
+        return NULL;
+    }
+    w->on_trigger = on_trigger;
+    w->user = user;
+    w->ctx = g_main_context_ref_thread_default();
+    w->self = getpid();
+    w->kmsg_fd = -1;
+    w->inotify_fd = -1;
+
+    int sources = 0;
+    if (journal_start(w) == 0) sources++;
+    if (kmsg_start(w) == 0) sources++;
+    if (files_start(w) == 0) sources++;
+    if (sources == 0) {
+        watcher_stop(w);
+        return NULL;
+    }
+    return w;
+}
+
+void watcher_stop(Watcher *w) {
+    if (!w) return;
+    drop_source(&w->settle);
+    drop_source(&w->journal_src);
+    drop_source(&w->journal_timer);
+    drop_source(&w->kmsg_src);
+    drop_source(&w->inotify_src);
+    if (w->journal) sd_journal_close(w->journal);
+    if (w->kmsg_fd >= 0) close(w->kmsg_fd);
+    if (w->inotify_fd >= 0) close(w->inotify_fd);
+    free(w->files);
+    free(w->read_buf);
+    free(w->hit_times);
+    g_main_context_unref(w->ctx);
+    free(w);
+}
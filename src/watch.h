@@ -0,0 +1,39 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stddef.h>
+#include "severity.h"
+
+// Resident error detection. New journal entries (through the sd-journal descriptor),
+// new /dev/kmsg records and lines appended to the log files directly in WATCH_LOG_DIR
+// (pacman.log among them, followed with inotify) are run through the severity matcher as
+// they arrive; nothing is re-read and nothing polls, so an idle system costs no CPU.
+// When enough lines at or above WATCH_MIN_LEVEL arrive within the window, the trigger
+// callback runs, after WATCH_SETTLE_MS so the rest of a burst lands first, and then not
+// again until the cooldown has passed.
+
+typedef struct {
+    unsigned threshold;      // matching lines within window_sec; a critical line always triggers
+    unsigned window_sec;
+    unsigned cooldown_sec;
+} WatchOptions;
+
+typedef struct {
+    char source[64];         // "journal", "kernel", or the log file's name
+    char line[512];          // the line that crossed the threshold (truncated)
+    Severity severity;       // highest severity seen since then
+    size_t lines;            // matching lines in the window, plus those during the settle delay
+} WatchTrigger;
+
+// Runs on the main loop the watcher was started on
+typedef void (*WatchTriggerFn)(const WatchTrigger *trigger, void *user);
+
+typedef struct Watcher Watcher;
+
+// Start watching on the thread-default main context. Sources this process cannot read
+// are skipped with a message; returns NULL when none could be opened.
+Watcher* watcher_start(const WatchOptions *opts, WatchTriggerFn on_trigger, void *user);
+
+void watcher_stop(Watcher *w);
+
+#endif // WATCH_H
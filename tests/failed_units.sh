@@ -0,0 +1,68 @@
+#!/bin/sh
+# Runs the reporter against tests/mock_systemd.c on a private session bus (through
+# CRASH_REPORTER_SYSTEM_BUS) and checks the failed-unit sections it renders from
+# ListUnitsFiltered and the units' properties.
+#
+# usage: tests/failed_units.sh [path/to/crash_reporter]
+# MOCK_SYSTEMD may name an already built mock; otherwise it is built with pkg-config.
+# Exit status 0 passed, 1 failed, 77 skipped (no dbus-run-session).
+
+BIN=$(realpath "${1:-./crash_reporter}")
+HERE=$(dirname "$(realpath "$0")")
+T=$(mktemp -d)
+trap 'rm -rf "$T"' EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+command -v dbus-run-session >/dev/null || { echo "SKIP: dbus-run-session not found"; exit 77; }
+MOCK=${MOCK_SYSTEMD:-$T/mock_systemd}
+if [ -z "$MOCK_SYSTEMD" ]; then
+    cc -o "$MOCK" "$HERE/mock_systemd.c" $(pkg-config --cflags --libs gio-2.0) || fail "could not build the mock"
+fi
+
+export HOME="$T" XDG_STATE_HOME="$T/state" XDG_CACHE_HOME="$T/cache"
+export BIN MOCK T
+dbus-run-session -- sh -c '
+    mkfifo "$T/ready"
+    "$MOCK" >"$T/ready" &
+    read line <"$T/ready" && [ "$line" = ready ] || exit 1
+    CRASH_REPORTER_SYSTEM_BUS="$DBUS_SESSION_BUS_ADDRESS" "$BIN" --headless --format=json -o "$T/report.json" \
+        >/dev/null 2>"$T/stderr"
+    [ -s "$T/report.json" ]
+' || fail "no report against the mock systemd"
+
+section() { # title
+    python3 -c "import json, sys
+for s in json.load(open(sys.argv[1]))['sections']:
+    if s['title'] == sys.argv[2]: print(s['text'])" "$T/report.json" "$1"
+}
+
+has() { # text, line expected in it
+    printf '%s\n' "$1" | grep -qxF -- "$2" || fail "missing line: $2"
+}
+
+LIST=$(section "Systemd Failed Units")
+[ -n "$LIST" ] || fail "no failed units section"
+has "$LIST" "  UNIT                LOAD   ACTIVE SUB    DESCRIPTION"
+has "$LIST" "● mock-broken.service loaded failed failed Mock broken service"
+has "$LIST" "● mock-crash.service  loaded failed failed Mock crashing service"
+has "$LIST" "2 loaded units listed."
+
+STATUS=$(section "Detailed Failed Unit Statuses")
+[ -n "$STATUS" ] || fail "no unit status section"
+has "$STATUS" "× mock-broken.service - Mock broken service"
+has "$STATUS" "     Loaded: loaded (/usr/lib/systemd/system/mock-broken.service)"
+has "$STATUS" "   Main PID: 4242 (code=exited, status=3)"
+has "$STATUS" "   Restarts: 2"
+has "$STATUS" "× mock-crash.service - Mock crashing service"
+has "$STATUS" "   Main PID: 4343 (code=dumped, signal=SIGSEGV)"
+printf '%s\n' "$STATUS" | grep -q "^     Active: failed (Result: exit-code) since 2023-11-1" ||
+    fail "mock-broken.service: no result and failure time"
+printf '%s\n' "$STATUS" | grep -q "^     Active: failed (Result: core-dump) since 2023-11-1" ||
+    fail "mock-crash.service: no result and failure time"
+[ "$(printf '%s\n' "$STATUS" | grep -c '^---$')" -eq 2 ] || fail "expected two status blocks"
+
+echo "PASS"
@@ -0,0 +1,118 @@
+#!/bin/sh
+# Files tests/crash_report.txt (through CRASH_REPORTER_REPORT_INPUT) against
+# tests/mock_github.py (through CRASH_REPORTER_GITHUB_API) and checks the
+# find/create/comment flow:
+#   1. a new fingerprint is searched for, then filed as a new issue
+#   2. without the local index, the search finds that issue and it gets a comment
+#   3. with the index, it gets a comment without a search
+#   4. two queued reports of the same crash, drained together, give one issue and a comment
+#
+# usage: tests/github_flow.sh [path/to/crash_reporter]
+# Exit status 0 passed, 1 failed.
+
+BIN=$(realpath "${1:-./crash_reporter}")
+HERE=$(dirname "$(realpath "$0")")
+T=$(mktemp -d)
+MOCK=
+trap '[ -n "$MOCK" ] && kill $MOCK 2>/dev/null; rm -rf "$T"' EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+PORT=$(python3 -c 'import socket; s = socket.socket(); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1])')
+export CRASH_REPORTER_GITHUB_API="http://127.0.0.1:$PORT"
+export CRASH_REPORTER_GITHUB_TOKEN=test-token
+export CRASH_REPORTER_REPORT_INPUT="$HERE/crash_report.txt"
+
+start_mock() { # [create delay]
+    : > "$T/log"
+    python3 "$HERE/mock_github.py" "$PORT" "$T/log" "${1:-0}" &
+    MOCK=$!
+    for _ in 1 2 3 4 5 6 7 8 9 10; do
+        python3 -c "import socket; socket.create_connection(('127.0.0.1', $PORT))" 2>/dev/null && return
+        sleep 0.2
+    done
+    fail "mock server did not start"
+}
+
+stop_mock() {
+    kill $MOCK 2>/dev/null
+    wait $MOCK 2>/dev/null
+    MOCK=
+}
+
+use_home() { # fresh state for a step
+    export HOME="$T/$1" XDG_STATE_HOME="$T/$1/state" XDG_CACHE_HOME="$T/$1/cache"
+    mkdir -p "$HOME"
+}
+
+file_issue() { # output file
+    "$BIN" --file-issue --no-ai --format=json -o "$1" >>"$T/stdout" 2>>"$T/stderr"
+}
+
+field() { # file, python expression over the report as r
+    python3 -c "import json, sys; r = json.load(open(sys.argv[1])); print($2)" "$1"
+}
+
+ops() { # operations logged by the mock, one per line
+    python3 -c "import json, sys; [print(json.loads(l)['op']) for l in open(sys.argv[1])]" "$T/log" | tr '\n' ' '
+}
+
+use_home flow
+start_mock
+file_issue "$T/r1.json"
+rc=$?
+[ $rc -eq 1 ] || fail "first report exited with $rc"
+FP=$(field "$T/r1.json" "r['fingerprint']['id']")
+case "$FP" in crfp-*) ;; *) fail "the report has no fingerprint" ;; esac
+URL=$(field "$T/r1.json" "r['issue']['url']")
+[ "$(field "$T/r1.json" "r['issue']['action']")" = created ] || fail "first report was not filed as a new issue"
+[ "$(ops)" = "search create " ] || fail "first report: expected a search and a create, got: $(ops)"
+grep -q "$FP" "$T/log" || fail "the new issue does not carry fingerprint $FP"
+
+# Same crash, index gone: found by the search
+rm -f "$XDG_STATE_HOME/crash-reporter/fingerprints.json"
+: > "$T/log"
+file_issue "$T/r2.json"
+[ "$(field "$T/r2.json" "r['fingerprint']['id']")" = "$FP" ] || fail "the fingerprint changed between runs"
+[ "$(field "$T/r2.json" "r['issue']['action']")" = commented ] || fail "second report did not comment"
+[ "$(field "$T/r2.json" "r['issue']['url']")" = "$URL" ] || fail "second report commented on another issue"
+[ "$(ops)" = "search comment " ] || fail "second report: expected a search and a comment, got: $(ops)"
+
+# Index in place: no search needed
+: > "$T/log"
+file_issue "$T/r3.json"
+[ "$(field "$T/r3.json" "r['issue']['action']")" = commented ] || fail "third report did not comment"
+[ "$(ops)" = "comment " ] || fail "third report: expected only a comment, got: $(ops)"
+stop_mock
+
+# Offline twice: both queued as new issues with the same fingerprint
+use_home spool
+file_issue "$T/q1.json"
+file_issue "$T/q2.json"
+for q in q1 q2; do
+    [ "$(field "$T/$q.json" "r['issue']['action']")" = queued ] || fail "offline report $q was not queued"
+done
+for q in q1 q2; do
+    [ "$(field "$T/$q.json" "r['fingerprint']['id']")" = "$FP" ] || fail "offline report $q has another fingerprint"
+done
+
+# Online again, with creation slow enough that both would be in flight at once
+start_mock 2
+"$BIN" --watch --file-issue --no-ai --format=json -o "$T/watch.json" >>"$T/stdout" 2>>"$T/stderr" &
+WATCH=$!
+for _ in $(seq 1 40); do
+    [ -z "$(find "$XDG_STATE_HOME/crash-reporter/spool" -maxdepth 1 -name '*.json.gz')" ] && break
+    sleep 0.25
+done
+kill -INT $WATCH
+wait $WATCH
+creates=$(python3 -c "import json, sys; print(sum(1 for l in open(sys.argv[1]) if json.loads(l)['op'] == 'create' and sys.argv[2] in json.loads(l)['body']))" "$T/log" "$FP")
+comments=$(python3 -c "import json, sys; print(sum(1 for l in open(sys.argv[1]) if json.loads(l)['op'] == 'comment'))" "$T/log")
+[ -z "$(find "$XDG_STATE_HOME/crash-reporter/spool" -maxdepth 1 -name '*.json.gz')" ] || fail "the spool was not drained"
+[ "$creates" -eq 1 ] || fail "draining the spool filed $creates issues for one crash"
+[ "$comments" -ge 1 ] || fail "the second queued report did not comment on the first one's issue"
+
+echo "PASS"
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Minimal stand-in for the parts of the GitHub REST API the reporter uses: issue search,
+# issue creation and comments. Issues live in memory. Every request is appended to the
+# log file as one JSON line, so a test can check what was asked and in which order.
+#
+# usage: mock_github.py PORT LOG [CREATE_DELAY_SEC]
+
+import json
+import sys
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+port, log_path = int(sys.argv[1]), sys.argv[2]
+create_delay = float(sys.argv[3]) if len(sys.argv) > 3 else 0.0
+lock = threading.Lock()
+issues = []
+
+
+def log(entry):
+    with lock, open(log_path, "a") as f:
+        f.write(json.dumps(entry) + "\n")
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def reply(self, status, obj):
+        data = json.dumps(obj).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_GET(self):
+        url = urllib.parse.urlsplit(self.path)
+        if url.path != "/search/issues":
+            return self.reply(404, {"message": "Not Found"})
+        query = urllib.parse.parse_qs(url.query).get("q", [""])[0]
+        term = query.split('"')[1] if query.count('"') >= 2 else query
+        log({"op": "search", "term": term})
+        with lock:
+            items = [dict(i) for i in issues if term in i["body"]]
+        self.reply(200, {"total_count": len(items), "items": items})
+
+    def do_POST(self):
+        body = json.loads(self.rfile.read(int(self.headers.get("Content-Length", 0))) or b"{}")
+        parts = self.path.strip("/").split("/")
+        # /repos/OWNER/NAME/issues and /repos/OWNER/NAME/issues/N/comments
+        if len(parts) == 4 and parts[0] == "repos" and parts[3] == "issues":
+            time.sleep(create_delay)
+            with lock:
+                number = len(issues) + 1
+                url = "https://github.invalid/%s/%s/issues/%d" % (parts[1], parts[2], number)
+                issues.append({"number": number, "html_url": url, "state": "open",
+                               "title": body.get("title", ""), "body": body.get("body", "")})
+            log({"op": "create", "number": number, "body": body.get("body", "")})
+            return self.reply(201, {"number": number, "html_url": url})
+        if len(parts) == 6 and parts[0] == "repos" and parts[3] == "issues" and parts[5] == "comments":
+            number = int(parts[4])
+            with lock:
+                known = any(i["number"] == number for i in issues)
+            if not known:
+                return self.reply(404, {"message": "Not Found"})
+            log({"op": "comment", "number": number, "body": body.get("body", "")})
+            return self.reply(201, {"html_url": "https://github.invalid/comment/%d" % number})
+        self.reply(404, {"message": "Not Found"})
+
+
+ThreadingHTTPServer(("127.0.0.1", port), Handler).serve_forever()
@@ -0,0 +1,135 @@
+/* Mock systemd for tests/failed_units.sh
+ * Takes org.freedesktop.systemd1 on the session bus and serves what units.c asks of
+ * systemd: ListUnitsFiltered on the manager and the Unit and Service properties of two
+ * failed units, one that exited with an error and one that dumped core. Prints "ready"
+ * once the name is owned.
+ *
+ * cc -o mock_systemd tests/mock_systemd.c $(pkg-config --cflags --libs gio-2.0)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <gio/gio.h>
+
+#define UNIT_PATH "/org/freedesktop/systemd1/unit/"
+
+typedef struct {
+    const char *name, *description, *path, *fragment_path, *result;
+    guint64 inactive_enter_usec;
+    gint32 exec_main_code, exec_main_status;
+    guint32 exec_main_pid, restarts;
+} MockUnit;
+
+static const MockUnit units[] = {
+    { "mock-broken.service", "Mock broken service", UNIT_PATH "mock_2dbroken_2eservice",
+      "/usr/lib/systemd/system/mock-broken.service", "exit-code", 1700000000000000ULL, CLD_EXITED, 3, 4242, 2 },
+    { "mock-crash.service", "Mock crashing service", UNIT_PATH "mock_2dcrash_2eservice",
+      "/usr/lib/systemd/system/mock-crash.service", "core-dump", 1700000060000000ULL, CLD_DUMPED, SIGSEGV, 4343, 0 },
+};
+#define NUNITS (sizeof(units) / sizeof(units[0]))
+
+static const char introspection[] =
+    "<node>"
+    "  <interface name='org.freedesktop.systemd1.Manager'>"
+    "    <method name='ListUnitsFiltered'>"
+    "      <arg type='as' name='states' direction='in'/>"
+    "      <arg type='a(ssssssouso)' name='units' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.systemd1.Unit'>"
+    "    <property type='s' name='FragmentPath' access='read'/>"
+    "    <property type='t' name='InactiveEnterTimestamp' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.freedesktop.systemd1.Service'>"
+    "    <property type='s' name='Result' access='read'/>"
+    "    <property type='i' name='ExecMainCode' access='read'/>"
+    "    <property type='i' name='ExecMainStatus' access='read'/>"
+    "    <property type='u' name='ExecMainPID' access='read'/>"
+    "    <property type='u' name='NRestarts' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+static void manager_call(GDBusConnection *bus, const gchar *sender, const gchar *path, const gchar *iface,
+                         const gchar *method, GVariant *params, GDBusMethodInvocation *invocation, gpointer user) {
+    (void)bus; (void)sender; (void)path; (void)iface; (void)method; (void)user;
+    // Every unit is failed, so any filter naming "failed" gets them all
+    GVariantIter *it;
+    const char *state;
+    int failed = 0;
+    g_variant_get(params, "(as)", &it);
+    while (g_variant_iter_next(it, "&s", &state)) failed |= strcmp(state, "failed") == 0;
+    g_variant_iter_free(it);
+
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE("a(ssssssouso)"));
+    for (size_t i = 0; failed && i < NUNITS; ++i) {
+        g_variant_builder_add(&b, "(ssssssouso)", units[i].name, units[i].description, "loaded", "failed", "failed",
+                              "", units[i].path, 0u, "", "/");
+    }
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(ssssssouso))", &b));
+}
+
+static GVariant* unit_property(GDBusConnection *bus, const gchar *sender, const gchar *path, const gchar *iface,
+                               const gchar *name, GError **error, gpointer user) {
+    (void)bus; (void)sender; (void)iface; (void)error; (void)user;
+    const MockUnit *u = NULL;
+    for (size_t i = 0; i < NUNITS && !u; ++i) {
+        if (strcmp(units[i].path, path) == 0) u = &units[i];
+    }
+    if (!u) return NULL;
+    if (strcmp(name, "FragmentPath") == 0) return g_variant_new_string(u->fragment_path);
+    if (strcmp(name, "InactiveEnterTimestamp") == 0) return g_variant_new_uint64(u->inactive_enter_usec);
+    if (strcmp(name, "Result") == 0) return g_variant_new_string(u->result);
+    if (strcmp(name, "ExecMainCode") == 0) return g_variant_new_int32(u->exec_main_code);
+    if (strcmp(name, "ExecMainStatus") == 0) return g_variant_new_int32(u->exec_main_status);
+    if (strcmp(name, "ExecMainPID") == 0) return g_variant_new_uint32(u->exec_main_pid);
+    if (strcmp(name, "NRestarts") == 0) return g_variant_new_uint32(u->restarts);
+    return NULL;
+}
+
+int main(void) {
+    GError *err = NULL;
+    GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &err);
+    GDBusNodeInfo *node = bus ? g_dbus_node_info_new_for_xml(introspection, &err) : NULL;
+    if (!node) {
+        fprintf(stderr, "mock_systemd: %s\n", err ? err->message : "no session bus");
+        return 1;
+    }
+
+    static const GDBusInterfaceVTable manager_vtable = { manager_call, NULL, NULL, { 0 } };
+    static const GDBusInterfaceVTable unit_vtable = { NULL, unit_property, NULL, { 0 } };
+    int ok = g_dbus_connection_register_object(bus, "/org/freedesktop/systemd1",
+                                               g_dbus_node_info_lookup_interface(node, "org.freedesktop.systemd1.Manager"),
+                                               &manager_vtable, NULL, NULL, &err) > 0;
+    for (size_t i = 0; ok && i < NUNITS; ++i) {
+        ok = g_dbus_connection_register_object(bus, units[i].path,
+                                               g_dbus_node_info_lookup_interface(node, "org.freedesktop.systemd1.Unit"),
+                                               &unit_vtable, NULL, NULL, &err) > 0 &&
+             g_dbus_connection_register_object(bus, units[i].path,
+                                               g_dbus_node_info_lookup_interface(node, "org.freedesktop.systemd1.Service"),
+                                               &unit_vtable, NULL, NULL, &err) > 0;
+    }
+    // DBUS_NAME_FLAG_DO_NOT_QUEUE; 1 is DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER
+    GVariant *reply = ok ? g_dbus_connection_call_sync(bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                                       "org.freedesktop.DBus", "RequestName",
+                                                       g_variant_new("(su)", "org.freedesktop.systemd1", 4u),
+                                                       G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &err)
+                         : NULL;
+    guint32 owned = 0;
+    if (reply) {
+        g_variant_get(reply, "(u)", &owned);
+        g_variant_unref(reply);
+    }
+    if (owned != 1) {
+        fprintf(stderr, "mock_systemd: could not serve org.freedesktop.systemd1: %s\n",
+                err ? err->message : "name taken");
+        return 1;
+    }
+
+    printf("ready\n");
+    fflush(stdout);
+    g_main_loop_run(g_main_loop_new(NULL, FALSE));
+    return 0;
+}